@@ -0,0 +1,184 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <memory>
+
+#include <Windows.h>
+#include <ctThreadIocp.hpp>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ///
+    /// The context given to pooled requests
+    /// - the shared_ptr tracks when the request's copy of the context is destroyed
+    ///
+    struct TestRequestContext {
+        std::shared_ptr<int> lifetime;
+        HANDLE completed_event = nullptr;
+        DWORD bytes_to_write = 0;
+    };
+
+    static volatile LONG s_completed_bytes = 0;
+
+    static void TestPooledCallback(OVERLAPPED* _overlapped, TestRequestContext& _context) noexcept
+    {
+        if (_overlapped->Internal == 0) {
+            ::InterlockedAdd(&s_completed_bytes, static_cast<LONG>(_context.bytes_to_write));
+        }
+        ::SetEvent(_context.completed_event);
+    }
+
+    static void NeverCalledCallback(OVERLAPPED*, TestRequestContext&) noexcept
+    {
+        Assert::Fail(L"The callback for a canceled request should never be invoked");
+    }
+
+    ///
+    /// Opens a temporary file for overlapped IO, deleted once closed
+    ///
+    static HANDLE OpenTestFile()
+    {
+        wchar_t temp_path[MAX_PATH + 1]{};
+        wchar_t temp_file[MAX_PATH + 1]{};
+        Assert::AreNotEqual(0UL, ::GetTempPathW(MAX_PATH, temp_path));
+        Assert::AreNotEqual(0U, ::GetTempFileNameW(temp_path, L"cts", 0, temp_file));
+        const HANDLE file = ::CreateFileW(
+            temp_file,
+            GENERIC_READ | GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE,
+            nullptr);
+        Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+        return file;
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctl;
+namespace ctsUnitTest {
+    TEST_CLASS(ctThreadIocpUnitTest)
+    {
+    public:
+        TEST_METHOD(CanceledPooledRequestDestroysContext)
+        {
+            const HANDLE file = OpenTestFile();
+            {
+                ctThreadIocp iocp(file);
+                TestRequestContext context;
+                context.lifetime = std::make_shared<int>(0);
+
+                OVERLAPPED* pov = iocp.new_pooled_request(NeverCalledCallback, context);
+                Assert::IsNotNull(pov);
+                // the request holds its own copy of the context
+                Assert::AreEqual(2L, context.lifetime.use_count());
+
+                iocp.cancel_request(pov);
+                Assert::AreEqual(1L, context.lifetime.use_count());
+            }
+            ::CloseHandle(file);
+        }
+
+        TEST_METHOD(CanceledPooledRequestIsReused)
+        {
+            const HANDLE file = OpenTestFile();
+            {
+                ctThreadIocp iocp(file);
+                TestRequestContext context;
+
+                OVERLAPPED* first_pov = iocp.new_pooled_request(NeverCalledCallback, context);
+                iocp.cancel_request(first_pov);
+                // the canceled request went back to this thread's free list: the next request reuses it
+                OVERLAPPED* second_pov = iocp.new_pooled_request(NeverCalledCallback, context);
+                Assert::IsTrue(first_pov == second_pov);
+                // and is handed out zeroed, ready for the next Win32 call
+                Assert::AreEqual(static_cast<ULONG_PTR>(0), second_pov->Internal);
+                Assert::AreEqual(0UL, second_pov->Offset);
+                iocp.cancel_request(second_pov);
+            }
+            ::CloseHandle(file);
+        }
+
+        TEST_METHOD(PooledRequestsComplete)
+        {
+            static const DWORD WriteCount = 64;
+            static const DWORD WriteSize = 512;
+            char write_buffer[WriteSize]{};
+
+            s_completed_bytes = 0;
+            const HANDLE file = OpenTestFile();
+            const HANDLE completed_event = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            Assert::IsNotNull(completed_event);
+            const auto lifetime = std::make_shared<int>(0);
+            {
+                ctThreadIocp iocp(file);
+                for (DWORD write = 0; write < WriteCount; ++write) {
+                    TestRequestContext context;
+                    context.lifetime = lifetime;
+                    context.completed_event = completed_event;
+                    context.bytes_to_write = WriteSize;
+
+                    OVERLAPPED* pov = iocp.new_pooled_request(TestPooledCallback, context);
+                    pov->Offset = write * WriteSize;
+                    if (!::WriteFile(file, write_buffer, WriteSize, nullptr, pov)) {
+                        const DWORD gle = ::GetLastError();
+                        if (gle != ERROR_IO_PENDING) {
+                            iocp.cancel_request(pov);
+                            Assert::Fail(L"WriteFile failed");
+                        }
+                    }
+                    // one write at a time: completions free requests back to the free lists as they go
+                    Assert::AreEqual(WAIT_OBJECT_0, ::WaitForSingleObject(completed_event, 5000));
+                }
+            }
+            // every completion destroyed its copy of the context
+            Assert::AreEqual(1L, lifetime.use_count());
+            Assert::AreEqual(static_cast<LONG>(WriteCount * WriteSize), static_cast<LONG>(s_completed_bytes));
+
+            ::CloseHandle(completed_event);
+            ::CloseHandle(file);
+        }
+
+        TEST_METHOD(FunctionRequestsStillComplete)
+        {
+            char write_buffer[16]{};
+            const HANDLE file = OpenTestFile();
+            const HANDLE completed_event = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            Assert::IsNotNull(completed_event);
+            {
+                ctThreadIocp iocp(file);
+                OVERLAPPED* pov = iocp.new_request([completed_event](OVERLAPPED*) noexcept { ::SetEvent(completed_event); });
+                if (!::WriteFile(file, write_buffer, sizeof write_buffer, nullptr, pov)) {
+                    const DWORD gle = ::GetLastError();
+                    if (gle != ERROR_IO_PENDING) {
+                        iocp.cancel_request(pov);
+                        Assert::Fail(L"WriteFile failed");
+                    }
+                }
+                Assert::AreEqual(WAIT_OBJECT_0, ::WaitForSingleObject(completed_event, 5000));
+            }
+            ::CloseHandle(completed_event);
+            ::CloseHandle(file);
+        }
+    };
+}
@@ -0,0 +1,432 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <Windows.h>
+#include <Psapi.h>
+
+#include "ctsBufferSlab.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    struct FakeRegistration {
+        char* buffer;
+        DWORD length;
+        RIO_BUFFERID buffer_id;
+    };
+
+    static std::vector<FakeRegistration> s_Registered;
+    static std::vector<RIO_BUFFERID> s_Deregistered;
+    static ULONG_PTR s_NextBufferId = 1;
+    static bool s_FailRegistration = false;
+
+    RIO_BUFFERID FakeRegisterBuffer(_In_ char* _buffer, DWORD _length)
+    {
+        if (s_FailRegistration) {
+            return RIO_INVALID_BUFFERID;
+        }
+        const auto buffer_id = reinterpret_cast<RIO_BUFFERID>(s_NextBufferId++);
+        s_Registered.push_back(FakeRegistration {_buffer, _length, buffer_id});
+        return buffer_id;
+    }
+
+    void FakeDeregisterBuffer(RIO_BUFFERID _buffer_id)
+    {
+        s_Deregistered.push_back(_buffer_id);
+    }
+
+    ctsTraffic::ctsBufferRegistrar FakeRegistrar()
+    {
+        s_Registered.clear();
+        s_Deregistered.clear();
+        s_FailRegistration = false;
+
+        ctsTraffic::ctsBufferRegistrar registrar;
+        registrar.register_buffer = FakeRegisterBuffer;
+        registrar.deregister_buffer = FakeDeregisterBuffer;
+        return registrar;
+    }
+
+    std::vector<char*> AllocateBuffers(ctsTraffic::ctsBufferSlab& _slab, unsigned long _count)
+    {
+        std::vector<char*> buffers;
+        for (unsigned long count = 0; count < _count; ++count) {
+            char* buffer = _slab.allocate();
+            Assert::IsNotNull(buffer);
+            buffers.push_back(buffer);
+        }
+        return buffers;
+    }
+
+    void DeallocateBuffers(ctsTraffic::ctsBufferSlab& _slab, const std::vector<char*>& _buffers)
+    {
+        for (auto* buffer : _buffers) {
+            _slab.deallocate(buffer);
+        }
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    // the length of a connection id
+    static const unsigned long BufferLength = 37;
+
+    TEST_CLASS(ctsBufferSlabUnitTest)
+    {
+    public:
+        TEST_METHOD(ChunksAreWholePages)
+        {
+            ::SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            Assert::AreEqual(system_info.dwPageSize / BufferLength, slab.buffers_per_chunk());
+            Assert::AreEqual(0UL, slab.committed_chunk_count());
+
+            const auto buffers(AllocateBuffers(slab, 1));
+            Assert::AreEqual(1UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(1), s_Registered.size());
+            Assert::AreEqual(system_info.dwPageSize, s_Registered[0].length);
+            DeallocateBuffers(slab, buffers);
+        }
+
+        TEST_METHOD(GrowsAChunkAtATime)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const unsigned long per_chunk = slab.buffers_per_chunk();
+
+            auto buffers(AllocateBuffers(slab, per_chunk));
+            Assert::AreEqual(1UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(1), s_Registered.size());
+
+            buffers.push_back(slab.allocate());
+            Assert::IsNotNull(buffers.back());
+            Assert::AreEqual(2UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(2), s_Registered.size());
+            // chunks are back to back
+            Assert::IsTrue(s_Registered[0].buffer + s_Registered[0].length == s_Registered[1].buffer);
+
+            DeallocateBuffers(slab, buffers);
+        }
+
+        TEST_METHOD(BuffersKeepTheirChunksBufferId)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const auto buffers(AllocateBuffers(slab, slab.buffers_per_chunk() * 3));
+            Assert::AreEqual(static_cast<size_t>(3), s_Registered.size());
+
+            for (auto* buffer : buffers) {
+                const auto registration = std::find_if(s_Registered.begin(), s_Registered.end(), [&](const FakeRegistration& _registration) {
+                    return buffer >= _registration.buffer && buffer + BufferLength <= _registration.buffer + _registration.length;
+                });
+                Assert::IsTrue(registration != s_Registered.end());
+                Assert::IsTrue(registration->buffer == slab.chunk_base(buffer));
+                Assert::IsTrue(registration->buffer_id == slab.chunk_buffer_id(buffer));
+            }
+            DeallocateBuffers(slab, buffers);
+        }
+
+        TEST_METHOD(GivesOutEachBufferOnce)
+        {
+            // not a multiple of the chunk size: the last chunk holds only what's left
+            const unsigned long max_buffers = 250;
+            ctsBufferSlab slab(BufferLength, 10, max_buffers, FakeRegistrar());
+
+            auto buffers(AllocateBuffers(slab, max_buffers));
+            Assert::IsNull(slab.allocate());
+
+            std::sort(buffers.begin(), buffers.end());
+            Assert::IsTrue(std::adjacent_find(buffers.begin(), buffers.end()) == buffers.end());
+            for (size_t index = 1; index < buffers.size(); ++index) {
+                Assert::IsTrue(buffers[index] - buffers[index - 1] >= static_cast<ptrdiff_t>(BufferLength));
+            }
+            DeallocateBuffers(slab, buffers);
+        }
+
+        TEST_METHOD(ReusesTheMostRecentlyFreed)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const auto buffers(AllocateBuffers(slab, 10));
+            DeallocateBuffers(slab, buffers);
+
+            const auto buffers_second(AllocateBuffers(slab, 10));
+            auto iter_first = buffers.rbegin();
+            for (auto* buffer : buffers_second) {
+                Assert::IsTrue(*iter_first == buffer);
+                ++iter_first;
+            }
+            DeallocateBuffers(slab, buffers_second);
+        }
+
+        TEST_METHOD(FillsTheLowestChunkFirst)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const unsigned long per_chunk = slab.buffers_per_chunk();
+            const auto first_chunk(AllocateBuffers(slab, per_chunk));
+            const auto second_chunk(AllocateBuffers(slab, per_chunk));
+
+            // a buffer freed in the first chunk is given out before those left in the second
+            slab.deallocate(second_chunk[0]);
+            slab.deallocate(first_chunk[5]);
+            Assert::IsTrue(first_chunk[5] == slab.allocate());
+            Assert::IsTrue(second_chunk[0] == slab.allocate());
+
+            DeallocateBuffers(slab, first_chunk);
+            DeallocateBuffers(slab, second_chunk);
+        }
+
+        TEST_METHOD(IdleTrailingChunksAreReleased)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const unsigned long per_chunk = slab.buffers_per_chunk();
+            const auto first_chunk(AllocateBuffers(slab, per_chunk));
+            const auto second_chunk(AllocateBuffers(slab, per_chunk));
+            const auto third_chunk(AllocateBuffers(slab, per_chunk));
+            Assert::AreEqual(3UL, slab.committed_chunk_count());
+
+            // one idle chunk is kept past the last in use
+            DeallocateBuffers(slab, third_chunk);
+            Assert::AreEqual(3UL, slab.committed_chunk_count());
+            Assert::IsTrue(s_Deregistered.empty());
+
+            DeallocateBuffers(slab, second_chunk);
+            Assert::AreEqual(2UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(1), s_Deregistered.size());
+            Assert::IsTrue(s_Registered[2].buffer_id == s_Deregistered[0]);
+
+            DeallocateBuffers(slab, first_chunk);
+            Assert::AreEqual(1UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(2), s_Deregistered.size());
+            Assert::IsTrue(s_Registered[1].buffer_id == s_Deregistered[1]);
+
+            // growing again registers the chunk again
+            const auto buffers(AllocateBuffers(slab, per_chunk + 1));
+            Assert::AreEqual(2UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(4), s_Registered.size());
+            Assert::IsTrue(s_Registered[3].buffer_id == slab.chunk_buffer_id(buffers.back()));
+            DeallocateBuffers(slab, buffers);
+        }
+
+        TEST_METHOD(ChunksInUseAreNeverReleased)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const unsigned long per_chunk = slab.buffers_per_chunk();
+            const auto first_chunk(AllocateBuffers(slab, per_chunk));
+            const auto second_chunk(AllocateBuffers(slab, per_chunk));
+            const auto third_chunk(AllocateBuffers(slab, per_chunk));
+
+            // one buffer still given out from the last chunk holds every chunk before it
+            DeallocateBuffers(slab, first_chunk);
+            DeallocateBuffers(slab, second_chunk);
+            DeallocateBuffers(slab, std::vector<char*>(third_chunk.begin() + 1, third_chunk.end()));
+            Assert::AreEqual(3UL, slab.committed_chunk_count());
+            Assert::IsTrue(s_Deregistered.empty());
+
+            slab.deallocate(third_chunk[0]);
+            Assert::AreEqual(1UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(2), s_Deregistered.size());
+        }
+
+        TEST_METHOD(DestructorDeregistersEveryChunk)
+        {
+            {
+                ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+                DeallocateBuffers(slab, AllocateBuffers(slab, slab.buffers_per_chunk() * 2));
+                Assert::AreEqual(1UL, slab.committed_chunk_count());
+            }
+            Assert::AreEqual(static_cast<size_t>(2), s_Deregistered.size());
+        }
+
+        TEST_METHOD(FailedRegistrationGivesOutNothing)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            s_FailRegistration = true;
+            Assert::IsNull(slab.allocate());
+            Assert::AreEqual(0UL, slab.committed_chunk_count());
+
+            s_FailRegistration = false;
+            char* buffer = slab.allocate();
+            Assert::IsNotNull(buffer);
+            slab.deallocate(buffer);
+        }
+
+        TEST_METHOD(UnregisteredChunksHaveNoBufferId)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, ctsBufferRegistrar());
+            char* buffer = slab.allocate();
+            Assert::IsNotNull(buffer);
+            Assert::IsTrue(RIO_INVALID_BUFFERID == slab.chunk_buffer_id(buffer));
+            Assert::IsTrue(buffer == slab.chunk_base(buffer));
+            slab.deallocate(buffer);
+        }
+
+        TEST_METHOD(LargePageChunksAreFoundByAddress)
+        {
+            // each chunk is allocated on its own: on large pages if the privilege is held, else on standard pages
+            const unsigned long large_page_size = 0x200000;
+            const unsigned long buffer_length = 0x10000;
+            ctsBufferSlab slab(buffer_length, 1, 1000, FakeRegistrar(), large_page_size);
+            Assert::AreEqual(large_page_size / buffer_length, slab.buffers_per_chunk());
+
+            const auto buffers(AllocateBuffers(slab, slab.buffers_per_chunk() * 3));
+            Assert::AreEqual(3UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(3), s_Registered.size());
+            for (const auto& registration : s_Registered) {
+                Assert::AreEqual(static_cast<DWORD>(large_page_size), registration.length);
+            }
+
+            std::vector<char*> sorted_buffers(buffers);
+            std::sort(sorted_buffers.begin(), sorted_buffers.end());
+            Assert::IsTrue(std::adjacent_find(sorted_buffers.begin(), sorted_buffers.end()) == sorted_buffers.end());
+
+            for (auto* buffer : buffers) {
+                const auto registration = std::find_if(s_Registered.begin(), s_Registered.end(), [&](const FakeRegistration& _registration) {
+                    return buffer >= _registration.buffer && buffer + buffer_length <= _registration.buffer + _registration.length;
+                });
+                Assert::IsTrue(registration != s_Registered.end());
+                Assert::IsTrue(registration->buffer == slab.chunk_base(buffer));
+                Assert::IsTrue(registration->buffer_id == slab.chunk_buffer_id(buffer));
+                // the buffers are writeable
+                buffer[0] = 1;
+                buffer[buffer_length - 1] = 1;
+            }
+
+            DeallocateBuffers(slab, buffers);
+            Assert::AreEqual(1UL, slab.committed_chunk_count());
+            Assert::AreEqual(static_cast<size_t>(2), s_Deregistered.size());
+        }
+
+        TEST_METHOD(NumaSlabsAllocateFromTheirNode)
+        {
+            // every machine has node 0
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar(), 0, 0);
+            char* buffer = slab.allocate();
+            Assert::IsNotNull(buffer);
+            // fault the page in so it's backed by physical memory
+            *buffer = 1;
+
+            PSAPI_WORKING_SET_EX_INFORMATION working_set{};
+            working_set.VirtualAddress = buffer;
+            Assert::IsTrue(!!::QueryWorkingSetEx(::GetCurrentProcess(), &working_set, static_cast<DWORD>(sizeof(working_set))));
+            Assert::IsTrue(!!working_set.VirtualAttributes.Valid);
+            Assert::AreEqual(0ULL, static_cast<unsigned long long>(working_set.VirtualAttributes.Node));
+            slab.deallocate(buffer);
+        }
+
+        TEST_METHOD(CountsReusedBuffers)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            auto buffers(AllocateBuffers(slab, 3));
+            slab.deallocate(buffers.back());
+            buffers.pop_back();
+
+            // the freed buffer is reused before a buffer never given out
+            const auto more_buffers(AllocateBuffers(slab, 2));
+            Assert::AreEqual(5ULL, slab.statistics().allocations);
+            Assert::AreEqual(1ULL, slab.statistics().reused_allocations);
+            Assert::AreEqual(4UL, slab.statistics().outstanding_buffers);
+            Assert::AreEqual(4UL, slab.statistics().peak_outstanding_buffers);
+            Assert::AreEqual(slab.buffers_per_chunk(), slab.statistics().committed_buffers);
+
+            DeallocateBuffers(slab, buffers);
+            DeallocateBuffers(slab, more_buffers);
+            Assert::AreEqual(0UL, slab.statistics().outstanding_buffers);
+            Assert::AreEqual(4UL, slab.statistics().peak_outstanding_buffers);
+        }
+
+        TEST_METHOD(ReleasedChunksAreFreshWhenCommittedAgain)
+        {
+            ctsBufferSlab slab(BufferLength, 10, 1000, FakeRegistrar());
+            const unsigned long per_chunk = slab.buffers_per_chunk();
+            const auto buffers(AllocateBuffers(slab, per_chunk * 3));
+            DeallocateBuffers(slab, buffers);
+            Assert::AreEqual(per_chunk * 3, slab.statistics().peak_committed_buffers);
+            Assert::AreEqual(per_chunk, slab.statistics().committed_buffers);
+
+            // the first chunk's buffers are reused: the second chunk's were decommitted
+            const auto buffers_second(AllocateBuffers(slab, per_chunk * 2));
+            Assert::AreEqual(static_cast<unsigned long long>(per_chunk), slab.statistics().reused_allocations);
+            DeallocateBuffers(slab, buffers_second);
+        }
+
+        TEST_METHOD(PoolRoundsLengthsToWholePages)
+        {
+            ::SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+            const unsigned long page_size = system_info.dwPageSize;
+
+            ctsBufferSlabPool pool(100, 0x10000000ULL, FakeRegistrar());
+            const auto small_allocation = pool.allocate(100);
+            const auto page_allocation = pool.allocate(page_size);
+            const auto larger_allocation = pool.allocate(page_size + 1);
+            Assert::IsNotNull(small_allocation.buffer);
+            Assert::IsNotNull(page_allocation.buffer);
+            Assert::IsNotNull(larger_allocation.buffer);
+
+            const auto statistics(pool.statistics());
+            Assert::AreEqual(static_cast<size_t>(2), statistics.size());
+            Assert::AreEqual(page_size, statistics[0].buffer_length);
+            Assert::AreEqual(2ULL, statistics[0].allocations);
+            Assert::AreEqual(page_size * 2, statistics[1].buffer_length);
+            Assert::AreEqual(1ULL, statistics[1].allocations);
+
+            pool.deallocate(small_allocation.buffer, 100);
+            pool.deallocate(page_allocation.buffer, page_size);
+            pool.deallocate(larger_allocation.buffer, page_size + 1);
+            Assert::AreEqual(0UL, pool.statistics()[0].outstanding_buffers);
+            Assert::AreEqual(0UL, pool.statistics()[1].outstanding_buffers);
+        }
+
+        TEST_METHOD(PoolGivesTheChunksBufferId)
+        {
+            ctsBufferSlabPool pool(100, 0x10000000ULL, FakeRegistrar());
+            const auto allocation = pool.allocate(65536);
+            Assert::IsNotNull(allocation.buffer);
+            Assert::AreEqual(static_cast<size_t>(1), s_Registered.size());
+            Assert::IsTrue(s_Registered[0].buffer == allocation.chunk_base);
+            Assert::IsTrue(s_Registered[0].buffer_id == allocation.buffer_id);
+            // chunks hold several buffers of this size
+            Assert::IsTrue(s_Registered[0].length >= ctsBufferSlabPool::ChunkBytes);
+            pool.deallocate(allocation.buffer, 65536);
+        }
+
+        TEST_METHOD(PoolFailsOnceAClassIsExhausted)
+        {
+            ctsBufferSlabPool pool(2, 0x10000000ULL, FakeRegistrar());
+            const auto first_allocation = pool.allocate(1000);
+            const auto second_allocation = pool.allocate(1000);
+            Assert::IsNotNull(first_allocation.buffer);
+            Assert::IsNotNull(second_allocation.buffer);
+            Assert::IsNull(pool.allocate(1000).buffer);
+            Assert::AreEqual(1ULL, pool.statistics()[0].failed_allocations);
+
+            // lengths too large for a slab are never given out
+            Assert::IsNull(pool.allocate(0x20000000).buffer);
+
+            pool.deallocate(first_allocation.buffer, 1000);
+            pool.deallocate(second_allocation.buffer, 1000);
+        }
+    };
+}
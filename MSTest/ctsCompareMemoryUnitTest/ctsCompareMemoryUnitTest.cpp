@@ -0,0 +1,185 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <cwchar>
+#include <vector>
+
+#include <Windows.h>
+
+#include "ctsCompareMemory.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    // every kernel up to the widest this machine supports: the kernels are ordered by width
+    std::vector<ctsTraffic::ctsCompareMemory::Kernel> SupportedKernels()
+    {
+        std::vector<ctsTraffic::ctsCompareMemory::Kernel> kernels;
+        const auto widest = static_cast<int>(ctsTraffic::ctsCompareMemory::SupportedKernel());
+        for (int kernel = 0; kernel <= widest; ++kernel) {
+            kernels.push_back(static_cast<ctsTraffic::ctsCompareMemory::Kernel>(kernel));
+        }
+        return kernels;
+    }
+
+    // a pattern which doesn't repeat within a vector, so a mismatch can't be hidden by a shifted compare
+    std::vector<char> MakePattern(size_t _length)
+    {
+        std::vector<char> pattern(_length);
+        for (size_t offset = 0; offset < _length; ++offset) {
+            pattern[offset] = static_cast<char>(offset * 7 + offset / 251);
+        }
+        return pattern;
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsCompareMemoryUnitTest)
+    {
+    public:
+        TEST_METHOD(EqualBuffersMatchTheFullLength)
+        {
+            const auto pattern = MakePattern(1024);
+            const auto received = pattern;
+            for (const auto kernel : SupportedKernels()) {
+                for (size_t length = 0; length <= 300; ++length) {
+                    Assert::AreEqual(length, ctsCompareMemory::Compare(kernel, pattern.data(), received.data(), length));
+                }
+                Assert::AreEqual(pattern.size(), ctsCompareMemory::Compare(kernel, pattern.data(), received.data(), pattern.size()));
+            }
+        }
+
+        TEST_METHOD(ReportsTheExactFirstMismatchOffset)
+        {
+            const auto pattern = MakePattern(512);
+            for (const auto kernel : SupportedKernels()) {
+                // every alignment of the buffers, every length through several vectors and every mismatch offset
+                for (size_t alignment = 0; alignment < 4; ++alignment) {
+                    for (size_t length = 1; length <= 200; ++length) {
+                        for (size_t mismatch = 0; mismatch < length; ++mismatch) {
+                            auto received = pattern;
+                            received[alignment + mismatch] ^= 0x80;
+                            // a later mismatch in the same vector must not be reported instead
+                            if (alignment + mismatch + 1 < received.size()) {
+                                received[alignment + mismatch + 1] ^= 0x01;
+                            }
+                            Assert::AreEqual(mismatch, ctsCompareMemory::Compare(kernel, pattern.data() + alignment, received.data() + alignment, length));
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(DefaultKernelMatchesScalar)
+        {
+            const auto pattern = MakePattern(64 * 1024);
+            auto received = pattern;
+            Assert::AreEqual(pattern.size(), ctsCompareMemory::Compare(pattern.data(), received.data(), pattern.size()));
+
+            received[40000] = static_cast<char>(~received[40000]);
+            Assert::AreEqual(
+                ctsCompareMemory::CompareScalar(pattern.data(), received.data(), pattern.size()),
+                ctsCompareMemory::Compare(pattern.data(), received.data(), pattern.size()));
+            Assert::AreEqual(static_cast<size_t>(40000), ctsCompareMemory::Compare(pattern.data(), received.data(), pattern.size()));
+        }
+
+        TEST_METHOD(NeverReadsPastTheEndOfTheBuffers)
+        {
+            // both buffers end against a no-access page: reading past either would fault
+            SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+            const size_t page_size = system_info.dwPageSize;
+            char* pages = static_cast<char*>(::VirtualAlloc(nullptr, page_size * 4, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+            Assert::IsNotNull(pages);
+            DWORD old_protection;
+            Assert::IsTrue(!!::VirtualProtect(pages + page_size, page_size, PAGE_NOACCESS, &old_protection));
+            Assert::IsTrue(!!::VirtualProtect(pages + page_size * 3, page_size, PAGE_NOACCESS, &old_protection));
+
+            const auto pattern = MakePattern(page_size);
+            memcpy(pages, pattern.data(), page_size);
+            memcpy(pages + page_size * 2, pattern.data(), page_size);
+            for (const auto kernel : SupportedKernels()) {
+                for (size_t length = 0; length <= 200; ++length) {
+                    const char* first = pages + page_size - length;
+                    const char* second = pages + page_size * 3 - length;
+                    Assert::AreEqual(length, ctsCompareMemory::Compare(kernel, first, second, length));
+                }
+            }
+            ::VirtualFree(pages, 0, MEM_RELEASE);
+        }
+
+        ///
+        /// Microbenchmark: verify throughput of each kernel on one core, at buffer sizes from 1 KB to 1 MB
+        /// - the results are written to the test output
+        /// - ignored so it doesn't slow every unit test pass: comment out TEST_IGNORE() to run it
+        ///
+        BEGIN_TEST_METHOD_ATTRIBUTE(VerifyThroughputPerCore)
+            TEST_METHOD_ATTRIBUTE(L"Category", L"Benchmark")
+            TEST_IGNORE()
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD(VerifyThroughputPerCore)
+        {
+            constexpr size_t MinimumBufferSize = 1024;
+            constexpr size_t MaximumBufferSize = 1024 * 1024;
+            // compare this many bytes at each size so the small sizes run long enough to time
+            constexpr size_t BytesPerMeasurement = 256 * 1024 * 1024;
+
+            const auto pattern = MakePattern(MaximumBufferSize);
+            const auto received = pattern;
+
+            // pin to one core so the measurement isn't skewed by the thread migrating
+            const DWORD_PTR prior_affinity = ::SetThreadAffinityMask(::GetCurrentThread(), 1);
+            LARGE_INTEGER frequency;
+            ::QueryPerformanceFrequency(&frequency);
+
+            wchar_t line[256];
+            swprintf_s(line, L"Widest supported kernel: %ws\n", ctsCompareMemory::KernelName(ctsCompareMemory::SupportedKernel()));
+            Logger::WriteMessage(line);
+            for (size_t buffer_size = MinimumBufferSize; buffer_size <= MaximumBufferSize; buffer_size *= 2) {
+                const size_t iterations = BytesPerMeasurement / buffer_size;
+                for (const auto kernel : SupportedKernels()) {
+                    LARGE_INTEGER start;
+                    ::QueryPerformanceCounter(&start);
+                    size_t bytes_verified = 0;
+                    for (size_t iteration = 0; iteration < iterations; ++iteration) {
+                        bytes_verified += ctsCompareMemory::Compare(kernel, pattern.data(), received.data(), buffer_size);
+                    }
+                    LARGE_INTEGER end;
+                    ::QueryPerformanceCounter(&end);
+                    Assert::AreEqual(iterations * buffer_size, bytes_verified);
+
+                    const double seconds = static_cast<double>(end.QuadPart - start.QuadPart) / static_cast<double>(frequency.QuadPart);
+                    swprintf_s(line, L"%7Iu bytes  %-8ws %8.2f GB/s\n",
+                        buffer_size,
+                        ctsCompareMemory::KernelName(kernel),
+                        seconds > 0.0 ? static_cast<double>(bytes_verified) / seconds / 1e9 : 0.0);
+                    Logger::WriteMessage(line);
+                }
+            }
+
+            if (prior_affinity != 0) {
+                ::SetThreadAffinityMask(::GetCurrentThread(), prior_affinity);
+            }
+        }
+    };
+}
@@ -0,0 +1,247 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <memory>
+#include <vector>
+
+#include <Windows.h>
+#include <ctException.hpp>
+#include <ctString.hpp>
+
+#include "ctsCompletionQueueShards.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ///
+    /// Simulates a completion queue for ctsCompletionQueueShard
+    /// - tracks how it was resized so tests can verify the shard's slot accounting
+    ///
+    class SimulatedCompletionQueue {
+    public:
+        static const unsigned long MaxSize = 0x10000;
+
+        volatile LONG queue_size = 0;
+        volatile LONG resize_count = 0;
+        volatile LONG concurrent_resizes = 0;
+        volatile LONG max_concurrent_resizes = 0;
+        bool fail_resize = false;
+
+        explicit SimulatedCompletionQueue(unsigned long _size) noexcept : queue_size(static_cast<LONG>(_size))
+        {
+        }
+
+        unsigned long size() const noexcept
+        {
+            return static_cast<unsigned long>(this->queue_size);
+        }
+
+        void resize(unsigned long _new_size)
+        {
+            const LONG resizing = ::InterlockedIncrement(&this->concurrent_resizes);
+            if (resizing > this->max_concurrent_resizes) {
+                this->max_concurrent_resizes = resizing;
+            }
+            ::InterlockedIncrement(&this->resize_count);
+            // yield mid-resize to give other threads the chance to race against it
+            ::SwitchToThread();
+
+            if (this->fail_resize) {
+                ::InterlockedDecrement(&this->concurrent_resizes);
+                throw ctl::ctException(ERROR_NOT_ENOUGH_MEMORY, L"resize", L"SimulatedCompletionQueue", false);
+            }
+            ::InterlockedExchange(&this->queue_size, static_cast<LONG>(_new_size));
+            ::InterlockedDecrement(&this->concurrent_resizes);
+        }
+    };
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsCompletionQueueShardsUnitTest)
+    {
+    private:
+        using SimulatedShard = ctsCompletionQueueShard<SimulatedCompletionQueue>;
+
+        static const unsigned long StressThreadCount = 16;
+        static const unsigned long StressIterations = 10000;
+        static const unsigned long StressSlots = 2;
+
+        struct StressContext {
+            SimulatedShard* shard = nullptr;
+            // the slots each thread holds once make_room has returned
+            volatile LONG reserved_slots = 0;
+            // times reserved slots exceeded the size of the queue
+            volatile LONG overcommitted = 0;
+            volatile LONG failures = 0;
+        };
+
+        static DWORD WINAPI StressThreadProc(LPVOID _context) noexcept
+        {
+            auto* context = static_cast<StressContext*>(_context);
+            for (unsigned long iteration = 0; iteration < StressIterations; ++iteration) {
+                try {
+                    context->shard->make_room(StressSlots);
+                }
+                catch (...) {
+                    ::InterlockedIncrement(&context->failures);
+                    continue;
+                }
+
+                const LONG reserved = ::InterlockedAdd(&context->reserved_slots, static_cast<LONG>(StressSlots));
+                if (static_cast<unsigned long>(reserved) > context->shard->completion_queue().size()) {
+                    ::InterlockedIncrement(&context->overcommitted);
+                }
+                if (0 == iteration % 7) {
+                    ::SwitchToThread();
+                }
+                ::InterlockedAdd(&context->reserved_slots, -static_cast<LONG>(StressSlots));
+
+                context->shard->release_room(StressSlots);
+            }
+            return 0;
+        }
+
+    public:
+        TEST_METHOD(ReserveWithinSizeDoesNotResize)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            for (unsigned long count = 0; count < 5; ++count) {
+                shard.make_room(2);
+            }
+            Assert::AreEqual(10UL, shard.used_slot_count());
+            Assert::AreEqual(10UL, shard.completion_queue().size());
+            Assert::AreEqual(0L, static_cast<long>(shard.completion_queue().resize_count));
+        }
+
+        TEST_METHOD(ReserveBeyondSizeGrowsByHalf)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            shard.make_room(12);
+            Assert::AreEqual(12UL, shard.used_slot_count());
+            Assert::AreEqual(18UL, shard.completion_queue().size());
+            Assert::AreEqual(1L, static_cast<long>(shard.completion_queue().resize_count));
+
+            // the grown queue now has room without resizing again
+            shard.make_room(6);
+            Assert::AreEqual(18UL, shard.used_slot_count());
+            Assert::AreEqual(1L, static_cast<long>(shard.completion_queue().resize_count));
+        }
+
+        TEST_METHOD(ReserveGrowsNoLargerThanMaxSize)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            shard.make_room(SimulatedCompletionQueue::MaxSize - 1);
+            Assert::AreEqual(SimulatedCompletionQueue::MaxSize, shard.completion_queue().size());
+        }
+
+        TEST_METHOD(ReleaseReturnsSlots)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            shard.make_room(8);
+            shard.release_room(8);
+            Assert::AreEqual(0UL, shard.used_slot_count());
+
+            shard.make_room(10);
+            Assert::AreEqual(10UL, shard.used_slot_count());
+            Assert::AreEqual(0L, static_cast<long>(shard.completion_queue().resize_count));
+        }
+
+        TEST_METHOD(FailedResizeReleasesReservation)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            shard.make_room(4);
+            shard.completion_queue().fail_resize = true;
+            try {
+                shard.make_room(20);
+                Assert::Fail(L"make_room should have thrown when the resize failed");
+            }
+            catch (const ctl::ctException& e) {
+                Assert::AreEqual(static_cast<unsigned long>(ERROR_NOT_ENOUGH_MEMORY), e.why());
+            }
+            Assert::AreEqual(4UL, shard.used_slot_count());
+            Assert::AreEqual(10UL, shard.completion_queue().size());
+
+            shard.completion_queue().fail_resize = false;
+            shard.make_room(20);
+            Assert::AreEqual(24UL, shard.used_slot_count());
+            Assert::AreEqual(36UL, shard.completion_queue().size());
+        }
+
+        TEST_METHOD(DequeueReturnsFunctorResult)
+        {
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(10));
+            const auto result = shard.dequeue([](const SimulatedCompletionQueue& _queue) noexcept {
+                return _queue.size() * 2;
+            });
+            Assert::AreEqual(20UL, result);
+        }
+
+        TEST_METHOD(ShardForWrapsProcessorIndex)
+        {
+            ctsCompletionQueueShards<SimulatedCompletionQueue> shards;
+            for (unsigned long count = 0; count < 4; ++count) {
+                shards.add(std::make_unique<SimulatedCompletionQueue>(10));
+            }
+            Assert::AreEqual(static_cast<size_t>(4), shards.count());
+            Assert::IsTrue(&shards[0] == &shards.shard_for(0));
+            Assert::IsTrue(&shards[3] == &shards.shard_for(3));
+            Assert::IsTrue(&shards[1] == &shards.shard_for(5));
+            Assert::IsTrue(&shards[0] == &shards.shard_for(8));
+        }
+
+        TEST_METHOD(StressReserveAndRelease)
+        {
+            // starting with room for a single reservation forces concurrent resizes
+            SimulatedShard shard(std::make_unique<SimulatedCompletionQueue>(StressSlots));
+            StressContext context;
+            context.shard = &shard;
+
+            HANDLE threads[StressThreadCount]{};
+            for (auto& thread : threads) {
+                thread = ::CreateThread(nullptr, 0, StressThreadProc, &context, 0, nullptr);
+                Assert::IsNotNull(thread);
+            }
+            Assert::AreEqual(
+                WAIT_OBJECT_0,
+                ::WaitForMultipleObjects(StressThreadCount, threads, TRUE, INFINITE));
+            for (auto& thread : threads) {
+                ::CloseHandle(thread);
+            }
+
+            Logger::WriteMessage(
+                ctl::ctString::format_string(
+                    L"StressReserveAndRelease: %ld resizes to a final size of %lu\n",
+                    shard.completion_queue().resize_count,
+                    shard.completion_queue().size()).c_str());
+
+            Assert::AreEqual(0L, static_cast<long>(context.failures));
+            Assert::AreEqual(0L, static_cast<long>(context.overcommitted));
+            Assert::AreEqual(0UL, shard.used_slot_count());
+            // resizes must only ever happen one at a time
+            Assert::AreEqual(1L, static_cast<long>(shard.completion_queue().max_concurrent_resizes));
+            // the queue never needs more than a slot per thread - and grows by half each resize
+            Assert::IsTrue(shard.completion_queue().size() <= StressThreadCount * StressSlots * 2);
+            Assert::IsTrue(shard.completion_queue().resize_count < 16);
+        }
+    };
+}
@@ -0,0 +1,169 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <Windows.h>
+
+#include "ctsConnectionRate.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsConnectionRateUnitTest)
+    {
+    public:
+        TEST_METHOD(ConstantRate)
+        {
+            const ctsConnectionRateSchedule schedule(10.0, 10.0, 0LL);
+            Assert::AreEqual(10.0, schedule.rate_at(0LL));
+            Assert::AreEqual(10.0, schedule.rate_at(5000LL));
+
+            // the first connection starts immediately, then one every 100 ms.
+            Assert::AreEqual(1LL, schedule.allowed_by(0LL));
+            Assert::AreEqual(1LL, schedule.allowed_by(99LL));
+            Assert::AreEqual(2LL, schedule.allowed_by(100LL));
+            Assert::AreEqual(11LL, schedule.allowed_by(1000LL));
+
+            Assert::AreEqual(0LL, schedule.time_of(0LL));
+            Assert::AreEqual(100LL, schedule.time_of(1LL));
+            Assert::AreEqual(1000LL, schedule.time_of(10LL));
+        }
+
+        TEST_METHOD(RampedRate)
+        {
+            // 10 to 30 per second over 2 seconds: 15 connections in the first second, 40 by the end of the ramp
+            const ctsConnectionRateSchedule schedule(10.0, 30.0, 2000LL);
+            Assert::AreEqual(10.0, schedule.rate_at(0LL));
+            Assert::AreEqual(20.0, schedule.rate_at(1000LL));
+            Assert::AreEqual(30.0, schedule.rate_at(2000LL));
+            Assert::AreEqual(30.0, schedule.rate_at(5000LL));
+
+            Assert::AreEqual(16LL, schedule.allowed_by(1000LL));
+            Assert::AreEqual(41LL, schedule.allowed_by(2000LL));
+            Assert::AreEqual(71LL, schedule.allowed_by(3000LL));
+
+            Assert::AreEqual(1000LL, schedule.time_of(15LL));
+            Assert::AreEqual(2000LL, schedule.time_of(40LL));
+            Assert::AreEqual(3000LL, schedule.time_of(70LL));
+        }
+
+        TEST_METHOD(TimeOfIsTheFirstTimeAllowed)
+        {
+            const ctsConnectionRateSchedule schedule(7.0, 333.0, 1500LL);
+            for (long long connection = 0; connection < 1000; ++connection) {
+                const long long connection_time = schedule.time_of(connection);
+                Assert::IsTrue(schedule.allowed_by(connection_time) > connection);
+                if (connection_time > 0) {
+                    Assert::IsTrue(schedule.allowed_by(connection_time - 1) <= connection);
+                }
+            }
+        }
+
+        TEST_METHOD(LimiterPacesClaims)
+        {
+            ctsConnectionRateLimiter limiter(ctsConnectionRateSchedule(10.0, 10.0, 0LL), 1000LL);
+            Assert::IsTrue(limiter.try_claim(1000LL));
+            Assert::IsFalse(limiter.try_claim(1000LL));
+            Assert::AreEqual(100LL, limiter.delay_until_next(1000LL));
+            Assert::AreEqual(40LL, limiter.delay_until_next(1060LL));
+
+            Assert::IsTrue(limiter.try_claim(1100LL));
+            Assert::IsFalse(limiter.try_claim(1100LL));
+            // a released claim can be taken again
+            limiter.release();
+            Assert::IsTrue(limiter.try_claim(1100LL));
+            Assert::IsFalse(limiter.try_claim(1199LL));
+        }
+
+        TEST_METHOD(LimiterCatchesUpWhenLate)
+        {
+            ctsConnectionRateLimiter limiter(ctsConnectionRateSchedule(10.0, 10.0, 0LL), 0LL);
+            // a late wakeup can claim every connection scheduled since
+            for (int claim = 0; claim < 6; ++claim) {
+                Assert::IsTrue(limiter.try_claim(500LL));
+            }
+            Assert::IsFalse(limiter.try_claim(500LL));
+            // the delay is never less than 1 ms once a claim has failed
+            Assert::AreEqual(1LL, limiter.delay_until_next(600LL));
+        }
+
+        TEST_METHOD(EmptyHistogram)
+        {
+            const ctsLatencyHistogram histogram;
+            Assert::AreEqual(0LL, histogram.count());
+            Assert::AreEqual(0LL, histogram.percentile(50.0));
+        }
+
+        TEST_METHOD(SmallValuesAreExact)
+        {
+            ctsLatencyHistogram histogram;
+            for (long long value = 0; value < 10; ++value) {
+                histogram.add(value);
+            }
+            Assert::AreEqual(10LL, histogram.count());
+            Assert::AreEqual(4LL, histogram.percentile(50.0));
+            Assert::AreEqual(8LL, histogram.percentile(90.0));
+            Assert::AreEqual(9LL, histogram.percentile(100.0));
+            Assert::AreEqual(0LL, histogram.percentile(0.0));
+        }
+
+        TEST_METHOD(LargeValuesAreBinned)
+        {
+            ctsLatencyHistogram histogram;
+            for (long long value = 1; value <= 100; ++value) {
+                histogram.add(value);
+            }
+            // 50 shares a bucket with 51, and 100 with 101 through 103
+            Assert::AreEqual(51LL, histogram.percentile(50.0));
+            Assert::AreEqual(103LL, histogram.percentile(100.0));
+
+            // every reported percentile is within 1/16 of the value at that rank
+            ctsLatencyHistogram wide_histogram;
+            for (long long value = 1; value <= 1000000; value *= 3) {
+                wide_histogram.add(value);
+                const long long reported = wide_histogram.percentile(100.0);
+                Assert::IsTrue(reported >= value);
+                Assert::IsTrue(reported <= value + value / 16);
+            }
+        }
+
+        TEST_METHOD(ValuesAreCapped)
+        {
+            ctsLatencyHistogram histogram;
+            histogram.add(-5LL);
+            histogram.add(ctsLatencyHistogram::MaxValue + 100LL);
+            Assert::AreEqual(0LL, histogram.percentile(50.0));
+            Assert::AreEqual(ctsLatencyHistogram::MaxValue, histogram.percentile(100.0));
+        }
+
+        TEST_METHOD(StatisticsTrackTheLastConnectAndFirstError)
+        {
+            ctsConnectionRateStatistics statistics;
+            statistics.connected(200LL, 1500LL);
+            // connections can complete out of order
+            statistics.connected(100LL, 500LL);
+            Assert::AreEqual(2LL, static_cast<long long>(statistics.connected_count));
+            Assert::AreEqual(200LL, static_cast<long long>(statistics.last_connected_ms));
+            Assert::AreEqual(2LL, statistics.connect_latency_usec.count());
+
+            Assert::AreEqual(-1LL, static_cast<long long>(statistics.first_connect_error_ms));
+            statistics.connect_failed(300LL);
+            statistics.connect_failed(400LL);
+            Assert::AreEqual(2LL, static_cast<long long>(statistics.connect_error_count));
+            Assert::AreEqual(300LL, static_cast<long long>(statistics.first_connect_error_ms));
+        }
+    };
+}
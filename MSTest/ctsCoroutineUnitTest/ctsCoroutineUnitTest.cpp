@@ -0,0 +1,191 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include <Windows.h>
+
+#include "ctsCoroutine.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ///
+    /// Consumes events from a channel until it has received _expected_events
+    /// - each resume is recorded with the events it was given
+    ///
+    struct ConsumerResults {
+        std::vector<std::vector<int>> resumes;
+        long received = 0;
+        bool completed = false;
+    };
+
+    ctsTraffic::ctsCoroutineTask ConsumeEvents(ctsTraffic::ctsCoroutineChannel<int>& _channel, long _expected_events, ConsumerResults& _results) noexcept
+    {
+        std::vector<int> events;
+        _channel.reserve(events, static_cast<size_t>(_expected_events));
+        while (_results.received < _expected_events) {
+            co_await _channel.next(events);
+            _results.resumes.push_back(events);
+            _results.received += static_cast<long>(events.size());
+        }
+        _results.completed = true;
+    }
+
+    ctsTraffic::ctsCoroutineTask CompleteImmediately(bool& _ran) noexcept
+    {
+        _ran = true;
+        co_return;
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsCoroutineUnitTest)
+    {
+    private:
+        static const long StressThreadCount = 8;
+        static const long StressEventsPerThread = 10000;
+
+        struct StressContext {
+            ctsCoroutineChannel<int>* channel = nullptr;
+            volatile LONG inline_resumes = 0;
+        };
+
+        static DWORD WINAPI StressThreadProc(LPVOID _context) noexcept
+        {
+            auto* context = static_cast<StressContext*>(_context);
+            for (long count = 0; count < StressEventsPerThread; ++count) {
+                // the same two step post the IO completion callbacks make
+                if (context->channel->post_if_waiting(1)) {
+                    ::InterlockedIncrement(&context->inline_resumes);
+                } else {
+                    context->channel->post(1);
+                }
+            }
+            return 0;
+        }
+
+    public:
+        TEST_METHOD(FrameIsReusedOnTheSameThread)
+        {
+            bool ran = false;
+            Assert::IsTrue(CompleteImmediately(ran).started());
+            Assert::IsTrue(ran);
+            const unsigned long free_frames = ctsCoroutineFramePool::free_frame_count();
+            Assert::IsTrue(free_frames > 0);
+
+            // the next coroutine takes the frame the first one returned
+            ran = false;
+            Assert::IsTrue(CompleteImmediately(ran).started());
+            Assert::IsTrue(ran);
+            Assert::AreEqual(free_frames, ctsCoroutineFramePool::free_frame_count());
+        }
+
+        TEST_METHOD(FramesInTheSameSizeClassAreShared)
+        {
+            void* frame = ctsCoroutineFramePool::allocate(100);
+            Assert::IsNotNull(frame);
+            ctsCoroutineFramePool::deallocate(frame, 100);
+            // 100 and 120 bytes are both in the 128 byte class
+            void* reused_frame = ctsCoroutineFramePool::allocate(120);
+            Assert::IsTrue(frame == reused_frame);
+            ctsCoroutineFramePool::deallocate(reused_frame, 120);
+        }
+
+        TEST_METHOD(LargeFramesAreNotPooled)
+        {
+            const unsigned long free_frames = ctsCoroutineFramePool::free_frame_count();
+            void* frame = ctsCoroutineFramePool::allocate(ctsCoroutineFramePool::MaxPooledFrameSize + 1);
+            Assert::IsNotNull(frame);
+            ctsCoroutineFramePool::deallocate(frame, ctsCoroutineFramePool::MaxPooledFrameSize + 1);
+            Assert::AreEqual(free_frames, ctsCoroutineFramePool::free_frame_count());
+        }
+
+        TEST_METHOD(PostResumesTheWaitingCoroutine)
+        {
+            ctsCoroutineChannel<int> channel;
+            ConsumerResults results;
+            Assert::IsTrue(ConsumeEvents(channel, 2, results).started());
+            // no events yet: the coroutine is suspended
+            Assert::AreEqual(static_cast<size_t>(0), results.resumes.size());
+
+            channel.post(10);
+            // resumed inline, and suspended again waiting for the second event
+            Assert::AreEqual(static_cast<size_t>(1), results.resumes.size());
+            Assert::AreEqual(static_cast<size_t>(1), results.resumes[0].size());
+            Assert::AreEqual(10, results.resumes[0][0]);
+            Assert::IsFalse(results.completed);
+
+            Assert::IsTrue(channel.post_if_waiting(20));
+            Assert::AreEqual(static_cast<size_t>(2), results.resumes.size());
+            Assert::AreEqual(20, results.resumes[1][0]);
+            Assert::IsTrue(results.completed);
+        }
+
+        TEST_METHOD(PostIfWaitingDoesNotPostWithoutAWaiter)
+        {
+            ctsCoroutineChannel<int> channel;
+            std::vector<int> events;
+            channel.reserve(events, 4);
+            // no coroutine is waiting on the channel
+            Assert::IsFalse(channel.post_if_waiting(1));
+            channel.post(2);
+            channel.post(3);
+
+            // a consumer starting with events already posted takes them without suspending
+            ConsumerResults results;
+            Assert::IsTrue(ConsumeEvents(channel, 2, results).started());
+            Assert::IsTrue(results.completed);
+            Assert::AreEqual(static_cast<size_t>(1), results.resumes.size());
+            Assert::AreEqual(static_cast<size_t>(2), results.resumes[0].size());
+            Assert::AreEqual(2, results.resumes[0][0]);
+            Assert::AreEqual(3, results.resumes[0][1]);
+        }
+
+        TEST_METHOD(StressPostFromManyThreads)
+        {
+            ctsCoroutineChannel<int> channel;
+            ConsumerResults results;
+            Assert::IsTrue(ConsumeEvents(channel, StressThreadCount * StressEventsPerThread, results).started());
+
+            StressContext context;
+            context.channel = &channel;
+            HANDLE threads[StressThreadCount]{};
+            for (auto& thread : threads) {
+                thread = ::CreateThread(nullptr, 0, StressThreadProc, &context, 0, nullptr);
+                Assert::IsNotNull(thread);
+            }
+            Assert::AreEqual(
+                WAIT_OBJECT_0,
+                ::WaitForMultipleObjects(StressThreadCount, threads, TRUE, INFINITE));
+            for (auto& thread : threads) {
+                ::CloseHandle(thread);
+            }
+
+            // every event is delivered exactly once
+            Assert::IsTrue(results.completed);
+            Assert::AreEqual(StressThreadCount * StressEventsPerThread, results.received);
+            Assert::IsTrue(context.inline_resumes > 0);
+        }
+    };
+}
@@ -19,6 +19,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <windows.h>
 // ctl headers
 #include <ctTimer.hpp>
+#include <ctScopeGuard.hpp>
 // project headers
 #include "ctsIOTask.hpp"
 #include "ctsConfig.h"
@@ -154,6 +155,10 @@ namespace ctsTraffic {
         {
             return 0;
         }
+        USHORT CurrentNumaNode() noexcept
+        {
+            return 0;
+        }
     }
 }
 ///
@@ -210,6 +215,7 @@ namespace ctsUnitTest {
             ctsConfig::Settings->PrePostRecvs = 1;
             ctsConfig::Settings->PrePostSends = 1;
             ctsConfig::Settings->ConnectionLimit = 8;
+            ctsConfig::Settings->RecvBufferSegments = 1;
             ctsConfig::Settings->TcpShutdown = (Graceful == _shutdown) ? ctsConfig::TcpShutdownType::GracefulShutdown : ctsConfig::TcpShutdownType::HardShutdown;
 
             s_TcpBytesPerSecond = 0LL;
@@ -1693,6 +1699,100 @@ namespace ctsUnitTest {
             Logger::WriteMessage(ToString<ctsTraffic::ctsIOTask>(test_task).c_str());
             Assert::AreEqual(ctsIOStatus::CompletedIo, test_pattern->complete_io(test_task, 0, 0));
         }
+        TEST_METHOD(PullClient_VerifyingBuffersNotUsingSharedBuffer_RecvSegments_Graceful)
+        {
+            ctsConfig::Settings->IoPattern = ctsConfig::IoPatternType::Pull;
+            ctsConfig::Settings->Protocol = ctsConfig::ProtocolType::TCP;
+            ctsConfig::Settings->TcpShutdown = ctsConfig::TcpShutdownType::GracefulShutdown;
+            ctsConfig::Settings->UseSharedBuffer = false;
+            ctsConfig::Settings->ShouldVerifyBuffers = true;
+            ctsConfig::Settings->PrePostRecvs = 1;
+            ctsConfig::Settings->PrePostSends = 1;
+            ctsConfig::Settings->RecvBufferSegments = 4;
+            ctlScopeGuard(resetRecvSegments, { ctsConfig::Settings->RecvBufferSegments = 1; });
+            s_TcpBytesPerSecond = 0LL;
+            s_MaxBufferSize = 1024;
+            s_BufferSize = 1024;
+            s_TransferSize = 1024 * 10;
+            s_IsListening = false;
+
+            std::shared_ptr<ctsIOPattern> test_pattern(ctsIOPattern::MakeIOPattern());
+
+            ctsIOTask test_task = test_pattern->initiate_io();
+            Assert::AreEqual(ctsStatistics::ConnectionIdLength, test_task.buffer_length);
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, test_pattern->complete_io(test_task, ctsStatistics::ConnectionIdLength, 0));
+
+            for (unsigned long io_count = 0; io_count < 10; ++io_count) {
+                test_task = test_pattern->initiate_io();
+                Assert::AreEqual(1024UL, test_task.buffer_length);
+                Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+                // each recv is scattered across 4 separate 256 byte buffers
+                Assert::AreEqual(4UL, test_task.buffer_segment_count);
+                Assert::IsTrue(test_task.buffer == test_task.buffer_segments[0].buffer);
+                Logger::WriteMessage(ctl::ctString::format_string(L"%u: %ws", io_count, ToString<ctsTraffic::ctsIOTask>(test_task).c_str()).c_str());
+                // "recv" the correct bytes, filling each segment in turn
+                unsigned long pattern_offset = test_task.expected_pattern_offset;
+                for (unsigned long segment = 0; segment < test_task.buffer_segment_count; ++segment) {
+                    Assert::AreEqual(256UL, test_task.buffer_segments[segment].length);
+                    ::memcpy(test_task.buffer_segments[segment].buffer, ctsIOPattern::AccessSharedBuffer() + pattern_offset, test_task.buffer_segments[segment].length);
+                    pattern_offset += test_task.buffer_segments[segment].length;
+                }
+                Assert::AreEqual(ctsIOStatus::ContinueIo, test_pattern->complete_io(test_task, 1024, 0));
+            }
+
+            // recv server completion
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(4UL, test_task.buffer_length);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, test_pattern->complete_io(test_task, 4, 0));
+
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::GracefulShutdown, test_task.ioAction);
+            Logger::WriteMessage(ToString<ctsTraffic::ctsIOTask>(test_task).c_str());
+            Assert::AreEqual(ctsIOStatus::ContinueIo, test_pattern->complete_io(test_task, 0, 0));
+
+            // the FIN is received into a single segment buffer
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(0UL, test_task.buffer_segment_count);
+            Logger::WriteMessage(ToString<ctsTraffic::ctsIOTask>(test_task).c_str());
+            Assert::AreEqual(ctsIOStatus::CompletedIo, test_pattern->complete_io(test_task, 0, 0));
+        }
+        TEST_METHOD(PullClient_VerifyingBuffersNotUsingSharedBuffer_RecvSegments_CorruptSegment)
+        {
+            ctsConfig::Settings->IoPattern = ctsConfig::IoPatternType::Pull;
+            ctsConfig::Settings->Protocol = ctsConfig::ProtocolType::TCP;
+            ctsConfig::Settings->TcpShutdown = ctsConfig::TcpShutdownType::GracefulShutdown;
+            ctsConfig::Settings->UseSharedBuffer = false;
+            ctsConfig::Settings->ShouldVerifyBuffers = true;
+            ctsConfig::Settings->PrePostRecvs = 1;
+            ctsConfig::Settings->PrePostSends = 1;
+            ctsConfig::Settings->RecvBufferSegments = 4;
+            ctlScopeGuard(resetRecvSegments, { ctsConfig::Settings->RecvBufferSegments = 1; });
+            s_TcpBytesPerSecond = 0LL;
+            s_MaxBufferSize = 1024;
+            s_BufferSize = 1024;
+            s_TransferSize = 1024 * 10;
+            s_IsListening = false;
+
+            std::shared_ptr<ctsIOPattern> test_pattern(ctsIOPattern::MakeIOPattern());
+
+            ctsIOTask test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, test_pattern->complete_io(test_task, ctsStatistics::ConnectionIdLength, 0));
+
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(4UL, test_task.buffer_segment_count);
+            unsigned long pattern_offset = test_task.expected_pattern_offset;
+            for (unsigned long segment = 0; segment < test_task.buffer_segment_count; ++segment) {
+                ::memcpy(test_task.buffer_segments[segment].buffer, ctsIOPattern::AccessSharedBuffer() + pattern_offset, test_task.buffer_segments[segment].length);
+                pattern_offset += test_task.buffer_segments[segment].length;
+            }
+            // corrupt a byte in the third segment
+            test_task.buffer_segments[2].buffer[10] = static_cast<char>(~test_task.buffer_segments[2].buffer[10]);
+            Assert::AreEqual(ctsIOStatus::FailedIo, test_pattern->complete_io(test_task, 1024, 0));
+        }
         TEST_METHOD(PullClient_NotVerifyingBuffersUsingSharedBuffer_Graceful)
         {
             ctsConfig::Settings->IoPattern = ctsConfig::IoPatternType::Pull;
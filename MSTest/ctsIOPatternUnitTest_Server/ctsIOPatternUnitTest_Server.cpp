@@ -149,6 +149,10 @@ namespace ctsTraffic {
         {
             return 0;
         }
+        USHORT CurrentNumaNode() noexcept
+        {
+            return 0;
+        }
     }
 }
 ///
@@ -154,6 +154,60 @@ namespace ctsUnitTest
             Assert::AreEqual(expected_datagram_count, dgrams_returned);
         }
 
+        TEST_METHOD(TinySegmentedSendRequest)
+        {
+            static const unsigned long buffer_size = UdpDatagramDataHeaderLength + 1;
+
+            ctsMediaStreamSegmentedSendRequests testbuffer(buffer_size, SequenceNumber, BufferPtr);
+            auto dgrams_returned = this->verify_segmented_byte_count(testbuffer, buffer_size);
+
+            static const unsigned long expected_datagram_count = 1;
+            Assert::AreEqual(expected_datagram_count, dgrams_returned);
+        }
+
+        TEST_METHOD(OneSegmentedSendRequest)
+        {
+            static const unsigned long buffer_size = ctsMediaStreamSegmentedSendRequests::MaximumSegmentsPerSend * UdpDatagramOffloadSegmentSizeBytes;
+
+            ctsMediaStreamSegmentedSendRequests testbuffer(buffer_size, SequenceNumber, BufferPtr);
+            auto dgrams_returned = this->verify_segmented_byte_count(testbuffer, buffer_size);
+
+            static const unsigned long expected_datagram_count = ctsMediaStreamSegmentedSendRequests::MaximumSegmentsPerSend;
+            Assert::AreEqual(expected_datagram_count, dgrams_returned);
+        }
+
+        TEST_METHOD(OneSegmentedSendRequestPlusOne)
+        {
+            // the final byte can't be sent alone - the prior send must leave room for a full header
+            static const unsigned long buffer_size = ctsMediaStreamSegmentedSendRequests::MaximumSegmentsPerSend * UdpDatagramOffloadSegmentSizeBytes + 1;
+
+            ctsMediaStreamSegmentedSendRequests testbuffer(buffer_size, SequenceNumber, BufferPtr);
+            auto dgrams_returned = this->verify_segmented_byte_count(testbuffer, buffer_size);
+
+            static const unsigned long expected_datagram_count = ctsMediaStreamSegmentedSendRequests::MaximumSegmentsPerSend + 1;
+            Assert::AreEqual(expected_datagram_count, dgrams_returned);
+        }
+
+        TEST_METHOD(UnevenSegmentedSendRequest)
+        {
+            // one byte more than a single segment must still be split into two datagrams with room for the header
+            static const unsigned long buffer_size = UdpDatagramOffloadSegmentSizeBytes + 1;
+
+            ctsMediaStreamSegmentedSendRequests testbuffer(buffer_size, SequenceNumber, BufferPtr);
+            auto dgrams_returned = this->verify_segmented_byte_count(testbuffer, buffer_size);
+
+            static const unsigned long expected_datagram_count = 2;
+            Assert::AreEqual(expected_datagram_count, dgrams_returned);
+        }
+
+        TEST_METHOD(LargeSegmentedSendRequest)
+        {
+            static const unsigned long buffer_size = 123456789;
+
+            ctsMediaStreamSegmentedSendRequests testbuffer(buffer_size, SequenceNumber, BufferPtr);
+            this->verify_segmented_byte_count(testbuffer, buffer_size);
+        }
+
         TEST_METHOD(ConstructStart)
         {
             Assert::AreEqual(UdpDatagramStartStringLength, static_cast<unsigned long>(::strlen(UdpDatagramStartString)));
@@ -192,6 +246,47 @@ namespace ctsUnitTest
 
             Assert::AreEqual(_buffer_size, total_bytes);
 
+            return datagram_count;
+        }
+        unsigned long verify_segmented_byte_count(ctsMediaStreamSegmentedSendRequests& _testbuffer, unsigned long _buffer_size) const
+        {
+            Logger::WriteMessage(
+                ctl::ctString::format_string(L"Buffer size %u\n", _buffer_size).c_str());
+
+            unsigned long datagram_count = 0;
+            unsigned long total_bytes = 0;
+            while (_testbuffer.next()) {
+                Assert::IsTrue(_testbuffer.segment_count() > 0);
+                Assert::IsTrue(_testbuffer.segment_count() <= ctsMediaStreamSegmentedSendRequests::MaximumSegmentsPerSend);
+                Assert::IsTrue(_testbuffer.segment_size() <= UdpDatagramOffloadSegmentSizeBytes);
+                Assert::AreEqual(_testbuffer.segment_count() * ctsMediaStreamSendRequests::BufferArraySize, _testbuffer.buffer_count());
+
+                const WSABUF* wsa_bufs = _testbuffer.buffers();
+                for (unsigned long segment = 0; segment < _testbuffer.segment_count(); ++segment) {
+                    const WSABUF* datagram = wsa_bufs + segment * ctsMediaStreamSendRequests::BufferArraySize;
+                    Assert::AreEqual(UdpDatagramProtocolHeaderFlagLength, datagram[0].len);
+                    Assert::AreEqual(UdpDatagramProtocolHeaderFlagData, *reinterpret_cast<unsigned short*>(datagram[0].buf));
+
+                    unsigned long datagram_length = 0;
+                    for (unsigned long buffer = 0; buffer < ctsMediaStreamSendRequests::BufferArraySize; ++buffer) {
+                        datagram_length += datagram[buffer].len;
+                    }
+                    // every datagram must have data after the header
+                    Assert::IsTrue(datagram_length > UdpDatagramDataHeaderLength);
+                    // the stack segments at segment_size: only the last datagram can be shorter
+                    if (segment + 1 < _testbuffer.segment_count()) {
+                        Assert::AreEqual(_testbuffer.segment_size(), datagram_length);
+                    } else {
+                        Assert::IsTrue(datagram_length <= _testbuffer.segment_size());
+                    }
+
+                    total_bytes += datagram_length;
+                    ++datagram_count;
+                }
+            }
+
+            Assert::AreEqual(_buffer_size, total_bytes);
+
             return datagram_count;
         }
     };
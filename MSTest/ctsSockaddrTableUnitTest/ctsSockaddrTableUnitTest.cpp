@@ -0,0 +1,117 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <memory>
+
+#include <Windows.h>
+#include <WinSock2.h>
+
+#include <ctSockaddr.hpp>
+
+#include "ctsSockaddrTable.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ctl::ctSockaddr MakeAddress(short _family, unsigned short _port) noexcept
+    {
+        ctl::ctSockaddr address(_family);
+        address.setPort(_port);
+        return address;
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsSockaddrTableUnitTest)
+    {
+    public:
+        TEST_METHOD(EqualAddressesHashEqually)
+        {
+            const ctsSockaddrHash hash;
+            Assert::IsTrue(hash(MakeAddress(AF_INET, 80)) == hash(MakeAddress(AF_INET, 80)));
+            Assert::IsTrue(hash(MakeAddress(AF_INET6, 80)) == hash(MakeAddress(AF_INET6, 80)));
+            Assert::IsTrue(hash(MakeAddress(AF_INET, 80)) != hash(MakeAddress(AF_INET, 81)));
+            Assert::IsTrue(hash(MakeAddress(AF_INET, 80)) != hash(MakeAddress(AF_INET6, 80)));
+        }
+
+        TEST_METHOD(FindInsertedAddresses)
+        {
+            ctsSockaddrTable<int> table;
+            Assert::IsFalse(static_cast<bool>(table.find(MakeAddress(AF_INET, 1))));
+
+            Assert::IsTrue(table.insert(MakeAddress(AF_INET, 1), std::make_shared<int>(1)));
+            Assert::IsTrue(table.insert(MakeAddress(AF_INET6, 1), std::make_shared<int>(6)));
+            Assert::AreEqual(static_cast<size_t>(2), table.size());
+
+            Assert::AreEqual(1, *table.find(MakeAddress(AF_INET, 1)));
+            Assert::AreEqual(6, *table.find(MakeAddress(AF_INET6, 1)));
+            Assert::IsFalse(static_cast<bool>(table.find(MakeAddress(AF_INET, 2))));
+        }
+
+        TEST_METHOD(InsertDoesNotReplace)
+        {
+            ctsSockaddrTable<int> table;
+            Assert::IsTrue(table.insert(MakeAddress(AF_INET, 1), std::make_shared<int>(1)));
+            Assert::IsFalse(table.insert(MakeAddress(AF_INET, 1), std::make_shared<int>(2)));
+            Assert::AreEqual(static_cast<size_t>(1), table.size());
+            Assert::AreEqual(1, *table.find(MakeAddress(AF_INET, 1)));
+        }
+
+        TEST_METHOD(EraseReturnsTheErasedObject)
+        {
+            ctsSockaddrTable<int> table;
+            const auto object = std::make_shared<int>(1);
+            Assert::IsTrue(table.insert(MakeAddress(AF_INET, 1), object));
+
+            const auto erased_object = table.erase(MakeAddress(AF_INET, 1));
+            Assert::IsTrue(object == erased_object);
+            Assert::AreEqual(static_cast<size_t>(0), table.size());
+            Assert::IsFalse(static_cast<bool>(table.find(MakeAddress(AF_INET, 1))));
+            // erasing an address not in the table is a no-op
+            Assert::IsFalse(static_cast<bool>(table.erase(MakeAddress(AF_INET, 1))));
+        }
+
+        TEST_METHOD(ManyAddresses)
+        {
+            ctsSockaddrTable<unsigned short> table;
+            for (unsigned short port = 1; port <= 10000; ++port) {
+                Assert::IsTrue(table.insert(MakeAddress(AF_INET, port), std::make_shared<unsigned short>(port)));
+            }
+            Assert::AreEqual(static_cast<size_t>(10000), table.size());
+
+            for (unsigned short port = 1; port <= 10000; ++port) {
+                const auto found = table.find(MakeAddress(AF_INET, port));
+                Assert::IsTrue(static_cast<bool>(found));
+                Assert::AreEqual(port, *found);
+            }
+
+            for (unsigned short port = 1; port <= 10000; port += 2) {
+                Assert::IsTrue(static_cast<bool>(table.erase(MakeAddress(AF_INET, port))));
+            }
+            Assert::AreEqual(static_cast<size_t>(5000), table.size());
+            for (unsigned short port = 1; port <= 10000; ++port) {
+                Assert::AreEqual(port % 2 == 0, static_cast<bool>(table.find(MakeAddress(AF_INET, port))));
+            }
+        }
+    };
+}
@@ -129,6 +129,7 @@ public:
         const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
 
         state_objects.push_back(_state_object);
+        ++created_objects;
     }
     void remove_deleted_objects() noexcept
     {
@@ -146,20 +147,35 @@ public:
         const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
 
         state_objects.clear();
+        created_objects = 0;
+    }
+    size_t created_count() noexcept
+    {
+        const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
+
+        return created_objects;
     }
 
     /// Interact with states of contained ctsSocketState objects
+    /// - must not hold the lock while completing: the broker adds replacement objects as sockets close
     void complete_state(DWORD _error_code)
     {
-        const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
+        std::vector<std::shared_ptr<ctsSocketState>> shared_states;
+        {
+            const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
 
-        for (auto& socket_state : state_objects) {
-            auto shared_state(socket_state.lock());
-            Assert::IsNotNull(shared_state.get());
-            if (shared_state) {
-                shared_state->complete_state(_error_code);
+            for (auto& socket_state : state_objects) {
+                // skip objects already closed and waiting to be deleted by the broker
+                auto shared_state(socket_state.lock());
+                if (shared_state && shared_state->current_state() != ctsSocketState::InternalState::Closed) {
+                    shared_states.push_back(shared_state);
+                }
             }
         }
+
+        for (auto& shared_state : shared_states) {
+            shared_state->complete_state(_error_code);
+        }
     }
     void validate_expected_count(size_t _count)
     {
@@ -168,30 +184,58 @@ public:
         Assert::AreEqual(_count, state_objects.size());
     }
     void validate_expected_count(size_t _count, ctsSocketState::InternalState _state)
+    {
+        Assert::AreEqual(_count, matched_count(_state));
+    }
+    /// the broker deletes and replaces closed objects from its own threadpool work: poll for the expected count
+    void wait_for_expected_count(size_t _count, DWORD _milliseconds)
+    {
+        const ULONGLONG deadline = ::GetTickCount64() + _milliseconds;
+        while (object_count() != _count && ::GetTickCount64() < deadline) {
+            ::Sleep(10);
+        }
+        validate_expected_count(_count);
+    }
+    void wait_for_expected_count(size_t _count, ctsSocketState::InternalState _state, DWORD _milliseconds)
+    {
+        const ULONGLONG deadline = ::GetTickCount64() + _milliseconds;
+        while (matched_count(_state) != _count && ::GetTickCount64() < deadline) {
+            ::Sleep(10);
+        }
+        Assert::AreEqual(_count, matched_count(_state));
+    }
+
+    // non-copyable
+    SocketStatePool(const SocketStatePool&) = delete;
+    SocketStatePool& operator=(const SocketStatePool&) = delete;
+
+private:
+    size_t object_count()
+    {
+        const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
+
+        return state_objects.size();
+    }
+    size_t matched_count(ctsSocketState::InternalState _state)
     {
         const ctl::ctAutoReleaseCriticalSection hold_lock(&cs);
 
         size_t matched_state = 0;
         for (auto& socket_state : state_objects) {
+            // objects being deleted by the broker are no longer in any state
             auto shared_state(socket_state.lock());
-            Assert::IsNotNull(shared_state.get());
             if (shared_state) {
                 if (shared_state->current_state() == _state) {
                     ++matched_state;
                 }
             }
         }
-
-        Assert::AreEqual(_count, matched_state);
+        return matched_state;
     }
 
-    // non-copyable
-    SocketStatePool(const SocketStatePool&) = delete;
-    SocketStatePool& operator=(const SocketStatePool&) = delete;
-
-private:
     CRITICAL_SECTION cs;
     std::vector<std::weak_ptr<ctsSocketState>> state_objects;
+    size_t created_objects = 0;
 };
 
 SocketStatePool* s_SocketPool;
@@ -202,7 +246,7 @@ SocketStatePool* s_SocketPool;
 /// - don't need to actually do any work - just need to control indications back to the broker
 /// - but we do need to track all instances created so we can control each socketstate
 ///
-ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker) :
+ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker, PTP_CALLBACK_ENVIRON) :
     broker(std::move(_broker))
 {
 }
@@ -227,14 +271,15 @@ void ctsSocketState::complete_state(DWORD _error_code) noexcept
 
 		case ctsSocketState::InternalState::Creating: {
 			auto parent = this->broker.lock();
-			parent->initiating_io();
+			parent->initiating_io(*this);
 			this->state = ctsSocketState::InternalState::InitiatingIO;
 			break;
 		}
 		case ctsSocketState::InternalState::InitiatingIO: {
-			auto parent = this->broker.lock();
-			parent->closing(true);
+			// the broker deletes this object once it's given back: update the state first
 			this->state = ctsSocketState::InternalState::Closed;
+			auto parent = this->broker.lock();
+			parent->closing(*this, true);
 			break;
 		}
 
@@ -244,9 +289,10 @@ void ctsSocketState::complete_state(DWORD _error_code) noexcept
     }
     } else {
         // move straight to Closed
-		auto parent = this->broker.lock();
-        parent->closing(ctsSocketState::InternalState::InitiatingIO == this->state);
+        const bool was_active = (ctsSocketState::InternalState::InitiatingIO == this->state);
         this->state = ctsSocketState::InternalState::Closed;
+		auto parent = this->broker.lock();
+        parent->closing(*this, was_active);
     }
 }
 
@@ -279,6 +325,7 @@ namespace ctsUnitTest {
         TEST_METHOD_INITIALIZE(MethodSetup)
         {
             ctsSocketBroker::s_TimerCallbackTimeoutMs = 333;
+            ctsConfig::Settings->BrokerShards = 1;
         }
         TEST_METHOD_CLEANUP(MethodCleanup)
         {
@@ -312,7 +359,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Closing sockets");
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -345,7 +391,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Closing sockets");
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -379,7 +424,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Closing sockets");
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -412,7 +456,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Closing sockets");
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -443,15 +486,20 @@ namespace ctsUnitTest {
             Logger::WriteMessage(L"Starting IO on sockets");
             s_SocketPool->complete_state(NO_ERROR);
             s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::InitiatingIO);
+            // the next sockets to accept are created as soon as the prior ones initiate IO
+            s_SocketPool->wait_for_expected_count(1, ctsSocketState::InternalState::Creating, ctsSocketBroker::s_TimerCallbackTimeoutMs);
 
             Logger::WriteMessage(L"Closing sockets");
+            // closes the sockets with IO, and initiates IO on the sockets which were accepting
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
+            s_SocketPool->wait_for_expected_count(1, ctsSocketState::InternalState::Creating, ctsSocketBroker::s_TimerCallbackTimeoutMs);
+            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::InitiatingIO);
 
             Assert::IsFalse(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
             ::Sleep(ctsSocketBroker::s_TimerCallbackTimeoutMs);
-            s_SocketPool->validate_expected_count(1);
+            // the closed sockets have been deleted
+            s_SocketPool->validate_expected_count(2);
         }
         TEST_METHOD(ManySuccessfulServerConnectionWithoutExit)
         {
@@ -476,16 +524,61 @@ namespace ctsUnitTest {
             Logger::WriteMessage(L"Starting IO on sockets");
             s_SocketPool->complete_state(NO_ERROR);
             s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::InitiatingIO);
+            // the next sockets to accept are created as soon as the prior ones initiate IO
+            s_SocketPool->wait_for_expected_count(100, ctsSocketState::InternalState::Creating, ctsSocketBroker::s_TimerCallbackTimeoutMs);
 
             Logger::WriteMessage(L"Closing sockets");
+            // closes the sockets with IO, and initiates IO on the sockets which were accepting
             s_SocketPool->complete_state(NO_ERROR);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
+            s_SocketPool->wait_for_expected_count(100, ctsSocketState::InternalState::Creating, ctsSocketBroker::s_TimerCallbackTimeoutMs);
+            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::InitiatingIO);
 
             Assert::IsFalse(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
             ::Sleep(ctsSocketBroker::s_TimerCallbackTimeoutMs);
-            // should create the next socket to accept on the next Timer callback
-            s_SocketPool->validate_expected_count(100);
+            // the closed sockets have been deleted
+            s_SocketPool->validate_expected_count(200);
+        }
+        TEST_METHOD(ClosedClientConnectionsAreReplacedBeforeTheTimer)
+        {
+            s_SocketPool->reset();
+
+            // Initialize config for this test
+            // a client (connecting), not a server (accepting)
+            ctsConfig::Settings->AcceptFunction = nullptr;
+            ctsConfig::Settings->Iterations = 2;
+            ctsConfig::Settings->ConnectionLimit = 10;
+            ctsConfig::Settings->ConnectionThrottleLimit = 10;
+            // these are not applicable to client
+            ctsConfig::Settings->ServerExitLimit = 0;
+            ctsConfig::Settings->AcceptLimit = 0;
+
+            // the timer only fires once, as the broker starts, within this test
+            ctsSocketBroker::s_TimerCallbackTimeoutMs = 10000;
+            std::shared_ptr<ctsSocketBroker> test_broker(std::make_shared<ctsSocketBroker>());
+			test_broker->start();
+
+            s_SocketPool->validate_expected_count(10, ctsSocketState::InternalState::Creating);
+
+            Logger::WriteMessage(L"Starting IO on sockets");
+            s_SocketPool->complete_state(NO_ERROR);
+            s_SocketPool->validate_expected_count(10, ctsSocketState::InternalState::InitiatingIO);
+
+            Logger::WriteMessage(L"Closing sockets - the second iteration must start immediately");
+            s_SocketPool->complete_state(NO_ERROR);
+            s_SocketPool->wait_for_expected_count(10, ctsSocketState::InternalState::Creating, 1000);
+
+            Logger::WriteMessage(L"Completing the second iteration");
+            s_SocketPool->complete_state(NO_ERROR);
+            s_SocketPool->validate_expected_count(10, ctsSocketState::InternalState::InitiatingIO);
+            s_SocketPool->complete_state(NO_ERROR);
+
+            // the last socket closing signals the broker is done
+            Assert::IsTrue(test_broker->wait(1000));
+            s_SocketPool->wait_for_expected_count(0, 1000);
+
+            // the broker is deleted as this test returns: no need to wait the full timer interval to drain it
+            ctsSocketBroker::s_TimerCallbackTimeoutMs = 333;
         }
 
         TEST_METHOD(OneFailedClientConnection_FailedConnect)
@@ -510,7 +603,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Connecting sockets");
             s_SocketPool->complete_state(WSAECONNREFUSED);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -539,7 +631,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Connecting sockets");
             s_SocketPool->complete_state(WSAECONNREFUSED);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -569,7 +660,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Connecting sockets");
             s_SocketPool->complete_state(WSAECONNREFUSED);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -598,7 +688,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Connecting sockets");
             s_SocketPool->complete_state(WSAECONNREFUSED);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -632,7 +721,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Failing IO on sockets");
             s_SocketPool->complete_state(WSAENOBUFS);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -665,7 +753,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Failing IO on sockets");
             s_SocketPool->complete_state(WSAENOBUFS);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -699,7 +786,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Failing IO on sockets");
             s_SocketPool->complete_state(WSAENOBUFS);
-            s_SocketPool->validate_expected_count(1, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -732,7 +818,6 @@ namespace ctsUnitTest {
 
             Logger::WriteMessage(L"Failing IO on sockets");
             s_SocketPool->complete_state(WSAENOBUFS);
-            s_SocketPool->validate_expected_count(100, ctsSocketState::InternalState::Closed);
 
             Assert::IsTrue(test_broker->wait(ctsSocketBroker::s_TimerCallbackTimeoutMs * 2));
             // let the timer fire
@@ -1102,5 +1187,66 @@ namespace ctsUnitTest {
             // let the timer fire
             s_SocketPool->validate_expected_count(0);
         }
+
+        TEST_METHOD(ShardsSplitTheConnectionThrottleLimit)
+        {
+            s_SocketPool->reset();
+
+            // Initialize config for this test
+            // a client (connecting), not a server (accepting)
+            ctsConfig::Settings->AcceptFunction = nullptr;
+            ctsConfig::Settings->Iterations = 1;
+            ctsConfig::Settings->ConnectionLimit = 15;
+            ctsConfig::Settings->ConnectionThrottleLimit = 5;
+            ctsConfig::Settings->BrokerShards = 4;
+            // these are not applicable to client
+            ctsConfig::Settings->ServerExitLimit = 0;
+            ctsConfig::Settings->AcceptLimit = 0;
+
+            std::shared_ptr<ctsSocketBroker> test_broker(std::make_shared<ctsSocketBroker>());
+			test_broker->start();
+
+            Logger::WriteMessage(L"1. Expecting 5 creating across all shards, 10 waiting\n");
+            s_SocketPool->validate_expected_count(5, ctsSocketState::InternalState::Creating);
+
+            Logger::WriteMessage(L"2. Completing sockets until all shards are done\n");
+            for (unsigned pass = 0; pass < 50 && !test_broker->wait(100); ++pass) {
+                s_SocketPool->complete_state(NO_ERROR);
+            }
+            Assert::IsTrue(test_broker->wait(0));
+            Assert::AreEqual(static_cast<size_t>(15), s_SocketPool->created_count());
+            s_SocketPool->wait_for_expected_count(0, 1000);
+        }
+
+        TEST_METHOD(ShardsShareTheServerExitLimit)
+        {
+            s_SocketPool->reset();
+
+            // Initialize config for this test
+            // not a client (connecting), a server (accepting)
+            ctsConfig::Settings->AcceptFunction = [] (std::weak_ptr<ctsSocket>) { };
+            ctsConfig::Settings->ServerExitLimit = 10;
+            ctsConfig::Settings->Iterations = 10;
+            ctsConfig::Settings->AcceptLimit = 4;
+            ctsConfig::Settings->BrokerShards = 4;
+            // these are not applicable to server
+            ctsConfig::Settings->ConnectionLimit = 0;
+            ctsConfig::Settings->ConnectionThrottleLimit = 0;
+
+            std::shared_ptr<ctsSocketBroker> test_broker(std::make_shared<ctsSocketBroker>());
+			test_broker->start();
+
+            Logger::WriteMessage(L"1. Expecting one accepting socket on each shard\n");
+            s_SocketPool->validate_expected_count(4, ctsSocketState::InternalState::Creating);
+
+            Logger::WriteMessage(L"2. Completing sockets until all shards are done\n");
+            for (unsigned pass = 0; pass < 50 && !test_broker->wait(100); ++pass) {
+                s_SocketPool->complete_state(NO_ERROR);
+            }
+            Assert::IsTrue(test_broker->wait(0));
+            // the shards never create more than ServerExitLimit between them
+            Assert::AreEqual(static_cast<size_t>(10), s_SocketPool->created_count());
+            s_SocketPool->wait_for_expected_count(0, 1000);
+        }
     };
 }
\ No newline at end of file
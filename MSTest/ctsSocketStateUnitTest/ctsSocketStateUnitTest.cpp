@@ -90,13 +90,17 @@ namespace ctsTraffic {
         {
             return 0;
         }
+        USHORT CurrentNumaNode() noexcept
+        {
+            return 0;
+        }
     }
 
     /// ctsSocketBroker stubs - when ctsSocketState calls out to update the broker
-    void ctsSocketBroker::initiating_io() noexcept
+    void ctsSocketBroker::initiating_io(ctsSocketState& _socket_state) noexcept
     {
     }
-    void ctsSocketBroker::closing(bool _was_active) noexcept
+    void ctsSocketBroker::closing(ctsSocketState& _socket_state, bool _was_active) noexcept
     {
     }
 }
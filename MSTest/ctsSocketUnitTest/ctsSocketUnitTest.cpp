@@ -110,6 +110,10 @@ namespace ctsTraffic {
         {
             return 0;
         }
+        USHORT CurrentNumaNode() noexcept
+        {
+            return 0;
+        }
     }
 }
 ///
@@ -0,0 +1,190 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include <Windows.h>
+
+#include "ctsSubmissionBatcher.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ///
+    /// Requests are ints: even values go to queue 0 (sends), odd values to queue 1 (receives)
+    ///
+    class FakeSubmitter {
+    public:
+        static const size_t QueueCount = 2;
+
+        struct Submission {
+            int request;
+            bool deferred;
+        };
+        std::vector<Submission> submissions;
+        std::vector<int> failures;
+        std::vector<size_t> commits;
+        // requests with this value fail to be submitted
+        int failing_request = -1;
+
+        size_t queue_of(const int& _request) const noexcept
+        {
+            return static_cast<size_t>(_request % 2);
+        }
+
+        DWORD submit(int& _request, bool _defer) noexcept
+        {
+            if (_request == this->failing_request) {
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+            this->submissions.push_back({_request, _defer});
+            return NO_ERROR;
+        }
+
+        DWORD commit(size_t _queue) noexcept
+        {
+            this->commits.push_back(_queue);
+            return NO_ERROR;
+        }
+
+        void failed(int& _request, DWORD) noexcept
+        {
+            this->failures.push_back(_request);
+        }
+    };
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsSubmissionBatcherUnitTest)
+    {
+    public:
+        TEST_METHOD(EmptyBatchSubmitsNothing)
+        {
+            ctsSubmissionBatcher<int, 4> batch;
+            FakeSubmitter submitter;
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(0UL, results.submitted);
+            Assert::AreEqual(0UL, results.doorbells);
+            Assert::IsTrue(submitter.submissions.empty());
+        }
+
+        TEST_METHOD(SingleRequestIsNotDeferred)
+        {
+            ctsSubmissionBatcher<int, 4> batch;
+            FakeSubmitter submitter;
+            batch.queue(2);
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(1UL, results.submitted);
+            Assert::AreEqual(1UL, results.doorbells);
+            Assert::AreEqual(static_cast<size_t>(1), submitter.submissions.size());
+            Assert::IsFalse(submitter.submissions[0].deferred);
+            Assert::IsTrue(batch.empty());
+        }
+
+        TEST_METHOD(OneDoorbellPerQueue)
+        {
+            ctsSubmissionBatcher<int, 8> batch;
+            FakeSubmitter submitter;
+            // sends 0, 2, 4 and receives 1, 3 interleaved
+            for (int request : {0, 1, 2, 3, 4}) {
+                batch.queue(request);
+            }
+            Assert::IsFalse(batch.full());
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(5UL, results.submitted);
+            Assert::AreEqual(2UL, results.doorbells);
+            Assert::IsTrue(submitter.commits.empty());
+
+            // submitted in the order queued, only the last of each queue is not deferred
+            Assert::AreEqual(static_cast<size_t>(5), submitter.submissions.size());
+            const bool expected_deferred[] = {true, true, true, false, false};
+            for (size_t submission = 0; submission < 5; ++submission) {
+                Assert::AreEqual(static_cast<int>(submission), submitter.submissions[submission].request);
+                Assert::AreEqual(expected_deferred[submission], submitter.submissions[submission].deferred);
+            }
+        }
+
+        TEST_METHOD(FullBatch)
+        {
+            ctsSubmissionBatcher<int, 2> batch;
+            batch.queue(0);
+            Assert::IsFalse(batch.full());
+            batch.queue(2);
+            Assert::IsTrue(batch.full());
+            Assert::AreEqual(static_cast<size_t>(2), batch.size());
+
+            FakeSubmitter submitter;
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(2UL, results.submitted);
+            Assert::AreEqual(1UL, results.doorbells);
+            Assert::IsFalse(batch.full());
+        }
+
+        TEST_METHOD(FailedDeferredRequest)
+        {
+            ctsSubmissionBatcher<int, 4> batch;
+            FakeSubmitter submitter;
+            submitter.failing_request = 2;
+            for (int request : {0, 2, 4}) {
+                batch.queue(request);
+            }
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(2UL, results.submitted);
+            // the last request still rings the doorbell for the deferred request before it
+            Assert::AreEqual(1UL, results.doorbells);
+            Assert::IsTrue(submitter.commits.empty());
+            Assert::AreEqual(static_cast<size_t>(1), submitter.failures.size());
+            Assert::AreEqual(2, submitter.failures[0]);
+        }
+
+        TEST_METHOD(FailedFinalRequestCommitsDeferred)
+        {
+            ctsSubmissionBatcher<int, 4> batch;
+            FakeSubmitter submitter;
+            submitter.failing_request = 4;
+            for (int request : {0, 1, 2, 4}) {
+                batch.queue(request);
+            }
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(3UL, results.submitted);
+            // the receive rang its own doorbell, the sends had to be committed
+            Assert::AreEqual(2UL, results.doorbells);
+            Assert::AreEqual(static_cast<size_t>(1), submitter.commits.size());
+            Assert::AreEqual(static_cast<size_t>(0), submitter.commits[0]);
+            Assert::AreEqual(static_cast<size_t>(1), submitter.failures.size());
+            Assert::AreEqual(4, submitter.failures[0]);
+        }
+
+        TEST_METHOD(FailedOnlyRequestDoesNotCommit)
+        {
+            ctsSubmissionBatcher<int, 4> batch;
+            FakeSubmitter submitter;
+            submitter.failing_request = 1;
+            batch.queue(1);
+            const auto results = batch.flush(submitter);
+            Assert::AreEqual(0UL, results.submitted);
+            Assert::AreEqual(0UL, results.doorbells);
+            Assert::IsTrue(submitter.commits.empty());
+        }
+    };
+}
@@ -0,0 +1,176 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include <Windows.h>
+
+#include "ctsTimerWheel.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    ///
+    /// Returns the due ticks of the expired entries, in the order they expired
+    ///
+    std::vector<long long> TakeExpired(ctsTraffic::ctsTimerWheelList& _expired)
+    {
+        std::vector<long long> due_ticks;
+        while (auto* entry = _expired.pop_front()) {
+            due_ticks.push_back(entry->due_tick);
+        }
+        return due_ticks;
+    }
+
+    ///
+    /// Advances the wheel only to each tick next_due_tick() asks for, until the entry expires
+    /// - returns the tick it expired on
+    ///
+    long long AdvanceUntilExpired(ctsTraffic::ctsTimerWheel& _wheel)
+    {
+        ctsTraffic::ctsTimerWheelList expired;
+        for (;;) {
+            const long long next_tick = _wheel.next_due_tick();
+            Assert::IsTrue(next_tick >= 0);
+            _wheel.advance(next_tick, expired);
+            if (!expired.empty()) {
+                TakeExpired(expired);
+                return next_tick;
+            }
+        }
+    }
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsTimerWheelUnitTest)
+    {
+    public:
+        TEST_METHOD(ExpiresOnTheDueTick)
+        {
+            ctsTimerWheel wheel(1000LL);
+            ctsTimerWheelEntry entry;
+            wheel.schedule(&entry, 1005LL);
+            Assert::AreEqual(1UL, wheel.size());
+            Assert::AreEqual(1005LL, wheel.next_due_tick());
+
+            ctsTimerWheelList expired;
+            wheel.advance(1004LL, expired);
+            Assert::IsTrue(expired.empty());
+            wheel.advance(1005LL, expired);
+            Assert::IsTrue(&entry == expired.pop_front());
+            Assert::IsTrue(expired.empty());
+            Assert::AreEqual(0UL, wheel.size());
+            Assert::AreEqual(-1LL, wheel.next_due_tick());
+        }
+
+        TEST_METHOD(PastDueExpiresOnTheNextTick)
+        {
+            ctsTimerWheel wheel(1000LL);
+            ctsTimerWheelList expired;
+            wheel.advance(1010LL, expired);
+
+            ctsTimerWheelEntry entry;
+            wheel.schedule(&entry, 900LL);
+            Assert::AreEqual(1011LL, entry.due_tick);
+            wheel.advance(1011LL, expired);
+            Assert::IsTrue(&entry == expired.pop_front());
+        }
+
+        TEST_METHOD(CancelledEntriesDontExpire)
+        {
+            ctsTimerWheel wheel(0LL);
+            ctsTimerWheelEntry near_entry;
+            ctsTimerWheelEntry far_entry;
+            wheel.schedule(&near_entry, 10LL);
+            wheel.schedule(&far_entry, 100000LL);
+            wheel.cancel(&near_entry);
+            wheel.cancel(&far_entry);
+            Assert::AreEqual(0UL, wheel.size());
+
+            ctsTimerWheelList expired;
+            wheel.advance(200000LL, expired);
+            Assert::IsTrue(expired.empty());
+        }
+
+        TEST_METHOD(ExpiresInDueOrder)
+        {
+            ctsTimerWheel wheel(0LL);
+            const long long due_ticks[] {700LL, 3LL, 20000LL, 650LL, 255LL, 256LL, 3LL, 5000000LL, 1LL};
+            ctsTimerWheelEntry entries[_countof(due_ticks)];
+            for (size_t index = 0; index < _countof(due_ticks); ++index) {
+                wheel.schedule(&entries[index], due_ticks[index]);
+            }
+
+            ctsTimerWheelList expired;
+            wheel.advance(5000000LL, expired);
+            const std::vector<long long> expired_ticks(TakeExpired(expired));
+            const std::vector<long long> expected_ticks {1LL, 3LL, 3LL, 255LL, 256LL, 650LL, 700LL, 20000LL, 5000000LL};
+            Assert::IsTrue(expected_ticks == expired_ticks);
+        }
+
+        TEST_METHOD(CascadesToTheExactTick)
+        {
+            // due in each coarser level, and beyond the furthest the wheel can hold
+            const long long due_ticks[] {1000LL, 20000LL, 2000000LL, ctsTimerWheel::MaxDelta + 100LL};
+            for (const auto due_tick : due_ticks) {
+                ctsTimerWheel wheel(12345LL);
+                ctsTimerWheelEntry entry;
+                wheel.schedule(&entry, 12345LL + due_tick);
+
+                ctsTimerWheelList expired;
+                wheel.advance(12345LL + due_tick - 1, expired);
+                Assert::IsTrue(expired.empty());
+                wheel.advance(12345LL + due_tick, expired);
+                Assert::IsTrue(&entry == expired.pop_front());
+            }
+        }
+
+        TEST_METHOD(NextDueTickNeverSkipsAnEntry)
+        {
+            const long long due_ticks[] {10LL, 300LL, 1000LL, 70000LL};
+            for (const auto due_tick : due_ticks) {
+                ctsTimerWheel wheel(0LL);
+                ctsTimerWheelEntry entry;
+                wheel.schedule(&entry, due_tick);
+                Assert::AreEqual(due_tick, AdvanceUntilExpired(wheel));
+            }
+        }
+
+        TEST_METHOD(NextDueTickIsTheEarliestEntry)
+        {
+            ctsTimerWheel wheel(0LL);
+            ctsTimerWheelEntry later_entry;
+            ctsTimerWheelEntry earlier_entry;
+            wheel.schedule(&later_entry, 200LL);
+            wheel.schedule(&earlier_entry, 20LL);
+            Assert::AreEqual(20LL, wheel.next_due_tick());
+
+            // an entry in a coarser level needs the wheel advanced to the next turn of the root level
+            ctsTimerWheelEntry coarse_entry;
+            wheel.schedule(&coarse_entry, 600LL);
+            wheel.cancel(&earlier_entry);
+            wheel.cancel(&later_entry);
+            Assert::AreEqual(256LL, wheel.next_due_tick());
+        }
+    };
+}
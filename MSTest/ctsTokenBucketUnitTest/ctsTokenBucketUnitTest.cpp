@@ -0,0 +1,142 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <Windows.h>
+
+#include "ctsTokenBucket.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+///
+/// Fakes
+///
+namespace ctsUnitTest {
+    // 1 Gbps: 8 ns per byte
+    const long long TestBytesPerSecond = 125000000LL;
+    const long long TestNsPerByte = 8LL;
+    const long long TestStartNs = 5000000000LL;
+}
+///
+/// End of Fakes
+///
+
+using namespace ctsTraffic;
+namespace ctsUnitTest {
+    TEST_CLASS(ctsTokenBucketUnitTest)
+    {
+    public:
+        TEST_METHOD(NoBurstPacesEverySend)
+        {
+            ctsTokenBucket bucket(TestBytesPerSecond, 0LL, TestStartNs);
+            // the first send isn't delayed, each one after waits for the one before to be paid for
+            long long now = TestStartNs;
+            Assert::AreEqual(0LL, bucket.delay_for(1000LL, now));
+            Assert::AreEqual(1000LL * TestNsPerByte, bucket.delay_for(1000LL, now));
+            Assert::AreEqual(2000LL * TestNsPerByte, bucket.delay_for(1000LL, now));
+
+            // sending on schedule is never delayed
+            now += 3000LL * TestNsPerByte;
+            for (unsigned long counter = 0; counter < 100; ++counter) {
+                Assert::AreEqual(0LL, bucket.delay_for(1000LL, now));
+                now += 1000LL * TestNsPerByte;
+            }
+        }
+
+        TEST_METHOD(BurstIsSentImmediately)
+        {
+            ctsTokenBucket bucket(TestBytesPerSecond, 4000LL, TestStartNs);
+            for (unsigned long counter = 0; counter < 4; ++counter) {
+                Assert::AreEqual(0LL, bucket.delay_for(1000LL, TestStartNs));
+            }
+            // the bucket is then empty: the next send waits for its tokens
+            Assert::AreEqual(1000LL * TestNsPerByte, bucket.delay_for(1000LL, TestStartNs));
+        }
+
+        TEST_METHOD(BucketRefillsOnlyToTheBurst)
+        {
+            ctsTokenBucket bucket(TestBytesPerSecond, 4000LL, TestStartNs);
+            // idle long enough to have filled the bucket many times over
+            const long long now = TestStartNs + 1000000000LL;
+            for (unsigned long counter = 0; counter < 4; ++counter) {
+                Assert::AreEqual(0LL, bucket.delay_for(1000LL, now));
+            }
+            Assert::AreEqual(1000LL * TestNsPerByte, bucket.delay_for(1000LL, now));
+        }
+
+        TEST_METHOD(SendLargerThanTheBurstWaitsForAFullBucket)
+        {
+            ctsTokenBucket bucket(TestBytesPerSecond, 1000LL, TestStartNs);
+            Assert::AreEqual(0LL, bucket.delay_for(500LL, TestStartNs));
+            // needs a full bucket: the 500 bytes taken are refilled first
+            Assert::AreEqual(500LL * TestNsPerByte, bucket.delay_for(3000LL, TestStartNs));
+            // the large send left the bucket in debt for its other 2000 bytes
+            Assert::AreEqual(3500LL * TestNsPerByte, bucket.delay_for(1000LL, TestStartNs));
+        }
+
+        TEST_METHOD(SubMillisecondDelays)
+        {
+            // 64KB sends at 10 Gbps are 52.4288 microseconds apart
+            ctsTokenBucket bucket(1250000000LL, 0LL, TestStartNs);
+            Assert::AreEqual(0LL, bucket.delay_for(65536LL, TestStartNs));
+            Assert::AreEqual(52429LL, bucket.delay_for(65536LL, TestStartNs));
+            Assert::AreEqual(104858LL, bucket.delay_for(65536LL, TestStartNs));
+        }
+
+        TEST_METHOD(BurstMeterMeasuresPacedSendsAsOneSend)
+        {
+            ctsBurstMeter meter(TestBytesPerSecond, TestStartNs);
+            long long now = TestStartNs;
+            for (unsigned long counter = 0; counter < 100; ++counter) {
+                meter.record(1000LL, now);
+                now += 1000LL * TestNsPerByte;
+            }
+            Assert::AreEqual(1000LL, meter.max_burst_bytes());
+        }
+
+        TEST_METHOD(BurstMeterMeasuresTheLargestBurst)
+        {
+            ctsBurstMeter meter(TestBytesPerSecond, TestStartNs);
+            // 4 sends at once
+            for (unsigned long counter = 0; counter < 4; ++counter) {
+                meter.record(1000LL, TestStartNs);
+            }
+            Assert::AreEqual(4000LL, meter.max_burst_bytes());
+
+            // after going idle, a smaller burst doesn't change the largest
+            const long long now = TestStartNs + 1000000000LL;
+            meter.record(1000LL, now);
+            meter.record(1000LL, now);
+            Assert::AreEqual(4000LL, meter.max_burst_bytes());
+
+            // sends ahead of the rate accumulate: 3 sends every 2 sends' worth of time
+            long long ahead = now + 2000LL * TestNsPerByte;
+            for (unsigned long counter = 0; counter < 10; ++counter) {
+                meter.record(1000LL, ahead);
+                meter.record(1000LL, ahead);
+                meter.record(1000LL, ahead);
+                ahead += 2000LL * TestNsPerByte;
+            }
+            Assert::AreEqual(12000LL, meter.max_burst_bytes());
+        }
+
+        TEST_METHOD(BurstMeterWithoutARate)
+        {
+            ctsBurstMeter meter(0LL, TestStartNs);
+            meter.record(1000LL, TestStartNs);
+            Assert::AreEqual(0LL, meter.max_burst_bytes());
+        }
+    };
+}
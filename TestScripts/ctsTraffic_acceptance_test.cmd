@@ -48,6 +48,11 @@ CALL :TESTCASES pull rioiocp
 CALL :TESTCASES pushpull rioiocp
 CALL :TESTCASES duplex rioiocp
 
+CALL :TESTCASES push riopoll
+CALL :TESTCASES pull riopoll
+CALL :TESTCASES pushpull riopoll
+CALL :TESTCASES duplex riopoll
+
 goto :eof
 
 :TESTCASES
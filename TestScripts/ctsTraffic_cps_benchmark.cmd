@@ -0,0 +1,76 @@
+REM
+REM
+REM Copyright (c) Microsoft Corporation
+REM All rights reserved.
+REM
+REM Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+REM
+REM THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+REM
+REM See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+REM
+REM
+
+REM
+REM Connections-per-second benchmark comparing the server accept functions
+REM - each run makes %CONNECTIONS% x %ITERATIONS% short-lived connections, each transferring %TRANSFER% bytes
+REM - compare the 'Connections Per Second' line from the client summary across the -acc options
+REM
+REM usage: ctsTraffic_cps_benchmark.cmd <server,client> [target]
+REM - start the server first, then the client with the server's address (default is localhost)
+REM
+
+@echo off
+
+if '%1' == '' (
+  echo Must specify server or client as the first argument
+  goto :exit
+)
+if /i '%1' NEQ 'server' (
+  if /i '%1' NEQ 'client' (
+    echo Must specify server or client
+    goto :exit
+  )
+)
+
+set Role=%1
+set Target=%2
+if '%Target%' == '' (
+  set Target=localhost
+)
+
+set CONNECTIONS=1000
+set ITERATIONS=10
+set /a TOTAL_CONNECTIONS=%CONNECTIONS% * %ITERATIONS%
+set TRANSFER=100
+
+CALL :BENCHMARK accept
+CALL :BENCHMARK AcceptEx
+CALL :BENCHMARK AcceptLoop
+
+goto :eof
+
+:BENCHMARK
+set ServerOptions= -listen:* -acc:%1 -pattern:push -buffer:%TRANSFER% -transfer:%TRANSFER% -ServerExitLimit:%TOTAL_CONNECTIONS% -ConsoleVerbosity:1 -StatusUpdate:1000
+set ClientOptions= -target:%Target% -pattern:push -buffer:%TRANSFER% -transfer:%TRANSFER% -connections:%CONNECTIONS% -iterations:%ITERATIONS% -ConsoleVerbosity:1 -StatusUpdate:1000
+
+echo.
+echo **********************************************************************************************
+echo Benchmark : -acc:%1
+echo **********************************************************************************************
+Set ERRORLEVEL=
+if '%Role%' == 'server' (
+  ctsTraffic.exe %ServerOptions%
+)
+if '%Role%' == 'client' (
+  REM delay the client so the server is listening
+  ping localhost -n 5 > nul
+  ctsTraffic.exe %ClientOptions%
+)
+
+IF ERRORLEVEL 1 (
+  echo BENCHMARK FAILED: %ERRORLEVEL% connections failed with -acc:%1
+  PAUSE
+)
+
+:exit
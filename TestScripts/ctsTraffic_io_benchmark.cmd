@@ -0,0 +1,81 @@
+REM
+REM
+REM Copyright (c) Microsoft Corporation
+REM All rights reserved.
+REM
+REM Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+REM
+REM THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+REM
+REM See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+REM
+REM
+
+REM
+REM Throughput benchmark comparing the IO functions driving WSASend/WSARecv: -IO:iocp and -IO:coroutine
+REM - each pattern is run with both IO functions, %CONNECTIONS% connections each transferring %TRANSFER% bytes
+REM - small buffers are used so the per-IO cost of the IO function dominates over the cost of copying data
+REM - compare the 'Total Bytes' and time taken in the client summary, and the CPU used, across the -IO options
+REM
+REM usage: ctsTraffic_io_benchmark.cmd <server,client> [target]
+REM - start the server first, then the client with the server's address (default is localhost)
+REM
+
+@echo off
+
+if '%1' == '' (
+  echo Must specify server or client as the first argument
+  goto :exit
+)
+if /i '%1' NEQ 'server' (
+  if /i '%1' NEQ 'client' (
+    echo Must specify server or client
+    goto :exit
+  )
+)
+
+set Role=%1
+set Target=%2
+if '%Target%' == '' (
+  set Target=localhost
+)
+
+set CONNECTIONS=64
+set BUFFER=4096
+set TRANSFER=1073741824
+
+CALL :BENCHMARK iocp push
+CALL :BENCHMARK coroutine push
+CALL :BENCHMARK iocp pull
+CALL :BENCHMARK coroutine pull
+CALL :BENCHMARK iocp pushpull
+CALL :BENCHMARK coroutine pushpull
+CALL :BENCHMARK iocp duplex
+CALL :BENCHMARK coroutine duplex
+
+goto :eof
+
+:BENCHMARK
+set ServerOptions= -listen:* -io:%1 -pattern:%2 -buffer:%BUFFER% -transfer:%TRANSFER% -ServerExitLimit:%CONNECTIONS% -ConsoleVerbosity:1 -StatusUpdate:1000
+set ClientOptions= -target:%Target% -io:%1 -pattern:%2 -buffer:%BUFFER% -transfer:%TRANSFER% -connections:%CONNECTIONS% -iterations:1 -ConsoleVerbosity:1 -StatusUpdate:1000
+
+echo.
+echo **********************************************************************************************
+echo Benchmark : -io:%1 -pattern:%2
+echo **********************************************************************************************
+Set ERRORLEVEL=
+if '%Role%' == 'server' (
+  ctsTraffic.exe %ServerOptions%
+)
+if '%Role%' == 'client' (
+  REM delay the client so the server is listening
+  ping localhost -n 5 > nul
+  ctsTraffic.exe %ClientOptions%
+)
+
+IF ERRORLEVEL 1 (
+  echo BENCHMARK FAILED: %ERRORLEVEL% connections failed with -io:%1 -pattern:%2
+  PAUSE
+)
+
+:exit
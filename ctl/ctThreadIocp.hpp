@@ -14,8 +14,10 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #pragma once
 
 // cpp headers
+#include <new>
 #include <utility>
 #include <functional>
+#include <type_traits>
 // os headers
 #include <excpt.h>
 #include <Windows.h>
@@ -35,15 +37,25 @@ namespace ctl
 	//
 	typedef std::function<void(OVERLAPPED*)> ctThreadIocpCallback_t;
 
+	//
+	// the common start of every request given to the ctThreadIocp IO completion function
+	// - the OVERLAPPED must be first: the completion function is given only the OVERLAPPED*
+	// - pooled_dispatch is only set for requests from new_pooled_request
+	//   it's invoked instead of a std::function, with _completed == false when the request is canceled
+	//
+	struct ctThreadIocpRequest
+	{
+		OVERLAPPED ov{};
+		void (*pooled_dispatch)(ctThreadIocpRequest* _request, bool _completed) = nullptr;
+	};
+
 	//
 	// structure passed to the ctThreadIocp IO completion function
 	// - to allow the callback function to find the callback
 	//   associated with that completed OVERLAPPED* 
 	//
-	struct ctThreadIocpCallbackInfo
+	struct ctThreadIocpCallbackInfo : ctThreadIocpRequest
 	{
-		OVERLAPPED ov{};
-		PVOID _padding{}; // required padding before the std::function for the below C_ASSERT alignment/sizing to be correct
 		ctThreadIocpCallback_t callback;
 
 		// ReSharper disable once CppPossiblyUninitializedMember
@@ -63,6 +75,99 @@ namespace ctl
 	// asserting at compile time, as we assume this when we reinterpret_cast in the callback
 	C_ASSERT(sizeof(ctThreadIocpCallbackInfo) == sizeof(OVERLAPPED) +sizeof(PVOID) +sizeof(ctThreadIocpCallback_t));
 
+	namespace details
+	{
+		//
+		// a request from new_pooled_request
+		// - holds the caller's Context inline and invokes the callback through a function pointer
+		// - the Context is constructed when the request is handed out, and destroyed once it completes or is canceled
+		//
+		template <typename Context>
+		struct ctThreadIocpPooledRequest : ctThreadIocpRequest
+		{
+			typedef void (*Callback_t)(OVERLAPPED* _overlapped, Context& _context);
+
+			Callback_t callback = nullptr;
+			ctThreadIocpPooledRequest* next_free = nullptr;
+			typename std::aligned_storage<sizeof(Context), alignof(Context)>::type context_storage;
+
+			Context& context() noexcept
+			{
+				return *reinterpret_cast<Context*>(&context_storage);
+			}
+
+			static void dispatch(ctThreadIocpRequest* _request, bool _completed) noexcept;
+		};
+
+		//
+		// a per-thread free list of pooled requests
+		// - requests are taken from the list of the thread starting the IO
+		//   and returned to the list of the thread which completes it, so the lists need no lock
+		// - each thread keeps at most MaxFreeRequests: beyond that requests are freed as they complete
+		//
+		template <typename Context>
+		class ctThreadIocpRequestFreeList
+		{
+		public:
+			static const unsigned long MaxFreeRequests = 256;
+
+			static ctThreadIocpRequestFreeList& for_this_thread() noexcept
+			{
+				static thread_local ctThreadIocpRequestFreeList free_list;
+				return free_list;
+			}
+
+			ctThreadIocpRequestFreeList() = default;
+			~ctThreadIocpRequestFreeList() noexcept
+			{
+				while (head) {
+					ctThreadIocpPooledRequest<Context>* next = head->next_free;
+					delete head;
+					head = next;
+				}
+			}
+
+			ctThreadIocpPooledRequest<Context>* pop() noexcept
+			{
+				ctThreadIocpPooledRequest<Context>* request = head;
+				if (request) {
+					head = request->next_free;
+					--count;
+				}
+				return request;
+			}
+
+			void push(ctThreadIocpPooledRequest<Context>* _request) noexcept
+			{
+				if (count >= MaxFreeRequests) {
+					delete _request;
+					return;
+				}
+				_request->next_free = head;
+				head = _request;
+				++count;
+			}
+
+			ctThreadIocpRequestFreeList(const ctThreadIocpRequestFreeList&) = delete;
+			ctThreadIocpRequestFreeList& operator=(const ctThreadIocpRequestFreeList&) = delete;
+
+		private:
+			ctThreadIocpPooledRequest<Context>* head = nullptr;
+			unsigned long count = 0;
+		};
+
+		template <typename Context>
+		void ctThreadIocpPooledRequest<Context>::dispatch(ctThreadIocpRequest* _request, bool _completed) noexcept
+		{
+			auto* pooled_request = static_cast<ctThreadIocpPooledRequest*>(_request);
+			if (_completed) {
+				pooled_request->callback(&pooled_request->ov, pooled_request->context());
+			}
+			pooled_request->context().~Context();
+			ctThreadIocpRequestFreeList<Context>::for_this_thread().push(pooled_request);
+		}
+	}
+
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	///
@@ -177,6 +282,41 @@ namespace ctl
 			return &new_callback->ov;
 		}
 
+		//
+		// new_pooled_request is the allocation-free alternative to new_request for the hot IO path
+		// - the callback is a plain function, invoked with the OVERLAPPED* and a reference to the request's copy of _context
+		// - requests are reused from a per-thread free list, so only a thread's first requests allocate
+		//   (Context should be cheap to copy and must not throw from its d'tor)
+		//
+		// The returned OVERLAPPED* follows exactly the same rules as one returned from new_request
+		// - including calling cancel_request if the Win32 API fails with an error other than ERROR_IO_PENDING
+		//
+		template <typename Context>
+		OVERLAPPED* new_pooled_request(void (*_callback)(OVERLAPPED*, Context&), const Context& _context) const
+		{
+			auto& free_list = details::ctThreadIocpRequestFreeList<Context>::for_this_thread();
+			auto* new_request = free_list.pop();
+			if (!new_request) {
+				// this can fail by throwing std::bad_alloc
+				new_request = new details::ctThreadIocpPooledRequest<Context>;
+			}
+			try {
+				new (&new_request->context_storage) Context(_context);
+			}
+			catch (...) {
+				free_list.push(new_request);
+				throw;
+			}
+			new_request->callback = _callback;
+			new_request->pooled_dispatch = &details::ctThreadIocpPooledRequest<Context>::dispatch;
+
+			// once creating a new request succeeds, start the IO
+			// - all below calls are no-fail calls
+			::StartThreadpoolIo(ptp_io);
+			::ZeroMemory(&new_request->ov, sizeof OVERLAPPED);
+			return &new_request->ov;
+		}
+
 		//
 		// This function should be called only if the Win32 API call which was given the OVERLAPPED* from new_request
 		// - failed with an error other than ERROR_IO_PENDING
@@ -188,8 +328,12 @@ namespace ctl
 		void cancel_request(OVERLAPPED* _pov) const noexcept
 		{
 			::CancelThreadpoolIo(ptp_io);
-			const auto old_request = reinterpret_cast<ctThreadIocpCallbackInfo*>(_pov);
-			delete old_request;
+			const auto old_request = reinterpret_cast<ctThreadIocpRequest*>(_pov);
+			if (old_request->pooled_dispatch) {
+				old_request->pooled_dispatch(old_request, false);
+			} else {
+				delete static_cast<ctThreadIocpCallbackInfo*>(old_request);
+			}
 		}
 
 		//
@@ -218,9 +362,14 @@ namespace ctl
 			// we're working really hard to break and never let TP swalling SEH exceptions
 			EXCEPTION_POINTERS* exr = nullptr;
 			__try {
-				auto* _request = static_cast<ctThreadIocpCallbackInfo*>(_overlapped);
-				_request->callback(static_cast<OVERLAPPED*>(_overlapped));
-				delete _request;
+				auto* _request = static_cast<ctThreadIocpRequest*>(_overlapped);
+				if (_request->pooled_dispatch) {
+					_request->pooled_dispatch(_request, true);
+				} else {
+					auto* _callback_info = static_cast<ctThreadIocpCallbackInfo*>(_request);
+					_callback_info->callback(static_cast<OVERLAPPED*>(_overlapped));
+					delete _callback_info;
+				}
 			}
 				// ReSharper disable once CppAssignedValueIsNeverUsed (exr is used in the except handler)
 			__except ((exr = GetExceptionInformation()), EXCEPTION_EXECUTE_HANDLER)
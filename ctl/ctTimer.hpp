@@ -175,6 +175,20 @@ namespace ctl
 			return static_cast<long long>((qpc.QuadPart * 1000LL) / details::s_Qpf.QuadPart);
 		}
 #endif
+		///
+		/// Returns the current 'time' from QPC/QPF in terms of nanoseconds
+		/// - for sub-millisecond pacing: unit tests pass their own times to the types which use this
+		///
+		inline
+		long long snap_qpc_as_nsec() noexcept
+		{
+			(void)::InitOnceExecuteOnce(&details::s_QpfInitOnce, details::s_QpfInitOnceCallback, nullptr, nullptr);
+			LARGE_INTEGER qpc;
+			::QueryPerformanceCounter(&qpc);
+			// split into whole seconds and the remainder: qpc * 1000000000 would overflow within minutes
+			const long long qpf = details::s_Qpf.QuadPart;
+			return (qpc.QuadPart / qpf) * 1000000000LL + ((qpc.QuadPart % qpf) * 1000000000LL) / qpf;
+		}
 		///
 		/// Returns the current 'time' from QPC/QPF as a FILETIME
 		/// (FILETIME records time in one-hundred-nano-seconds)
@@ -0,0 +1,380 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// cpp headers
+#include <vector>
+#include <deque>
+#include <memory>
+#include <exception>
+// os headers
+#include <windows.h>
+#include <winsock2.h>
+// ctl headers
+#include <ctSockaddr.hpp>
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+#include <ctHandle.hpp>
+#include <ctScopeGuard.hpp>
+// project headers
+#include "ctsSocket.h"
+#include "ctsConfig.h"
+
+namespace ctsTraffic {
+    //
+    // Accepts connections with one persistent accept loop per listening socket
+    //
+    // Unlike ctsAcceptEx, no accept request is re-armed for each connection
+    // - a long-running threadpool work item per listener calls accept() back-to-back
+    // - each accepted socket is handed directly to the ctsSocket that has waited the longest for a connection
+    //
+    // If no ctsSocket is waiting, the accepted connection is queued for the next request
+    // - once MaxQueuedConnections are queued the loops stop accepting until a request arrives,
+    //   leaving further connections in the listen backlog
+    //
+    namespace details {
+        //
+        // bounds the connections accepted ahead of requests across all listeners
+        //
+        static const size_t MaxQueuedConnections = 100;
+
+        class ctsAcceptLoopImpl;
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// struct to capture relevant details of an accepted connection
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////
+        struct ctsAcceptLoopConnection {
+            ctl::ctScopedSocket accept_socket;
+            ctl::ctSockaddr local_addr;
+            ctl::ctSockaddr remote_addr;
+            DWORD gle = 0;
+        };
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// struct to track each listening socket and the work item running its accept loop
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////
+        struct ctsAcceptLoopListener {
+            ctsAcceptLoopListener(ctsAcceptLoopImpl* _parent, const ctl::ctSockaddr& _addr) noexcept :
+                parent(_parent),
+                addr(_addr)
+            {
+            }
+            ~ctsAcceptLoopListener() noexcept
+            {
+                // the listening socket must be closed first to fail the blocking accept() in the loop
+                this->socket.reset();
+                if (this->accept_loop != nullptr) {
+                    ::WaitForThreadpoolWorkCallbacks(this->accept_loop, TRUE);
+                    ::CloseThreadpoolWork(this->accept_loop);
+                }
+            }
+
+            ctsAcceptLoopListener(const ctsAcceptLoopListener&) = delete;
+            ctsAcceptLoopListener& operator=(const ctsAcceptLoopListener&) = delete;
+            ctsAcceptLoopListener(ctsAcceptLoopListener&&) = delete;
+            ctsAcceptLoopListener& operator=(ctsAcceptLoopListener&&) = delete;
+
+            ctsAcceptLoopImpl* parent = nullptr;
+            ctl::ctSockaddr addr;
+            ctl::ctScopedSocket socket;
+            PTP_WORK accept_loop = nullptr;
+        };
+
+        class ctsAcceptLoopImpl {
+        private:
+            TP_CALLBACK_ENVIRON thread_pool_environment{};
+            // CS guards access to the queues and is the lock for the condition variable
+            CRITICAL_SECTION cs{};
+            // signaled when a request takes a queued connection, freeing room to accept another
+            CONDITION_VARIABLE room_to_accept{};
+
+            _Guarded_by_(cs)
+            std::deque<std::weak_ptr<ctsSocket>> pended_accept_requests;
+            _Guarded_by_(cs)
+            std::deque<ctsAcceptLoopConnection> accepted_connections;
+            _Guarded_by_(cs)
+            bool shutting_down = false;
+
+            std::vector<std::unique_ptr<ctsAcceptLoopListener>> listeners;
+
+        public:
+            ctsAcceptLoopImpl()
+            {
+                if (!::InitializeCriticalSectionEx(&cs, 4000, 0)) {
+                    throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsAcceptLoop", false);
+                }
+                ctlScopeGuard(deleteCsOnError, { ::DeleteCriticalSection(&cs); });
+                ::InitializeConditionVariable(&room_to_accept);
+
+                // will use the global threadpool, but will mark these work-items as running long
+                ::InitializeThreadpoolEnvironment(&thread_pool_environment);
+                ::SetThreadpoolCallbackRunsLong(&thread_pool_environment);
+
+                // listen to each address
+                // - if anything fails, this temp vector will go out of scope and safely be destroyed
+                std::vector<std::unique_ptr<ctsAcceptLoopListener>> temp_listeners;
+                for (const auto& addr : ctsConfig::Settings->ListenAddresses) {
+                    auto listener(std::make_unique<ctsAcceptLoopListener>(this, addr));
+                    listener->socket.reset(ctsConfig::CreateSocket(addr.family(), SOCK_STREAM, IPPROTO_TCP, ctsConfig::Settings->SocketFlags));
+
+                    const auto gle = ctsConfig::SetPreBindOptions(listener->socket.get(), addr);
+                    if (gle != NO_ERROR) {
+                        throw ctl::ctException(gle, L"SetPreBindOptions", L"ctsAcceptLoop", false);
+                    }
+
+                    if (SOCKET_ERROR == ::bind(listener->socket.get(), addr.sockaddr(), addr.length())) {
+                        throw ctl::ctException(::WSAGetLastError(), L"bind", L"ctsAcceptLoop", false);
+                    }
+
+                    if (SOCKET_ERROR == ::listen(listener->socket.get(), ctsConfig::GetListenBacklog())) {
+                        throw ctl::ctException(::WSAGetLastError(), L"listen", L"ctsAcceptLoop", false);
+                    }
+
+                    listener->accept_loop = ::CreateThreadpoolWork(AcceptLoopWorker, listener.get(), &thread_pool_environment);
+                    if (nullptr == listener->accept_loop) {
+                        throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsAcceptLoop", false);
+                    }
+
+                    PrintDebugInfo(
+                        L"\t\tListening to %ws\n", addr.writeCompleteAddress().c_str());
+                    temp_listeners.push_back(std::move(listener));
+                }
+
+                if (temp_listeners.empty()) {
+                    throw std::exception("ctsAcceptLoop invoked with no listening addresses specified");
+                }
+
+                // everything succeeded - start accepting on every listener
+                listeners.swap(temp_listeners);
+                for (const auto& listener : listeners) {
+                    ::SubmitThreadpoolWork(listener->accept_loop);
+                }
+                deleteCsOnError.dismiss();
+            }
+
+            ~ctsAcceptLoopImpl() noexcept
+            {
+                ::EnterCriticalSection(&cs);
+                shutting_down = true;
+                // close out all caller requests for new accepted sockets
+                for (const auto& weak_socket : pended_accept_requests) {
+                    auto shared_socket(weak_socket.lock());
+                    if (shared_socket) {
+                        shared_socket->complete_state(WSAECONNABORTED);
+                    }
+                }
+                pended_accept_requests.clear();
+                ::LeaveCriticalSection(&cs);
+                ::WakeAllConditionVariable(&room_to_accept);
+
+                // closes each listening socket and waits for its accept loop to exit
+                listeners.clear();
+                accepted_connections.clear();
+
+                ::DeleteCriticalSection(&cs);
+            }
+
+            //
+            // Returns a queued connection if one was already accepted
+            // - else saves the request to be handed the next connection accepted
+            //
+            void accept_socket(const std::weak_ptr<ctsSocket>& _weak_socket)
+            {
+                ctsAcceptLoopConnection accepted_connection;
+                {
+                    const ctl::ctAutoReleaseCriticalSection lock(&cs);
+                    if (accepted_connections.empty()) {
+                        // no accepted connections yet -- save the weak_ptr, *not* the shared_ptr
+                        pended_accept_requests.push_back(_weak_socket);
+                        return;
+                    }
+
+                    accepted_connection = std::move(accepted_connections.front());
+                    accepted_connections.pop_front();
+                }
+                // a connection was taken off the queue - a loop waiting for room can accept again
+                ::WakeAllConditionVariable(&room_to_accept);
+
+                complete_accept(_weak_socket, accepted_connection);
+            }
+
+            // non-copyable
+            ctsAcceptLoopImpl(const ctsAcceptLoopImpl&) = delete;
+            ctsAcceptLoopImpl& operator=(const ctsAcceptLoopImpl&) = delete;
+            ctsAcceptLoopImpl(ctsAcceptLoopImpl&&) = delete;
+            ctsAcceptLoopImpl& operator=(ctsAcceptLoopImpl&&) = delete;
+
+        private:
+            static VOID NTAPI AcceptLoopWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept
+            {
+                const auto* listener = static_cast<ctsAcceptLoopListener*>(_context);
+                listener->parent->run_accept_loop(listener->socket.get());
+            }
+
+            //
+            // Runs for the lifetime of the listening socket: only returns once shutting down
+            //
+            void run_accept_loop(SOCKET _listening_socket) noexcept
+            {
+                for (;;) {
+                    // scoping the lock: wait for room to queue another connection before accepting it
+                    {
+                        const ctl::ctAutoReleaseCriticalSection lock(&cs);
+                        while (!shutting_down && accepted_connections.size() >= MaxQueuedConnections) {
+                            ::SleepConditionVariableCS(&room_to_accept, &cs, INFINITE);
+                        }
+                        if (shutting_down) {
+                            return;
+                        }
+                    }
+
+                    ctsAcceptLoopConnection accepted_connection;
+                    int remote_addr_len = accepted_connection.remote_addr.length();
+                    accepted_connection.accept_socket.reset(
+                        ::accept(_listening_socket, accepted_connection.remote_addr.sockaddr(), &remote_addr_len));
+                    if (INVALID_SOCKET == accepted_connection.accept_socket.get()) {
+                        accepted_connection.gle = ::WSAGetLastError();
+                        // closing the listening socket on shutdown fails the blocking accept()
+                        if (!this->is_shutting_down()) {
+                            ctsConfig::PrintErrorIfFailed(L"accept", accepted_connection.gle);
+                        }
+                    } else {
+                        accepted_connection.gle = prepare_accepted_socket(_listening_socket, accepted_connection);
+                        if (accepted_connection.gle != NO_ERROR) {
+                            accepted_connection.accept_socket.reset();
+                        }
+                    }
+
+                    std::weak_ptr<ctsSocket> weak_socket;
+                    // scoping the lock: hand the connection to the oldest request, or queue it for the next request
+                    {
+                        const ctl::ctAutoReleaseCriticalSection lock(&cs);
+                        if (shutting_down) {
+                            return;
+                        }
+
+                        if (pended_accept_requests.empty()) {
+                            try { accepted_connections.push_back(std::move(accepted_connection)); }
+                            catch (const std::exception&) {
+                                // if fails to be added to our queue, it's OK
+                                // - it will be closed as it goes out of scope and we'll accept another
+                            }
+                            continue;
+                        }
+
+                        weak_socket = pended_accept_requests.front();
+                        pended_accept_requests.pop_front();
+                    }
+
+                    complete_accept(weak_socket, accepted_connection);
+                }
+            }
+
+            bool is_shutting_down() noexcept
+            {
+                const ctl::ctAutoReleaseCriticalSection lock(&cs);
+                return shutting_down;
+            }
+
+            //
+            // Sets the options on the accepted socket that ctsAcceptEx sets before AcceptEx
+            // - returns the Win32 error if any step fails
+            //
+            static DWORD prepare_accepted_socket(SOCKET _listening_socket, ctsAcceptLoopConnection& _accepted_connection) noexcept
+            {
+                const SOCKET accepted_socket = _accepted_connection.accept_socket.get();
+                int local_addr_len = _accepted_connection.local_addr.length();
+                if (0 != ::getsockname(accepted_socket, _accepted_connection.local_addr.sockaddr(), &local_addr_len)) {
+                    local_addr_len = _accepted_connection.local_addr.length();
+                    (void) ::getsockname(_listening_socket, _accepted_connection.local_addr.sockaddr(), &local_addr_len);
+                }
+
+                auto gle = ctsConfig::SetPreBindOptions(accepted_socket, _accepted_connection.local_addr);
+                if (gle != NO_ERROR) {
+                    ctsConfig::PrintErrorIfFailed(L"SetPreBindOptions", gle);
+                    return gle;
+                }
+
+                gle = ctsConfig::SetPreConnectOptions(accepted_socket);
+                if (gle != NO_ERROR) {
+                    ctsConfig::PrintErrorIfFailed(L"SetPreConnectOptions", gle);
+                    return gle;
+                }
+
+                return NO_ERROR;
+            }
+
+            static void complete_accept(const std::weak_ptr<ctsSocket>& _weak_socket, ctsAcceptLoopConnection& _accepted_connection) noexcept
+            {
+                auto shared_socket(_weak_socket.lock());
+                if (!shared_socket) {
+                    // socket was closed from beneath us
+                    ctsConfig::PrintErrorIfFailed(L"accept", WSAECONNABORTED);
+                    return;
+                }
+
+                // the failure was printed when the connection was accepted
+                if (_accepted_connection.gle != NO_ERROR) {
+                    shared_socket->complete_state(_accepted_connection.gle);
+                    return;
+                }
+
+                // transfering ownership to the ctsSocket
+                shared_socket->set_local_address(_accepted_connection.local_addr);
+                shared_socket->set_socket(_accepted_connection.accept_socket.release());
+                shared_socket->set_target_address(_accepted_connection.remote_addr);
+                shared_socket->complete_state(0);
+
+                ctsConfig::PrintNewConnection(_accepted_connection.local_addr, _accepted_connection.remote_addr);
+            }
+        };
+
+        std::shared_ptr<ctsAcceptLoopImpl> s_pimpl;
+        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+        static INIT_ONCE s_ctsAcceptLoopImplInitOnce = INIT_ONCE_STATIC_INIT;
+        static BOOL CALLBACK s_ctsAcceptLoopImplInitFn(PINIT_ONCE, PVOID perror, PVOID*)
+        {
+            try { s_pimpl = std::make_shared<ctsAcceptLoopImpl>(); }
+            catch (const std::exception& e) {
+                ctsConfig::PrintException(e);
+                *static_cast<DWORD*>(perror) = ctl::ctErrorCode(e);
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+    }
+
+    void ctsAcceptLoop(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        DWORD error = 0;
+        if (!::InitOnceExecuteOnce(&details::s_ctsAcceptLoopImplInitOnce, details::s_ctsAcceptLoopImplInitFn, &error, nullptr)) {
+            auto shared_socket(_weak_socket.lock());
+            if (shared_socket) {
+                shared_socket->complete_state(error);
+            }
+
+        } else {
+            try { details::s_pimpl->accept_socket(_weak_socket); }
+            catch (const std::exception&) {
+                auto shared_socket(_weak_socket.lock());
+                if (shared_socket) {
+                    shared_socket->complete_state(ERROR_OUTOFMEMORY);
+                }
+            }
+        }
+    }
+} // namespace
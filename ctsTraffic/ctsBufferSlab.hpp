@@ -0,0 +1,572 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+// os headers
+#include <Windows.h>
+#include <WinSock2.h>
+#include <MSWSock.h>
+// ctl headers
+#include <ctException.hpp>
+// project headers
+#include "ctsLargePages.hpp"
+
+namespace ctsTraffic {
+    ///
+    /// Registers each chunk of a ctsBufferSlab as it's committed, and deregisters it as it's released
+    /// - both are nullptr when the buffers are not registered
+    /// - neither may throw: register_buffer returns RIO_INVALID_BUFFERID on failure
+    ///
+    struct ctsBufferRegistrar {
+        RIO_BUFFERID (*register_buffer)(_In_ char* _buffer, DWORD _length) = nullptr;
+        void (*deregister_buffer)(RIO_BUFFERID _buffer_id) = nullptr;
+    };
+
+    struct ctsBufferSlabStatistics {
+        unsigned long buffer_length = 0;
+        // buffers given out, and how many of those had been given out before
+        unsigned long long allocations = 0;
+        unsigned long long reused_allocations = 0;
+        // buffers that could not be given out: the slab was full or could not grow
+        unsigned long long failed_allocations = 0;
+        unsigned long outstanding_buffers = 0;
+        unsigned long peak_outstanding_buffers = 0;
+        unsigned long committed_buffers = 0;
+        unsigned long peak_committed_buffers = 0;
+    };
+
+    ///
+    /// A slab of fixed-length buffers carved from one reserved address range
+    /// - the range is committed a chunk at a time as buffers are needed, and each chunk is registered on its own:
+    ///   buffers keep their registration however much the slab grows after them
+    /// - each chunk counts the buffers given out from it: once the trailing chunks have none out,
+    ///   all but one of them are deregistered and decommitted
+    /// - chunks are whole pages laid out back to back, so the chunk holding a buffer is found from its address
+    ///
+    /// Buffers are given out from the lowest chunk with one free, most recently freed first, so the trailing chunks drain
+    ///
+    /// With a large page size, chunks are whole large pages
+    /// - large pages can only be reserved and committed together: each chunk is then allocated on its own,
+    ///   falling back to standard pages for that chunk if not enough large pages are free
+    /// - as chunks are no longer back to back, the chunk holding a buffer is found by a binary search of their addresses
+    ///
+    /// Given a NUMA node, the address range (or each chunk) is allocated with that node as its preferred node,
+    /// so every buffer's pages come from that node's memory
+    ///
+    /// This is not thread-safe: callers must serialize access
+    ///
+    class ctsBufferSlab {
+    public:
+        ///
+        /// Reserves address space for _max_buffers buffers of _buffer_length bytes,
+        /// in chunks of at least _buffers_per_chunk buffers rounded up to whole pages
+        /// - nothing is committed until the first buffer is taken
+        /// - chunks are allocated on large pages when given their size (as returned by ctsLargePages::Enable)
+        /// - memory is allocated from _numa_node unless given NUMA_NO_PREFERRED_NODE
+        ///
+        /// - can throw ctl::ctException or std::bad_alloc
+        ///
+        ctsBufferSlab(
+            unsigned long _buffer_length,
+            unsigned long _buffers_per_chunk,
+            unsigned long _max_buffers,
+            ctsBufferRegistrar _registrar,
+            size_t _large_page_size = 0,
+            DWORD _numa_node = NUMA_NO_PREFERRED_NODE) :
+            registrar(_registrar),
+            buffer_length(_buffer_length),
+            max_buffers(_max_buffers),
+            numa_node(_numa_node)
+        {
+            this->stats.buffer_length = _buffer_length;
+
+            ::SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+            const unsigned long long page_size = (_large_page_size > 0) ? _large_page_size : system_info.dwPageSize;
+            const unsigned long long min_chunk_bytes = static_cast<unsigned long long>(_buffer_length) * _buffers_per_chunk;
+            const unsigned long long chunk_bytes = (min_chunk_bytes + page_size - 1) / page_size * page_size;
+            if (0 == _buffer_length || 0 == _buffers_per_chunk || 0 == _max_buffers || chunk_bytes > MAXDWORD) {
+                throw ctl::ctException(ERROR_INVALID_PARAMETER, L"ctsBufferSlab", L"ctsBufferSlab", false);
+            }
+            this->chunk_length = static_cast<DWORD>(chunk_bytes);
+            this->chunk_buffers = static_cast<unsigned long>(chunk_bytes / _buffer_length);
+
+            this->chunks.resize((_max_buffers + this->chunk_buffers - 1) / this->chunk_buffers);
+            if (_large_page_size > 0) {
+                // reserved so inserting never reallocates
+                this->chunk_addresses.reserve(this->chunks.size());
+            } else {
+                // pages committed later in the range are taken from the node it was reserved with
+                this->base = this->allocate_range(chunk_bytes * this->chunks.size(), MEM_RESERVE);
+                if (nullptr == this->base) {
+                    throw ctl::ctException(::GetLastError(), L"VirtualAlloc", L"ctsBufferSlab", false);
+                }
+            }
+        }
+
+        ///
+        /// Any buffers still given out must no longer be in use
+        ///
+        ~ctsBufferSlab() noexcept
+        {
+            while (this->committed_chunks > 0) {
+                this->release_chunk();
+            }
+            if (this->base) {
+                ::VirtualFree(this->base, 0, MEM_RELEASE);
+            }
+        }
+
+        ///
+        /// Returns nullptr when every buffer is given out, or when the next chunk can't be committed or registered
+        ///
+        char* allocate() noexcept
+        {
+            while (this->first_free_chunk < this->committed_chunks && this->chunks[this->first_free_chunk].free_buffers.empty()) {
+                ++this->first_free_chunk;
+            }
+            if (this->first_free_chunk == this->committed_chunks && !this->commit_chunk()) {
+                ++this->stats.failed_allocations;
+                return nullptr;
+            }
+
+            ctsBufferChunk& chunk = this->chunks[this->first_free_chunk];
+            // buffers never given out are beneath those freed back on top of them
+            if (chunk.free_buffers.size() > chunk.fresh_buffers) {
+                ++this->stats.reused_allocations;
+            } else {
+                --chunk.fresh_buffers;
+            }
+            char* buffer = chunk.free_buffers.back();
+            chunk.free_buffers.pop_back();
+            ++chunk.outstanding;
+
+            ++this->stats.allocations;
+            ++this->stats.outstanding_buffers;
+            if (this->stats.outstanding_buffers > this->stats.peak_outstanding_buffers) {
+                this->stats.peak_outstanding_buffers = this->stats.outstanding_buffers;
+            }
+            return buffer;
+        }
+
+        void deallocate(_In_ char* _buffer) noexcept
+        {
+            const unsigned long index = this->chunk_index(_buffer);
+            ctsBufferChunk& chunk = this->chunks[index];
+            // reserved to hold every buffer in the chunk when it was committed: push_back() can't throw
+            chunk.free_buffers.push_back(_buffer);
+            --chunk.outstanding;
+            --this->stats.outstanding_buffers;
+            if (index < this->first_free_chunk) {
+                this->first_free_chunk = index;
+            }
+
+            // keep one idle chunk past the last in use, so connections coming and going at a chunk boundary don't thrash
+            while (this->committed_chunks > 1 &&
+                   0 == this->chunks[this->committed_chunks - 1].outstanding &&
+                   0 == this->chunks[this->committed_chunks - 2].outstanding) {
+                this->release_chunk();
+            }
+        }
+
+        ///
+        /// The base address and registered buffer id of the chunk holding a buffer given out from this slab
+        /// - RIO addresses a buffer by its offset from the base of the registered chunk
+        ///
+        char* chunk_base(_In_ const char* _buffer) const noexcept
+        {
+            return this->chunks[this->chunk_index(_buffer)].address;
+        }
+
+        RIO_BUFFERID chunk_buffer_id(_In_ const char* _buffer) const noexcept
+        {
+            return this->chunks[this->chunk_index(_buffer)].buffer_id;
+        }
+
+        unsigned long committed_chunk_count() const noexcept
+        {
+            return this->committed_chunks;
+        }
+
+        unsigned long buffers_per_chunk() const noexcept
+        {
+            return this->chunk_buffers;
+        }
+
+        const ctsBufferSlabStatistics& statistics() const noexcept
+        {
+            return this->stats;
+        }
+
+        // non-copyable
+        ctsBufferSlab(const ctsBufferSlab&) = delete;
+        ctsBufferSlab& operator=(const ctsBufferSlab&) = delete;
+        ctsBufferSlab(ctsBufferSlab&&) = delete;
+        ctsBufferSlab& operator=(ctsBufferSlab&&) = delete;
+
+    private:
+        struct ctsBufferChunk {
+            char* address = nullptr;
+            bool large_pages = false;
+            RIO_BUFFERID buffer_id = RIO_INVALID_BUFFERID;
+            unsigned long outstanding = 0;
+            unsigned long buffer_count = 0;
+            // the buffers at the bottom of free_buffers that have never been given out
+            unsigned long fresh_buffers = 0;
+            std::vector<char*> free_buffers;
+        };
+
+        const ctsBufferRegistrar registrar;
+        const unsigned long buffer_length;
+        const unsigned long max_buffers;
+        const DWORD numa_node;
+        DWORD chunk_length = 0;
+        unsigned long chunk_buffers = 0;
+
+        // the reserved range the chunks are committed from: null when each chunk is allocated on its own
+        char* base = nullptr;
+        // when each chunk is allocated on its own: the index of each committed chunk, sorted by its address
+        std::vector<unsigned long> chunk_addresses;
+        std::vector<ctsBufferChunk> chunks;
+        // chunks are committed in order: [0, committed_chunks) are committed
+        unsigned long committed_chunks = 0;
+        // no chunk before this one has a free buffer
+        unsigned long first_free_chunk = 0;
+        ctsBufferSlabStatistics stats;
+
+        unsigned long chunk_index(_In_ const char* _buffer) const noexcept
+        {
+            if (this->base) {
+                return static_cast<unsigned long>(static_cast<size_t>(_buffer - this->base) / this->chunk_length);
+            }
+            // the last chunk starting at or before the buffer
+            const auto found = std::upper_bound(
+                this->chunk_addresses.begin(),
+                this->chunk_addresses.end(),
+                _buffer,
+                [this](const char* _address, unsigned long _index) noexcept {
+                    return std::less<const char*>()(_address, this->chunks[_index].address);
+                });
+            return *(found - 1);
+        }
+
+        // allocates a new address range, from numa_node if given one
+        char* allocate_range(size_t _length, DWORD _allocation_type) const noexcept
+        {
+            if (NUMA_NO_PREFERRED_NODE == this->numa_node) {
+                return static_cast<char*>(::VirtualAlloc(nullptr, _length, _allocation_type, PAGE_READWRITE));
+            }
+            return static_cast<char*>(::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, _length, _allocation_type, PAGE_READWRITE, this->numa_node));
+        }
+
+        // returns nullptr if the memory could not be committed
+        char* commit_chunk_memory(_Inout_ ctsBufferChunk& _chunk) noexcept
+        {
+            if (this->base) {
+                char* chunk_address = this->base + static_cast<size_t>(this->committed_chunks) * this->chunk_length;
+                return ::VirtualAlloc(chunk_address, this->chunk_length, MEM_COMMIT, PAGE_READWRITE) ? chunk_address : nullptr;
+            }
+
+            char* chunk_address = ctsLargePages::Allocate(this->chunk_length, this->numa_node);
+            _chunk.large_pages = (chunk_address != nullptr);
+            if (!chunk_address) {
+                chunk_address = this->allocate_range(this->chunk_length, MEM_RESERVE | MEM_COMMIT);
+            }
+            return chunk_address;
+        }
+
+        void release_chunk_memory(_Inout_ ctsBufferChunk& _chunk) noexcept
+        {
+            if (this->base) {
+                ::VirtualFree(_chunk.address, this->chunk_length, MEM_DECOMMIT);
+            } else if (_chunk.large_pages) {
+                ctsLargePages::Free(_chunk.address, this->chunk_length);
+            } else {
+                ::VirtualFree(_chunk.address, 0, MEM_RELEASE);
+            }
+            _chunk.address = nullptr;
+            _chunk.large_pages = false;
+        }
+
+        bool commit_chunk() noexcept
+        {
+            if (this->committed_chunks == this->chunks.size()) {
+                return false;
+            }
+
+            ctsBufferChunk& chunk = this->chunks[this->committed_chunks];
+            char* chunk_address = this->commit_chunk_memory(chunk);
+            if (!chunk_address) {
+                return false;
+            }
+            chunk.address = chunk_address;
+
+            // the last chunk holds only what's left of max_buffers
+            const unsigned long carved_buffers = this->committed_chunks * this->chunk_buffers;
+            const unsigned long buffer_count =
+                (this->max_buffers - carved_buffers < this->chunk_buffers) ? this->max_buffers - carved_buffers : this->chunk_buffers;
+
+            try {
+                chunk.free_buffers.reserve(buffer_count);
+            }
+            catch (const std::exception&) {
+                this->release_chunk_memory(chunk);
+                return false;
+            }
+
+            if (this->registrar.register_buffer) {
+                chunk.buffer_id = this->registrar.register_buffer(chunk_address, this->chunk_length);
+                if (RIO_INVALID_BUFFERID == chunk.buffer_id) {
+                    this->release_chunk_memory(chunk);
+                    return false;
+                }
+            }
+
+            if (!this->base) {
+                // capacity was reserved for every chunk: inserting can't throw
+                const auto insert_at = std::upper_bound(
+                    this->chunk_addresses.begin(),
+                    this->chunk_addresses.end(),
+                    chunk_address,
+                    [this](const char* _address, unsigned long _index) noexcept {
+                        return std::less<const char*>()(_address, this->chunks[_index].address);
+                    });
+                this->chunk_addresses.insert(insert_at, this->committed_chunks);
+            }
+
+            // pushed in reverse so they're given out from the lowest address
+            for (unsigned long index = buffer_count; index > 0; --index) {
+                chunk.free_buffers.push_back(chunk_address + static_cast<size_t>(index - 1) * this->buffer_length);
+            }
+            chunk.buffer_count = buffer_count;
+            chunk.fresh_buffers = buffer_count;
+            ++this->committed_chunks;
+
+            this->stats.committed_buffers += buffer_count;
+            if (this->stats.committed_buffers > this->stats.peak_committed_buffers) {
+                this->stats.peak_committed_buffers = this->stats.committed_buffers;
+            }
+            return true;
+        }
+
+        void release_chunk() noexcept
+        {
+            --this->committed_chunks;
+            ctsBufferChunk& chunk = this->chunks[this->committed_chunks];
+            if (this->registrar.deregister_buffer && chunk.buffer_id != RIO_INVALID_BUFFERID) {
+                this->registrar.deregister_buffer(chunk.buffer_id);
+            }
+            chunk.buffer_id = RIO_INVALID_BUFFERID;
+            chunk.outstanding = 0;
+            this->stats.committed_buffers -= chunk.buffer_count;
+            // keeps its capacity for when the chunk is committed again
+            chunk.free_buffers.clear();
+            if (!this->base) {
+                this->chunk_addresses.erase(std::find(this->chunk_addresses.begin(), this->chunk_addresses.end(), this->committed_chunks));
+            }
+            this->release_chunk_memory(chunk);
+
+            if (this->first_free_chunk > this->committed_chunks) {
+                this->first_free_chunk = this->committed_chunks;
+            }
+        }
+    };
+
+    ///
+    /// A buffer given out by a ctsBufferSlabPool, with the base and registered buffer id of its chunk
+    ///
+    struct ctsBufferSlabAllocation {
+        char* buffer = nullptr;
+        char* chunk_base = nullptr;
+        RIO_BUFFERID buffer_id = RIO_INVALID_BUFFERID;
+    };
+
+    ///
+    /// ctsBufferSlabs shared across connections, one for each size class of buffer
+    /// - a size class is a whole number of pages: lengths are rounded up to the page size
+    /// - each slab reserves room for _max_buffers buffers, or as many as fit in _max_slab_bytes if fewer
+    /// - chunks are about ChunkBytes, so each registration covers several buffers
+    /// - chunks are allocated on large pages when given their size
+    /// - every slab is allocated from the NUMA node given, if any
+    ///
+    /// allocate() returns a null buffer once a class is exhausted: callers fall back to allocating their own
+    ///
+    /// This is thread-safe
+    ///
+    class ctsBufferSlabPool {
+    public:
+        static const unsigned long ChunkBytes = 0x400000;
+
+        ctsBufferSlabPool(
+            unsigned long _max_buffers,
+            unsigned long long _max_slab_bytes,
+            ctsBufferRegistrar _registrar,
+            size_t _large_page_size = 0,
+            DWORD _numa_node = NUMA_NO_PREFERRED_NODE) noexcept :
+            registrar(_registrar),
+            max_buffers(_max_buffers),
+            max_slab_bytes(_max_slab_bytes),
+            large_page_size(_large_page_size),
+            numa_node(_numa_node)
+        {
+            ::SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+            this->page_size = system_info.dwPageSize;
+        }
+
+        ctsBufferSlabAllocation allocate(size_t _length) noexcept
+        {
+            ctsBufferSlabAllocation allocation;
+            const unsigned long class_length = this->class_length_of(_length);
+            if (0 == class_length) {
+                return allocation;
+            }
+
+            ::AcquireSRWLockExclusive(&this->lock);
+            ctsBufferSlabClass* slab_class = this->find_class(class_length);
+            if (!slab_class) {
+                slab_class = this->add_class(class_length);
+            }
+            if (slab_class) {
+                if (slab_class->slab) {
+                    allocation.buffer = slab_class->slab->allocate();
+                    if (allocation.buffer) {
+                        allocation.chunk_base = slab_class->slab->chunk_base(allocation.buffer);
+                        allocation.buffer_id = slab_class->slab->chunk_buffer_id(allocation.buffer);
+                    }
+                } else {
+                    // the slab could not be reserved
+                    ++slab_class->failed_allocations;
+                }
+            }
+            ::ReleaseSRWLockExclusive(&this->lock);
+            return allocation;
+        }
+
+        ///
+        /// _length must be the length the buffer was allocated with
+        ///
+        void deallocate(_In_ char* _buffer, size_t _length) noexcept
+        {
+            ::AcquireSRWLockExclusive(&this->lock);
+            this->find_class(this->class_length_of(_length))->slab->deallocate(_buffer);
+            ::ReleaseSRWLockExclusive(&this->lock);
+        }
+
+        ///
+        /// A snapshot of the statistics of each size class, in the order each was first used
+        ///
+        /// - can throw std::bad_alloc
+        ///
+        std::vector<ctsBufferSlabStatistics> statistics() const
+        {
+            std::vector<ctsBufferSlabStatistics> return_statistics;
+            ::AcquireSRWLockShared(&this->lock);
+            try {
+                for (const auto& slab_class : this->classes) {
+                    ctsBufferSlabStatistics class_statistics;
+                    if (slab_class.slab) {
+                        class_statistics = slab_class.slab->statistics();
+                    }
+                    class_statistics.buffer_length = slab_class.length;
+                    class_statistics.failed_allocations += slab_class.failed_allocations;
+                    return_statistics.push_back(class_statistics);
+                }
+            }
+            catch (...) {
+                ::ReleaseSRWLockShared(&this->lock);
+                throw;
+            }
+            ::ReleaseSRWLockShared(&this->lock);
+            return return_statistics;
+        }
+
+        // non-copyable
+        ctsBufferSlabPool(const ctsBufferSlabPool&) = delete;
+        ctsBufferSlabPool& operator=(const ctsBufferSlabPool&) = delete;
+        ctsBufferSlabPool(ctsBufferSlabPool&&) = delete;
+        ctsBufferSlabPool& operator=(ctsBufferSlabPool&&) = delete;
+
+    private:
+        struct ctsBufferSlabClass {
+            unsigned long length = 0;
+            // null when the slab could not be reserved: every allocation from the class fails
+            std::unique_ptr<ctsBufferSlab> slab;
+            unsigned long long failed_allocations = 0;
+        };
+
+        const ctsBufferRegistrar registrar;
+        const unsigned long max_buffers;
+        const unsigned long long max_slab_bytes;
+        const size_t large_page_size;
+        const DWORD numa_node;
+        unsigned long page_size = 0;
+
+        mutable SRWLOCK lock = SRWLOCK_INIT;
+        // only a few lengths are used in a run: searched in order
+        _Guarded_by_(lock) std::vector<ctsBufferSlabClass> classes;
+
+        // zero when the length is too large for a size class
+        unsigned long class_length_of(size_t _length) const noexcept
+        {
+            const unsigned long long class_length = (static_cast<unsigned long long>(_length) + this->page_size - 1) / this->page_size * this->page_size;
+            if (0 == class_length || class_length > this->max_slab_bytes || class_length > MAXDWORD) {
+                return 0;
+            }
+            return static_cast<unsigned long>(class_length);
+        }
+
+        _Requires_lock_held_(lock)
+        ctsBufferSlabClass* find_class(unsigned long _class_length) noexcept
+        {
+            for (auto& slab_class : this->classes) {
+                if (slab_class.length == _class_length) {
+                    return &slab_class;
+                }
+            }
+            return nullptr;
+        }
+
+        // returns nullptr if the class could not be added
+        _Requires_lock_held_(lock)
+        ctsBufferSlabClass* add_class(unsigned long _class_length) noexcept
+        {
+            try {
+                this->classes.emplace_back();
+            }
+            catch (const std::exception&) {
+                return nullptr;
+            }
+
+            ctsBufferSlabClass& slab_class = this->classes.back();
+            slab_class.length = _class_length;
+            const unsigned long long slab_buffers = this->max_slab_bytes / _class_length;
+            const unsigned long max_class_buffers = (slab_buffers < this->max_buffers) ? static_cast<unsigned long>(slab_buffers) : this->max_buffers;
+            const unsigned long buffers_per_chunk = (_class_length < ChunkBytes) ? ChunkBytes / _class_length : 1;
+            try {
+                slab_class.slab = std::make_unique<ctsBufferSlab>(_class_length, buffers_per_chunk, max_class_buffers, this->registrar, this->large_page_size, this->numa_node);
+            }
+            catch (const std::exception&) {
+                // leaving the class without a slab, so its allocations are counted as failed
+            }
+            return &slab_class;
+        }
+    };
+}
@@ -0,0 +1,201 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <Windows.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace ctsTraffic {
+    namespace ctsCompareMemory {
+        ///
+        /// Each kernel has RtlCompareMemory semantics: it returns the number of leading bytes which match
+        /// - thus returns _length when the buffers are equal, else the offset of the first byte that differs
+        ///
+        /// The vector kernels compare a full vector per instruction, then scan the inequality mask
+        /// for its lowest set bit to find the exact byte that differs
+        ///
+        enum class Kernel {
+            Scalar,
+            Sse2,
+            Avx2,
+            Avx512
+        };
+
+        inline const wchar_t* KernelName(Kernel _kernel) noexcept
+        {
+            switch (_kernel) {
+                case Kernel::Sse2: return L"SSE2";
+                case Kernel::Avx2: return L"AVX2";
+                case Kernel::Avx512: return L"AVX-512";
+                default: return L"Scalar";
+            }
+        }
+
+        inline size_t CompareScalar(_In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            size_t offset = 0;
+            while (offset < _length && _first[offset] == _second[offset]) {
+                ++offset;
+            }
+            return offset;
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+        inline size_t CompareSse2(_In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            size_t offset = 0;
+            for (; offset + sizeof(__m128i) <= _length; offset += sizeof(__m128i)) {
+                const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_first + offset));
+                const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_second + offset));
+                // movemask sets a bit for each byte that's equal: once inverted, the lowest set bit is the first mismatch
+                const unsigned long mismatch_mask = ~static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi8(first, second))) & 0xffffUL;
+                if (mismatch_mask != 0) {
+                    unsigned long first_mismatch;
+                    _BitScanForward(&first_mismatch, mismatch_mask);
+                    return offset + first_mismatch;
+                }
+            }
+            return offset + CompareScalar(_first + offset, _second + offset, _length - offset);
+        }
+
+        inline size_t CompareAvx2(_In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            size_t offset = 0;
+            for (; offset + sizeof(__m256i) <= _length; offset += sizeof(__m256i)) {
+                const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_first + offset));
+                const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_second + offset));
+                const unsigned long mismatch_mask = ~static_cast<unsigned long>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(first, second)));
+                if (mismatch_mask != 0) {
+                    unsigned long first_mismatch;
+                    _BitScanForward(&first_mismatch, mismatch_mask);
+                    return offset + first_mismatch;
+                }
+            }
+            // fewer than 32 bytes remain: finish with a single 16 byte compare then the scalar loop
+            // - clearing the upper halves of the YMM registers first avoids the AVX to SSE transition penalty
+            _mm256_zeroupper();
+            return offset + CompareSse2(_first + offset, _second + offset, _length - offset);
+        }
+#endif
+
+#if defined(_M_X64)
+        inline size_t CompareAvx512(_In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            size_t offset = 0;
+            for (; offset + sizeof(__m512i) <= _length; offset += sizeof(__m512i)) {
+                const __m512i first = _mm512_loadu_si512(_first + offset);
+                const __m512i second = _mm512_loadu_si512(_second + offset);
+                const __mmask64 mismatch_mask = _mm512_cmpneq_epi8_mask(first, second);
+                if (mismatch_mask != 0) {
+                    unsigned long first_mismatch;
+                    _BitScanForward64(&first_mismatch, mismatch_mask);
+                    return offset + first_mismatch;
+                }
+            }
+            // the tail is compared with masked loads: bytes outside the mask are never read, so this can't fault past the buffer
+            const size_t remaining = _length - offset;
+            if (remaining > 0) {
+                const __mmask64 tail_mask = (1ULL << remaining) - 1;
+                const __m512i first = _mm512_maskz_loadu_epi8(tail_mask, _first + offset);
+                const __m512i second = _mm512_maskz_loadu_epi8(tail_mask, _second + offset);
+                const __mmask64 mismatch_mask = _mm512_mask_cmpneq_epi8_mask(tail_mask, first, second);
+                if (mismatch_mask != 0) {
+                    unsigned long first_mismatch;
+                    _BitScanForward64(&first_mismatch, mismatch_mask);
+                    return offset + first_mismatch;
+                }
+            }
+            return _length;
+        }
+#endif
+
+        ///
+        /// Returns the widest kernel both the processor and the OS support
+        /// - AVX state must be enabled by the OS in XCR0 (checked with xgetbv), not only reported by cpuid
+        ///
+        inline Kernel SupportedKernel() noexcept
+        {
+#if defined(_M_IX86) || defined(_M_X64)
+            int cpu_info[4]{};
+            ::__cpuid(cpu_info, 0);
+            const int max_leaf = cpu_info[0];
+
+            ::__cpuid(cpu_info, 1);
+            constexpr int Sse2Bit = 1 << 26;  // EDX
+            constexpr int OsXsaveBit = 1 << 27;  // ECX
+            constexpr int AvxBit = 1 << 28;  // ECX
+            if ((cpu_info[3] & Sse2Bit) == 0) {
+                return Kernel::Scalar;
+            }
+            if ((cpu_info[2] & OsXsaveBit) == 0 || (cpu_info[2] & AvxBit) == 0 || max_leaf < 7) {
+                return Kernel::Sse2;
+            }
+
+            constexpr unsigned long long XmmYmmState = 0x6;  // XCR0 bits 1 and 2
+            const unsigned long long enabled_state = ::_xgetbv(0);
+            if ((enabled_state & XmmYmmState) != XmmYmmState) {
+                return Kernel::Sse2;
+            }
+
+            ::__cpuidex(cpu_info, 7, 0);
+            constexpr int Avx2Bit = 1 << 5;  // EBX
+            if ((cpu_info[1] & Avx2Bit) == 0) {
+                return Kernel::Sse2;
+            }
+#if defined(_M_X64)
+            constexpr int Avx512FBit = 1 << 16;  // EBX
+            constexpr int Avx512BWBit = 1 << 30;  // EBX
+            constexpr unsigned long long ZmmState = 0xe0;  // XCR0 bits 5, 6 and 7: opmask, ZMM0-15 upper halves, ZMM16-31
+            if ((cpu_info[1] & Avx512FBit) != 0 && (cpu_info[1] & Avx512BWBit) != 0 &&
+                (enabled_state & ZmmState) == ZmmState) {
+                return Kernel::Avx512;
+            }
+#endif
+            return Kernel::Avx2;
+#else
+            return Kernel::Scalar;
+#endif
+        }
+
+        ///
+        /// Compares with the given kernel: the caller must have checked it against SupportedKernel()
+        ///
+        inline size_t Compare(Kernel _kernel, _In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            switch (_kernel) {
+#if defined(_M_IX86) || defined(_M_X64)
+                case Kernel::Sse2: return CompareSse2(_first, _second, _length);
+                case Kernel::Avx2: return CompareAvx2(_first, _second, _length);
+#endif
+#if defined(_M_X64)
+                case Kernel::Avx512: return CompareAvx512(_first, _second, _length);
+#endif
+                default: return CompareScalar(_first, _second, _length);
+            }
+        }
+
+        ///
+        /// Compares with the widest supported kernel, selected once per process
+        ///
+        inline size_t Compare(_In_reads_bytes_(_length) const char* _first, _In_reads_bytes_(_length) const char* _second, size_t _length) noexcept
+        {
+            static const Kernel s_kernel = SupportedKernel();
+            return Compare(s_kernel, _first, _second, _length);
+        }
+    }
+}
@@ -0,0 +1,188 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <vector>
+#include <utility>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+#include <ctScopeGuard.hpp>
+
+namespace ctsTraffic {
+    ///
+    /// One shard of a sharded completion queue
+    /// - owns the completion queue, the count of slots reserved in it for outstanding IO,
+    ///   and the prioritized lock that lets a thread growing the queue interrupt the thread dequeuing from it
+    ///
+    /// Slot accounting is lock-free unless the queue must grow
+    /// - reserving and releasing slots are a single interlocked add on used_slots
+    /// - only when the reserved slots exceed the published queue size is the priority lock taken to resize
+    /// - the queue size only ever grows, so a reservation which fits when it's made always continues to fit
+    ///
+    /// The CompletionQueue type is the backend implementing the queue, and must expose:
+    ///   static const unsigned long MaxSize;       // the largest size the queue can be grown to
+    ///   unsigned long size() const noexcept;      // the current size of the queue
+    ///   void resize(unsigned long _new_size);     // grows the queue - throws on failure
+    ///
+    template <typename CompletionQueue>
+    class ctsCompletionQueueShard {
+    private:
+        ctl::ctPrioritizedCriticalSection prioritized_cs;
+        std::unique_ptr<CompletionQueue> queue;
+        // both are only ever accessed with Interlocked* functions
+        // - queue_size is only written under the priority lock, after the queue is resized
+        volatile LONG used_slots = 0;
+        volatile LONG queue_size = 0;
+
+    public:
+        explicit ctsCompletionQueueShard(std::unique_ptr<CompletionQueue>&& _queue) noexcept :
+            queue(std::move(_queue))
+        {
+            static_assert(CompletionQueue::MaxSize <= MAXLONG, "the completion queue size must fit in a LONG");
+            this->queue_size = static_cast<LONG>(this->queue->size());
+        }
+
+        ///
+        /// Reserves slots in the completion queue for new IO
+        /// - the common path is a single interlocked add when the queue has room for the new slots
+        /// - otherwise takes the priority lock to halt the dequeuing thread
+        ///   and grows the queue to 1.5 times the slots then in use
+        ///
+        /// - can throw under low resources or failure to resize
+        ///
+        void make_room(unsigned long _new_slots)
+        {
+            const LONG new_used_slots = ::InterlockedAdd(&this->used_slots, static_cast<LONG>(_new_slots));
+            if (new_used_slots <= ::InterlockedCompareExchange(&this->queue_size, 0, 0)) {
+                return;
+            }
+
+            // release our reservation if the queue can't be grown
+            ctlScopeGuard(releaseSlotsOnFailure, { ::InterlockedAdd(&this->used_slots, -static_cast<LONG>(_new_slots)); });
+
+            const ctl::ctAutoReleasePriorityCriticalSection priority_lock(this->prioritized_cs);
+            // another thread may have already grown the queue, or slots may have since been released
+            // - re-read the slots now in use to grow the queue once for all current reservations
+            const LONG current_used_slots = ::InterlockedCompareExchange(&this->used_slots, 0, 0);
+            const unsigned long current_size = this->queue->size();
+            if (current_size < static_cast<unsigned long>(current_used_slots)) {
+                // fail hard if we are already at the max size and can't grow it for more IO
+                ctl::ctFatalCondition(
+                    ((CompletionQueue::MaxSize == current_size) || (static_cast<unsigned long>(current_used_slots) > CompletionQueue::MaxSize)),
+                    L"ctsCompletionQueueShard: attempting to grow the completion queue beyond its maximum size (%u)",
+                    CompletionQueue::MaxSize);
+
+                static_assert(MAXLONG / 1.5 > CompletionQueue::MaxSize, "the completion queue size can overflow");
+                unsigned long new_size = static_cast<unsigned long>(current_used_slots * 1.5);
+                if (new_size > CompletionQueue::MaxSize) {
+                    new_size = CompletionQueue::MaxSize;
+                }
+                this->queue->resize(new_size);
+                // publish the new size to the lock-free path only after the queue has grown
+                ::InterlockedExchange(&this->queue_size, static_cast<LONG>(new_size));
+            }
+
+            releaseSlotsOnFailure.dismiss();
+        }
+
+        ///
+        /// Releases slots previously reserved with make_room
+        ///
+        void release_room(unsigned long _slots) noexcept
+        {
+            const LONG new_used_slots = ::InterlockedAdd(&this->used_slots, -static_cast<LONG>(_slots));
+            ctl::ctFatalCondition(
+                new_used_slots < 0,
+                L"ctsCompletionQueueShard::release_room(%u): underflow - used slots is now (%d)",
+                _slots, new_used_slots);
+        }
+
+        ///
+        /// Invokes the functor with the completion queue while holding the default lock
+        /// - the priority lock taken by make_room can interrupt dequeuing to add space to the queue
+        /// - returns what the functor returns
+        ///
+        template <typename DequeueFunctor>
+        auto dequeue(DequeueFunctor&& _functor) noexcept
+        {
+            const ctl::ctAutoReleaseDefaultCriticalSection default_lock(this->prioritized_cs);
+            return _functor(*this->queue);
+        }
+
+        unsigned long used_slot_count() noexcept
+        {
+            return static_cast<unsigned long>(::InterlockedCompareExchange(&this->used_slots, 0, 0));
+        }
+
+        CompletionQueue& completion_queue() const noexcept
+        {
+            return *this->queue;
+        }
+
+        // non-copyable
+        ctsCompletionQueueShard(const ctsCompletionQueueShard&) = delete;
+        ctsCompletionQueueShard& operator=(const ctsCompletionQueueShard&) = delete;
+        ctsCompletionQueueShard(ctsCompletionQueueShard&&) = delete;
+        ctsCompletionQueueShard& operator=(ctsCompletionQueueShard&&) = delete;
+    };
+
+    ///
+    /// A set of completion queue shards, typically one per processor
+    /// - each shard is independently locked and grown, so IO on sockets bound to different shards never contends
+    /// - shards are only added during initialization, before any IO is started on them
+    ///
+    template <typename CompletionQueue>
+    class ctsCompletionQueueShards {
+    private:
+        std::vector<std::unique_ptr<ctsCompletionQueueShard<CompletionQueue>>> shards;
+
+    public:
+        ctsCompletionQueueShards() = default;
+
+        // can throw std::bad_alloc
+        void add(std::unique_ptr<CompletionQueue>&& _queue)
+        {
+            this->shards.push_back(std::make_unique<ctsCompletionQueueShard<CompletionQueue>>(std::move(_queue)));
+        }
+
+        size_t count() const noexcept
+        {
+            return this->shards.size();
+        }
+
+        ctsCompletionQueueShard<CompletionQueue>& operator[](size_t _index) const noexcept
+        {
+            return *this->shards[_index];
+        }
+
+        ///
+        /// Returns the shard to bind to IO initiated from the specified processor
+        ///
+        ctsCompletionQueueShard<CompletionQueue>& shard_for(size_t _processor_index) const noexcept
+        {
+            return *this->shards[_processor_index % this->shards.size()];
+        }
+
+        // non-copyable
+        ctsCompletionQueueShards(const ctsCompletionQueueShards&) = delete;
+        ctsCompletionQueueShards& operator=(const ctsCompletionQueueShards&) = delete;
+        ctsCompletionQueueShards(ctsCompletionQueueShards&&) = delete;
+        ctsCompletionQueueShards& operator=(ctsCompletionQueueShards&&) = delete;
+    };
+}
@@ -37,6 +37,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsConfig.h"
 #include "ctsLogger.hpp"
 #include "ctsIOPattern.h"
+#include "ctsLargePages.hpp"
 #include "ctsPrintStatus.hpp"
 
 // project functors
@@ -86,11 +87,18 @@ namespace ctsTraffic
         static PTP_POOL s_ThreadPool = nullptr;
         static TP_CALLBACK_ENVIRON s_ThreadPoolEnvironment;
         static unsigned long s_ThreadPoolThreadCount = 0;
+        // one threadpool per NUMA node, its threads pinned to that node's processors
+        // - only created with -NumaBind on machines with more than one node
+        static TP_CALLBACK_ENVIRON* s_NodeThreadPoolEnvironments = nullptr;
+        // the NUMA node of each processor, indexed by (group * MAXIMUM_PROC_PER_GROUP) + processor number
+        // - only populated on machines with more than one node
+        static vector<USHORT> s_ProcessorNumaNodes;
 
         static const wchar_t* s_CreateFunctionName = nullptr;
         static const wchar_t* s_ConnectFunctionName = nullptr;
         static const wchar_t* s_AcceptFunctionName = nullptr;
         static const wchar_t* s_IoFunctionName = nullptr;
+        static const wchar_t* s_TransmitFileName = nullptr;
 
         // connection info + error info
         static unsigned long s_ConsoleVerbosity = 4;
@@ -475,6 +483,7 @@ namespace ctsTraffic
         /// -acc:accept
         /// -acc:wsaaccept
         /// -acc:acceptex  (*default)
+        /// -acc:acceptloop
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -504,6 +513,11 @@ namespace ctsTraffic
                     Settings->AcceptFunction = ctsAcceptEx;
                     s_AcceptFunctionName = L"AcceptEx";
                 }
+                else if (ctString::iordinal_equals(L"AcceptLoop", value))
+                {
+                    Settings->AcceptFunction = ctsAcceptLoop;
+                    s_AcceptFunctionName = L"AcceptLoop (a persistent accept loop per listener)";
+                }
                 else
                 {
                     throw invalid_argument("-acc");
@@ -539,6 +553,8 @@ namespace ctsTraffic
         /// -io:iocp (*default)
         /// -io:wsapoll
         /// -io:rioiocp
+        /// -io:riopoll
+        /// -io:coroutine
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -573,6 +589,18 @@ namespace ctsTraffic
                     Settings->SocketFlags |= WSA_FLAG_REGISTERED_IO;
                     s_IoFunctionName = L"RioIocp (RIO using IOCP notifications)";
                 }
+                else if (ctString::iordinal_equals(L"riopoll", value))
+                {
+                    Settings->IoFunction = ctsRioPoll;
+                    Settings->SocketFlags |= WSA_FLAG_REGISTERED_IO;
+                    s_IoFunctionName = L"RioPoll (RIO using polled completion queues)";
+                }
+                else if (ctString::iordinal_equals(L"coroutine", value))
+                {
+                    Settings->IoFunction = ctsSendRecvCoroutine;
+                    Settings->Options |= HANDLE_INLINE_IOCP;
+                    s_IoFunctionName = L"Coroutine (WSASend/WSARecv using IOCP, driven by a coroutine per connection)";
+                }
                 else
                 {
                     throw invalid_argument("-io");
@@ -612,6 +640,82 @@ namespace ctsTraffic
                 }
             }
         }
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for a file to stream over every TCP connection instead of the buffer pattern
+        ///
+        /// -TransmitFile:<path>
+        ///
+        /// Senders pass the file to TransmitFile so the data is sent directly from the file cache
+        /// - sends continue from the start of the file once the end is reached
+        /// Receivers verify the data against a read-only view of the same file
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+            void set_transmitFile(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-TransmitFile");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                if (Settings->Protocol != ProtocolType::TCP)
+                {
+                    throw invalid_argument("-TransmitFile (only applicable to TCP)");
+                }
+                if (Settings->SocketFlags & WSA_FLAG_REGISTERED_IO)
+                {
+                    throw invalid_argument("-TransmitFile (cannot be used with registered i/o: -IO:rioiocp or -IO:riopoll)");
+                }
+
+                const auto value = ParseArgument(*found_arg, L"-TransmitFile");
+                // opened overlapped so concurrent TransmitFile calls each send from the offset in their OVERLAPPED
+                Settings->TransmitFileHandle = CreateFileW(
+                    value,
+                    GENERIC_READ,
+                    FILE_SHARE_READ,
+                    nullptr,
+                    OPEN_EXISTING,
+                    FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                    nullptr);
+                if (INVALID_HANDLE_VALUE == Settings->TransmitFileHandle)
+                {
+                    throw ctException(GetLastError(), L"CreateFileW", L"ctsConfig", false);
+                }
+
+                LARGE_INTEGER file_size;
+                if (!GetFileSizeEx(Settings->TransmitFileHandle, &file_size))
+                {
+                    throw ctException(GetLastError(), L"GetFileSizeEx", L"ctsConfig", false);
+                }
+                // offsets into the file are tracked in the 32-bit ctsIOTask::buffer_offset
+                if (0 == file_size.QuadPart || file_size.QuadPart > MAXDWORD)
+                {
+                    throw invalid_argument("-TransmitFile (the file must be at least 1 byte and less than 4GB)");
+                }
+                Settings->TransmitFileSize = static_cast<unsigned long>(file_size.QuadPart);
+
+                // the view keeps the mapping referenced: the mapping handle isn't needed once mapped
+                const HANDLE file_mapping = CreateFileMappingW(Settings->TransmitFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (nullptr == file_mapping)
+                {
+                    throw ctException(GetLastError(), L"CreateFileMappingW", L"ctsConfig", false);
+                }
+                Settings->TransmitFileView = static_cast<const char*>(MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0));
+                const auto gle = GetLastError();
+                CloseHandle(file_mapping);
+                if (nullptr == Settings->TransmitFileView)
+                {
+                    throw ctException(gle, L"MapViewOfFile", L"ctsConfig", false);
+                }
+
+                s_TransmitFileName = value;
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the InlineCompletions setting to use
@@ -725,7 +829,7 @@ namespace ctsTraffic
         ///
         /// Parses for socket Options
         /// - allows for more than one option to be set
-        /// -Options:<keepalive,tcpfastpath [-Options:<...>] [-Options:<...>]
+        /// -Options:<keepalive,tcpfastpath,zerocopy,batchsend,udpoffload> [-Options:<...>] [-Options:<...>]
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -764,6 +868,39 @@ namespace ctsTraffic
                             throw invalid_argument("-Options (tcpfastpath only allowed with TCP sockets)");
                         }
                     }
+                    else if (ctString::iordinal_equals(L"zerocopy", value))
+                    {
+                        if (ProtocolType::TCP == Settings->Protocol)
+                        {
+                            Settings->Options |= ZERO_COPY_SEND;
+                        }
+                        else
+                        {
+                            throw invalid_argument("-Options (zerocopy only allowed with TCP sockets)");
+                        }
+                    }
+                    else if (ctString::iordinal_equals(L"batchsend", value))
+                    {
+                        if (ProtocolType::UDP == Settings->Protocol)
+                        {
+                            Settings->Options |= BATCH_DATAGRAM_SEND;
+                        }
+                        else
+                        {
+                            throw invalid_argument("-Options (batchsend only allowed with UDP sockets)");
+                        }
+                    }
+                    else if (ctString::iordinal_equals(L"udpoffload", value))
+                    {
+                        if (ProtocolType::UDP == Settings->Protocol)
+                        {
+                            Settings->Options |= UDP_SEGMENTATION_OFFLOAD;
+                        }
+                        else
+                        {
+                            throw invalid_argument("-Options (udpoffload only allowed with UDP sockets)");
+                        }
+                    }
                     else
                     {
                         throw invalid_argument("-Options");
@@ -778,6 +915,11 @@ namespace ctsTraffic
                     break;
                 }
             }
+
+            if ((Settings->Options & BATCH_DATAGRAM_SEND) && (Settings->Options & UDP_SEGMENTATION_OFFLOAD))
+            {
+                throw invalid_argument("-Options (batchsend and udpoffload cannot be used together)");
+            }
         }
 
         //////////////////////////////////////////////////////////////////////////////////////////
@@ -1368,6 +1510,72 @@ namespace ctsTraffic
             }
         }
 
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the rate at which clients create new connections
+        ///
+        /// -ConnectionRate:####
+        ///                :[low,high]
+        /// -ConnectionRateRamp:####
+        ///
+        /// A range ramps the rate from low to high over -ConnectionRateRamp seconds
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static void set_connectionRate(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-ConnectionRate");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                if (IsListening())
+                {
+                    throw invalid_argument("-ConnectionRate is only supported when running as a client");
+                }
+
+                const auto value = ParseArgument(*found_arg, L"-ConnectionRate");
+                if (value[0] == L'[')
+                {
+                    get_range(value, Settings->ConnectionRateLow, Settings->ConnectionRateHigh);
+                }
+                else
+                {
+                    Settings->ConnectionRateLow = as_integral<unsigned long>(value);
+                    Settings->ConnectionRateHigh = Settings->ConnectionRateLow;
+                }
+                if (0 == Settings->ConnectionRateLow)
+                {
+                    throw invalid_argument("-ConnectionRate");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+
+            const auto found_ramp = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-ConnectionRateRamp");
+                return (value != nullptr);
+            });
+            if (found_ramp != end(args))
+            {
+                if (Settings->ConnectionRateLow == Settings->ConnectionRateHigh)
+                {
+                    throw invalid_argument("-ConnectionRateRamp requires a range of rates with -ConnectionRate:[low,high]");
+                }
+                Settings->ConnectionRateRampSeconds = as_integral<unsigned long>(ParseArgument(*found_ramp, L"-ConnectionRateRamp"));
+                if (0 == Settings->ConnectionRateRampSeconds)
+                {
+                    throw invalid_argument("-ConnectionRateRamp");
+                }
+                // always remove the arg from our vector
+                args.erase(found_ramp);
+            }
+            else if (Settings->ConnectionRateLow != Settings->ConnectionRateHigh)
+            {
+                throw invalid_argument("-ConnectionRate:[low,high] requires -ConnectionRateRamp");
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the buffer size to push down per IO
@@ -1529,6 +1737,7 @@ namespace ctsTraffic
         /// -RateLimit:####
         ///           :[low,high]
         /// -RateLimitPeriod:####
+        /// -RateLimitBurst:####
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -1566,7 +1775,8 @@ namespace ctsTraffic
                 const auto value = ParseArgument(parameter, L"-RateLimitPeriod");
                 return (value != nullptr);
             });
-            if (found_ratelimit_period != end(args))
+            const bool ratelimit_period_set = (found_ratelimit_period != end(args));
+            if (ratelimit_period_set)
             {
                 if (Settings->Protocol != ProtocolType::TCP)
                 {
@@ -1580,6 +1790,30 @@ namespace ctsTraffic
                 // always remove the arg from our vector
                 args.erase(found_ratelimit_period);
             }
+
+            const auto found_ratelimit_burst = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-RateLimitBurst");
+                return (value != nullptr);
+            });
+            if (found_ratelimit_burst != end(args))
+            {
+                if (Settings->Protocol != ProtocolType::TCP)
+                {
+                    throw invalid_argument("-RateLimitBurst (only applicable to TCP)");
+                }
+                if (0LL == s_RateLimitLow)
+                {
+                    throw invalid_argument("-RateLimitBurst requires specifying -RateLimit");
+                }
+                if (ratelimit_period_set)
+                {
+                    throw invalid_argument("-RateLimitBurst cannot be used with -RateLimitPeriod");
+                }
+                Settings->TcpBytesPerSecondBurst = as_integral<long long>(ParseArgument(*found_ratelimit_burst, L"-RateLimitBurst"));
+                Settings->TcpBytesPerSecondTokenBucket = true;
+                // always remove the arg from our vector
+                args.erase(found_ratelimit_burst);
+            }
         }
 
         //////////////////////////////////////////////////////////////////////////////////////////
@@ -1851,6 +2085,58 @@ namespace ctsTraffic
             }
         }
 
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets optional recv segments value
+        ///
+        /// -RecvSegments:#
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+            void set_recvSegments(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-RecvSegments");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                Settings->RecvBufferSegments = as_integral<unsigned long>(ParseArgument(*found_arg, L"-RecvSegments"));
+                if (0 == Settings->RecvBufferSegments || Settings->RecvBufferSegments > ctsIOTask::MaxBufferSegments)
+                {
+                    throw invalid_argument("-RecvSegments");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets optional run-to-completion budget
+        ///
+        /// -RunToCompletion:#####
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+            void set_runToCompletion(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-RunToCompletion");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                Settings->RunToCompletionBudget = as_integral<unsigned long>(ParseArgument(*found_arg, L"-RunToCompletion"));
+                if (0 == Settings->RunToCompletionBudget)
+                {
+                    throw invalid_argument("-RunToCompletion");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Sets optional prepostsends value
@@ -1874,7 +2160,8 @@ namespace ctsTraffic
             else
             {
                 Settings->PrePostSends = 1;
-                if (Settings->SocketFlags & WSA_FLAG_REGISTERED_IO)
+                // without stack send buffering, enough sends must be in flight to fill the pipe
+                if ((Settings->SocketFlags & WSA_FLAG_REGISTERED_IO) || (Settings->Options & ZERO_COPY_SEND))
                 {
                     // 0 PrePostSends == rely on ISB
                     Settings->PrePostSends = 0;
@@ -1968,6 +2255,66 @@ namespace ctsTraffic
             }
         }
 
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Pins every thread of a NUMA node's threadpool to the node's processors
+        ///
+        /// The threadpool's minimum and maximum must both be _thread_count,
+        /// so it never creates or retires a thread after they're pinned
+        /// - a work callback runs on each thread: each pins its own thread then waits at a barrier
+        ///   until every one has run, so no thread can run two of them
+        /// - the barrier is sized to _thread_count, so this relies on the threadpool running that many
+        ///   callbacks at once: its minimum guarantees those threads exist, and its maximum that no
+        ///   other threads do - with fewer threads running, the callbacks would wait on the barrier forever
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        struct NodeThreadAffinity
+        {
+            SYNCHRONIZATION_BARRIER all_threads_pinned{};
+            GROUP_AFFINITY affinity{};
+            volatile LONG error = NO_ERROR;
+        };
+
+        static VOID CALLBACK PinNodeThreadCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept
+        {
+            auto* node_affinity = static_cast<NodeThreadAffinity*>(_context);
+            if (!SetThreadGroupAffinity(GetCurrentThread(), &node_affinity->affinity, nullptr))
+            {
+                InterlockedCompareExchange(&node_affinity->error, static_cast<LONG>(GetLastError()), NO_ERROR);
+            }
+            EnterSynchronizationBarrier(&node_affinity->all_threads_pinned, 0);
+        }
+
+        static void pin_node_threadpool(PTP_CALLBACK_ENVIRON _tp_environment, const GROUP_AFFINITY& _affinity, unsigned long _thread_count)
+        {
+            NodeThreadAffinity node_affinity;
+            node_affinity.affinity = _affinity;
+            if (!InitializeSynchronizationBarrier(&node_affinity.all_threads_pinned, static_cast<LONG>(_thread_count), -1))
+            {
+                throw ctException(GetLastError(), L"InitializeSynchronizationBarrier", L"ctsConfig", false);
+            }
+
+            const PTP_WORK pin_work = CreateThreadpoolWork(PinNodeThreadCallback, &node_affinity, _tp_environment);
+            if (!pin_work)
+            {
+                const auto gle = GetLastError();
+                DeleteSynchronizationBarrier(&node_affinity.all_threads_pinned);
+                throw ctException(gle, L"CreateThreadpoolWork", L"ctsConfig", false);
+            }
+            for (unsigned long thread = 0; thread < _thread_count; ++thread)
+            {
+                SubmitThreadpoolWork(pin_work);
+            }
+            WaitForThreadpoolWorkCallbacks(pin_work, FALSE);
+            CloseThreadpoolWork(pin_work);
+            DeleteSynchronizationBarrier(&node_affinity.all_threads_pinned);
+
+            if (node_affinity.error != NO_ERROR)
+            {
+                throw ctException(node_affinity.error, L"SetThreadGroupAffinity", L"ctsConfig", false);
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Sets a threadpool environment for TP APIs to consume
@@ -1994,6 +2341,274 @@ namespace ctsTraffic
             SetThreadpoolCallbackPool(&s_ThreadPoolEnvironment, s_ThreadPool);
 
             Settings->PTPEnvironment = &s_ThreadPoolEnvironment;
+
+            // nodes without their own threadpool use the above threadpool
+            // - which is every node unless -NumaBind is set on a machine with more than one node
+            ULONG highest_node_number = 0;
+            if (!GetNumaHighestNodeNumber(&highest_node_number))
+            {
+                highest_node_number = 0;
+            }
+            Settings->PTPNodeEnvironments.assign(highest_node_number + 1, Settings->PTPEnvironment);
+            if (0 == highest_node_number)
+            {
+                return;
+            }
+
+            // map every processor to its node up front, so finding the node of the current processor is a table lookup
+            const WORD group_count = GetActiveProcessorGroupCount();
+            s_ProcessorNumaNodes.assign(static_cast<size_t>(group_count) * MAXIMUM_PROC_PER_GROUP, 0);
+            for (WORD group = 0; group < group_count; ++group)
+            {
+                const DWORD group_processor_count = GetActiveProcessorCount(group);
+                for (DWORD number = 0; number < group_processor_count; ++number)
+                {
+                    PROCESSOR_NUMBER processor{};
+                    processor.Group = group;
+                    processor.Number = static_cast<BYTE>(number);
+                    USHORT node = 0;
+                    if (GetNumaProcessorNodeEx(&processor, &node) && node <= highest_node_number)
+                    {
+                        s_ProcessorNumaNodes[group * MAXIMUM_PROC_PER_GROUP + number] = node;
+                    }
+                }
+            }
+
+            // with -NumaBind, create a threadpool for each node sized to the processors on that node
+            // - with a fixed number of threads, each pinned to the node's processors
+            // - without it, connections have no reason to stay on one node, so the pinned threads would only sit idle
+            if (!Settings->NumaBind)
+            {
+                return;
+            }
+            s_NodeThreadPoolEnvironments = new TP_CALLBACK_ENVIRON[highest_node_number + 1];
+            for (ULONG node = 0; node <= highest_node_number; ++node)
+            {
+                GROUP_AFFINITY node_affinity{};
+                if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &node_affinity))
+                {
+                    continue;
+                }
+                unsigned long node_processor_count = 0;
+                for (KAFFINITY processor_mask = node_affinity.Mask; processor_mask != 0; processor_mask &= processor_mask - 1)
+                {
+                    ++node_processor_count;
+                }
+                if (0 == node_processor_count)
+                {
+                    continue;
+                }
+
+                const PTP_POOL node_threadpool = CreateThreadpool(nullptr);
+                if (!node_threadpool)
+                {
+                    throw ctException(GetLastError(), L"CreateThreadPool", L"ctsConfig", false);
+                }
+                const unsigned long node_thread_count = node_processor_count * s_DefaultThreadpoolFactor;
+                SetThreadpoolThreadMaximum(node_threadpool, node_thread_count);
+                if (!SetThreadpoolThreadMinimum(node_threadpool, node_thread_count))
+                {
+                    throw ctException(GetLastError(), L"SetThreadpoolThreadMinimum", L"ctsConfig", false);
+                }
+
+                InitializeThreadpoolEnvironment(&s_NodeThreadPoolEnvironments[node]);
+                SetThreadpoolCallbackPool(&s_NodeThreadPoolEnvironments[node], node_threadpool);
+                pin_node_threadpool(&s_NodeThreadPoolEnvironments[node], node_affinity, node_thread_count);
+                Settings->PTPNodeEnvironments[node] = &s_NodeThreadPoolEnvironments[node];
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets the number of shards the ctsSocketBroker splits connections across
+        ///
+        /// -BrokerShards:#####
+        ///
+        /// Defaults to one shard per processor
+        /// - the broker reduces this so every shard can keep at least one connection pended
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static void set_brokerShards(vector<const wchar_t*>& args)
+        {
+            SYSTEM_INFO system_info;
+            GetSystemInfo(&system_info);
+            Settings->BrokerShards = system_info.dwNumberOfProcessors;
+
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-BrokerShards");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                Settings->BrokerShards = as_integral<unsigned long>(ParseArgument(*found_arg, L"-BrokerShards"));
+                if (0 == Settings->BrokerShards)
+                {
+                    throw invalid_argument("-BrokerShards");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the processors to pin completion workers to
+        ///
+        /// -CpuSet:#,#-#
+        ///
+        /// Processors are numbered across all processor groups, in group order
+        /// - the RIO completion workers are each pinned to a processor in the set
+        /// - on machines with a single processor group the process affinity is also set
+        ///   which keeps every threadpool thread on the set
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static void set_cpuSet(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-CpuSet");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                const WORD group_count = GetActiveProcessorGroupCount();
+                const DWORD processor_count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+                Settings->CpuSetMasks.assign(group_count, 0);
+
+                // each comma-delimited token is either one processor or a range of processors: low-high
+                const wstring value(ParseArgument(*found_arg, L"-CpuSet"));
+                size_t token_start = 0;
+                while (token_start <= value.length())
+                {
+                    size_t token_end = value.find(L',', token_start);
+                    if (wstring::npos == token_end)
+                    {
+                        token_end = value.length();
+                    }
+                    const wstring token(value.substr(token_start, token_end - token_start));
+                    const auto range_delimiter = token.find(L'-');
+
+                    unsigned long low_processor;
+                    unsigned long high_processor;
+                    if (wstring::npos == range_delimiter)
+                    {
+                        low_processor = as_integral<unsigned long>(token);
+                        high_processor = low_processor;
+                    }
+                    else
+                    {
+                        low_processor = as_integral<unsigned long>(token.substr(0, range_delimiter));
+                        high_processor = as_integral<unsigned long>(token.substr(range_delimiter + 1));
+                    }
+                    if (high_processor < low_processor || high_processor >= processor_count)
+                    {
+                        throw invalid_argument("-CpuSet");
+                    }
+
+                    for (unsigned long processor = low_processor; processor <= high_processor; ++processor)
+                    {
+                        // convert the processor index to its group and number within that group
+                        DWORD group_processor = processor;
+                        for (WORD group = 0; group < group_count; ++group)
+                        {
+                            const DWORD group_processor_count = GetActiveProcessorCount(group);
+                            if (group_processor < group_processor_count)
+                            {
+                                Settings->CpuSetMasks[group] |= static_cast<KAFFINITY>(1) << group_processor;
+                                break;
+                            }
+                            group_processor -= group_processor_count;
+                        }
+                    }
+
+                    token_start = token_end + 1;
+                }
+
+                // threadpool threads can only be constrained through the process affinity
+                // - which can't span processor groups
+                if (1 == group_count)
+                {
+                    if (!SetProcessAffinityMask(GetCurrentProcess(), Settings->CpuSetMasks[0]))
+                    {
+                        throw ctException(GetLastError(), L"SetProcessAffinityMask", L"ctsConfig", false);
+                    }
+                }
+
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for whether connections are bound to the NUMA node they are created on
+        ///
+        /// -NumaBind:<on,off>
+        ///
+        /// When on, each connection's IO completes on the threadpool of that node
+        /// and its recv buffers are allocated from that node's memory
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static void set_numaBind(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-NumaBind");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                const auto value = ParseArgument(*found_arg, L"-NumaBind");
+                if (ctString::iordinal_equals(L"on", value))
+                {
+                    Settings->NumaBind = true;
+                }
+                else if (ctString::iordinal_equals(L"off", value))
+                {
+                    Settings->NumaBind = false;
+                }
+                else
+                {
+                    throw invalid_argument("-NumaBind");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for whether to allocate the shared buffers and buffer slabs on large pages
+        ///
+        /// -LargePages:<on,off>
+        ///
+        /// Large pages need the 'Lock pages in memory' privilege
+        /// - when unavailable, buffers are allocated on standard pages
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static void set_largePages(vector<const wchar_t*>& args)
+        {
+            const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+                const auto value = ParseArgument(parameter, L"-LargePages");
+                return (value != nullptr);
+            });
+            if (found_arg != end(args))
+            {
+                const auto value = ParseArgument(*found_arg, L"-LargePages");
+                if (ctString::iordinal_equals(L"on", value))
+                {
+                    Settings->LargePages = true;
+                    Settings->LargePageSize = ctsLargePages::Enable();
+                }
+                else if (ctString::iordinal_equals(L"off", value))
+                {
+                    Settings->LargePages = false;
+                }
+                else
+                {
+                    throw invalid_argument("-LargePages");
+                }
+                // always remove the arg from our vector
+                args.erase(found_arg);
+            }
         }
 
         //////////////////////////////////////////////////////////////////////////////////////////
@@ -2240,6 +2855,12 @@ namespace ctsTraffic
                         L"\t- <default> == 1073741824  (each connection will transfer a sum total of 1GB)\n"
                         L"\t- supports range : [low,high]  (each connection will randomly choose a total transfer size send across)\n"
                         L"\t  note : specifying a range *will* create failures (used to test TCP failures paths)\n"
+                        L"-TransmitFile:<filename with/without path>\n"
+                        L"   - sends the contents of the file with TransmitFile instead of sending the buffer pattern\n"
+                        L"\t- <default> == (not set - the buffer pattern is sent)\n"
+                        L"\t  note : sends start again from the beginning of the file once the end of the file is sent\n"
+                        L"\t       : the receiver must specify the same file to verify the data received (-Verify:data)\n"
+                        L"\t       : cannot be used with -IO:rioiocp or -IO:riopoll\n"
                         L"-Shutdown:<graceful,rude>\n"
                         L"   - controls how clients terminate the TCP connection - note this is a client-only option\n"
                         L"\t- <default> == graceful\n"
@@ -2359,13 +2980,23 @@ namespace ctsTraffic
                         L"                                                                      \n"
                         L"  * these options target specific scenario requirements               \n"
                         L"----------------------------------------------------------------------\n"
-                        L"-Acc:<accept,AcceptEx>\n"
+                        L"-Acc:<accept,AcceptEx,AcceptLoop>\n"
                         L"   - specifies the Winsock API to process accepting inbound connections\n"
                         L"    the default is appropriate unless deliberately needing to test other APIs\n"
                         L"\t- <default> == AcceptEx\n"
                         L"\t- AcceptEx : uses OVERLAPPED AcceptEx with IO Completion ports\n"
                         L"\t- accept : uses blocking calls to accept\n"
                         L"\t         : be careful using this as it will not scale out well as each call blocks a thread\n"
+                        L"\t- AcceptLoop : one thread per listening socket calls accept back-to-back for the entire run\n"
+                        L"\t             : each accepted connection is handed directly to a waiting connection request\n"
+                        L"-BrokerShards:####\n"
+                        L"   - the number of independent shards connections are split across as they are created and closed\n"
+                        L"\t     each shard keeps its own share of -Connections (or -AcceptLimit) and -ThrottleConnections\n"
+                        L"\t     so connection setup does not contend on one lock\n"
+                        L"\t     with -NumaBind, each shard runs on the threadpool of one NUMA node,\n"
+                        L"\t     whose threads only run on that node's processors\n"
+                        L"\t- <default> == the number of processors\n"
+                        L"\t  note : reduced as needed so every shard has at least one connection to pend\n"
                         L"-Bind:<IP-address or *>\n"
                         L"   - a client-side option used to control what IP address is used for outgoing connections\n"
                         L"\t- <default> == *  (will implicitly bind to the correct IP to connect to the target IP)\n"
@@ -2386,6 +3017,23 @@ namespace ctsTraffic
                         L"\t- ConnectEx : uses OVERLAPPED ConnectEx with IO Completion ports\n"
                         L"\t- connect : uses blocking calls to connect\n"
                         L"\t          : be careful using this as it will not scale out well as each call blocks a thread\n"
+                        L"-ConnectionRate:####\n"
+                        L"   - a client-side option to pace new connections at the given number of connections per second\n"
+                        L"\t- <default> == not set (new connections are created as quickly as the other limits allow)\n"
+                        L"\t- supports range : [low,high] the rate ramps linearly from low to high over -ConnectionRateRamp seconds\n"
+                        L"\t  note : -Connections and -ThrottleConnections still limit the connections open and connecting\n"
+                        L"\t         so they must be large enough to sustain the rate for the connection lifetime\n"
+                        L"\t  note : the summary reports the achieved rate, connect latency percentiles,\n"
+                        L"\t         and the rate at which connections first failed to connect\n"
+                        L"-ConnectionRateRamp:####\n"
+                        L"   - the number of seconds over which to ramp from the low to the high -ConnectionRate\n"
+                        L"\t  note : required when -ConnectionRate specifies a range\n"
+                        L"-CpuSet:#,#-#\n"
+                        L"   - the processors to pin completion workers to: a comma-delimited list of processors or ranges of processors\n"
+                        L"     processors are numbered across all processor groups, in group order\n"
+                        L"\t- <default> == not set (completion workers can run on any processor)\n"
+                        L"\t  note : each -IO:rioiocp and -IO:riopoll worker is pinned to its own processor when it is in the set\n"
+                        L"\t  note : threadpool threads are also kept on the set only on machines with one processor group\n"
                         L"-IfIndex:####\n"
                         L"   - the interface index which to use for outbound connectivity\n"
                         L"     assigns the interface with IP_UNICAST_IF / IPV6_UNICAST_IF\n"
@@ -2394,11 +3042,21 @@ namespace ctsTraffic
                         L"   - will set the below option on all SOCKETs for OVERLAPPED I/O calls so inline successful\n"
                         L"     completions will not be queued to the completion handler\n"
                         L"     ::SetFileCompletionNotificationModes(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)\n"
-                        L"\t- <default> == on for TCP 'iocp' -IO option, and is on for UDP client receivers\n"
+                        L"\t- <default> == on for TCP 'iocp' and 'coroutine' -IO options, and is on for UDP client receivers\n"
                         L"                 off for all other -IO options\n"
-                        L"-IO:<readwritefile>\n"
-                        L"   - an additional IO option beyond iocp and rioiocp\n"
+                        L"-IO:<coroutine,readwritefile,riopoll>\n"
+                        L"   - additional IO options beyond iocp and rioiocp\n"
+                        L"\t- coroutine : the same WSARecv/WSASend IO as iocp, with each connection's IO driven by one coroutine\n"
+                        L"\t              rather than by a chain of completion callbacks\n"
                         L"\t- readwritefile : leverages ReadFile/WriteFile using IOCP for async completions\n"
+                        L"\t- riopoll : registered i/o with dedicated threads continuously polling the completion queue\n"
+                        L"\t            reaps completions across all connections without waiting on a notification\n"
+                        L"\t  note : riopoll threads spin on every processor while the test is running\n"
+                        L"-LargePages:<on,off>\n"
+                        L"   - allocates the shared send and verify buffers, connection IDs and recv buffers on large pages\n"
+                        L"     so each is mapped by far fewer TLB entries\n"
+                        L"\t- <default> == off\n"
+                        L"\t  note : requires the 'Lock pages in memory' privilege - standard pages are used without it\n"
                         L"-LocalPort:####\n"
                         L"   - the local port to bind to when initiating a connection\n"
                         L"\t- <default> == 0  (an ephemeral port will be chosen when making a connection)\n"
@@ -2413,19 +3071,36 @@ namespace ctsTraffic
                         L"\t- <default> == off\n"
                         L"\t  note : the default behavior when not specified is for TCP to indicate data per RFC\n"
                         L"           thus apps generally only set this when they know precisely the number of bytes they are expecting\n"
+                        L"-NumaBind:<on,off>\n"
+                        L"   - binds each connection to the NUMA node of the thread which created it\n"
+                        L"     its IO completes on that node's threadpool, whose threads only run on that node's processors,\n"
+                        L"     and its recv buffers are borrowed from slabs allocated from that node's memory\n"
+                        L"\t- <default> == off\n"
+                        L"\t  note : only has an effect on machines with more than one NUMA node\n"
                         L"-OnError:<log,break>\n"
                         L"   - policy to control how errors are handled at runtime\n"
                         L"\t- <default> == log \n"
                         L"\t- log : log error information only\n"
                         L"\t- break : break into the debugger with error information\n"
                         L"\t          useful when live-troubleshooting difficult failures\n"
-                        L"-Options:<keepalive,tcpfastpath>  [-Options:<...>] [-Options:<...>]\n"
+                        L"-Options:<keepalive,tcpfastpath,zerocopy,batchsend,udpoffload>  [-Options:<...>] [-Options:<...>]\n"
                         L"   - additional socket options and IOCTLS available to be set on connected sockets\n"
                         L"\t- <default> == None\n"
                         L"\t- keepalive : only for TCP sockets - enables default timeout Keep-Alive probes\n"
                         L"\t            : ctsTraffic servers have this enabled by default\n"
                         L"\t- tcpfastpath : a new option for Windows 8, only for TCP sockets over loopback\n"
                         L"\t              : the firewall must be disabled for the option to take effect\n"
+                        L"\t- zerocopy : only for TCP sockets - sets SO_SNDBUF to zero so sends are made directly from\n"
+                        L"\t           : the shared send buffer instead of being copied into the stack\n"
+                        L"\t           : a send that completes inline is equally finished with the buffer, so -InlineCompletions still applies\n"
+                        L"\t           : and -PrePostSends defaults to following the Ideal Send Backlog\n"
+                        L"\t           : cannot be combined with -SendBufValue\n"
+                        L"\t- batchsend : only for UDP servers - queues every datagram of a frame with registered i/o\n"
+                        L"\t            : and submits them to the kernel with a single commit instead of one send per datagram\n"
+                        L"\t            : frames from every stream due at the same time share the same commit\n"
+                        L"\t- udpoffload : only for UDP sockets - servers send each frame as large buffers segmented into datagrams\n"
+                        L"\t             : by the stack (USO), clients receive datagrams coalesced by the stack (URO)\n"
+                        L"\t             : cannot be combined with batchsend\n"
                         L"-PrePostRecvs:#####\n"
                         L"   - specifies the number of recv requests to issue concurrently within an IO Pattern\n"
                         L"   - for example, with the default -pattern:pull, the client will post recv calls \n"
@@ -2454,11 +3129,32 @@ namespace ctsTraffic
                         L"\t- <default> == 100 (-RateLimit bytes/second will be split out across 100 ms. time slices)\n"
                         L"\t  note : only applicable to TCP connections\n"
                         L"\t  note : only applicable is -RateLimit is set (default is not to rate limit)\n"
+                        L"-RateLimitBurst:#####\n"
+                        L"   - paces -RateLimit sends with a token bucket holding this many bytes, instead of per -RateLimitPeriod\n"
+                        L"\t     sends are scheduled to the microsecond from a dedicated pacing thread,\n"
+                        L"\t     and each connection reports SendBurst: the most bytes it sent ahead of its rate limit\n"
+                        L"\t     For example, -RateLimit:125000000 -RateLimitBurst:65536 paces 1 Gbps with bursts of at most 64KB\n"
+                        L"\t- <default> == <not set> (-RateLimit is enforced per -RateLimitPeriod)\n"
+                        L"\t  note : 0 paces each send on its own: a send is never started ahead of the rate\n"
+                        L"\t  note : only applicable to TCP connections, and cannot be used with -RateLimitPeriod\n"
                         L"-RecvBufValue:#####\n"
                         L"   - specifies the value to pass to the SO_RCVBUF socket option\n"
                         L"\t     Note: this is only necessary to specify in carefully considered scenarios\n"
                         L"\t     the default receive buffering is optimal for the majority of scenarios\n"
                         L"\t- <default> == <not set>\n"
+                        L"-RecvSegments:#\n"
+                        L"   - the number of smaller buffers each recv request is scattered across with a single WSARecv\n"
+                        L"\t     each buffer is 1/# of -Buffer, so a recv of the full buffer fills all # buffers in turn\n"
+                        L"\t- <default> == 1 (each recv request uses one contiguous buffer)\n"
+                        L"\t  note : only applicable to TCP with -IO:iocp or -IO:coroutine, with a maximum of 4\n"
+                        L"-RunToCompletion:#####\n"
+                        L"   - the number of IO requests completed inline on a socket before yielding to the threadpool\n"
+                        L"\t     IO which completes inline is processed in a loop on the calling thread until an IO pends,\n"
+                        L"\t     including IO following an async completion which is run from the completion callback\n"
+                        L"\t     once this many IO complete inline, the next IO is scheduled to run from the threadpool\n"
+                        L"\t     so one busy connection cannot hold a thread from the other connections\n"
+                        L"\t- <default> == <not set> (async completions restart IO with a new call into the IO function)\n"
+                        L"\t  note : only applicable to -IO:iocp with inline completions (-InlineCompletions:on)\n"
                         L"-SendBufValue:#####\n"
                         L"   - specifies the value to pass to the SO_SNDBUF socket option\n"
                         L"\t     Note: this is only necessary to specify in carefully considered scenarios\n"
@@ -2600,7 +3296,12 @@ namespace ctsTraffic
             set_protocol(args);
 
             set_ioPattern(args);
+            // -NumaBind decides whether set_threadpool creates a threadpool per NUMA node
+            set_numaBind(args);
             set_threadpool(args);
+            set_brokerShards(args);
+            set_cpuSet(args);
+            set_largePages(args);
             // validate protocol & pattern combinations
             if (ProtocolType::UDP == Settings->Protocol && IoPatternType::MediaStream != Settings->IoPattern)
             {
@@ -2640,6 +3341,7 @@ namespace ctsTraffic
             set_compartment(args);
             set_connections(args);
             set_throttleConnections(args);
+            set_connectionRate(args);
             set_buffer(args);
             set_transfer(args);
             set_ratelimit(args);
@@ -2711,6 +3413,7 @@ namespace ctsTraffic
             // - hence it is requirement to invoke it prior to any socket operation
             //
             set_ioFunction(args);
+            set_transmitFile(args);
             set_inlineCompletions(args);
             set_msgWaitAll(args);
             set_create(args);
@@ -2734,6 +3437,39 @@ namespace ctsTraffic
             set_prepostsends(args);
             set_recvbufvalue(args);
             set_sendbufvalue(args);
+            if (Settings->Options & ZERO_COPY_SEND)
+            {
+                if (Settings->Options & SET_SEND_BUF)
+                {
+                    throw invalid_argument("-Options:zerocopy cannot be combined with -SendBufValue");
+                }
+                // with a zero-byte send buffer the stack sends directly from the caller's buffer
+                // - the send completes only once the stack no longer needs the buffer
+                Settings->SendBufValue = 0;
+                Settings->Options |= SET_SEND_BUF;
+            }
+            set_runToCompletion(args);
+            if (Settings->RunToCompletionBudget > 0)
+            {
+                if (Settings->IoFunction != ctsSendRecvIocp)
+                {
+                    throw invalid_argument("-RunToCompletion requires -IO:iocp");
+                }
+                if (!(Settings->Options & HANDLE_INLINE_IOCP))
+                {
+                    throw invalid_argument("-RunToCompletion requires inline completions (-InlineCompletions:on)");
+                }
+            }
+            set_recvSegments(args);
+            if (Settings->RecvBufferSegments > 1)
+            {
+                // registered IO sends and receives take a single RIO_BUF, and ReadFile a single buffer
+                if (ProtocolType::TCP != Settings->Protocol ||
+                    (Settings->IoFunction != ctsSendRecvIocp && Settings->IoFunction != ctsSendRecvCoroutine))
+                {
+                    throw invalid_argument("-RecvSegments requires TCP with -IO:iocp or -IO:coroutine");
+                }
+            }
 
             if (!args.empty())
             {
@@ -2838,7 +3574,10 @@ namespace ctsTraffic
                 }
                 else
                 { // TCP
-                    s_ConnectionLogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,SendBytes,SendBps,RecvBytes,RecvBps,TimeMs,Result,ConnectionId\r\n");
+                    s_ConnectionLogger->LogMessage(
+                        (s_RateLimitLow > 0) ?
+                        L"TimeSlice,LocalAddress,RemoteAddress,SendBytes,SendBps,RecvBytes,RecvBps,TimeMs,Result,ConnectionId,SendBurstBytes\r\n" :
+                        L"TimeSlice,LocalAddress,RemoteAddress,SendBytes,SendBps,RecvBytes,RecvBps,TimeMs,Result,ConnectionId\r\n");
                 }
             }
 
@@ -3304,7 +4043,8 @@ namespace ctsTraffic
             static LPCWSTR TCPProtocolFailureResultTextFormat = L"[%.3f] TCP connection failed with the protocol error %ws : [%ws - %ws] [%hs] : SendBytes[%lld]  SendBps[%lld]  RecvBytes[%lld]  RecvBps[%lld]  Time[%lld ms]";
 
             // csv format : L"TimeSlice,LocalAddress,RemoteAddress,SendBytes,SendBps,RecvBytes,RecvBps,TimeMs,Result,ConnectionId"
-            static LPCWSTR TCPResultCsvFormat = L"%.3f,%ws,%ws,%lld,%lld,%lld,%lld,%lld,%ws,%hs\r\n";
+            // - with -RateLimit, followed by SendBurstBytes
+            static LPCWSTR TCPResultCsvFormat = L"%.3f,%ws,%ws,%lld,%lld,%lld,%lld,%lld,%ws,%hs";
 
             const long long total_time = (_stats.end_time.get() - _stats.start_time.get());
             ctFatalCondition(
@@ -3350,6 +4090,11 @@ namespace ctsTraffic
                         ctsIOPattern::BuildProtocolErrorString(_error) :
                         error_string.c_str(),
                         _stats.connection_identifier);
+                    if (s_RateLimitLow > 0)
+                    {
+                        csv_string.append(ctString::format_string(L",%lld", _stats.send_burst_bytes.get()));
+                    }
+                    csv_string.append(L"\r\n");
                 }
                 // we'll never write csv format to the console so we'll need a text string in that case
                 // - and/or in the case the s_ConnectionLogger isn't writing to csv
@@ -3384,6 +4129,10 @@ namespace ctsTraffic
                             (total_time > 0LL) ? static_cast<long long>(_stats.bytes_recv.get() * 1000LL / total_time) : 0LL,
                             total_time);
                     }
+                    if (s_RateLimitLow > 0)
+                    {
+                        text_string.append(ctString::format_string(L"  SendBurst[%lld bytes]", _stats.send_burst_bytes.get()));
+                    }
                 }
 
                 if (write_to_console)
@@ -4001,10 +4750,29 @@ namespace ctsTraffic
                 {
                     setting_string.append(L" MsgWaitAll");
                 }
+                if (Settings->Options & ZERO_COPY_SEND)
+                {
+                    setting_string.append(L" ZeroCopy");
+                }
+                if (Settings->Options & BATCH_DATAGRAM_SEND)
+                {
+                    setting_string.append(L" BatchSend");
+                }
+                if (Settings->Options & UDP_SEGMENTATION_OFFLOAD)
+                {
+                    setting_string.append(L" UdpOffload");
+                }
             }
             setting_string.append(L"\n");
 
             setting_string.append(ctString::format_string(L"\tIO function: %ws\n", s_IoFunctionName));
+            if (s_TransmitFileName != nullptr)
+            {
+                setting_string.append(
+                    ctString::format_string(
+                        L"\tTransmitFile: %ws (%lu bytes)\n",
+                        s_TransmitFileName, static_cast<unsigned long>(Settings->TransmitFileSize)));
+            }
 
             setting_string.append(L"\tIoPattern: ");
             switch (Settings->IoPattern)
@@ -4034,6 +4802,16 @@ namespace ctsTraffic
 
             setting_string.append(ctString::format_string(L"\tPrePostRecvs: %u\n", static_cast<unsigned long>(Settings->PrePostRecvs)));
 
+            if (Settings->RecvBufferSegments > 1)
+            {
+                setting_string.append(ctString::format_string(L"\tRecvSegments: %u\n", Settings->RecvBufferSegments));
+            }
+
+            if (Settings->RunToCompletionBudget > 0)
+            {
+                setting_string.append(ctString::format_string(L"\tRunToCompletion: %u IO before yielding\n", Settings->RunToCompletionBudget));
+            }
+
             if (Settings->PrePostSends > 0)
             {
                 setting_string.append(ctString::format_string(L"\tPrePostSends: %u\n", static_cast<unsigned long>(Settings->PrePostSends)));
@@ -4126,6 +4904,13 @@ namespace ctsTraffic
                             L"\tSending throughput rate limited down to a range of [%lld, %lld] bytes/second\n",
                             s_RateLimitLow, s_RateLimitHigh));
                 }
+                if (Settings->TcpBytesPerSecondTokenBucket)
+                {
+                    setting_string.append(
+                        ctString::format_string(
+                            L"\t\tPaced by a token bucket with a burst of %lld bytes\n",
+                            Settings->TcpBytesPerSecondBurst));
+                }
             }
 
             if (s_NetAdapterAddresses != nullptr)
@@ -4258,6 +5043,48 @@ namespace ctsTraffic
                 }
             }
 
+            setting_string.append(ctString::format_string(L"\tBrokerShards: %u\n", Settings->BrokerShards));
+            if (Settings->ConnectionRateHigh > 0)
+            {
+                if (Settings->ConnectionRateLow == Settings->ConnectionRateHigh)
+                {
+                    setting_string.append(ctString::format_string(L"\tConnectionRate: %u per second\n", Settings->ConnectionRateHigh));
+                }
+                else
+                {
+                    setting_string.append(
+                        ctString::format_string(
+                            L"\tConnectionRate: %u to %u per second over %u seconds\n",
+                            Settings->ConnectionRateLow,
+                            Settings->ConnectionRateHigh,
+                            Settings->ConnectionRateRampSeconds));
+                }
+            }
+            if (!Settings->CpuSetMasks.empty())
+            {
+                setting_string.append(L"\tCpuSet:");
+                for (size_t group = 0; group < Settings->CpuSetMasks.size(); ++group)
+                {
+                    setting_string.append(ctString::format_string(L" [%Iu:0x%Ix]", group, static_cast<size_t>(Settings->CpuSetMasks[group])));
+                }
+                setting_string.append(L"\n");
+            }
+            if (Settings->NumaBind)
+            {
+                setting_string.append(ctString::format_string(L"\tNumaBind: on (%Iu nodes)\n", Settings->PTPNodeEnvironments.size()));
+            }
+            if (Settings->LargePages)
+            {
+                if (Settings->LargePageSize > 0)
+                {
+                    setting_string.append(ctString::format_string(L"\tLargePages: on (%Iu bytes)\n", Settings->LargePageSize));
+                }
+                else
+                {
+                    setting_string.append(L"\tLargePages: unavailable - using standard pages\n");
+                }
+            }
+
             setting_string.append(L"\n");
 
             // immediately print the legend once we know the status info object
@@ -4339,5 +5166,17 @@ namespace ctsTraffic
         {
             return s_ConsoleVerbosity;
         }
+
+        USHORT CurrentNumaNode() noexcept
+        {
+            if (s_ProcessorNumaNodes.empty())
+            {
+                return 0;
+            }
+            PROCESSOR_NUMBER processor;
+            GetCurrentProcessorNumberEx(&processor);
+            const size_t processor_index = static_cast<size_t>(processor.Group) * MAXIMUM_PROC_PER_GROUP + processor.Number;
+            return (processor_index < s_ProcessorNumaNodes.size()) ? s_ProcessorNumaNodes[processor_index] : 0;
+        }
     } // namespace ctsConfig
 } // namespace ctsTraffic
@@ -27,9 +27,11 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // - with the below exceptions : these do not include any cts* headers
 //   -- ctsSafeInt.hpp
 //   -- ctsStatistics.hpp
+//   -- ctsConnectionRate.hpp
 //
 #include "ctsSafeInt.hpp"
 #include "ctsStatistics.hpp"
+#include "ctsConnectionRate.hpp"
 
 namespace ctsTraffic
 {
@@ -96,7 +98,10 @@ namespace ctsTraffic
             SET_SEND_BUF = 0x0040,
             ENABLE_CIRCULAR_QUEUEING = 0x0080,
             MSG_WAIT_ALL = 0x0100,
-            // next enum  = 0x0200
+            BATCH_DATAGRAM_SEND = 0x0200,
+            UDP_SEGMENTATION_OFFLOAD = 0x0400,
+            ZERO_COPY_SEND = 0x0800,
+            // next enum  = 0x1000
         };
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -318,6 +323,13 @@ namespace ctsTraffic
 
             HANDLE CtrlCHandle = nullptr;
             PTP_CALLBACK_ENVIRON PTPEnvironment = nullptr;
+            // a threadpool environment for each NUMA node, indexed by node number
+            // - each is PTPEnvironment unless -NumaBind is set on a machine with more than one node
+            // - otherwise each is a separate pool whose threads are pinned to its node's processors
+            std::vector<PTP_CALLBACK_ENVIRON> PTPNodeEnvironments;
+            // -CpuSet : the processors completion workers are pinned to, as a mask for each processor group
+            // - empty when -CpuSet was not specified
+            std::vector<KAFFINITY> CpuSetMasks;
 
             ctsSocketFunction CreateFunction;
             ctsSocketFunction ConnectFunction;
@@ -338,6 +350,13 @@ namespace ctsTraffic
             unsigned long AcceptLimit = 0;
             unsigned long ConnectionLimit = 0;
             unsigned long ConnectionThrottleLimit = 0;
+            // -BrokerShards : the number of shards the ctsSocketBroker splits connections across
+            unsigned long BrokerShards = 1;
+            // -ConnectionRate : new client connections per second, ramping from low to high over the ramp
+            // - zero when new connections are not paced
+            unsigned long ConnectionRateLow = 0;
+            unsigned long ConnectionRateHigh = 0;
+            unsigned long ConnectionRateRampSeconds = 0;
 
             std::vector<ctl::ctSockaddr> ListenAddresses;
             std::vector<ctl::ctSockaddr> TargetAddresses;
@@ -347,15 +366,24 @@ namespace ctsTraffic
             ctsConnectionStatistics ConnectionStatusDetails;
             ctsTcpStatistics TcpStatusDetails;
             ctsUdpStatistics UdpStatusDetails;
+            ctsConnectionRateStatistics ConnectionRateDetails;
 
             unsigned long StatusUpdateFrequencyMilliseconds = 0;
 
             long long TcpBytesPerSecondPeriod = 100LL;
+            // -RateLimitBurst : paces -RateLimit sends with a token bucket of this many bytes instead of per period
+            // - only applies when TcpBytesPerSecondTokenBucket is set: zero paces each send on its own
+            long long TcpBytesPerSecondBurst = 0LL;
+            bool TcpBytesPerSecondTokenBucket = false;
             long long StartTimeMilliseconds = 0;
 
             unsigned long TimeLimit = 0;
             unsigned long PrePostRecvs = 0;
             unsigned long PrePostSends = 0;
+            // -RunToCompletion : the IO completed inline on a socket before yielding to the threadpool (0 == disabled)
+            unsigned long RunToCompletionBudget = 0;
+            // -RecvSegments : the number of buffers each TCP recv is scattered across
+            unsigned long RecvBufferSegments = 1;
             unsigned long RecvBufValue = 0;
             unsigned long SendBufValue = 0;
 
@@ -364,11 +392,22 @@ namespace ctsTraffic
 
             unsigned long OutgoingIfIndex = 0;
 
+            // -TransmitFile : the file sent with TransmitFile, and a read-only view of it to verify received data
+            HANDLE TransmitFileHandle = INVALID_HANDLE_VALUE;
+            const char* TransmitFileView = nullptr;
+            unsigned long TransmitFileSize = 0;
+
             unsigned short LocalPortLow = 0;
             unsigned short LocalPortHigh = 0;
 
             bool UseSharedBuffer = false;
             bool ShouldVerifyBuffers = false;
+            // -NumaBind : connections use the threadpool and recv buffers of the NUMA node they were created on
+            bool NumaBind = false;
+            // -LargePages : the shared buffers and buffer slabs are allocated on large pages
+            // - LargePageSize is zero when not requested, or when large pages are unavailable
+            bool LargePages = false;
+            size_t LargePageSize = 0;
         };
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -382,5 +421,7 @@ namespace ctsTraffic
         SOCKET CreateSocket(int af, int type, int protocol, DWORD dwFlags);
         bool ShutdownCalled() noexcept;
         unsigned long ConsoleVerbosity() noexcept;
+        // the NUMA node of the processor the calling thread is currently running on
+        USHORT CurrentNumaNode() noexcept;
     } // namespace ctsConfig
 } // namespace ctsTraffic
@@ -0,0 +1,304 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <cmath>
+// os headers
+#include <Windows.h>
+
+//
+// ** NOTE ** this is included by ctsConfig.h: it cannot include any cts* headers
+//
+namespace ctsTraffic {
+    ///
+    /// The schedule of new connections a client creates with -ConnectionRate
+    /// - the rate ramps linearly from start_rate to end_rate over ramp_ms, then holds at end_rate
+    /// - connections are scheduled against the total the schedule allows since it began
+    ///   rather than the time since the prior connection, so a late timer delays connections but never drops them
+    ///
+    /// Rates are in connections per second, times are in milliseconds since the schedule began
+    ///
+    class ctsConnectionRateSchedule {
+    public:
+        ctsConnectionRateSchedule(double _start_rate, double _end_rate, long long _ramp_ms) noexcept :
+            start_rate(_ramp_ms > 0 ? _start_rate : _end_rate),
+            end_rate(_end_rate),
+            ramp_seconds(_ramp_ms > 0 ? static_cast<double>(_ramp_ms) / 1000.0 : 0.0)
+        {
+        }
+
+        ///
+        /// The target rate at the specified time
+        ///
+        double rate_at(long long _elapsed_ms) const noexcept
+        {
+            const double seconds = seconds_from(_elapsed_ms);
+            if (seconds >= this->ramp_seconds) {
+                return this->end_rate;
+            }
+            return this->start_rate + (this->end_rate - this->start_rate) * seconds / this->ramp_seconds;
+        }
+
+        ///
+        /// The total number of connections allowed to have started by the specified time
+        /// - the first connection is allowed immediately
+        ///
+        long long allowed_by(long long _elapsed_ms) const noexcept
+        {
+            return static_cast<long long>(std::floor(this->connections_by(seconds_from(_elapsed_ms)))) + 1LL;
+        }
+
+        ///
+        /// The time at which the connection at the (zero-based) index is allowed to start
+        ///
+        long long time_of(long long _connection_index) const noexcept
+        {
+            const double connection = static_cast<double>(_connection_index);
+            const double ramp_connections = this->connections_by(this->ramp_seconds);
+
+            double seconds;
+            if (connection >= ramp_connections) {
+                seconds = this->ramp_seconds + (connection - ramp_connections) / this->end_rate;
+            } else if (this->start_rate == this->end_rate) {
+                seconds = connection / this->start_rate;
+            } else {
+                // solving connections_by(seconds) == connection for seconds within the ramp
+                const double acceleration = (this->end_rate - this->start_rate) / this->ramp_seconds;
+                const double discriminant = this->start_rate * this->start_rate + 2.0 * acceleration * connection;
+                seconds = (std::sqrt(discriminant > 0.0 ? discriminant : 0.0) - this->start_rate) / acceleration;
+            }
+            return static_cast<long long>(std::ceil(seconds * 1000.0));
+        }
+
+    private:
+        double start_rate;
+        double end_rate;
+        double ramp_seconds;
+
+        static double seconds_from(long long _elapsed_ms) noexcept
+        {
+            return (_elapsed_ms > 0) ? static_cast<double>(_elapsed_ms) / 1000.0 : 0.0;
+        }
+
+        // the area under the rate over time: the number of connections the schedule has allowed
+        double connections_by(double _seconds) const noexcept
+        {
+            if (_seconds < this->ramp_seconds) {
+                return this->start_rate * _seconds +
+                    (this->end_rate - this->start_rate) * _seconds * _seconds / (2.0 * this->ramp_seconds);
+            }
+            return (this->start_rate + this->end_rate) * this->ramp_seconds / 2.0 +
+                this->end_rate * (_seconds - this->ramp_seconds);
+        }
+    };
+
+    ///
+    /// Paces new connections to a ctsConnectionRateSchedule
+    /// - shared by every shard of the ctsSocketBroker: claims are a single interlocked compare-exchange
+    /// - a claim which is not used (e.g. the socket failed to be created) must be given back with release()
+    ///
+    class ctsConnectionRateLimiter {
+    public:
+        ctsConnectionRateLimiter(const ctsConnectionRateSchedule& _schedule, long long _start_ms) noexcept :
+            schedule(_schedule),
+            start_ms(_start_ms)
+        {
+        }
+
+        ///
+        /// Claims the next connection if the schedule allows it to start at _now_ms
+        ///
+        bool try_claim(long long _now_ms) noexcept
+        {
+            const LONGLONG allowed = this->schedule.allowed_by(_now_ms - this->start_ms);
+            LONGLONG started = ::InterlockedCompareExchange64(&this->started_connections, 0LL, 0LL);
+            while (started < allowed) {
+                const LONGLONG prior = ::InterlockedCompareExchange64(&this->started_connections, started + 1, started);
+                if (prior == started) {
+                    return true;
+                }
+                started = prior;
+            }
+            return false;
+        }
+
+        void release() noexcept
+        {
+            ::InterlockedDecrement64(&this->started_connections);
+        }
+
+        ///
+        /// The milliseconds from _now_ms until the schedule allows another connection
+        /// - at least 1, as this is only asked once a claim has failed
+        ///
+        long long delay_until_next(long long _now_ms) const noexcept
+        {
+            const LONGLONG next_connection = ::InterlockedCompareExchange64(
+                const_cast<volatile LONGLONG*>(&this->started_connections), 0LL, 0LL);
+            const long long delay = this->schedule.time_of(next_connection) - (_now_ms - this->start_ms);
+            return (delay > 1LL) ? delay : 1LL;
+        }
+
+        // non-copyable
+        ctsConnectionRateLimiter(const ctsConnectionRateLimiter&) = delete;
+        ctsConnectionRateLimiter& operator=(const ctsConnectionRateLimiter&) = delete;
+        ctsConnectionRateLimiter(ctsConnectionRateLimiter&&) = delete;
+        ctsConnectionRateLimiter& operator=(ctsConnectionRateLimiter&&) = delete;
+
+    private:
+        const ctsConnectionRateSchedule schedule;
+        const long long start_ms;
+        volatile LONGLONG started_connections = 0LL;
+    };
+
+    ///
+    /// A lock-free histogram of latencies in microseconds
+    /// - values below SubBucketCount each have their own bucket
+    /// - larger values are binned into SubBucketCount linear buckets per power of two,
+    ///   so percentiles are reported within 1/SubBucketCount (about 6%) of the recorded values
+    /// - values are capped at MaxValue
+    ///
+    class ctsLatencyHistogram {
+    public:
+        static const long long MaxValue = (1LL << 40) - 1;
+
+        ctsLatencyHistogram() = default;
+
+        void add(long long _value) noexcept
+        {
+            if (_value < 0) {
+                _value = 0;
+            }
+            if (_value > MaxValue) {
+                _value = MaxValue;
+            }
+            ::InterlockedIncrement64(&this->counts[bucket_of(_value)]);
+            ::InterlockedIncrement64(&this->total_count);
+        }
+
+        long long count() const noexcept
+        {
+            return ::InterlockedCompareExchange64(const_cast<volatile LONGLONG*>(&this->total_count), 0LL, 0LL);
+        }
+
+        ///
+        /// The largest value in the bucket holding the value at the percentile [0.0, 100.0]
+        /// - returns zero if no values have been added
+        ///
+        long long percentile(double _percentile) const noexcept
+        {
+            const long long total = this->count();
+            if (0 == total) {
+                return 0LL;
+            }
+            long long rank = static_cast<long long>(std::ceil(_percentile / 100.0 * static_cast<double>(total)));
+            if (rank < 1) {
+                rank = 1;
+            }
+
+            long long counted = 0LL;
+            for (unsigned long bucket = 0; bucket < BucketCount; ++bucket) {
+                counted += ::InterlockedCompareExchange64(const_cast<volatile LONGLONG*>(&this->counts[bucket]), 0LL, 0LL);
+                if (counted >= rank) {
+                    return largest_value_of(bucket);
+                }
+            }
+            // values were added while counting
+            return largest_value_of(BucketCount - 1);
+        }
+
+        // non-copyable
+        ctsLatencyHistogram(const ctsLatencyHistogram&) = delete;
+        ctsLatencyHistogram& operator=(const ctsLatencyHistogram&) = delete;
+        ctsLatencyHistogram(ctsLatencyHistogram&&) = delete;
+        ctsLatencyHistogram& operator=(ctsLatencyHistogram&&) = delete;
+
+    private:
+        static const unsigned long SubBucketBits = 4;
+        static const unsigned long SubBucketCount = 1UL << SubBucketBits;
+        // one row of sub-buckets for each power of two from SubBucketCount up to MaxValue
+        static const unsigned long BucketCount = SubBucketCount + (40 - SubBucketBits) * SubBucketCount;
+
+        volatile LONGLONG counts[BucketCount]{};
+        volatile LONGLONG total_count = 0LL;
+
+        static unsigned long bucket_of(long long _value) noexcept
+        {
+            if (_value < static_cast<long long>(SubBucketCount)) {
+                return static_cast<unsigned long>(_value);
+            }
+            unsigned long highest_bit = SubBucketBits;
+            while ((_value >> (highest_bit + 1)) != 0) {
+                ++highest_bit;
+            }
+            const unsigned long shift = highest_bit - SubBucketBits;
+            const unsigned long sub_bucket = static_cast<unsigned long>(_value >> shift) - SubBucketCount;
+            return SubBucketCount + shift * SubBucketCount + sub_bucket;
+        }
+
+        static long long largest_value_of(unsigned long _bucket) noexcept
+        {
+            if (_bucket < SubBucketCount) {
+                return static_cast<long long>(_bucket);
+            }
+            const unsigned long shift = (_bucket - SubBucketCount) / SubBucketCount;
+            const unsigned long sub_bucket = (_bucket - SubBucketCount) % SubBucketCount;
+            return ((static_cast<long long>(SubBucketCount + sub_bucket) + 1LL) << shift) - 1LL;
+        }
+    };
+
+    ///
+    /// Results of pacing new connections with -ConnectionRate
+    /// - times are in milliseconds since the schedule began
+    ///
+    struct ctsConnectionRateStatistics {
+        // from starting to create the socket to being connected
+        ctsLatencyHistogram connect_latency_usec;
+        volatile LONGLONG connected_count = 0LL;
+        volatile LONGLONG last_connected_ms = 0LL;
+        volatile LONGLONG connect_error_count = 0LL;
+        // when the first connection failed to connect: -1 if none have failed
+        volatile LONGLONG first_connect_error_ms = -1LL;
+
+        ctsConnectionRateStatistics() = default;
+
+        void connected(long long _elapsed_ms, long long _latency_usec) noexcept
+        {
+            this->connect_latency_usec.add(_latency_usec);
+            ::InterlockedIncrement64(&this->connected_count);
+            // connections can complete out of order: only move the time forward
+            LONGLONG last_connected = ::InterlockedCompareExchange64(&this->last_connected_ms, 0LL, 0LL);
+            while (last_connected < _elapsed_ms) {
+                const LONGLONG prior = ::InterlockedCompareExchange64(&this->last_connected_ms, _elapsed_ms, last_connected);
+                if (prior == last_connected) {
+                    break;
+                }
+                last_connected = prior;
+            }
+        }
+
+        void connect_failed(long long _elapsed_ms) noexcept
+        {
+            ::InterlockedIncrement64(&this->connect_error_count);
+            ::InterlockedCompareExchange64(&this->first_connect_error_ms, _elapsed_ms, -1LL);
+        }
+
+        // non-copyable
+        ctsConnectionRateStatistics(const ctsConnectionRateStatistics&) = delete;
+        ctsConnectionRateStatistics& operator=(const ctsConnectionRateStatistics&) = delete;
+        ctsConnectionRateStatistics(ctsConnectionRateStatistics&&) = delete;
+        ctsConnectionRateStatistics& operator=(ctsConnectionRateStatistics&&) = delete;
+    };
+}
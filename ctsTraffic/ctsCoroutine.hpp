@@ -0,0 +1,318 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <coroutine>
+#include <new>
+#include <utility>
+#include <vector>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctScopeGuard.hpp>
+
+//
+// these require C++20 coroutines: ctsTraffic builds with /await:strict to enable them
+//
+namespace ctsTraffic {
+    ///
+    /// Per-thread pool of coroutine frames
+    /// - frames are binned into size classes of FrameSizeGranularity bytes, up to MaxPooledFrameSize
+    /// - a frame is taken from the list of the thread starting the coroutine
+    ///   and returned to the list of the thread on which it completes, so the lists need no lock
+    /// - each thread keeps at most MaxFreeFrames of each size class: beyond that frames are freed
+    ///
+    class ctsCoroutineFramePool {
+    public:
+        static const size_t FrameSizeGranularity = 64;
+        static const size_t MaxPooledFrameSize = 4096;
+        static const unsigned long MaxFreeFrames = 64;
+
+        ///
+        /// Returns nullptr if the frame cannot be allocated
+        ///
+        static void* allocate(size_t _size) noexcept
+        {
+            if (_size > MaxPooledFrameSize) {
+                return ::operator new(_size, std::nothrow);
+            }
+            auto& frame_lists = FrameLists::for_this_thread();
+            const size_t size_class = size_class_of(_size);
+            FreeFrame* frame = frame_lists.heads[size_class];
+            if (frame) {
+                frame_lists.heads[size_class] = frame->next;
+                --frame_lists.counts[size_class];
+                return frame;
+            }
+            // allocate the full size class so the frame can be reused for any coroutine in the class
+            return ::operator new((size_class + 1) * FrameSizeGranularity, std::nothrow);
+        }
+
+        static void deallocate(_In_ void* _frame, size_t _size) noexcept
+        {
+            if (_size > MaxPooledFrameSize) {
+                ::operator delete(_frame);
+                return;
+            }
+            auto& frame_lists = FrameLists::for_this_thread();
+            const size_t size_class = size_class_of(_size);
+            if (frame_lists.counts[size_class] >= MaxFreeFrames) {
+                ::operator delete(_frame);
+                return;
+            }
+            auto* frame = static_cast<FreeFrame*>(_frame);
+            frame->next = frame_lists.heads[size_class];
+            frame_lists.heads[size_class] = frame;
+            ++frame_lists.counts[size_class];
+        }
+
+        ///
+        /// The number of frames the calling thread is holding for reuse
+        ///
+        static unsigned long free_frame_count() noexcept
+        {
+            const auto& frame_lists = FrameLists::for_this_thread();
+            unsigned long free_frames = 0;
+            for (const auto count : frame_lists.counts) {
+                free_frames += count;
+            }
+            return free_frames;
+        }
+
+    private:
+        static const size_t SizeClassCount = MaxPooledFrameSize / FrameSizeGranularity;
+
+        struct FreeFrame {
+            FreeFrame* next;
+        };
+
+        struct FrameLists {
+            FreeFrame* heads[SizeClassCount]{};
+            unsigned long counts[SizeClassCount]{};
+
+            static FrameLists& for_this_thread() noexcept
+            {
+                static thread_local FrameLists frame_lists;
+                return frame_lists;
+            }
+
+            FrameLists() = default;
+            ~FrameLists() noexcept
+            {
+                for (auto* head : heads) {
+                    while (head) {
+                        FreeFrame* next = head->next;
+                        ::operator delete(head);
+                        head = next;
+                    }
+                }
+            }
+
+            FrameLists(const FrameLists&) = delete;
+            FrameLists& operator=(const FrameLists&) = delete;
+        };
+
+        static size_t size_class_of(size_t _size) noexcept
+        {
+            return (_size == 0) ? 0 : (_size - 1) / FrameSizeGranularity;
+        }
+    };
+
+    ///
+    /// The return type of a fire-and-forget coroutine
+    /// - the coroutine starts running as soon as it's invoked, and its frame is freed as soon as it returns
+    /// - frames come from ctsCoroutineFramePool: if one can't be allocated the coroutine never runs,
+    ///   which the caller sees as started() returning false
+    ///
+    /// Coroutines returning ctsCoroutineTask must not let exceptions escape: doing so is fatal
+    ///
+    class ctsCoroutineTask {
+    public:
+        struct promise_type {
+            ctsCoroutineTask get_return_object() noexcept
+            {
+                return ctsCoroutineTask(true);
+            }
+            static ctsCoroutineTask get_return_object_on_allocation_failure() noexcept
+            {
+                return ctsCoroutineTask(false);
+            }
+
+            std::suspend_never initial_suspend() const noexcept
+            {
+                return {};
+            }
+            std::suspend_never final_suspend() const noexcept
+            {
+                return {};
+            }
+            void return_void() const noexcept
+            {
+            }
+            void unhandled_exception() const noexcept
+            {
+                ctl::ctAlwaysFatalCondition(L"ctsCoroutineTask: an exception escaped from a coroutine");
+            }
+
+            static void* operator new(size_t _size) noexcept
+            {
+                return ctsCoroutineFramePool::allocate(_size);
+            }
+            static void operator delete(void* _frame, size_t _size) noexcept
+            {
+                ctsCoroutineFramePool::deallocate(_frame, _size);
+            }
+        };
+
+        bool started() const noexcept
+        {
+            return this->coroutine_started;
+        }
+
+    private:
+        explicit ctsCoroutineTask(bool _started) noexcept : coroutine_started(_started)
+        {
+        }
+
+        bool coroutine_started;
+    };
+
+    ///
+    /// Delivers events posted from any thread to a single coroutine
+    /// - the coroutine awaits next() to take every event posted since it last looked
+    ///   suspending only if there are none
+    /// - the thread posting an event to a suspended coroutine resumes it inline, before post returns
+    ///
+    /// The pending events are held in a vector swapped with the coroutine's on each next()
+    /// - posting never allocates once the coroutine has reserve()'d room for every event which can be outstanding
+    ///
+    /// The coroutine owning the channel must not complete while events can still be posted to it
+    ///
+    template <typename Event>
+    class ctsCoroutineChannel {
+    public:
+        class Awaiter {
+        public:
+            Awaiter(ctsCoroutineChannel& _channel, std::vector<Event>& _events) noexcept :
+                channel(_channel),
+                events(_events)
+            {
+            }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> _coroutine) noexcept
+            {
+                ::AcquireSRWLockExclusive(&this->channel.lock);
+                if (!this->channel.pending.empty()) {
+                    ::ReleaseSRWLockExclusive(&this->channel.lock);
+                    return false;
+                }
+                this->channel.waiter = _coroutine;
+                ::ReleaseSRWLockExclusive(&this->channel.lock);
+                return true;
+            }
+
+            void await_resume() noexcept
+            {
+                this->events.clear();
+                ::AcquireSRWLockExclusive(&this->channel.lock);
+                this->events.swap(this->channel.pending);
+                ::ReleaseSRWLockExclusive(&this->channel.lock);
+            }
+
+        private:
+            ctsCoroutineChannel& channel;
+            std::vector<Event>& events;
+        };
+
+        ctsCoroutineChannel() = default;
+
+        ///
+        /// The coroutine's vector of events, which is swapped with the pending events on each next()
+        /// - must also be reserved with room for every event which can be outstanding
+        ///
+        /// - can throw std::bad_alloc
+        ///
+        void reserve(std::vector<Event>& _events, size_t _event_count)
+        {
+            _events.reserve(_event_count);
+            ::AcquireSRWLockExclusive(&this->lock);
+            ctlScopeGuard(releaseLock, { ::ReleaseSRWLockExclusive(&this->lock); });
+            this->pending.reserve(_event_count);
+        }
+
+        ///
+        /// Returns an awaitable which fills _events with the events posted since next() was last awaited
+        ///
+        Awaiter next(std::vector<Event>& _events) noexcept
+        {
+            return Awaiter(*this, _events);
+        }
+
+        ///
+        /// Posts the event only if the coroutine is suspended waiting for one
+        /// - returns true if the event was posted: the coroutine has been resumed on this thread
+        ///   and has already run until its next suspension - or completion - before this returns
+        ///
+        bool post_if_waiting(Event&& _event) noexcept
+        {
+            ::AcquireSRWLockExclusive(&this->lock);
+            if (!this->waiter) {
+                ::ReleaseSRWLockExclusive(&this->lock);
+                return false;
+            }
+            this->pending.push_back(std::move(_event));
+            const std::coroutine_handle<> coroutine = this->waiter;
+            this->waiter = nullptr;
+            ::ReleaseSRWLockExclusive(&this->lock);
+
+            coroutine.resume();
+            return true;
+        }
+
+        ///
+        /// Posts the event, resuming the coroutine on this thread if it was suspended waiting for one
+        ///
+        void post(Event&& _event) noexcept
+        {
+            ::AcquireSRWLockExclusive(&this->lock);
+            this->pending.push_back(std::move(_event));
+            const std::coroutine_handle<> coroutine = this->waiter;
+            this->waiter = nullptr;
+            ::ReleaseSRWLockExclusive(&this->lock);
+
+            if (coroutine) {
+                coroutine.resume();
+            }
+        }
+
+        // non-copyable
+        ctsCoroutineChannel(const ctsCoroutineChannel&) = delete;
+        ctsCoroutineChannel& operator=(const ctsCoroutineChannel&) = delete;
+        ctsCoroutineChannel(ctsCoroutineChannel&&) = delete;
+        ctsCoroutineChannel& operator=(ctsCoroutineChannel&&) = delete;
+
+    private:
+        SRWLOCK lock = SRWLOCK_INIT;
+        std::vector<Event> pending;
+        // set only while the coroutine is suspended in next()
+        std::coroutine_handle<> waiter;
+    };
+}
@@ -26,6 +26,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // project headers
 #include "ctsMediaStreamProtocol.hpp"
 #include "ctsIOBuffers.hpp"
+#include "ctsLargePages.hpp"
+#include "ctsCompareMemory.hpp"
 
 
 namespace ctsTraffic {
@@ -49,69 +51,118 @@ namespace ctsTraffic {
     static unsigned long s_SharedBufferSize = 0;
     static RIO_BUFFERID s_SharedBufferId = RIO_INVALID_BUFFERID;
 
+    /// Recv buffers are borrowed from slabs shared across connections, sized by the recv buffers each connection needs
+    /// - so short-lived connections don't each allocate (and with RIO, register) their own
+    /// - null when using the shared buffer: all recvs then go to s_WriteableSharedBuffer
+    static ctsBufferSlabPool* s_RecvBufferSlabs = nullptr;
+    /// With -NumaBind, connections instead borrow from the slabs of the NUMA node they were created on
+    /// - indexed by node: empty unless there's more than one node
+    static vector<ctsBufferSlabPool*> s_NodeRecvBufferSlabs;
+
+    /// With -TransmitFile the file replaces BufferPattern as the data sent and verified
+    /// - send and recv offsets then wrap at the end of the file instead of at the end of BufferPattern
+    static unsigned long s_PatternWrapSize = BufferPatternSize;
+
     static const char* s_CompletionMessage = "DONE";
     static const unsigned long s_CompletionMessageSize = 4;
     static const unsigned long s_FinBufferSize = 4; // just 4 bytes for the FIN
     static char s_FinBuffer[s_FinBufferSize];
 
-    BOOL CALLBACK InitOnceIOPatternCallback(PINIT_ONCE, PVOID, PVOID *) noexcept
+    /// With -LargePages the shared buffers are allocated on large pages, as every send and verify walks them
+    /// - falling back to standard pages if not enough large pages are free
+    /// - _large_page_length receives the whole large page allocation length, or zero if on standard pages
+    static char* AllocateSharedBuffer(unsigned long _length, _Out_opt_ size_t* _large_page_length = nullptr) noexcept
     {
-        // first create the buffer pattern
-        for (unsigned long fill_slot = 0; fill_slot < BufferPatternSize; ++fill_slot)
-        {
-            *reinterpret_cast<unsigned short*>(&BufferPattern[fill_slot * 2]) = static_cast<unsigned short>(fill_slot);
-        }
-
-        s_SharedBufferSize = BufferPatternSize + ctsConfig::GetMaxBufferSize() + s_CompletionMessageSize;
-
-        s_ProtectedSharedBuffer = static_cast<char*>(::VirtualAlloc(nullptr, s_SharedBufferSize, MEM_COMMIT, PAGE_READWRITE));
-        if (!s_ProtectedSharedBuffer) {
-            ctAlwaysFatalCondition(L"VirtualAlloc alloc failed: %u", ::GetLastError());
+        const size_t large_page_size = ctsConfig::Settings->LargePageSize;
+        if (large_page_size > 0) {
+            const size_t large_page_length = (_length + large_page_size - 1) / large_page_size * large_page_size;
+            char* buffer = ctsLargePages::Allocate(large_page_length);
+            if (buffer) {
+                if (_large_page_length) {
+                    *_large_page_length = large_page_length;
+                }
+                return buffer;
+            }
         }
-
-        s_WriteableSharedBuffer = static_cast<char*>(::VirtualAlloc(nullptr, s_SharedBufferSize, MEM_COMMIT, PAGE_READWRITE));
-        if (!s_WriteableSharedBuffer) {
-            ctAlwaysFatalCondition(L"VirtualAlloc alloc failed: %u", ::GetLastError());
+        if (_large_page_length) {
+            *_large_page_length = 0;
         }
+        return static_cast<char*>(::VirtualAlloc(nullptr, _length, MEM_COMMIT, PAGE_READWRITE));
+    }
 
-        // fill in this allocated buffer while we can write to it
-        char* protected_destination = s_ProtectedSharedBuffer;
-        char* writeable_destination = s_WriteableSharedBuffer;
+    static void FillSharedBuffer(_Out_writes_bytes_(s_SharedBufferSize) char* _buffer) noexcept
+    {
+        char* destination = _buffer;
         unsigned long write_size_remaining = s_SharedBufferSize;
         while (write_size_remaining > 0) {
             const unsigned long bytes_to_write = (write_size_remaining > BufferPatternSize) ? BufferPatternSize : write_size_remaining;
 
-            auto memerror = ::memcpy_s(protected_destination, write_size_remaining, BufferPattern, bytes_to_write);
+            const auto memerror = ::memcpy_s(destination, write_size_remaining, BufferPattern, bytes_to_write);
             ctFatalCondition(
                 memerror != 0,
                 L"memcpy_s(%p, %lu, %p, %lu) failed : %d",
-                protected_destination, write_size_remaining, BufferPattern, bytes_to_write, memerror);
+                destination, write_size_remaining, BufferPattern, bytes_to_write, memerror);
 
-            memerror = ::memcpy_s(writeable_destination, write_size_remaining, BufferPattern, bytes_to_write);
-            ctFatalCondition(
-                memerror != 0,
-                L"memcpy_s(%p, %lu, %p, %lu) failed : %d",
-                writeable_destination, write_size_remaining, BufferPattern, bytes_to_write, memerror);
-
-            protected_destination += bytes_to_write;
-            writeable_destination += bytes_to_write;
+            destination += bytes_to_write;
             write_size_remaining -= bytes_to_write;
         }
         // set the final 4 bytes to the DONE message for the send buffer
         ::memcpy_s(
-            s_ProtectedSharedBuffer + s_SharedBufferSize - s_CompletionMessageSize,
-            s_CompletionMessageSize,
-            s_CompletionMessage,
-            s_CompletionMessageSize);
-        ::memcpy_s(
-            s_WriteableSharedBuffer + s_SharedBufferSize - s_CompletionMessageSize,
+            _buffer + s_SharedBufferSize - s_CompletionMessageSize,
             s_CompletionMessageSize,
             s_CompletionMessage,
             s_CompletionMessageSize);
+    }
+
+    BOOL CALLBACK InitOnceIOPatternCallback(PINIT_ONCE, PVOID, PVOID *) noexcept
+    {
+        if (ctsConfig::Settings->TransmitFileView != nullptr) {
+            s_PatternWrapSize = ctsConfig::Settings->TransmitFileSize;
+        }
+
+        // first create the buffer pattern
+        for (unsigned long fill_slot = 0; fill_slot < BufferPatternSize; ++fill_slot)
+        {
+            *reinterpret_cast<unsigned short*>(&BufferPattern[fill_slot * 2]) = static_cast<unsigned short>(fill_slot);
+        }
+
+        s_SharedBufferSize = BufferPatternSize + ctsConfig::GetMaxBufferSize() + s_CompletionMessageSize;
+
+        size_t protected_buffer_large_page_length;
+        s_ProtectedSharedBuffer = AllocateSharedBuffer(s_SharedBufferSize, &protected_buffer_large_page_length);
+        if (!s_ProtectedSharedBuffer) {
+            ctAlwaysFatalCondition(L"VirtualAlloc alloc failed: %u", ::GetLastError());
+        }
+
+        s_WriteableSharedBuffer = AllocateSharedBuffer(s_SharedBufferSize);
+        if (!s_WriteableSharedBuffer) {
+            ctAlwaysFatalCondition(L"VirtualAlloc alloc failed: %u", ::GetLastError());
+        }
+
+        // fill in this allocated buffer while we can write to it
+        FillSharedBuffer(s_ProtectedSharedBuffer);
+        FillSharedBuffer(s_WriteableSharedBuffer);
 
         // guarantee noone will write to our s_ProtectedSharedBuffer
+        // - large pages can only be protected as the whole allocation
+        // - if the OS still won't protect them, move the buffer to standard pages: verification relies on it being read-only
         DWORD old_setting;
-        if (!::VirtualProtect(s_ProtectedSharedBuffer, s_SharedBufferSize, PAGE_READONLY, &old_setting)) {
+        if (protected_buffer_large_page_length > 0 &&
+            !::VirtualProtect(s_ProtectedSharedBuffer, protected_buffer_large_page_length, PAGE_READONLY, &old_setting)) {
+            auto& large_page_statistics = ctsLargePages::Statistics();
+            ::InterlockedIncrement64(&large_page_statistics.fallback_count);
+            ::InterlockedAdd64(&large_page_statistics.fallback_bytes, static_cast<LONGLONG>(protected_buffer_large_page_length));
+            ctsLargePages::Free(s_ProtectedSharedBuffer, protected_buffer_large_page_length);
+            protected_buffer_large_page_length = 0;
+
+            s_ProtectedSharedBuffer = static_cast<char*>(::VirtualAlloc(nullptr, s_SharedBufferSize, MEM_COMMIT, PAGE_READWRITE));
+            if (!s_ProtectedSharedBuffer) {
+                ctAlwaysFatalCondition(L"VirtualAlloc alloc failed: %u", ::GetLastError());
+            }
+            FillSharedBuffer(s_ProtectedSharedBuffer);
+        }
+        if (0 == protected_buffer_large_page_length &&
+            !::VirtualProtect(s_ProtectedSharedBuffer, s_SharedBufferSize, PAGE_READONLY, &old_setting)) {
             ctAlwaysFatalCondition(L"VirtualProtect failed: %u", ::GetLastError());
         }
 
@@ -123,6 +174,25 @@ namespace ctsTraffic {
             }
         }
 
+        if (!ctsConfig::Settings->UseSharedBuffer) {
+            // clients can have connections closing while new ones start
+            // - beyond this, and once a slab has reserved as much address space as it may, connections allocate their own
+            const unsigned long max_connections = ctsConfig::IsListening() ?
+                statics::ServerMaxConnections :
+                ctsConfig::Settings->ConnectionLimit * 2;
+            const unsigned long long max_slab_bytes = (sizeof(void*) > 4) ? 0x1000000000ULL : 0x10000000ULL;
+            s_RecvBufferSlabs = new ctsBufferSlabPool(max_connections, max_slab_bytes, statics::RioBufferRegistrar(), ctsConfig::Settings->LargePageSize);
+
+            if (ctsConfig::Settings->NumaBind && ctsConfig::Settings->PTPNodeEnvironments.size() > 1) {
+                // any node could take every connection: each slab only reserves address space until buffers are taken
+                s_NodeRecvBufferSlabs.reserve(ctsConfig::Settings->PTPNodeEnvironments.size());
+                for (size_t node = 0; node < ctsConfig::Settings->PTPNodeEnvironments.size(); ++node) {
+                    s_NodeRecvBufferSlabs.push_back(new ctsBufferSlabPool(
+                        max_connections, max_slab_bytes, statics::RioBufferRegistrar(), ctsConfig::Settings->LargePageSize, static_cast<DWORD>(node)));
+                }
+            }
+        }
+
         return TRUE;
     }
 
@@ -165,11 +235,27 @@ namespace ctsTraffic {
         (void) ::InitOnceExecuteOnce(&s_IOPatternInitializer, InitOnceIOPatternCallback, nullptr, nullptr);
         return s_ProtectedSharedBuffer;
     }
+    vector<ctsBufferSlabStatistics> ctsIOPattern::RecvBufferSlabStatistics()
+    {
+        if (!s_RecvBufferSlabs) {
+            return vector<ctsBufferSlabStatistics>();
+        }
+        auto statistics = s_RecvBufferSlabs->statistics();
+        for (const auto* node_slabs : s_NodeRecvBufferSlabs) {
+            const auto node_statistics = node_slabs->statistics();
+            statistics.insert(statistics.end(), node_statistics.begin(), node_statistics.end());
+        }
+        return statistics;
+    }
 
     ctsIOPattern::ctsIOPattern(unsigned long _recv_count) :
+        // with a range of rate limits, each connection chooses its rate once
+        bytes_sending_per_second(ctsConfig::GetTcpBytesPerSecond()),
         // (bytes/sec) * (1 sec/1000 ms) * (x ms/Quantum) == (bytes/quantum)
-        bytes_sending_per_quantum(ctsConfig::GetTcpBytesPerSecond() * static_cast<unsigned long long>(ctsConfig::Settings->TcpBytesPerSecondPeriod) / 1000LL),
-        quantum_start_time_ms(ctTimer::snap_qpc_as_msec())
+        bytes_sending_per_quantum(bytes_sending_per_second * static_cast<unsigned long long>(ctsConfig::Settings->TcpBytesPerSecondPeriod) / 1000LL),
+        quantum_start_time_ms(ctTimer::snap_qpc_as_msec()),
+        send_token_bucket(static_cast<long long>(bytes_sending_per_second), ctsConfig::Settings->TcpBytesPerSecondBurst, ctTimer::snap_qpc_as_nsec()),
+        send_burst_meter(static_cast<long long>(bytes_sending_per_second), ctTimer::snap_qpc_as_nsec())
     {
         ctFatalCondition(
             ctsConfig::Settings->UseSharedBuffer && ctsConfig::Settings->ShouldVerifyBuffers,
@@ -182,40 +268,86 @@ namespace ctsTraffic {
             throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsIOPattern", false);
         }
         ctlScopeGuard(deleteCSonError, { ::DeleteCriticalSection(&cs); });
+        ctlScopeGuard(returnSlabBufferOnError, { if (recv_slab_buffer) { recv_slab_pool->deallocate(recv_slab_buffer, recv_slab_length); } });
+
+        if (ctsConfig::Settings->PTPNodeEnvironments.size() > 1) {
+            this->numa_node = ctsConfig::CurrentNumaNode();
+            this->track_numa_node = true;
+        }
 
         // if TCP, will always need a recv buffer for the final FIN 
         if ((_recv_count > 0) || (ctsConfig::Settings->Protocol == ctsConfig::ProtocolType::TCP)) {
+            // with -RecvSegments, each recv is spread across that many smaller buffers
+            // - the recv for the FIN still takes a single buffer, so each must be large enough for the FIN
+            unsigned long recv_buffer_size = ctsConfig::GetMaxBufferSize();
+            unsigned long recv_buffer_count = _recv_count;
+            if ((_recv_count > 0) && (ctsConfig::Settings->RecvBufferSegments > 1)) {
+                this->recv_segment_size = (recv_buffer_size + ctsConfig::Settings->RecvBufferSegments - 1) / ctsConfig::Settings->RecvBufferSegments;
+                if (this->recv_segment_size < s_FinBufferSize) {
+                    this->recv_segment_size = s_FinBufferSize;
+                }
+                recv_buffer_size = this->recv_segment_size;
+                recv_buffer_count *= ctsConfig::Settings->RecvBufferSegments;
+            }
+
             // recv will only use the same shared buffer when the user specified to do so on the cmdline
             if (ctsConfig::Settings->UseSharedBuffer) {
                 if (_recv_count > 0) {
-                    for (unsigned long free_list = 0; free_list < _recv_count; ++free_list) {
+                    for (unsigned long free_list = 0; free_list < recv_buffer_count; ++free_list) {
                         recv_buffer_free_list.push_back(s_WriteableSharedBuffer);
                     }
                     // if using RIO, can share the same BufferId when not needing to validate the buffer
                     recv_rio_bufferid = s_SharedBufferId;
+                    recv_rio_buffer_base = s_WriteableSharedBuffer;
                 } else {
                     // just use the shared buffer to capture the ACK's since recv_count == 0
                     recv_buffer_free_list.push_back(s_WriteableSharedBuffer);
                     recv_rio_bufferid = s_SharedBufferId;
+                    recv_rio_buffer_base = s_WriteableSharedBuffer;
                 }
             } else {
                 if (_recv_count > 0) {
-                    recv_buffer_container.resize(ctsConfig::GetMaxBufferSize() * _recv_count);
-                    char* raw_recv_buffer = &recv_buffer_container[0];
-                    for (unsigned long free_list = 0; free_list < _recv_count; ++free_list) {
-                        recv_buffer_free_list.push_back(raw_recv_buffer + static_cast<size_t>(free_list * ctsConfig::GetMaxBufferSize()));
+                    // borrowed from the slabs shared across connections
+                    // - with -NumaBind, from the slabs of the node whose threadpool services this connection
+                    // - falling back to allocating them for just this connection if the slab for their size is exhausted
+                    ctsBufferSlabPool* slab_pool = s_RecvBufferSlabs;
+                    if (this->track_numa_node && this->numa_node < s_NodeRecvBufferSlabs.size()) {
+                        slab_pool = s_NodeRecvBufferSlabs[this->numa_node];
+                    }
+                    char* raw_recv_buffer;
+                    const size_t recv_length = static_cast<size_t>(recv_buffer_size) * recv_buffer_count;
+                    const auto allocation = slab_pool->allocate(recv_length);
+                    if (allocation.buffer) {
+                        raw_recv_buffer = allocation.buffer;
+                        this->recv_slab_pool = slab_pool;
+                        this->recv_slab_buffer = allocation.buffer;
+                        this->recv_slab_length = recv_length;
+                        // the slab's chunks are already registered: each recv is addressed by its offset from the base of the chunk
+                        recv_rio_bufferid = allocation.buffer_id;
+                        recv_rio_buffer_base = allocation.chunk_base;
+                    } else {
+                        recv_buffer_container.resize(recv_length);
+                        raw_recv_buffer = &recv_buffer_container[0];
+                    }
+                    for (unsigned long free_list = 0; free_list < recv_buffer_count; ++free_list) {
+                        recv_buffer_free_list.push_back(raw_recv_buffer + static_cast<size_t>(free_list) * recv_buffer_size);
                     }
                 } else {
                     // just use the shared buffer to capture the FIN since recv_count == 0
                     recv_buffer_free_list.push_back(s_WriteableSharedBuffer);
                     recv_rio_bufferid = s_SharedBufferId;
+                    recv_rio_buffer_base = s_WriteableSharedBuffer;
                 }
             }
 
+            // register the entire recv buffer allocation once with RIO
+            // - every pended recv then references the same BufferId at its own offset
+            //   so no buffers need to be registered or pinned per IO request
             if (ctsConfig::Settings->SocketFlags & WSA_FLAG_REGISTERED_IO &&
-                recv_rio_bufferid != s_SharedBufferId) {
-                ctFatalCondition(_recv_count > 1, L"Current not supporting >1 concurrent IO requests with RIO");
-                recv_rio_bufferid = ctRIORegisterBuffer(recv_buffer_free_list[0], static_cast<DWORD>(ctsConfig::GetMaxBufferSize()));
+                recv_rio_bufferid != s_SharedBufferId &&
+                !recv_slab_buffer) {
+                recv_rio_buffer_base = recv_buffer_free_list[0];
+                recv_rio_bufferid = ctRIORegisterBuffer(recv_rio_buffer_base, recv_buffer_size * recv_buffer_count);
                 if (RIO_INVALID_BUFFERID == recv_rio_bufferid) {
                     throw ctException(::WSAGetLastError(), L"RIORegisterBuffer", L"ctsIOPattern", false);
                 }
@@ -224,15 +356,24 @@ namespace ctsTraffic {
 
         // init was successful - don't delete
         deleteCSonError.dismiss();
+        returnSlabBufferOnError.dismiss();
     }
 
 
     ctsIOPattern::~ctsIOPattern() noexcept
     {
-        if (recv_rio_bufferid != RIO_INVALID_BUFFERID && recv_rio_bufferid != s_SharedBufferId) {
+        if (recv_slab_buffer) {
+            // the slab owns the registration of its chunks
+            recv_slab_pool->deallocate(recv_slab_buffer, recv_slab_length);
+        } else if (recv_rio_bufferid != RIO_INVALID_BUFFERID && recv_rio_bufferid != s_SharedBufferId) {
             ctRIODeregisterBuffer(recv_rio_bufferid);
         }
 
+        if (numa_tracked_completions > 0) {
+            ctsConfig::Settings->ConnectionStatusDetails.numa_tracked_completion_count.add(numa_tracked_completions);
+            ctsConfig::Settings->ConnectionStatusDetails.cross_node_completion_count.add(cross_node_completions);
+        }
+
         ::DeleteCriticalSection(&cs);
     }
 
@@ -327,18 +468,22 @@ namespace ctsTraffic {
 
             if (this->recv_rio_bufferid != RIO_INVALID_BUFFERID) {
                 // RIO must always use the allocated buffers which were registered
-                return_task.buffer = *this->recv_buffer_free_list.rbegin();
+                // - RIO is registered at the recv_rio_buffer_base address
+                //   thus needs to specify the offset to get to the unique buffer for this request
+                char* rio_buffer = *this->recv_buffer_free_list.rbegin();
                 this->recv_buffer_free_list.pop_back();
+                return_task.buffer = this->recv_rio_buffer_base;
+                return_task.buffer_offset = static_cast<unsigned long>(rio_buffer - this->recv_rio_buffer_base);
                 return_task.rio_bufferid = this->recv_rio_bufferid;
                 return_task.buffer_type = ctsIOTask::BufferType::Tracked;
             } else {
                 return_task.buffer = s_FinBuffer;
+                return_task.buffer_offset = 0;
                 return_task.buffer_type = ctsIOTask::BufferType::Static;
             }
 
             return_task.ioAction = IOTaskAction::Recv;
             return_task.buffer_length = s_FinBufferSize;
-            return_task.buffer_offset = 0;
             return_task.track_io = false;
             break;
 
@@ -371,9 +516,23 @@ namespace ctsTraffic {
         //
         const ctAutoReleaseCriticalSection local_cs(&this->cs);
 
+        if (this->track_numa_node) {
+            ++this->numa_tracked_completions;
+            if (ctsConfig::CurrentNumaNode() != this->numa_node) {
+                ++this->cross_node_completions;
+            }
+        }
+
         // Only add the recv buffer back if it was one of our listed recv buffers
+        // - RIO tasks reference the registered base address, with the unique buffer at buffer_offset
         if (ctsIOTask::BufferType::Tracked == _original_task.buffer_type) {
-            this->recv_buffer_free_list.push_back(_original_task.buffer);
+            if (_original_task.buffer_segment_count > 0) {
+                for (unsigned long segment = 0; segment < _original_task.buffer_segment_count; ++segment) {
+                    this->recv_buffer_free_list.push_back(_original_task.buffer_segments[segment].buffer);
+                }
+            } else {
+                this->recv_buffer_free_list.push_back(_original_task.buffer + _original_task.buffer_offset);
+            }
         }
 
         // preserve the previous task
@@ -478,7 +637,7 @@ namespace ctsTraffic {
                     }
 
                     this->recv_pattern_offset += _current_transfer;
-                    this->recv_pattern_offset %= BufferPatternSize;
+                    this->recv_pattern_offset %= s_PatternWrapSize;
                 }
             }
             break;
@@ -495,6 +654,9 @@ namespace ctsTraffic {
 
             if (IOTaskAction::Send == _original_task.ioAction) {
                 ctsConfig::Settings->TcpStatusDetails.bytes_sent.add(_current_transfer);
+                if (this->bytes_sending_per_second > 0) {
+                    this->send_burst_meter.record(_current_transfer, ctTimer::snap_qpc_as_nsec());
+                }
             } else {
                 ctsConfig::Settings->TcpStatusDetails.bytes_recv.add(_current_transfer);
             }
@@ -560,6 +722,16 @@ namespace ctsTraffic {
             L"ctsIOPattern internal error: next buffer size (%llu) is greater than MAXDWORD (%u)",
             static_cast<ULONGLONG>(new_buffer_size), MAXDWORD);
         //
+        // TransmitFile can't wrap back to the start of the file within one send
+        // - end this send at the end of the file: the next send starts from the beginning
+        //
+        if (IOTaskAction::Send == _action && ctsConfig::Settings->TransmitFileView != nullptr) {
+            const unsigned long bytes_to_end_of_file = s_PatternWrapSize - static_cast<unsigned long>(this->send_pattern_offset);
+            if (new_buffer_size > bytes_to_end_of_file) {
+                new_buffer_size = bytes_to_end_of_file;
+            }
+        }
+        //
         // build the next IO request with a properly calculated buffer size
         // Send must specify the offset because we must align the patterns that we send
         // Recv must not specify an offset because will always use the entire buffer for the recv
@@ -569,7 +741,12 @@ namespace ctsTraffic {
             //
             // check to see if the send needs to be deferred into the future
             //
-            if (this->bytes_sending_per_quantum > 0) {
+            if (ctsConfig::Settings->TcpBytesPerSecondTokenBucket && this->bytes_sending_per_second > 0) {
+                // paced to the nanosecond, then scheduled to the microsecond by the ctsPacer
+                const long long delay_ns = this->send_token_bucket.delay_for(static_cast<long long>(new_buffer_size), ctTimer::snap_qpc_as_nsec());
+                return_task.time_offset_microseconds = delay_ns / 1000LL;
+
+            } else if (this->bytes_sending_per_quantum > 0) {
                 const auto current_time_ms(ctTimer::snap_qpc_as_msec());
                 if (this->bytes_sending_this_quantum < this->bytes_sending_per_quantum) {
                     // adjust bytes_sending_this_quantum
@@ -627,25 +804,35 @@ namespace ctsTraffic {
             }
 
             return_task.ioAction = IOTaskAction::Send;
-            return_task.buffer = s_ProtectedSharedBuffer;
-            return_task.rio_bufferid = s_SharedBufferId;
             return_task.buffer_length = static_cast<unsigned long>(new_buffer_size);
             return_task.buffer_offset = static_cast<unsigned long>(this->send_pattern_offset);
             return_task.expected_pattern_offset = 0; // The sender shouldn't be validating this
-            return_task.buffer_type = ctsIOTask::BufferType::Static;
+            if (ctsConfig::Settings->TransmitFileView != nullptr) {
+                // the IO function sends from the file at buffer_offset: buffer is the view of those same bytes
+                return_task.buffer = const_cast<char*>(ctsConfig::Settings->TransmitFileView);
+                return_task.buffer_type = ctsIOTask::BufferType::TransmitFile;
+            } else {
+                return_task.buffer = s_ProtectedSharedBuffer;
+                return_task.rio_bufferid = s_SharedBufferId;
+                return_task.buffer_type = ctsIOTask::BufferType::Static;
+            }
 
             // now that we are indicating this buffer to send, increment the offset for the next send request
             this->send_pattern_offset += new_buffer_size;
-            this->send_pattern_offset %= BufferPatternSize;
+            this->send_pattern_offset %= s_PatternWrapSize;
 
             ctFatalCondition(
-                this->send_pattern_offset >= BufferPatternSize,
-                L"this->pattern_offset being too large (larger than BufferPatternSize %lu) means we might walk off the end of our shared buffer (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
-                BufferPatternSize, this);
+                this->send_pattern_offset >= s_PatternWrapSize,
+                L"this->pattern_offset being too large (larger than the pattern size %lu) means we might walk off the end of our shared buffer (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
+                s_PatternWrapSize, this);
             ctFatalCondition(
-                return_task.buffer_length + return_task.buffer_offset > s_SharedBufferSize,
+                ctsIOTask::BufferType::Static == return_task.buffer_type && return_task.buffer_length + return_task.buffer_offset > s_SharedBufferSize,
                 L"return_task (%p) for a Send request is specifying a buffer that is larger than the static SharedBufferSize (%lu) (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
                 &return_task, s_SharedBufferSize, this);
+            ctFatalCondition(
+                ctsIOTask::BufferType::TransmitFile == return_task.buffer_type && return_task.buffer_length + return_task.buffer_offset > s_PatternWrapSize,
+                L"return_task (%p) for a Send request is specifying a range past the end of the TransmitFile file (%lu bytes) (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
+                &return_task, s_PatternWrapSize, this);
 
         } else {
             ctFatalCondition(
@@ -663,12 +850,42 @@ namespace ctsTraffic {
             return_task.expected_pattern_offset = static_cast<unsigned long>(this->recv_pattern_offset);
 
             ctFatalCondition(
-                this->recv_pattern_offset >= BufferPatternSize,
+                this->recv_pattern_offset >= s_PatternWrapSize,
                 L"pattern_offset being too large means we might walk off the end of our shared buffer (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)", this);
             ctFatalCondition(
                 return_task.buffer_length + return_task.buffer_offset > new_buffer_size,
                 L"return_task (%p) for a Recv request is specifying a buffer that is larger than buffer_size (%lu) (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
                 &return_task, static_cast<unsigned long>(new_buffer_size), this);
+
+            if (this->recv_segment_size > 0) {
+                // scatter the recv across as many free segments as it needs, starting with the buffer already taken
+                unsigned long bytes_remaining = return_task.buffer_length;
+                char* segment_buffer = return_task.buffer;
+                for (;;) {
+                    ctsIOTaskBufferSegment& segment = return_task.buffer_segments[return_task.buffer_segment_count];
+                    ++return_task.buffer_segment_count;
+                    segment.buffer = segment_buffer;
+                    segment.length = (bytes_remaining < this->recv_segment_size) ? bytes_remaining : this->recv_segment_size;
+                    bytes_remaining -= segment.length;
+                    if (0 == bytes_remaining) {
+                        break;
+                    }
+
+                    ctFatalCondition(
+                        return_task.buffer_segment_count == ctsIOTask::MaxBufferSegments || this->recv_buffer_free_list.empty(),
+                        L"return_task (%p) for a Recv request needs more segments than are available (%lu bytes remaining of %lu) (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
+                        &return_task, bytes_remaining, return_task.buffer_length, this);
+                    segment_buffer = *this->recv_buffer_free_list.rbegin();
+                    this->recv_buffer_free_list.pop_back();
+                }
+            }
+
+            if (this->recv_rio_bufferid != RIO_INVALID_BUFFERID) {
+                // RIO is registered at the recv_rio_buffer_base address
+                // - thus needs to specify the offset to get to the unique buffer for this request
+                return_task.buffer_offset = static_cast<unsigned long>(return_task.buffer - this->recv_rio_buffer_base);
+                return_task.buffer = this->recv_rio_buffer_base;
+            }
         }
 
         return return_task;
@@ -680,27 +897,61 @@ namespace ctsTraffic {
             return true;
         }
         //
-        // We're using RtlCompareMemory instead of memcmp because it returns the first offset at which the buffers differ,
+        // We're using ctsCompareMemory instead of memcmp because it returns the first offset at which the buffers differ,
         // which is more useful than memcmp's "sign of the difference between the first two differing elements"
+        // - it has RtlCompareMemory semantics, but compares with the widest SIMD instructions the processor supports
+        //
+        // The shared buffer holds enough of BufferPattern past any offset for the largest buffer: it's compared in one pass
+        // A -TransmitFile file is compared in pieces, wrapping to the start of the file just as the sender did
         //
-        const auto pattern_buffer = s_ProtectedSharedBuffer + _original_task.expected_pattern_offset;
-        const size_t length_matched = ::RtlCompareMemory(
-            pattern_buffer,
-            _original_task.buffer + _original_task.buffer_offset,
-            _transferred_bytes);
-        if (length_matched != _transferred_bytes) {
-            ctsConfig::PrintErrorInfo(
-                L"ctsIOPattern found data corruption: detected an invalid byte pattern in the returned buffer (length %u): "
-                L"buffer received (%p), expected buffer pattern (%p) - mismatch from expected pattern at offset (%Iu) [expected 32-bit value '0x%x' didn't match '0x%x']",
-                _transferred_bytes,
-                _original_task.buffer + _original_task.buffer_offset,
-                pattern_buffer,
-                length_matched,
-                pattern_buffer[length_matched],
-                *(_original_task.buffer + _original_task.buffer_offset + length_matched));
+        const char* pattern_source = s_ProtectedSharedBuffer;
+        unsigned long pattern_source_length = s_SharedBufferSize;
+        if (ctsConfig::Settings->TransmitFileView != nullptr) {
+            pattern_source = ctsConfig::Settings->TransmitFileView;
+            pattern_source_length = ctsConfig::Settings->TransmitFileSize;
+        }
+
+        // A scatter-gather recv fills its segments in order: each continues the pattern where the prior segment ended
+        //
+        WSABUF received_buffers[ctsIOTask::MaxBufferSegments];
+        const unsigned long received_buffer_count = _original_task.fill_wsabufs(received_buffers);
+
+        unsigned long pattern_offset = _original_task.expected_pattern_offset;
+        unsigned long bytes_verified = 0;
+        for (unsigned long received_buffer_index = 0; received_buffer_index < received_buffer_count && bytes_verified < _transferred_bytes; ++received_buffer_index) {
+            const char* received_buffer = received_buffers[received_buffer_index].buf;
+            const unsigned long segment_bytes = min(_transferred_bytes - bytes_verified, static_cast<unsigned long>(received_buffers[received_buffer_index].len));
+            unsigned long segment_bytes_verified = 0;
+            while (segment_bytes_verified < segment_bytes) {
+                const unsigned long bytes_to_compare = min(segment_bytes - segment_bytes_verified, pattern_source_length - pattern_offset);
+                const auto pattern_buffer = pattern_source + pattern_offset;
+                const size_t length_matched = ctsCompareMemory::Compare(
+                    pattern_buffer,
+                    received_buffer + segment_bytes_verified,
+                    bytes_to_compare);
+                if (length_matched != bytes_to_compare) {
+                    ctsConfig::PrintErrorInfo(
+                        L"ctsIOPattern found data corruption: detected an invalid byte pattern in the returned buffer (length %u): "
+                        L"buffer received (%p), expected buffer pattern (%p) - mismatch from expected pattern at offset (%Iu) [expected 32-bit value '0x%x' didn't match '0x%x']",
+                        _transferred_bytes,
+                        received_buffer,
+                        pattern_buffer,
+                        bytes_verified + segment_bytes_verified + length_matched,
+                        pattern_buffer[length_matched],
+                        received_buffer[segment_bytes_verified + length_matched]);
+                    return false;
+                }
+
+                segment_bytes_verified += bytes_to_compare;
+                pattern_offset += bytes_to_compare;
+                if (pattern_offset == pattern_source_length) {
+                    pattern_offset = 0;
+                }
+            }
+            bytes_verified += segment_bytes;
         }
 
-        return (length_matched == _transferred_bytes);
+        return true;
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,11 +22,14 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctLocks.hpp>
 #include <ctString.hpp>
 // project headers
+#include "ctsBufferSlab.hpp"
 #include "ctsConfig.h"
 #include "ctsIOTask.hpp"
 #include "ctsSafeInt.hpp"
 #include "ctsIOPatternState.hpp"
 #include "ctsStatistics.hpp"
+#include "ctsTokenBucket.hpp"
+#include "ctsWheelTimer.hpp"
 #include <mswsock.h>
 
 namespace ctsTraffic {
@@ -84,6 +87,13 @@ namespace ctsTraffic {
         ///
         static char* AccessSharedBuffer() noexcept;
         ///
+        /// The occupancy and reuse of each size class of recv buffers borrowed across connections
+        /// - empty if no connection has borrowed recv buffers
+        ///
+        /// - can throw std::bad_alloc
+        ///
+        static std::vector<ctsBufferSlabStatistics> RecvBufferSlabStatistics();
+        ///
         /// d'tor must be virtual as this is a base pure virtual class
         ///
         virtual ~ctsIOPattern() noexcept;
@@ -202,6 +212,12 @@ namespace ctsTraffic {
         // When needing to dynamically allocate, containing a vector to hold the bytes
         std::vector<char*> recv_buffer_free_list;
         std::vector<char> recv_buffer_container;
+        // the recv buffers are borrowed from slabs shared across connections, already registered with RIO
+        // - with -NumaBind, from the slabs allocated from the memory of numa_node
+        // - returned to the pool they came from, with the length they were borrowed with, when this connection is done
+        ctsBufferSlabPool* recv_slab_pool = nullptr;
+        char* recv_slab_buffer = nullptr;
+        size_t recv_slab_length = 0;
         // optional callback for protocols which need to communicate OOB to the IO function
         std::function<void(const ctsIOTask&)> callback;
 
@@ -214,14 +230,32 @@ namespace ctsTraffic {
         ctsSizeT recv_pattern_offset = 0;
 
         // RIO buffer Id
+        // - registered once over all recv buffers, with each recv addressed by its offset from recv_rio_buffer_base
         RIO_BUFFERID recv_rio_bufferid = RIO_INVALID_BUFFERID;
+        char* recv_rio_buffer_base = nullptr;
+        // with -RecvSegments, the size of each buffer in recv_buffer_free_list: each recv is spread across several of them
+        // - zero when each recv uses a single buffer
+        unsigned long recv_segment_size = 0UL;
         // tracking time information for scheduling IO at time offsets
+        const ctsSignedLongLong bytes_sending_per_second;
         const ctsSignedLongLong bytes_sending_per_quantum;
         ctsSignedLongLong bytes_sending_this_quantum = 0LL;
         ctsSignedLongLong quantum_start_time_ms;
+        // with -RateLimitBurst, sends are paced by the token bucket instead of per quantum
+        ctsTokenBucket send_token_bucket;
+        // with -RateLimit, measures how far sends ran ahead of the rate as they complete
+        ctsBurstMeter send_burst_meter;
 
         unsigned long last_error = ctsStatusIORunning;
 
+        // the NUMA node of the thread which created this connection
+        // - only tracked on machines with more than one node, counting how many completions run on another node
+        // - counted under the object lock, then added to the process-wide statistics once when destroyed
+        USHORT numa_node = 0;
+        bool track_numa_node = false;
+        long long numa_tracked_completions = 0LL;
+        long long cross_node_completions = 0LL;
+
     protected:
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
@@ -293,6 +327,21 @@ namespace ctsTraffic {
             }
         }
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Copies the burstiness measured of rate limited sends into the statistics to be printed
+        /// - only TCP connections are rate limited
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        void update_send_burst(ctsTcpStatistics& _stats) const noexcept
+        {
+            const ctl::ctAutoReleaseCriticalSection auto_lock(&this->cs);
+            _stats.send_burst_bytes.set(this->send_burst_meter.max_burst_bytes());
+        }
+        void update_send_burst(ctsUdpStatistics&) const noexcept
+        {
+        }
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Enabling derived types to update the internally tracked last-error
@@ -402,6 +451,7 @@ namespace ctsTraffic {
                 this->update_last_protocol_error(ctsIOPatternProtocolError::TooFewBytes);
             }
 
+            this->update_send_burst(stats);
             ctsConfig::PrintConnectionResults(
                 _local_addr,
                 _remote_addr,
@@ -631,8 +681,10 @@ namespace ctsTraffic {
 
     private:
         // private member variables
-        PTP_TIMER renderer_timer = nullptr;
-        PTP_TIMER start_timer = nullptr;
+        // both timers are run from the processor's shared timer wheel
+        // - the d'tor takes them under the lock to stop the callbacks from setting them again
+        std::unique_ptr<ctsWheelTimer> renderer_timer;
+        std::unique_ptr<ctsWheelTimer> start_timer;
 
         long long base_time_milliseconds = 0LL;
         const double frame_rate_ms_per_frame = 0LL;
@@ -661,6 +713,9 @@ namespace ctsTraffic {
         bool finished_stream = false;
 
         // member functions - all require the base lock
+        _Requires_lock_held_(cs)
+        ctsIOPatternProtocolError completed_datagram(const ctsIOTask& _task, unsigned long _completed_bytes, long long _receiver_qpc) noexcept;
+
         _Requires_lock_held_(cs)
         std::vector<ctsConfig::JitterFrameEntry>::iterator find_sequence_number(long long _seq_number) noexcept;
 
@@ -678,10 +733,10 @@ namespace ctsTraffic {
 
         /// The "Renderer" processes frames at the specified frame rate
         static
-        VOID CALLBACK TimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER) noexcept;
+        void TimerCallback(_In_opt_ PVOID _context) noexcept;
         /// Callback to track when the server has actually started sending
         static
-        VOID CALLBACK StartCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER) noexcept;
+        void StartCallback(_In_opt_ PVOID _context) noexcept;
     };
 
 } //namespace
@@ -89,41 +89,21 @@ namespace ctsTraffic {
         }
 
         // after creating, refer to the timers under the lock
-        renderer_timer = ::CreateThreadpoolTimer(TimerCallback, this, nullptr);
-        if (!renderer_timer) {
-            throw ctException(::GetLastError(), L"CreateThreadpoolTimer", L"ctsIOPatternMediaStreamClient", false);
-        }
-        ctlScopeGuard(deleteTimerCallbackOnError,
-        {
-            ::SetThreadpoolTimer(renderer_timer, nullptr, 0, 0);
-            ::WaitForThreadpoolTimerCallbacks(renderer_timer, FALSE);
-            ::CloseThreadpoolTimer(renderer_timer);
-        });
-
-        start_timer = ::CreateThreadpoolTimer(StartCallback, this, nullptr);
-        if (!start_timer) {
-            throw ctException(::GetLastError(), L"CreateThreadpoolTimer", L"ctsIOPatternMediaStreamClient", false);
-        }
-        // no errors, dismiss the scope guard
-        deleteTimerCallbackOnError.dismiss();
+        renderer_timer = std::make_unique<ctsWheelTimer>(TimerCallback, this);
+        start_timer = std::make_unique<ctsWheelTimer>(StartCallback, this);
     }
     
     ctsIOPatternMediaStreamClient::~ctsIOPatternMediaStreamClient() noexcept
     {
+        // take the timers under the lock so the callbacks stop setting them
         this->base_lock();
-        // ReSharper disable once CppLocalVariableMayBeConst
-        PTP_TIMER original_timer = this->renderer_timer;
-        this->renderer_timer = nullptr;
+        std::unique_ptr<ctsWheelTimer> original_renderer_timer(std::move(this->renderer_timer));
+        std::unique_ptr<ctsWheelTimer> original_start_timer(std::move(this->start_timer));
         this->base_unlock();
 
         // stop both timers
-        ::SetThreadpoolTimer(this->start_timer, nullptr, 0, 0);
-        ::WaitForThreadpoolTimerCallbacks(this->start_timer, FALSE);
-        ::CloseThreadpoolTimer(this->start_timer);
-
-        ::SetThreadpoolTimer(original_timer, nullptr, 0, 0);
-        ::WaitForThreadpoolTimerCallbacks(original_timer, FALSE);
-        ::CloseThreadpoolTimer(original_timer);
+        original_start_timer.reset();
+        original_renderer_timer.reset();
     }
 
     ctsIOTask ctsIOPatternMediaStreamClient::next_task() noexcept
@@ -179,104 +159,134 @@ namespace ctsTraffic {
                 }
             }
 
-            if (!ctsMediaStreamMessage::ValidateBufferLengthFromTask(_task, _completed_bytes)) {
-                ctsConfig::PrintErrorInfo(L"MediaStreamClient received an invalid datagram trying to parse the protocol header");
-                return ctsIOPatternProtocolError::TooFewBytes;
-            }
+            // the stack can coalesce many datagrams into one recv buffer - process each datagram on its own
+            if (_task.coalesced_segment_size > 0 && _completed_bytes > _task.coalesced_segment_size) {
+                ctsIOTask datagram_task(_task);
+                unsigned long datagram_offset = 0;
+                while (datagram_offset < _completed_bytes) {
+                    unsigned long datagram_bytes = _completed_bytes - datagram_offset;
+                    if (datagram_bytes > _task.coalesced_segment_size) {
+                        datagram_bytes = _task.coalesced_segment_size;
+                    }
+                    // keep the task's own offset: the buffer can be the base of a registered slab
+                    datagram_task.buffer_offset = _task.buffer_offset + datagram_offset;
+                    datagram_task.buffer_length = datagram_bytes;
 
-            if (ctsMediaStreamMessage::GetProtocolHeaderFromTask(_task) == UdpDatagramProtocolHeaderFlagId) {
-                // save off the connection ID when we receive it
-                ctsMediaStreamMessage::SetConnectionIdFromTask(this->connection_id(), _task);
-                // since a recv completed, will need to request another
-                ++this->recv_needed;
-                return ctsIOPatternProtocolError::NoError;
+                    const auto datagram_status = this->completed_datagram(datagram_task, datagram_bytes, qpc.QuadPart);
+                    if (datagram_status != ctsIOPatternProtocolError::NoError) {
+                        return datagram_status;
+                    }
+                    datagram_offset += datagram_bytes;
+                }
+            } else {
+                const auto datagram_status = this->completed_datagram(_task, _completed_bytes, qpc.QuadPart);
+                if (datagram_status != ctsIOPatternProtocolError::NoError) {
+                    return datagram_status;
+                }
             }
 
-            // validate the buffer contents
-            ctsIOTask validation_task(_task);
-            validation_task.buffer_offset = UdpDatagramDataHeaderLength; // skip the UdpDatagramDataHeaderLength since we use them for our own stuff
-            validation_task.buffer_length -= UdpDatagramDataHeaderLength;
-            if (!this->verify_buffer(validation_task, _completed_bytes - UdpDatagramDataHeaderLength)) {
-                // exit early if the buffers don't match
-                return ctsIOPatternProtocolError::CorruptedBytes;
-            }
+            // since a recv completed successfully, will need to request another
+            ++this->recv_needed;
+        }
+        // else this is the completion of the SEND request
 
-            // track the # of *bits* received
-            ctsConfig::Settings->UdpStatusDetails.bits_received.add(_completed_bytes * 8);
-            this->stats.bits_received.add(_completed_bytes * 8);
+        return ctsIOPatternProtocolError::NoError;
+    }
 
-            const long long received_seq_number = ctsMediaStreamMessage::GetSequenceNumberFromTask(_task);
-            if (received_seq_number > this->final_frame) {
-                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
-                this->stats.error_frames.increment();
+    _Requires_lock_held_(cs)
+    ctsIOPatternProtocolError ctsIOPatternMediaStreamClient::completed_datagram(const ctsIOTask& _task, unsigned long _completed_bytes, long long _receiver_qpc) noexcept
+    {
+        if (!ctsMediaStreamMessage::ValidateBufferLengthFromTask(_task, _completed_bytes)) {
+            ctsConfig::PrintErrorInfo(L"MediaStreamClient received an invalid datagram trying to parse the protocol header");
+            return ctsIOPatternProtocolError::TooFewBytes;
+        }
 
-                PrintDebugInfo(
-                    L"\t\tctsIOPatternMediaStreamClient recevieved **an unknown** seq number (%lld) (outside the final frame %lu)\n",
-                    received_seq_number,
-                    this->final_frame);
-            } else {
-                //
-                // search our circular queue (starting at the head_entry)
-                // for the seq number we just received, and if found, tag as received
-                //
-                const auto found_slot = this->find_sequence_number(received_seq_number);
-                if (found_slot != this->frame_entries.end()) {
-                    if (found_slot->received != this->frame_size_bytes) {
-                        const long long buffered_qpc = *reinterpret_cast<long long*>(_task.buffer + 8);
-                        const long long buffered_qpf = *reinterpret_cast<long long*>(_task.buffer + 16);
-
-                        // always overwrite qpc & qpf values with the latest datagram details
-                        found_slot->sender_qpc = buffered_qpc;
-                        found_slot->sender_qpf = buffered_qpf;
-                        found_slot->receiver_qpc = qpc.QuadPart;
-                        found_slot->receiver_qpf = ctTimer::snap_qpf();
-                        found_slot->received += _completed_bytes;
-
-                        PrintDebugInfo(
-                            L"\t\tctsIOPatternMediaStreamClient received seq number %lld (%lu bytes)\n",
-                            static_cast<long long>(found_slot->sequence_number),
-                            static_cast<unsigned long>(found_slot->received));
-
-                        // stop the timer once we receive the last frame
-                        // - it's not perfect (e.g. might have received them out of order)
-                        // - but it will be very close for tracking the total bits/sec
-                        if (static_cast<unsigned long>(received_seq_number) == this->final_frame) {
-                            this->end_stats();
-                        }
-
-                    } else {
-                        ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
-                        this->stats.duplicate_frames.increment();
-
-                        PrintDebugInfo(
-                            L"\t\tctsIOPatternMediaStreamClient received **a duplicate frame** for seq number (%lld)\n",
-                            received_seq_number);
+        if (ctsMediaStreamMessage::GetProtocolHeaderFromTask(_task) == UdpDatagramProtocolHeaderFlagId) {
+            // save off the connection ID when we receive it
+            ctsMediaStreamMessage::SetConnectionIdFromTask(this->connection_id(), _task);
+            return ctsIOPatternProtocolError::NoError;
+        }
+
+        // validate the buffer contents
+        ctsIOTask validation_task(_task);
+        validation_task.buffer_offset = _task.buffer_offset + UdpDatagramDataHeaderLength; // skip the UdpDatagramDataHeaderLength since we use them for our own stuff
+        validation_task.buffer_length -= UdpDatagramDataHeaderLength;
+        if (!this->verify_buffer(validation_task, _completed_bytes - UdpDatagramDataHeaderLength)) {
+            // exit early if the buffers don't match
+            return ctsIOPatternProtocolError::CorruptedBytes;
+        }
+
+        // track the # of *bits* received
+        ctsConfig::Settings->UdpStatusDetails.bits_received.add(_completed_bytes * 8);
+        this->stats.bits_received.add(_completed_bytes * 8);
+
+        const long long received_seq_number = ctsMediaStreamMessage::GetSequenceNumberFromTask(_task);
+        if (received_seq_number > this->final_frame) {
+            ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+            this->stats.error_frames.increment();
+
+            PrintDebugInfo(
+                L"\t\tctsIOPatternMediaStreamClient recevieved **an unknown** seq number (%lld) (outside the final frame %lu)\n",
+                received_seq_number,
+                this->final_frame);
+        } else {
+            //
+            // search our circular queue (starting at the head_entry)
+            // for the seq number we just received, and if found, tag as received
+            //
+            const auto found_slot = this->find_sequence_number(received_seq_number);
+            if (found_slot != this->frame_entries.end()) {
+                if (found_slot->received != this->frame_size_bytes) {
+                    const long long buffered_qpc = *reinterpret_cast<long long*>(_task.buffer + _task.buffer_offset + 8);
+                    const long long buffered_qpf = *reinterpret_cast<long long*>(_task.buffer + _task.buffer_offset + 16);
+
+                    // always overwrite qpc & qpf values with the latest datagram details
+                    found_slot->sender_qpc = buffered_qpc;
+                    found_slot->sender_qpf = buffered_qpf;
+                    found_slot->receiver_qpc = _receiver_qpc;
+                    found_slot->receiver_qpf = ctTimer::snap_qpf();
+                    found_slot->received += _completed_bytes;
+
+                    PrintDebugInfo(
+                        L"\t\tctsIOPatternMediaStreamClient received seq number %lld (%lu bytes)\n",
+                        static_cast<long long>(found_slot->sequence_number),
+                        static_cast<unsigned long>(found_slot->received));
+
+                    // stop the timer once we receive the last frame
+                    // - it's not perfect (e.g. might have received them out of order)
+                    // - but it will be very close for tracking the total bits/sec
+                    if (static_cast<unsigned long>(received_seq_number) == this->final_frame) {
+                        this->end_stats();
                     }
 
                 } else {
-                    // didn't find a slot for the received seq. number
-                    ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
-                    this->stats.error_frames.increment();
-
-                    if (received_seq_number < this->head_entry->sequence_number) {
-                        PrintDebugInfo(
-                            L"\t\tctsIOPatternMediaStreamClient received **a stale** seq number (%lld) - current seq number (%lld)\n",
-                            received_seq_number,
-                            static_cast<long long>(this->head_entry->sequence_number));
-                    } else {
-                        PrintDebugInfo(
-                            L"\t\tctsIOPatternMediaStreamClient recevieved **a future** seq number (%lld) - head of queue (%lld) tail of queue (%lld)\n",
-                            received_seq_number,
-                            static_cast<long long>(this->head_entry->sequence_number),
-                            static_cast<long long>(this->head_entry->sequence_number + this->frame_entries.size() - 1));
-                    }
+                    ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                    this->stats.duplicate_frames.increment();
+
+                    PrintDebugInfo(
+                        L"\t\tctsIOPatternMediaStreamClient received **a duplicate frame** for seq number (%lld)\n",
+                        received_seq_number);
                 }
-            }
 
-            // since a recv completed successfully, will need to request another
-            ++this->recv_needed;
+            } else {
+                // didn't find a slot for the received seq. number
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                this->stats.error_frames.increment();
+
+                if (received_seq_number < this->head_entry->sequence_number) {
+                    PrintDebugInfo(
+                        L"\t\tctsIOPatternMediaStreamClient received **a stale** seq number (%lld) - current seq number (%lld)\n",
+                        received_seq_number,
+                        static_cast<long long>(this->head_entry->sequence_number));
+                } else {
+                    PrintDebugInfo(
+                        L"\t\tctsIOPatternMediaStreamClient recevieved **a future** seq number (%lld) - head of queue (%lld) tail of queue (%lld)\n",
+                        received_seq_number,
+                        static_cast<long long>(this->head_entry->sequence_number),
+                        static_cast<long long>(this->head_entry->sequence_number + this->frame_entries.size() - 1));
+                }
+            }
         }
-        // else this is the completion of the SEND request
 
         return ctsIOPatternProtocolError::NoError;
     }
@@ -345,11 +355,7 @@ namespace ctsTraffic {
             timer_offset -= ctTimer::snap_qpc_as_msec();
             // only set the timer if we have time to wait
             if (initial_timer || timer_offset > 2) {
-                // convert to filetime from milliseconds
-                // - make a 'relative' for SetThreadpoolTimer
-                FILETIME file_time(ctTimer::convert_msec_relative_filetime(timer_offset));
-                // TP Timer APIs work off of the UTC time
-                ::SetThreadpoolTimer(this->renderer_timer, &file_time, 0, 0);
+                this->renderer_timer->set(timer_offset);
                 timer_scheduled = true;
             }
         }
@@ -361,11 +367,7 @@ namespace ctsTraffic {
     void ctsIOPatternMediaStreamClient::set_next_start_timer() const noexcept
     {
         if (this->start_timer != nullptr) {
-            // convert to filetime from milliseconds
-            // - make a 'relative' for SetThreadpoolTimer
-            FILETIME file_time(ctTimer::convert_msec_relative_filetime(static_cast<long long>(frame_rate_ms_per_frame) + 500LL));
-            // TP Timer APIs work off of the UTC time
-            ::SetThreadpoolTimer(this->start_timer, &file_time, 0, 0);
+            this->start_timer->set(static_cast<long long>(frame_rate_ms_per_frame) + 500LL);
         }
     }
 
@@ -418,7 +420,7 @@ namespace ctsTraffic {
         }
     }
 
-    VOID CALLBACK ctsIOPatternMediaStreamClient::StartCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER) noexcept
+    void ctsIOPatternMediaStreamClient::StartCallback(_In_opt_ PVOID _context) noexcept
     {
         static const char StartBuffer[] = "START";
 
@@ -450,7 +452,7 @@ namespace ctsTraffic {
         // else, don't schedule this timer anymore
     }
 
-    VOID CALLBACK ctsIOPatternMediaStreamClient::TimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER) noexcept
+    void ctsIOPatternMediaStreamClient::TimerCallback(_In_opt_ PVOID _context) noexcept
     {
         auto* this_ptr = static_cast<ctsIOPatternMediaStreamClient*>(_context);
 
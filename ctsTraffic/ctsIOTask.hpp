@@ -39,8 +39,25 @@ namespace ctsTraffic {
         FatalAbort
     };
 
+    ///
+    /// One buffer of a scatter-gather ctsIOTask
+    ///
+    struct ctsIOTaskBufferSegment {
+        _Field_size_full_(length)
+        char* buffer = nullptr;
+        unsigned long length = 0UL;
+    };
+
     struct ctsIOTask {
+        // the most buffers a single scatter-gather IO request can be spread across
+        static const unsigned long MaxBufferSegments = 4UL;
+
         long long time_offset_milliseconds = 0LL;
+        // sends paced by the -RateLimitBurst token bucket are delayed in microseconds instead
+        // - run from the high-resolution ctsPacer rather than the socket's threadpool timer
+        long long time_offset_microseconds = 0LL;
+        // with registered IO, buffer is the address registered as rio_bufferid
+        // - buffer_offset is then the offset from that address to the unique buffer for this request
         RIO_BUFFERID rio_bufferid = RIO_INVALID_BUFFERID;
 
         _Field_size_full_(buffer_length)
@@ -49,6 +66,14 @@ namespace ctsTraffic {
         unsigned long buffer_offset = 0UL;
         unsigned long expected_pattern_offset = 0UL;
         IOTaskAction ioAction = IOTaskAction::None;
+        // scatter-gather IO: when buffer_segment_count is non-zero the IO is made across buffer_segments, in order
+        // - buffer + buffer_offset is then the first segment, and buffer_length is the total across all segments
+        // - zero when the task has the single buffer (buffer + buffer_offset, buffer_length)
+        ctsIOTaskBufferSegment buffer_segments[MaxBufferSegments];
+        unsigned long buffer_segment_count = 0UL;
+        // with UDP receive coalescing, the size of each datagram coalesced into buffer
+        // - zero when the completed buffer holds a single datagram
+        unsigned long coalesced_segment_size = 0UL;
 
         // (internal) flag identifying the type of buffer
         enum class BufferType
@@ -57,11 +82,31 @@ namespace ctsTraffic {
             TcpConnectionId,
             UdpConnectionId,
             Static,
-            Tracked
+            Tracked,
+            // sent directly from the -TransmitFile file: buffer_offset is the offset into the file
+            TransmitFile
         } buffer_type = BufferType::Null;
         // (internal) flag if this IO request is tracked and verified
         bool track_io = false;
 
+        ///
+        /// Fills the WSABUF array with every buffer of the task, returning the number of WSABUFs filled
+        ///
+        unsigned long fill_wsabufs(WSABUF (&_wsabufs)[MaxBufferSegments]) const noexcept
+        {
+            if (0 == this->buffer_segment_count) {
+                _wsabufs[0].buf = this->buffer + this->buffer_offset;
+                _wsabufs[0].len = this->buffer_length;
+                return 1;
+            }
+
+            for (unsigned long segment = 0; segment < this->buffer_segment_count; ++segment) {
+                _wsabufs[segment].buf = this->buffer_segments[segment].buffer;
+                _wsabufs[segment].len = this->buffer_segments[segment].length;
+            }
+            return this->buffer_segment_count;
+        }
+
         static LPCWSTR PrintIOAction(const IOTaskAction& _action) noexcept
         {
             switch (_action) {
@@ -0,0 +1,109 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <Windows.h>
+// ctl headers
+#include <ctHandle.hpp>
+
+namespace ctsTraffic {
+    namespace ctsLargePages {
+        ///
+        /// Tracks the memory allocated on large pages across the process
+        /// - each large page is mapped by a single TLB entry, where standard pages need one for each page
+        ///
+        struct ctsLargePageStatistics {
+            volatile LONGLONG large_page_bytes = 0LL;
+            volatile LONGLONG peak_large_page_bytes = 0LL;
+            // allocations which asked for large pages but had to fall back to standard pages
+            volatile LONGLONG fallback_count = 0LL;
+            volatile LONGLONG fallback_bytes = 0LL;
+        };
+
+        inline ctsLargePageStatistics& Statistics() noexcept
+        {
+            static ctsLargePageStatistics statistics;
+            return statistics;
+        }
+
+        ///
+        /// Enables SeLockMemoryPrivilege in the process token: large page allocations require it
+        /// - returns the large page size, or zero if large pages are unavailable
+        ///   (the processor has none, or the user was not granted 'Lock pages in memory')
+        ///
+        inline size_t Enable() noexcept
+        {
+            const size_t large_page_size = ::GetLargePageMinimum();
+            if (0 == large_page_size) {
+                return 0;
+            }
+
+            HANDLE raw_token;
+            if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &raw_token)) {
+                return 0;
+            }
+            const ctl::ctScopedHandle token(raw_token);
+
+            TOKEN_PRIVILEGES privileges{};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            if (!::LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+                return 0;
+            }
+            // succeeds without enabling a privilege the token doesn't hold: GetLastError() then returns ERROR_NOT_ALL_ASSIGNED
+            if (!::AdjustTokenPrivileges(token.get(), FALSE, &privileges, 0, nullptr, nullptr) ||
+                ::GetLastError() != ERROR_SUCCESS) {
+                return 0;
+            }
+            return large_page_size;
+        }
+
+        ///
+        /// Allocates and commits _length bytes on large pages: _length must be a multiple of the large page size
+        /// - returns nullptr if physical memory is too fragmented to find enough contiguous large pages:
+        ///   callers fall back to standard pages
+        /// - the pages are taken from _numa_node when given one
+        ///
+        inline char* Allocate(size_t _length, DWORD _numa_node = NUMA_NO_PREFERRED_NODE) noexcept
+        {
+            auto& statistics = Statistics();
+            char* buffer = (NUMA_NO_PREFERRED_NODE == _numa_node) ?
+                static_cast<char*>(::VirtualAlloc(nullptr, _length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)) :
+                static_cast<char*>(::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, _length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, _numa_node));
+            if (!buffer) {
+                ::InterlockedIncrement64(&statistics.fallback_count);
+                ::InterlockedAdd64(&statistics.fallback_bytes, static_cast<LONGLONG>(_length));
+                return nullptr;
+            }
+
+            const LONGLONG large_page_bytes = ::InterlockedAdd64(&statistics.large_page_bytes, static_cast<LONGLONG>(_length));
+            LONGLONG peak_bytes = ::InterlockedCompareExchange64(&statistics.peak_large_page_bytes, 0LL, 0LL);
+            while (peak_bytes < large_page_bytes) {
+                const LONGLONG prior = ::InterlockedCompareExchange64(&statistics.peak_large_page_bytes, large_page_bytes, peak_bytes);
+                if (prior == peak_bytes) {
+                    break;
+                }
+                peak_bytes = prior;
+            }
+            return buffer;
+        }
+
+        inline void Free(_In_ char* _buffer, size_t _length) noexcept
+        {
+            ::VirtualFree(_buffer, 0, MEM_RELEASE);
+            ::InterlockedAdd64(&Statistics().large_page_bytes, -static_cast<LONGLONG>(_length));
+        }
+    }
+}
@@ -16,6 +16,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // os headers
 #include <Windows.h>
 #include <WinSock2.h>
+#include <ws2ipdef.h>
 // ctl headers
 #include <ctSockaddr.hpp>
 #include <ctException.hpp>
@@ -37,6 +38,41 @@ namespace ctsTraffic {
         bool continue_io = false;
     };
 
+    ///
+    /// With -Options:udpoffload recvs are posted with WSARecvMsg so the stack can coalesce datagrams (URO)
+    /// - the WSAMSG and its control buffer must stay valid until the recv completes
+    ///
+    struct ctsMediaStreamCoalescedRecv
+    {
+        WSAMSG message{};
+        WSABUF data{};
+        char control[WSA_CMSG_SPACE(sizeof(DWORD))]{};
+
+        explicit ctsMediaStreamCoalescedRecv(const ctsIOTask& _task) noexcept
+        {
+            this->data.buf = _task.buffer + _task.buffer_offset;
+            this->data.len = _task.buffer_length;
+            this->message.lpBuffers = &this->data;
+            this->message.dwBufferCount = 1;
+            this->message.Control.buf = this->control;
+            this->message.Control.len = static_cast<ULONG>(sizeof(this->control));
+        }
+
+        // returns the task with the size of each datagram the stack coalesced into its buffer
+        ctsIOTask completed_task(const ctsIOTask& _task) noexcept
+        {
+            ctsIOTask return_task(_task);
+            for (WSACMSGHDR* control_message = WSA_CMSG_FIRSTHDR(&this->message);
+                 control_message != nullptr;
+                 control_message = WSA_CMSG_NXTHDR(&this->message, control_message)) {
+                if (IPPROTO_UDP == control_message->cmsg_level && UDP_COALESCED_INFO == control_message->cmsg_type) {
+                    return_task.coalesced_segment_size = *reinterpret_cast<DWORD*>(WSA_CMSG_DATA(control_message));
+                }
+            }
+            return return_task;
+        }
+    };
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// Internal implementation functions
@@ -153,6 +189,20 @@ namespace ctsTraffic {
                 shared_socket->complete_state(error);
                 return;
             }
+
+            if (ctsConfig::Settings->Options & ctsConfig::OptionType::UDP_SEGMENTATION_OFFLOAD) {
+                // allow the stack to coalesce up to a full recv buffer of datagrams
+                DWORD coalesced_size = ctsConfig::GetMediaStream().FrameSizeBytes;
+                if (coalesced_size > UdpDatagramMaximumSizeBytes) {
+                    coalesced_size = UdpDatagramMaximumSizeBytes;
+                }
+                if (SOCKET_ERROR == ::setsockopt(socket, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, reinterpret_cast<const char*>(&coalesced_size), static_cast<int>(sizeof(coalesced_size)))) {
+                    const auto gle = ::WSAGetLastError();
+                    ctsConfig::PrintErrorIfFailed(L"setsockopt(UDP_RECV_MAX_COALESCED_SIZE)", gle);
+                    shared_socket->complete_state(gle);
+                    return;
+                }
+            }
         }
 
         const ctl::ctSockaddr targetAddress(shared_socket->target_address());
@@ -220,9 +270,25 @@ namespace ctsTraffic {
 
                 LPCWSTR function_name = nullptr;
                 wsIOResult result;
+                std::shared_ptr<ctsMediaStreamCoalescedRecv> coalesced_recv;
                 if (IOTaskAction::Send == _next_io.ioAction) {
                     function_name = L"WSASendTo";
                     result = ctsWSASendTo(_shared_socket, _next_io, std::move(callback));
+                } else if (IOTaskAction::Recv == _next_io.ioAction && (ctsConfig::Settings->Options & ctsConfig::OptionType::UDP_SEGMENTATION_OFFLOAD)) {
+                    function_name = L"WSARecvMsg";
+                    try {
+                        coalesced_recv = std::make_shared<ctsMediaStreamCoalescedRecv>(_next_io);
+                        result = ctsWSARecvMsg(
+                            _shared_socket,
+                            &coalesced_recv->message,
+                            [weak_reference = std::weak_ptr<ctsSocket>(_shared_socket), _next_io, coalesced_recv] (OVERLAPPED* _ov) noexcept {
+                            ctsMediaStreamClientIoCompletionCallback(_ov, weak_reference, coalesced_recv->completed_task(_next_io));
+                        });
+                    }
+                    catch (const std::exception& e) {
+                        ctsConfig::PrintException(e);
+                        result = wsIOResult(WSAENOBUFS);
+                    }
                 } else if (IOTaskAction::Recv == _next_io.ioAction) {
                     function_name = L"WSARecvFrom";
                     result = ctsWSARecvFrom(_shared_socket, _next_io, std::move(callback));
@@ -245,7 +311,7 @@ namespace ctsTraffic {
                     // hold a reference on the iopattern
                     auto shared_pattern(_shared_socket->io_pattern());
                     const auto protocol_status = shared_pattern->complete_io(
-                        _next_io,
+                        (coalesced_recv && NO_ERROR == result.error_code) ? coalesced_recv->completed_task(_next_io) : _next_io,
                         result.bytes_transferred,
                         result.error_code);
 
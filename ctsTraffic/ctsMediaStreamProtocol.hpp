@@ -266,6 +266,126 @@ namespace ctsTraffic {
     };
 
 
+    // datagrams sent with segmentation offload are sized to fit within a typical 1500 byte MTU
+    static const unsigned long UdpDatagramOffloadSegmentSizeBytes = 1400UL;
+
+    ///
+    /// ctsMediaStreamSegmentedSendRequests splits a frame into datagrams for UDP segmentation offload (USO)
+    /// - each send request is a single buffer holding many datagrams which the stack splits on the wire at every segment_size() bytes
+    /// - datagrams are at most UdpDatagramOffloadSegmentSizeBytes, where ctsMediaStreamSendRequests sends up to UdpDatagramMaximumSizeBytes
+    /// - every datagram carries its own header, so a receiver without coalescing still parses each one on its own
+    /// - every datagram in a send request is segment_size() bytes except the last, which can be shorter
+    ///
+    class ctsMediaStreamSegmentedSendRequests
+    {
+    public:
+        // bounds each send request to no more than a non-offloaded datagram
+        static const unsigned long MaximumSegmentsPerSend = UdpDatagramMaximumSizeBytes / UdpDatagramOffloadSegmentSizeBytes;
+
+        ~ctsMediaStreamSegmentedSendRequests() = default;
+        ctsMediaStreamSegmentedSendRequests() = delete;
+        ctsMediaStreamSegmentedSendRequests(const ctsMediaStreamSegmentedSendRequests&) = delete;
+        ctsMediaStreamSegmentedSendRequests& operator=(const ctsMediaStreamSegmentedSendRequests&) = delete;
+        ctsMediaStreamSegmentedSendRequests(ctsMediaStreamSegmentedSendRequests&&) = delete;
+        ctsMediaStreamSegmentedSendRequests& operator=(ctsMediaStreamSegmentedSendRequests&&) = delete;
+
+        ctsMediaStreamSegmentedSendRequests(long long _bytes_to_send, long long _sequence_number, const char* _send_buffer) noexcept
+        : qpf(ctl::ctTimer::snap_qpf()),
+          bytes_to_send(_bytes_to_send),
+          sequence_number(_sequence_number),
+          send_buffer(const_cast<char*>(_send_buffer))
+        {
+            ctl::ctFatalCondition(
+                _bytes_to_send <= UdpDatagramDataHeaderLength,
+                L"ctsMediaStreamSegmentedSendRequests requires a buffer size to send larger than the ctsTraffic UDP header");
+        }
+
+        ///
+        /// Composes the next send request into buffers()
+        /// - returns false once every byte of the frame has been composed
+        ///
+        bool next() noexcept
+        {
+            if (0 == this->bytes_to_send) {
+                return false;
+            }
+
+            long long send_length = MaximumSegmentsPerSend * UdpDatagramOffloadSegmentSizeBytes;
+            if (send_length > this->bytes_to_send) {
+                send_length = this->bytes_to_send;
+            }
+            // must guarantee that after this send we have enough bytes for the next datagram if there are bytes left over
+            const long long bytes_remaining = this->bytes_to_send - send_length;
+            if (bytes_remaining > 0 && bytes_remaining <= UdpDatagramDataHeaderLength) {
+                send_length -= UdpDatagramDataHeaderLength + 1 - bytes_remaining;
+            }
+
+            // spread the bytes evenly across the datagrams so the final datagram always has room for the header
+            this->segments = static_cast<unsigned long>((send_length + UdpDatagramOffloadSegmentSizeBytes - 1) / UdpDatagramOffloadSegmentSizeBytes);
+            this->segment_bytes = static_cast<unsigned long>((send_length + this->segments - 1) / this->segments);
+
+            unsigned long bytes_composed = 0;
+            for (unsigned long segment = 0; segment < this->segments; ++segment) {
+                unsigned long datagram_length = this->segment_bytes;
+                if (segment + 1 == this->segments) {
+                    datagram_length = static_cast<unsigned long>(send_length) - bytes_composed;
+                }
+                bytes_composed += datagram_length;
+
+                // buffer layout: header#, seq. number, qpc, qpf, then the buffered data
+                WSABUF* datagram = &this->wsabufs[segment * ctsMediaStreamSendRequests::BufferArraySize];
+                datagram[0].buf = reinterpret_cast<char*>(const_cast<unsigned short*>(&UdpDatagramProtocolHeaderFlagData));
+                datagram[0].len = UdpDatagramProtocolHeaderFlagLength;
+                datagram[1].buf = reinterpret_cast<char*>(&this->sequence_number);
+                datagram[1].len = UdpDatagramSequenceNumberLength;
+                datagram[2].buf = reinterpret_cast<char*>(&this->qpc_value.QuadPart);
+                datagram[2].len = UdpDatagramQPCLength;
+                datagram[3].buf = reinterpret_cast<char*>(&this->qpf);
+                datagram[3].len = UdpDatagramQPFLength;
+                datagram[4].buf = this->send_buffer;
+                datagram[4].len = datagram_length - UdpDatagramDataHeaderLength;
+            }
+            this->bytes_to_send -= send_length;
+
+            // refresh the QPC value at the last possible moment before returning the buffers to the user
+            ::QueryPerformanceCounter(&this->qpc_value);
+            return true;
+        }
+
+        // returning non-const buffers as Winsock APIs don't take const WSABUF*
+        WSABUF* buffers() noexcept
+        {
+            return this->wsabufs.data();
+        }
+
+        unsigned long buffer_count() const noexcept
+        {
+            return this->segments * ctsMediaStreamSendRequests::BufferArraySize;
+        }
+
+        // the size of each datagram the stack will segment the send request into
+        unsigned long segment_size() const noexcept
+        {
+            return this->segment_bytes;
+        }
+
+        unsigned long segment_count() const noexcept
+        {
+            return this->segments;
+        }
+
+    private:
+        std::array<WSABUF, MaximumSegmentsPerSend * ctsMediaStreamSendRequests::BufferArraySize> wsabufs{};
+        LARGE_INTEGER qpc_value{};
+        long long qpf;
+        long long bytes_to_send;
+        long long sequence_number;
+        char* send_buffer;
+        unsigned long segments = 0;
+        unsigned long segment_bytes = 0;
+    };
+
+
     struct ctsMediaStreamMessage
     {
         long long sequence_number;
@@ -323,7 +443,7 @@ namespace ctsTraffic {
 
         static unsigned short GetProtocolHeaderFromTask(const ctsIOTask& _task) noexcept
         {
-            return *reinterpret_cast<unsigned short*>(_task.buffer);
+            return *reinterpret_cast<unsigned short*>(_task.buffer + _task.buffer_offset);
         }
 
         static void SetConnectionIdFromTask(_Inout_updates_(ctsStatistics::ConnectionIdLength) char* _connection_id, const ctsIOTask& _task) noexcept
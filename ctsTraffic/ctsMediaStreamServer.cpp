@@ -14,11 +14,14 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // cpp headers
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include <algorithm>
 // os headers
 #include <Windows.h>
 #include <WinSock2.h>
+#include <ws2ipdef.h>
 // ctl headers
+#include <ctSocketExtensions.hpp>
 #include <ctLocks.hpp>
 #include <ctException.hpp>
 #include <ctScopeGuard.hpp>
@@ -33,6 +36,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsMediaStreamServerConnectedSocket.h"
 #include "ctsMediaStreamServerListeningSocket.h"
 #include "ctsMediaStreamProtocol.hpp"
+#include "ctsSockaddrTable.hpp"
 
 
 namespace ctsTraffic {
@@ -101,7 +105,7 @@ namespace ctsTraffic {
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Called to remove that socket from the tracked vector of connected sockets
+    /// Called to remove that socket from the tracked table of connected sockets
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     void ctsMediaStreamServerClose(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
@@ -111,7 +115,7 @@ namespace ctsTraffic {
 
             const auto shared_socket(_weak_socket.lock());
             if (shared_socket) {
-                ctsMediaStreamServerImpl::remove_socket(shared_socket->local_address());
+                ctsMediaStreamServerImpl::remove_socket(shared_socket->target_address());
             }
         }
         catch (const std::exception&) {
@@ -121,13 +125,18 @@ namespace ctsTraffic {
 
     namespace ctsMediaStreamServerImpl {
         std::vector<std::unique_ptr<ctsMediaStreamServerListeningSocket>> listening_sockets;
+        // the batch sender of each listening socket, keyed by the SOCKET its connected sockets send from
+        // - only written while initializing, so looking up the sender for each frame takes no lock
+        std::unordered_map<SOCKET, ctsMediaStreamServerBatchSender*> batch_senders;
         
         // function for doing the actual IO for a UDP media stream datagram connection
         wsIOResult ConnectedSocketIo(_In_ ctsMediaStreamServerConnectedSocket* this_ptr);
+        // sends a frame with UDP segmentation offload
+        wsIOResult SegmentedSocketIo(SOCKET socket, const ctl::ctSockaddr& remote_addr, const ctsIOTask& next_task, long long seq_number) noexcept;
 
-        CRITICAL_SECTION connected_object_guard;
-        _Guarded_by_(connected_object_guard)
-            std::vector<std::shared_ptr<ctsMediaStreamServerConnectedSocket>> connected_sockets;
+        // connected sockets indexed by their remote address
+        // - looked up for every frame scheduled, so lookups only take a shared lock on part of the table
+        ctsSockaddrTable<ctsMediaStreamServerConnectedSocket> connected_sockets;
 
         CRITICAL_SECTION awaiting_object_guard;
         // weak_ptr<> to ctsSocket objects ready to accept a connection
@@ -149,13 +158,6 @@ namespace ctsTraffic {
         static BOOL CALLBACK InitOnceImpl(PINIT_ONCE, PVOID, PVOID *)
         {
             try {
-                if (!::InitializeCriticalSectionEx(&ctsMediaStreamServerImpl::connected_object_guard, 4000, 0)) {
-                    throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
-                }
-                ctlScopeGuard(
-                    deleteConnectedObjectguardOnError,
-                    {::DeleteCriticalSection(&ctsMediaStreamServerImpl::connected_object_guard);});
-
                 if (!::InitializeCriticalSectionEx(&ctsMediaStreamServerImpl::awaiting_object_guard, 4000, 0)) {
                     throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
                 }
@@ -163,15 +165,29 @@ namespace ctsTraffic {
                     deleteAwaitingObjectguardOnError,
                     {::DeleteCriticalSection(&ctsMediaStreamServerImpl::awaiting_object_guard);});
 
+                // batched sends are posted through RIO on the listening sockets
+                DWORD listening_socket_flags = ctsConfig::Settings->SocketFlags;
+                if (ctsConfig::Settings->Options & ctsConfig::OptionType::BATCH_DATAGRAM_SEND) {
+                    listening_socket_flags |= WSA_FLAG_REGISTERED_IO;
+                }
+
                 // 'listen' to each address
                 for (const auto& addr : ctsConfig::Settings->ListenAddresses) {
-                    ctl::ctScopedSocket listening(ctsConfig::CreateSocket(addr.family(), SOCK_DGRAM, IPPROTO_UDP, ctsConfig::Settings->SocketFlags));
+                    ctl::ctScopedSocket listening(ctsConfig::CreateSocket(addr.family(), SOCK_DGRAM, IPPROTO_UDP, listening_socket_flags));
 
                     const auto error = ctsConfig::SetPreBindOptions(listening.get(), addr);
                     if (error != NO_ERROR) {
                         throw ctl::ctException(error, L"SetPreBindOptions", L"ctsMediaStreamServer", false);
                     }
 
+                    if (ctsConfig::Settings->Options & ctsConfig::OptionType::UDP_SEGMENTATION_OFFLOAD) {
+                        // the segment size is given with each WSASendMsg - this fails early if USO is not supported
+                        DWORD segment_size = 0;
+                        if (SOCKET_ERROR == ::setsockopt(listening.get(), IPPROTO_UDP, UDP_SEND_MSG_SIZE, reinterpret_cast<const char*>(&segment_size), static_cast<int>(sizeof(segment_size)))) {
+                            throw ctl::ctException(::WSAGetLastError(), L"setsockopt(UDP_SEND_MSG_SIZE)", L"ctsMediaStreamServer", false);
+                        }
+                    }
+
                     if (SOCKET_ERROR == ::bind(listening.get(), addr.sockaddr(), addr.length())) {
                         throw ctl::ctException(::WSAGetLastError(), L"bind", L"ctsMediaStreamServer", false);
                     }
@@ -191,13 +207,18 @@ namespace ctsTraffic {
                     throw std::exception("ctsMediaStreamServer invoked with no listening addresses specified");
                 }
 
+                for (const auto& listener : ctsMediaStreamServerImpl::listening_sockets) {
+                    if (listener->get_batch_sender()) {
+                        ctsMediaStreamServerImpl::batch_senders.emplace(listener->get_socket(), listener->get_batch_sender());
+                    }
+                }
+
                 // initiate the recv's in the 'listening' sockets
                 for (auto& listener : ctsMediaStreamServerImpl::listening_sockets) {
                     listener->initiate_recv();
                 }
 
                 // dismiss scope guards as there were no errors
-                deleteConnectedObjectguardOnError.dismiss();
                 deleteAwaitingObjectguardOnError.dismiss();
             }
             catch (const std::exception& e) {
@@ -226,32 +247,17 @@ namespace ctsTraffic {
                 throw ctl::ctException(WSAECONNABORTED, L"ctsSocket already freed", L"ctsMediaStreamServer", false);
             }
 
-            std::shared_ptr<ctsMediaStreamServerConnectedSocket> shared_connected_socket;
-            {
-                // must guard connected_sockets since we need to add it
-                const ctl::ctAutoReleaseCriticalSection lock_connected_object(&ctsMediaStreamServerImpl::connected_object_guard);
-
-                // find the matching connected_socket
-                const auto found_socket = std::find_if(
-                    std::begin(ctsMediaStreamServerImpl::connected_sockets),
-                    std::end(ctsMediaStreamServerImpl::connected_sockets),
-                    [&shared_socket] (const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                        return (shared_socket->target_address() == _connected_socket->get_address());
-                    }
-                );
-
-                if (found_socket == std::end(ctsMediaStreamServerImpl::connected_sockets)) {
-                    PrintDebugInfo(
-                        L"\t\tctsMediaStreamServer - failed to find the socket with remote address %ws in our connected socket list\n",
-                        shared_socket->target_address().writeCompleteAddress().c_str());
-                    throw ctl::ctException(ERROR_INVALID_DATA, L"ctsSocket was not found in the Connected Sockets", L"ctsMediaStreamServer", false);
-                }
-
-                shared_connected_socket = *found_socket;
+            // find the matching connected_socket
+            const auto shared_connected_socket(ctsMediaStreamServerImpl::connected_sockets.find(shared_socket->target_address()));
+            if (!shared_connected_socket) {
+                PrintDebugInfo(
+                    L"\t\tctsMediaStreamServer - failed to find the socket with remote address %ws in our connected socket list\n",
+                    shared_socket->target_address().writeCompleteAddress().c_str());
+                throw ctl::ctException(ERROR_INVALID_DATA, L"ctsSocket was not found in the Connected Sockets", L"ctsMediaStreamServer", false);
             }
-            // must call into connected socket without holding a lock
-            // and without maintaining an iterator into the list
-            // since the call to schedule_io could end up asking to remove this object from the list
+
+            // must call into connected socket without holding the table's lock
+            // since the call to schedule_io could end up asking to remove this object from the table
             shared_connected_socket->schedule_task(_task);
         }
 
@@ -268,23 +274,23 @@ namespace ctsTraffic {
             if (shared_socket) {
                 const ctl::ctAutoReleaseCriticalSection lock_awaiting_object(&ctsMediaStreamServerImpl::awaiting_object_guard);
 
-                if (ctsMediaStreamServerImpl::awaiting_endpoints.empty()) {
-                    // just add it to our accepting sockets vector under the writer lock
-                    ctsMediaStreamServerImpl::accepting_sockets.push_back(_weak_socket);
-
-                } else {
+                bool accepted_endpoint = false;
+                while (!ctsMediaStreamServerImpl::awaiting_endpoints.empty()) {
                     auto waiting_endpoint = ctsMediaStreamServerImpl::awaiting_endpoints.rbegin();
 
-                    // must guard connected_sockets since we need to add it to the vector
-                    // - scope to the lock
-                    {
-                        const ctl::ctAutoReleaseCriticalSection lock_connected_object(&ctsMediaStreamServerImpl::connected_object_guard);
-                        ctsMediaStreamServerImpl::connected_sockets.emplace_back(
-                            std::make_shared<ctsMediaStreamServerConnectedSocket>(
+                    if (!ctsMediaStreamServerImpl::connected_sockets.insert(
+                        waiting_endpoint->second,
+                        std::make_shared<ctsMediaStreamServerConnectedSocket>(
                             _weak_socket, 
                             waiting_endpoint->first, 
                             waiting_endpoint->second,
-                            ctsMediaStreamServerImpl::ConnectedSocketIo));
+                            ctsMediaStreamServerImpl::ConnectedSocketIo))) {
+                        // a repeated START queued this endpoint again after it was already established
+                        PrintDebugInfo(
+                            L"\t\tctsMediaStreamServer - dropping queued endpoint with remote address %ws as it was already established\n",
+                            waiting_endpoint->second.writeCompleteAddress().c_str());
+                        ctsMediaStreamServerImpl::awaiting_endpoints.pop_back();
+                        continue;
                     }
 
                     // now complete the ctsSocket 'Create' request
@@ -308,6 +314,13 @@ namespace ctsTraffic {
                     // if added to connected_sockets, can then safely remove it from the waiting endpoint
                     // - no longer touching the iterator waiting_endpoint
                     ctsMediaStreamServerImpl::awaiting_endpoints.pop_back();
+                    accepted_endpoint = true;
+                    break;
+                }
+
+                if (!accepted_endpoint) {
+                    // just add it to our accepting sockets vector under the writer lock
+                    ctsMediaStreamServerImpl::accepting_sockets.push_back(_weak_socket);
                 }
             }
         }
@@ -320,18 +333,8 @@ namespace ctsTraffic {
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         void remove_socket(const ctl::ctSockaddr& _target_addr)
         {
-            const ctl::ctAutoReleaseCriticalSection lock_connected_object(&ctsMediaStreamServerImpl::connected_object_guard);
-
-            const auto found_socket = std::find_if(
-                std::begin(ctsMediaStreamServerImpl::connected_sockets),
-                std::end(ctsMediaStreamServerImpl::connected_sockets),
-                [&_target_addr] (const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                return _target_addr == _connected_socket->get_address();
-            });
-
-            if (found_socket != std::end(ctsMediaStreamServerImpl::connected_sockets)) {
-                ctsMediaStreamServerImpl::connected_sockets.erase(found_socket);
-            }
+            // the connected socket is deleted as the returned reference goes out of scope, after the table is unlocked
+            ctsMediaStreamServerImpl::connected_sockets.erase(_target_addr);
         }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -344,25 +347,13 @@ namespace ctsTraffic {
         void start(const ctl::ctScopedSocket& _socket, const ctl::ctSockaddr& _local_addr, const ctl::ctSockaddr& _target_addr)
         {
             // before starting a socket, verify there is not already a connected socket with this same socket address
-            // scope the lock
-            {
-                const ctl::ctAutoReleaseCriticalSection lock_connected_object(&ctsMediaStreamServerImpl::connected_object_guard);
-
-                const auto found_socket = std::find_if(
-                    std::begin(ctsMediaStreamServerImpl::connected_sockets),
-                    std::end(ctsMediaStreamServerImpl::connected_sockets),
-                    [&_target_addr] (const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                    return _target_addr == _connected_socket->get_address();
-                });
-
-                if (found_socket != std::end(ctsMediaStreamServerImpl::connected_sockets)) {
-                    PrintDebugInfo(
-                        L"\t\tctsMediaStreamServer - socket with remote address %ws asked to be Started but was already established\n",
-                        _target_addr.writeCompleteAddress().c_str());
-                    // return early if this was a duplicate request: this can happen if there is latency or drops
-                    // between the client and server as they attempt to negotiating starting a new stream
-                    return;
-                }
+            if (ctsMediaStreamServerImpl::connected_sockets.find(_target_addr)) {
+                PrintDebugInfo(
+                    L"\t\tctsMediaStreamServer - socket with remote address %ws asked to be Started but was already established\n",
+                    _target_addr.writeCompleteAddress().c_str());
+                // return early if this was a duplicate request: this can happen if there is latency or drops
+                // between the client and server as they attempt to negotiating starting a new stream
+                return;
             }
 
             // find a ctsSocket waiting to 'accept' a connection and complete it
@@ -375,15 +366,15 @@ namespace ctsTraffic {
                 auto shared_instance = weak_instance.lock();
                 if (shared_instance) {
                     // 'move' the accepting socket to connected
-                    // - scope the lock
-                    {
-                        const ctl::ctAutoReleaseCriticalSection lock_connected_object(&ctsMediaStreamServerImpl::connected_object_guard);
-                        ctsMediaStreamServerImpl::connected_sockets.emplace_back(
-                            std::make_shared<ctsMediaStreamServerConnectedSocket>(
+                    if (!ctsMediaStreamServerImpl::connected_sockets.insert(
+                        _target_addr,
+                        std::make_shared<ctsMediaStreamServerConnectedSocket>(
                             weak_instance,
                             _socket.get(),
                             _target_addr,
-                            ctsMediaStreamServerImpl::ConnectedSocketIo));
+                            ctsMediaStreamServerImpl::ConnectedSocketIo))) {
+                        // a duplicate START was established between the check above and taking awaiting_object_guard
+                        return;
                     }
 
                     // verify is successfully added to connected_sockets before popping off accepting_sockets
@@ -460,11 +451,35 @@ namespace ctsTraffic {
                     seq_number,
                     next_task.buffer_length);
 
+                if (ctsConfig::Settings->Options & ctsConfig::OptionType::UDP_SEGMENTATION_OFFLOAD) {
+                    return SegmentedSocketIo(socket, remote_addr, next_task, seq_number);
+                }
+
                 ctsMediaStreamSendRequests sending_requests(
                     next_task.buffer_length, // total bytes to send
                     seq_number,
                     next_task.buffer);
 
+                // the connected socket shares the SOCKET of the listener which received its START
+                const auto batch_sender = ctsMediaStreamServerImpl::batch_senders.find(socket);
+                if (batch_sender != ctsMediaStreamServerImpl::batch_senders.end()) {
+                    return_results = batch_sender->second->send(sending_requests, remote_addr);
+                    if (return_results.error_code != 0) {
+                        try {
+                            ctsConfig::PrintErrorInfo(
+                                L"ctsMediaStreamServerBatchSender::send(%Iu, seq %lld, %ws) failed [%d]",
+                                socket,
+                                seq_number,
+                                remote_addr.writeCompleteAddress().c_str(),
+                                return_results.error_code);
+                        }
+                        catch (const std::exception&) {
+                            // best effort
+                        }
+                    }
+                    return return_results;
+                }
+
                 for (auto& send_request : sending_requests) {
                     // making a synchronous call
                     DWORD bytes_sent;
@@ -510,11 +525,69 @@ namespace ctsTraffic {
                     }
                     
                     // successfully completed synchronously
+                    ctsConfig::Settings->UdpStatusDetails.datagram_send_calls.increment();
+                    ctsConfig::Settings->UdpStatusDetails.datagrams_sent.increment();
                     return_results.bytes_transferred += bytes_sent;
                 }
             }
 
             return return_results;
         }
+
+        wsIOResult SegmentedSocketIo(SOCKET socket, const ctl::ctSockaddr& remote_addr, const ctsIOTask& next_task, long long seq_number) noexcept
+        {
+            ctsMediaStreamSegmentedSendRequests sending_requests(
+                next_task.buffer_length, // total bytes to send
+                seq_number,
+                next_task.buffer);
+
+            char control_buffer[WSA_CMSG_SPACE(sizeof(DWORD))]{};
+            wsIOResult return_results;
+            while (sending_requests.next()) {
+                WSAMSG send_message{};
+                send_message.name = remote_addr.sockaddr();
+                send_message.namelen = remote_addr.length();
+                send_message.lpBuffers = sending_requests.buffers();
+                send_message.dwBufferCount = sending_requests.buffer_count();
+                // a single datagram is sent as-is - only ask the stack to segment larger sends
+                if (sending_requests.segment_count() > 1) {
+                    WSACMSGHDR* control_message = reinterpret_cast<WSACMSGHDR*>(control_buffer);
+                    control_message->cmsg_level = IPPROTO_UDP;
+                    control_message->cmsg_type = UDP_SEND_MSG_SIZE;
+                    control_message->cmsg_len = WSA_CMSG_LEN(sizeof(DWORD));
+                    *reinterpret_cast<DWORD*>(WSA_CMSG_DATA(control_message)) = sending_requests.segment_size();
+
+                    send_message.Control.buf = control_buffer;
+                    send_message.Control.len = static_cast<ULONG>(sizeof(control_buffer));
+                }
+
+                // making a synchronous call
+                DWORD bytes_sent;
+                if (SOCKET_ERROR == ctl::ctWSASendMsg(socket, &send_message, 0, &bytes_sent, nullptr, nullptr)) {
+                    const auto error = ::WSAGetLastError();
+                    try {
+                        ctsConfig::PrintErrorInfo(
+                            L"WSASendMsg(%Iu, seq %lld, %ws) failed sending %lu datagrams of %lu bytes [%d]",
+                            socket,
+                            seq_number,
+                            remote_addr.writeCompleteAddress().c_str(),
+                            sending_requests.segment_count(),
+                            sending_requests.segment_size(),
+                            error);
+                    }
+                    catch (const std::exception&) {
+                        // best effort
+                    }
+                    return wsIOResult(error);
+                }
+
+                // successfully completed synchronously
+                ctsConfig::Settings->UdpStatusDetails.datagram_send_calls.increment();
+                ctsConfig::Settings->UdpStatusDetails.datagrams_sent.add(sending_requests.segment_count());
+                return_results.bytes_transferred += bytes_sent;
+            }
+
+            return return_results;
+        }
     }
 }
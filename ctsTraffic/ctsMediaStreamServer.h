@@ -88,7 +88,7 @@ namespace ctsTraffic {
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Called to remove that socket from the tracked vector of connected sockets
+    /// Called to remove that socket from the tracked table of connected sockets
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     void ctsMediaStreamServerClose(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
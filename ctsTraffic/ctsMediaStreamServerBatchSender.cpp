@@ -0,0 +1,315 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// cpp headers
+#include <vector>
+// os headers
+#include <Windows.h>
+#include <WinSock2.h>
+#include <mswsock.h>
+// ctl headers
+#include <ctSocketExtensions.hpp>
+#include <ctSockaddr.hpp>
+#include <ctScopeGuard.hpp>
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+// project headers
+#include "ctsMediaStreamServerBatchSender.h"
+#include "ctsMediaStreamProtocol.hpp"
+#include "ctsConfig.h"
+
+
+namespace ctsTraffic {
+
+    ctsMediaStreamServerBatchSender::ctsMediaStreamServerBatchSender(SOCKET _socket) :
+        socket(_socket)
+    {
+        if (!::InitializeCriticalSectionEx(&this->object_guard, 4000, 0)) {
+            throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServerBatchSender", false);
+        }
+        ctlScopeGuard(deleteCsOnError, { ::DeleteCriticalSection(&this->object_guard); });
+
+        // a datagram is never larger than a frame and its header
+        const unsigned long long frame_datagram_length =
+            static_cast<unsigned long long>(ctsConfig::GetMediaStream().FrameSizeBytes) + UdpDatagramDataHeaderLength;
+        const unsigned long datagram_length = (frame_datagram_length < UdpDatagramMaximumSizeBytes) ?
+            static_cast<unsigned long>(frame_datagram_length) :
+            UdpDatagramMaximumSizeBytes;
+        // keep the address at the start of each slot aligned
+        this->slot_length = (StagingAddressLength + datagram_length + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~static_cast<unsigned long>(MEMORY_ALLOCATION_ALIGNMENT - 1);
+        this->slot_count = MaxStagingBufferBytes / this->slot_length;
+        if (this->slot_count > MaxOutstandingDatagrams) {
+            this->slot_count = MaxOutstandingDatagrams;
+        }
+
+        // taken from the back: hand out the slots from the start of the buffer first
+        this->free_slots.reserve(this->slot_count);
+        for (unsigned long slot = this->slot_count; slot > 0; --slot) {
+            this->free_slots.push_back(slot - 1);
+        }
+        this->rio_results.resize(this->slot_count);
+
+        const DWORD staging_size = this->slot_count * this->slot_length;
+        this->staging_buffer = static_cast<char*>(::VirtualAlloc(nullptr, staging_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        if (nullptr == this->staging_buffer) {
+            throw ctl::ctException(::GetLastError(), L"VirtualAlloc", L"ctsMediaStreamServerBatchSender", false);
+        }
+        ctlScopeGuard(freeStagingBufferOnError, { ::VirtualFree(this->staging_buffer, 0, MEM_RELEASE); });
+
+        this->staging_buffer_id = ctl::ctRIORegisterBuffer(this->staging_buffer, staging_size);
+        if (RIO_INVALID_BUFFERID == this->staging_buffer_id) {
+            throw ctl::ctException(::WSAGetLastError(), L"RIORegisterBuffer", L"ctsMediaStreamServerBatchSender", false);
+        }
+        ctlScopeGuard(deregisterStagingBufferOnError, { ctl::ctRIODeregisterBuffer(this->staging_buffer_id); });
+
+        // the CQ is polled whenever slots are needed and after each commit - no notification mechanism is needed
+        this->rio_cq = ctl::ctRIOCreateCompletionQueue(this->slot_count, nullptr);
+        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+        if (RIO_INVALID_CQ == this->rio_cq) {
+            throw ctl::ctException(::WSAGetLastError(), L"RIOCreateCompletionQueue", L"ctsMediaStreamServerBatchSender", false);
+        }
+        ctlScopeGuard(closeCqOnError, { ctl::ctRIOCloseCompletionQueue(this->rio_cq); });
+
+        // receives are never posted through the RQ: they continue through WSARecvFrom
+        // don't need a scope guard to close the RQ on error - the RQ is freed when the socket is closed
+        this->rio_rq = ctl::ctRIOCreateRequestQueue(
+            _socket,
+            1, 1,
+            this->slot_count, 1,
+            this->rio_cq,
+            this->rio_cq,
+            this);
+        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+        if (RIO_INVALID_RQ == this->rio_rq) {
+            throw ctl::ctException(::WSAGetLastError(), L"RIOCreateRequestQueue", L"ctsMediaStreamServerBatchSender", false);
+        }
+
+        this->commit_work = ::CreateThreadpoolWork(CommitCallback, this, ctsConfig::Settings->PTPEnvironment);
+        if (nullptr == this->commit_work) {
+            throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsMediaStreamServerBatchSender", false);
+        }
+
+        // no failures
+        closeCqOnError.dismiss();
+        deregisterStagingBufferOnError.dismiss();
+        freeStagingBufferOnError.dismiss();
+        deleteCsOnError.dismiss();
+    }
+
+    ///
+    /// The RQ is freed when the SOCKET is closed
+    /// - the owner must close the SOCKET before deleting this object
+    ///
+    ctsMediaStreamServerBatchSender::~ctsMediaStreamServerBatchSender() noexcept
+    {
+        if (this->commit_work != nullptr) {
+            ::WaitForThreadpoolWorkCallbacks(this->commit_work, FALSE);
+            ::CloseThreadpoolWork(this->commit_work);
+        }
+        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+        if (this->rio_cq != RIO_INVALID_CQ) {
+            ctl::ctRIOCloseCompletionQueue(this->rio_cq);
+        }
+        if (this->staging_buffer_id != RIO_INVALID_BUFFERID) {
+            ctl::ctRIODeregisterBuffer(this->staging_buffer_id);
+        }
+        if (this->staging_buffer != nullptr) {
+            ::VirtualFree(this->staging_buffer, 0, MEM_RELEASE);
+        }
+        ::DeleteCriticalSection(&this->object_guard);
+    }
+
+    wsIOResult ctsMediaStreamServerBatchSender::send(ctsMediaStreamSendRequests& _requests, const ctl::ctSockaddr& _remote_addr) noexcept
+    {
+        wsIOResult return_results;
+        for (auto& send_request : _requests) {
+            const unsigned long slot = this->take_slot();
+            if (NoSlot == slot) {
+                // every slot is in flight: send this datagram now rather than wait for a send to complete
+                DWORD bytes_sent;
+                const auto send_result = ::WSASendTo(
+                    this->socket,
+                    send_request.data(),
+                    static_cast<DWORD>(send_request.size()),
+                    &bytes_sent,
+                    0,
+                    _remote_addr.sockaddr(),
+                    _remote_addr.length(),
+                    nullptr,
+                    nullptr);
+                if (SOCKET_ERROR == send_result) {
+                    return_results = wsIOResult(::WSAGetLastError());
+                    break;
+                }
+                ctsConfig::Settings->UdpStatusDetails.datagram_send_calls.increment();
+                ctsConfig::Settings->UdpStatusDetails.datagrams_sent.increment();
+                return_results.bytes_transferred += bytes_sent;
+                continue;
+            }
+
+            // the slot belongs to this thread until it's queued: copy the datagram without holding the lock
+            const unsigned long slot_offset = slot * this->slot_length;
+            ::memcpy_s(this->staging_buffer + slot_offset, StagingAddressLength, _remote_addr.sockaddr_inet(), sizeof(SOCKADDR_INET));
+            unsigned long datagram_length = 0;
+            for (const auto& wsabuf : send_request) {
+                const auto copy_error = ::memcpy_s(
+                    this->staging_buffer + slot_offset + StagingAddressLength + datagram_length,
+                    this->slot_length - StagingAddressLength - datagram_length,
+                    wsabuf.buf,
+                    wsabuf.len);
+                ctl::ctFatalCondition(
+                    copy_error != 0,
+                    L"ctsMediaStreamServerBatchSender::send : memcpy_s failed copying a datagram of %u bytes into the staging buffer (error : %d)",
+                    datagram_length + wsabuf.len, copy_error);
+                datagram_length += wsabuf.len;
+            }
+
+            RIO_BUF rio_remote_address;
+            rio_remote_address.BufferId = this->staging_buffer_id;
+            rio_remote_address.Offset = slot_offset;
+            rio_remote_address.Length = StagingAddressLength;
+
+            RIO_BUF rio_buffer;
+            rio_buffer.BufferId = this->staging_buffer_id;
+            rio_buffer.Offset = slot_offset + StagingAddressLength;
+            rio_buffer.Length = datagram_length;
+
+            const ctl::ctAutoReleaseCriticalSection object_lock(&this->object_guard);
+            // the slot is returned to free_slots when its completion is reaped
+            if (!ctl::ctRIOSendEx(
+                this->rio_rq, &rio_buffer, 1, nullptr, &rio_remote_address, nullptr, nullptr, RIO_MSG_DEFER,
+                reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(slot)))) {
+                return_results = wsIOResult(::WSAGetLastError());
+                this->free_slots.push_back(slot);
+                break;
+            }
+            ++this->deferred_datagrams;
+            return_results.bytes_transferred += datagram_length;
+        }
+
+        // only request the commit once the whole frame is queued
+        // - the datagrams of every other stream queued before the work item runs are submitted with it
+        const ctl::ctAutoReleaseCriticalSection object_lock(&this->object_guard);
+        if (this->deferred_datagrams > 0 && !this->commit_pending) {
+            this->commit_pending = true;
+            ::SubmitThreadpoolWork(this->commit_work);
+        }
+        return return_results;
+    }
+
+    ///
+    /// Returns a free slot, reaping completed sends if none are free
+    /// - returns NoSlot if every slot is still in flight, having committed any deferred sends so they can complete
+    ///
+    unsigned long ctsMediaStreamServerBatchSender::take_slot() noexcept
+    {
+        const ctl::ctAutoReleaseCriticalSection object_lock(&this->object_guard);
+        if (this->free_slots.empty()) {
+            this->reap_completions();
+            if (this->free_slots.empty()) {
+                // the caller sends directly: deferred datagrams must be submitted first to stay in order
+                this->commit();
+                return NoSlot;
+            }
+        }
+
+        const unsigned long slot = this->free_slots.back();
+        this->free_slots.pop_back();
+        return slot;
+    }
+
+    ///
+    /// Submits all deferred sends with one call
+    ///
+    void ctsMediaStreamServerBatchSender::commit() noexcept
+    {
+        if (0 == this->deferred_datagrams) {
+            return;
+        }
+
+        if (!ctl::ctRIOSendEx(this->rio_rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr)) {
+            // the deferred sends stay queued, to be submitted with the next commit
+            const auto error = ::WSAGetLastError();
+            try {
+                ctsConfig::PrintErrorInfo(
+                    L"RIOSendEx(%Iu, RIO_MSG_COMMIT_ONLY) failed to submit %u datagrams [%d]",
+                    this->socket,
+                    this->deferred_datagrams,
+                    error);
+            }
+            catch (const std::exception&) {
+                // best effort
+            }
+            return;
+        }
+        ctsConfig::Settings->UdpStatusDetails.datagram_send_calls.increment();
+        ctsConfig::Settings->UdpStatusDetails.datagrams_sent.add(this->deferred_datagrams);
+        this->deferred_datagrams = 0;
+    }
+
+    ///
+    /// Dequeues every completed send without waiting, returning their slots to free_slots
+    ///
+    void ctsMediaStreamServerBatchSender::reap_completions() noexcept
+    {
+        ULONG failed_sends = 0;
+        LONG first_failure = 0;
+        for (;;) {
+            const auto deque_result = ctl::ctRIODequeueCompletion(
+                this->rio_cq,
+                this->rio_results.data(),
+                static_cast<ULONG>(this->rio_results.size()));
+            ctl::ctFatalCondition(
+                (RIO_CORRUPT_CQ == deque_result),
+                L"ctRIODequeueCompletion on(%p) returned RIO_CORRUPT_CQ", this->rio_cq);
+
+            for (ULONG iter_result = 0; iter_result < deque_result; ++iter_result) {
+                if (this->rio_results[iter_result].Status != 0) {
+                    if (0 == failed_sends) {
+                        first_failure = this->rio_results[iter_result].Status;
+                    }
+                    ++failed_sends;
+                }
+                this->free_slots.push_back(static_cast<unsigned long>(this->rio_results[iter_result].RequestContext));
+            }
+
+            if (deque_result < this->rio_results.size()) {
+                break;
+            }
+        }
+
+        if (failed_sends > 0) {
+            try {
+                ctsConfig::PrintErrorInfo(
+                    L"RIOSendEx(%Iu) : %u datagrams failed to send [%d]",
+                    this->socket,
+                    failed_sends,
+                    first_failure);
+            }
+            catch (const std::exception&) {
+                // best effort
+            }
+        }
+    }
+
+    VOID CALLBACK ctsMediaStreamServerBatchSender::CommitCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_WORK) noexcept
+    {
+        auto* this_ptr = static_cast<ctsMediaStreamServerBatchSender*>(_context);
+
+        const ctl::ctAutoReleaseCriticalSection object_lock(&this_ptr->object_guard);
+        // datagrams deferred from here on need another commit
+        this_ptr->commit_pending = false;
+        this_ptr->commit();
+        this_ptr->reap_completions();
+    }
+}
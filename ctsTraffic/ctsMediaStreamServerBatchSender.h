@@ -0,0 +1,93 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <vector>
+// os headers
+#include <Windows.h>
+#include <WinSock2.h>
+#include <mswsock.h>
+// ctl headers
+#include <ctSockaddr.hpp>
+// project headers
+#include "ctsWinsockLayer.h"
+#include "ctsMediaStreamProtocol.hpp"
+
+namespace ctsTraffic {
+    ///
+    /// Sends the datagrams of media stream frames from a shared datagram server socket
+    /// - each datagram is copied into a free slot of a registered staging buffer, beside its remote address,
+    ///   and queued with RIO_MSG_DEFER: RIOSendEx takes a single data buffer, so the header must be made contiguous with the data
+    /// - queued datagrams are submitted with a single RIO_MSG_COMMIT_ONLY from a threadpool work item,
+    ///   so the frames of every stream sent from this socket before the work item runs share one commit
+    /// - completions are reaped without waiting, after each commit and whenever no slot is free
+    ///
+    /// If every slot is still in flight the datagram is sent with WSASendTo rather than waiting for a slot
+    ///
+    /// The SOCKET must have been created with WSA_FLAG_REGISTERED_IO
+    /// - receives on the SOCKET continue to be posted with WSARecvFrom
+    ///
+    class ctsMediaStreamServerBatchSender {
+    private:
+        // each slot holds the remote address followed by the datagram
+        static const unsigned long StagingAddressLength = sizeof(SOCKADDR_INET);
+        // bound the datagrams in flight, and the staging buffer holding them
+        static const unsigned long MaxOutstandingDatagrams = 1024;
+        static const unsigned long MaxStagingBufferBytes = 16UL * 1024UL * 1024UL;
+        static const unsigned long NoSlot = 0xffffffffUL;
+
+        mutable CRITICAL_SECTION object_guard{};
+        // submitted once for every datagram deferred until it runs
+        PTP_WORK commit_work = nullptr;
+
+        const SOCKET socket;
+        _Guarded_by_(object_guard) RIO_CQ rio_cq = RIO_INVALID_CQ;
+        _Guarded_by_(object_guard) RIO_RQ rio_rq = RIO_INVALID_RQ;
+        // a slot is only written by the thread which took it from free_slots, until it's queued
+        char* staging_buffer = nullptr;
+        RIO_BUFFERID staging_buffer_id = RIO_INVALID_BUFFERID;
+        unsigned long slot_length = 0;
+        unsigned long slot_count = 0;
+
+        // reserved to slot_count: slots are returned without allocating
+        _Guarded_by_(object_guard) std::vector<unsigned long> free_slots;
+        _Guarded_by_(object_guard) std::vector<RIORESULT> rio_results;
+        _Guarded_by_(object_guard) unsigned long deferred_datagrams = 0;
+        _Guarded_by_(object_guard) bool commit_pending = false;
+
+        unsigned long take_slot() noexcept;
+        _Requires_lock_held_(object_guard) void commit() noexcept;
+        _Requires_lock_held_(object_guard) void reap_completions() noexcept;
+
+        static VOID CALLBACK CommitCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_WORK) noexcept;
+
+    public:
+        // can throw ctl::ctException or std::bad_alloc
+        explicit ctsMediaStreamServerBatchSender(SOCKET _socket);
+        ~ctsMediaStreamServerBatchSender() noexcept;
+
+        ///
+        /// Queues every datagram of the frame, to be submitted with the next commit
+        /// - returns once queued: the bytes returned are those queued or sent, and errors are those from queuing
+        ///
+        wsIOResult send(ctsMediaStreamSendRequests& _requests, const ctl::ctSockaddr& _remote_addr) noexcept;
+
+        // non-copyable
+        ctsMediaStreamServerBatchSender(const ctsMediaStreamServerBatchSender&) = delete;
+        ctsMediaStreamServerBatchSender& operator=(const ctsMediaStreamServerBatchSender&) = delete;
+        ctsMediaStreamServerBatchSender(ctsMediaStreamServerBatchSender&&) = delete;
+        ctsMediaStreamServerBatchSender& operator=(ctsMediaStreamServerBatchSender&&) = delete;
+    };
+}
@@ -36,6 +36,7 @@ namespace ctsTraffic {
         ctSockaddr _remote_addr,
         ctsMediaStreamConnectedSocketIoFunctor _io_functor)
         :
+        task_timer(ctsMediaStreamTimerCallback, this),
         weak_socket(std::move(_weak_socket)),
         io_functor(std::move(_io_functor)),
         socket(_sending_socket),
@@ -45,21 +46,12 @@ namespace ctsTraffic {
         if (!::InitializeCriticalSectionEx(&object_guard, 4000, 0)) {
             throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
         }
-
-        task_timer = ::CreateThreadpoolTimer(ctsMediaStreamTimerCallback, this, ctsConfig::Settings->PTPEnvironment);
-        if (nullptr == task_timer) {
-            const auto gle = ::GetLastError();
-            ::DeleteCriticalSection(&object_guard);
-            throw ctException(gle, L"CreateThreadpoolTimer", L"ctsMediaStreamServer", false);
-        }
     }
 
     ctsMediaStreamServerConnectedSocket::~ctsMediaStreamServerConnectedSocket() noexcept
     {
-        // stop the TP before deleting the CS
-        ::SetThreadpoolTimer(task_timer, nullptr, 0, 0);
-        ::WaitForThreadpoolTimerCallbacks(task_timer, TRUE);
-        ::CloseThreadpoolTimer(task_timer);
+        // stop the timer before deleting the CS
+        task_timer.cancel();
 
         ::DeleteCriticalSection(&object_guard);
     }
@@ -105,14 +97,13 @@ namespace ctsTraffic {
                 // in this case, immediately schedule the WSASendTo
                 const ctAutoReleaseCriticalSection lock_object(&this->object_guard);
                 this->next_task = _task;
-                ctsMediaStreamServerConnectedSocket::ctsMediaStreamTimerCallback(nullptr, this, nullptr);
+                ctsMediaStreamServerConnectedSocket::ctsMediaStreamTimerCallback(this);
 
             } else {
-                FILETIME ftDueTime(ctTimer::convert_msec_relative_filetime(_task.time_offset_milliseconds));
                 // assign the next task *and* schedule the timer while in *this object lock
                 const ctAutoReleaseCriticalSection lock_object(&this->object_guard);
                 this->next_task = _task;
-                ::SetThreadpoolTimer(this->task_timer, &ftDueTime, 0, 0);
+                this->task_timer.set(_task.time_offset_milliseconds);
             }
         }
     }
@@ -125,7 +116,7 @@ namespace ctsTraffic {
         }
     }
         
-    VOID CALLBACK ctsMediaStreamServerConnectedSocket::ctsMediaStreamTimerCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept
+    void ctsMediaStreamServerConnectedSocket::ctsMediaStreamTimerCallback(_In_opt_ PVOID _context) noexcept
     {
         auto this_ptr = static_cast<ctsMediaStreamServerConnectedSocket*>(_context);
 
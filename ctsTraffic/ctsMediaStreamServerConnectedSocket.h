@@ -25,6 +25,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsSocket.h"
 #include "ctsWinsockLayer.h"
 #include "ctsSocketGuard.hpp"
+#include "ctsWheelTimer.hpp"
 
 
 namespace ctsTraffic {
@@ -41,7 +42,8 @@ namespace ctsTraffic {
 
         // the CS is mutable so we can take a lock / release a lock in const methods
         mutable CRITICAL_SECTION object_guard{};
-        PTP_TIMER task_timer = nullptr;
+        // paces the frames sent: shared with every other stream on the processor's timer wheel
+        ctsWheelTimer task_timer;
 
         // this weak_socket is the weak reference to the ctsSocket tracked by ctsSocketState & ctsSocketBroker
         // used to complete the state when finished and take a shared_ptr when needing to take a reference
@@ -93,6 +95,6 @@ namespace ctsTraffic {
         ctsMediaStreamServerConnectedSocket& operator=(ctsMediaStreamServerConnectedSocket&&) = delete;
 
     private:
-        static VOID CALLBACK ctsMediaStreamTimerCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept;
+        static void ctsMediaStreamTimerCallback(_In_opt_ PVOID _context) noexcept;
     };
 }
\ No newline at end of file
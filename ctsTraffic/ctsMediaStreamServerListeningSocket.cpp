@@ -44,6 +44,11 @@ namespace ctsTraffic {
             !!(ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP),
             L"ctsMediaStream sockets must not have HANDLE_INLINE_IOCP set on its datagram sockets");
 
+        // create before the CS so nothing leaks if this throws
+        if (ctsConfig::Settings->Options & ctsConfig::OptionType::BATCH_DATAGRAM_SEND) {
+            this->batch_sender = std::make_unique<ctsMediaStreamServerBatchSender>(this->socket.get());
+        }
+
         if (!::InitializeCriticalSectionEx(&object_guard, 4000, 0)) {
             throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
         }
@@ -69,6 +74,12 @@ namespace ctsTraffic {
         return this->listening_addr;
     }
 
+    ctsMediaStreamServerBatchSender* ctsMediaStreamServerListeningSocket::get_batch_sender() const noexcept
+    {
+        // batch_sender is only set in the c'tor and destroyed in the d'tor - no lock is needed
+        return this->batch_sender.get();
+    }
+
     void ctsMediaStreamServerListeningSocket::reset() noexcept
     {
         const ctl::ctAutoReleaseCriticalSection object_lock(&this->object_guard);
@@ -22,6 +22,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctThreadIocp.hpp"
 #include "ctHandle.hpp"
 
+#include "ctsMediaStreamServerBatchSender.h"
+
 namespace ctsTraffic {
     class ctsMediaStreamServerListeningSocket {
     private:
@@ -46,6 +48,9 @@ namespace ctsTraffic {
         _Guarded_by_(object_guard)
         DWORD recv_flags = 0;
 
+        // only created when -Options:batchsend was specified
+        std::unique_ptr<ctsMediaStreamServerBatchSender> batch_sender;
+
         void recv_completion(OVERLAPPED* _ov) noexcept;
 
     public:
@@ -59,6 +64,9 @@ namespace ctsTraffic {
 
         ctl::ctSockaddr get_address() const noexcept;
 
+        // returns nullptr if datagrams are not batched on this socket
+        ctsMediaStreamServerBatchSender* get_batch_sender() const noexcept;
+
         void reset() noexcept;
 
         void initiate_recv() noexcept;
@@ -0,0 +1,168 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <functional>
+#include <memory>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctTimer.hpp>
+// project headers
+#include "ctsTimerWheel.hpp"
+
+namespace ctsTraffic {
+    ///
+    /// Runs functions at sub-millisecond offsets, for sends paced by -RateLimitBurst
+    /// - threadpool timers fire on the system timer tick: at best 1 ms, often 15.6 ms
+    /// - instead a dedicated thread waits on a high-resolution waitable timer,
+    ///   set for the earliest function due on a timer wheel turning in 1 microsecond ticks
+    ///
+    /// The pacing thread never runs the functions itself: each due function is submitted to its threadpool
+    /// - so one slow function (e.g. a socket's send loop) never delays any other function due at the same time
+    /// - each function is given its own threadpool work when scheduled, so submitting it when due can't fail
+    /// - the functions must not throw
+    /// - the pacer cannot cancel them: they must hold only weak references to what they act on
+    ///
+    class ctsPacer {
+    public:
+        ///
+        /// The pacing thread is created on first use and lives for the life of the process
+        ///
+        /// - can throw ctl::ctException or std::bad_alloc
+        ///
+        static ctsPacer& instance()
+        {
+            // deliberately never deleted: the pacing thread can still be running as the process exits
+            static ctsPacer& pacer = *std::make_unique<ctsPacer>().release();
+            return pacer;
+        }
+
+        // can throw ctl::ctException
+        ctsPacer() : wheel(snap_tick())
+        {
+            // high-resolution timers are available from Windows 10 1803: fall back to a standard timer before then
+            this->timer = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            if (nullptr == this->timer) {
+                this->timer = ::CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+                if (nullptr == this->timer) {
+                    throw ctl::ctException(::GetLastError(), L"CreateWaitableTimerEx", L"ctsPacer", false);
+                }
+            }
+
+            HANDLE thread = ::CreateThread(nullptr, 0, PacingThread, this, 0, nullptr);
+            if (nullptr == thread) {
+                const auto gle = ::GetLastError();
+                ::CloseHandle(this->timer);
+                throw ctl::ctException(gle, L"CreateThread", L"ctsPacer", false);
+            }
+            ::SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST);
+            ::CloseHandle(thread);
+        }
+
+        ///
+        /// Runs _function on the threadpool of _tp_environment _delay_microseconds from now
+        ///
+        /// - can throw ctl::ctException or std::bad_alloc
+        ///
+        void schedule(std::function<void()> _function, long long _delay_microseconds, _In_opt_ PTP_CALLBACK_ENVIRON _tp_environment)
+        {
+            auto entry = std::make_unique<ctsPacerEntry>();
+            entry->function = std::move(_function);
+            entry->work = ::CreateThreadpoolWork(PacedWorkCallback, entry.get(), _tp_environment);
+            if (nullptr == entry->work) {
+                throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsPacer::schedule", false);
+            }
+
+            const long long now_tick = snap_tick();
+            const long long due_tick = now_tick + ((_delay_microseconds > 0) ? _delay_microseconds : 0);
+
+            ::AcquireSRWLockExclusive(&this->lock);
+            this->wheel.schedule(entry.release(), due_tick);
+            if (this->armed_tick < 0 || due_tick < this->armed_tick) {
+                this->arm(due_tick, now_tick);
+            }
+            ::ReleaseSRWLockExclusive(&this->lock);
+        }
+
+        // non-copyable
+        ctsPacer(const ctsPacer&) = delete;
+        ctsPacer& operator=(const ctsPacer&) = delete;
+        ctsPacer(ctsPacer&&) = delete;
+        ctsPacer& operator=(ctsPacer&&) = delete;
+
+    private:
+        struct ctsPacerEntry : ctsTimerWheelEntry {
+            std::function<void()> function;
+            PTP_WORK work = nullptr;
+        };
+
+        SRWLOCK lock = SRWLOCK_INIT;
+        HANDLE timer = nullptr;
+        _Guarded_by_(lock) ctsTimerWheel wheel;
+        // the tick the waitable timer is set to fire: -1 when not set
+        _Guarded_by_(lock) long long armed_tick = -1LL;
+
+        static long long snap_tick() noexcept
+        {
+            return ctl::ctTimer::snap_qpc_as_nsec() / 1000LL;
+        }
+
+        _Requires_lock_held_(lock)
+        void arm(long long _due_tick, long long _now_tick) noexcept
+        {
+            // negative due times are relative, in 100 ns units: zero would be an absolute time
+            LARGE_INTEGER due_time;
+            due_time.QuadPart = (_due_tick > _now_tick) ? -((_due_tick - _now_tick) * 10LL) : -1LL;
+            ::SetWaitableTimer(this->timer, &due_time, 0, nullptr, nullptr, FALSE);
+            this->armed_tick = _due_tick;
+        }
+
+        static void CALLBACK PacedWorkCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK _work) noexcept
+        {
+            const std::unique_ptr<ctsPacerEntry> entry(static_cast<ctsPacerEntry*>(_context));
+            entry->function();
+            // a work object can be closed from its own callback: it's released once the callback returns
+            ::CloseThreadpoolWork(_work);
+        }
+
+        static DWORD WINAPI PacingThread(_In_ LPVOID _context) noexcept
+        {
+            auto* this_ptr = static_cast<ctsPacer*>(_context);
+            ctsTimerWheelList expired;
+            for (;;) {
+                ::WaitForSingleObject(this_ptr->timer, INFINITE);
+
+                ::AcquireSRWLockExclusive(&this_ptr->lock);
+                this_ptr->armed_tick = -1LL;
+                this_ptr->wheel.advance(snap_tick(), expired);
+                ::ReleaseSRWLockExclusive(&this_ptr->lock);
+
+                // hand each due function to its threadpool: the entry is deleted once it has run
+                while (auto* expired_entry = expired.pop_front()) {
+                    ::SubmitThreadpoolWork(static_cast<ctsPacerEntry*>(expired_entry)->work);
+                }
+
+                ::AcquireSRWLockExclusive(&this_ptr->lock);
+                const long long next_due_tick = this_ptr->wheel.next_due_tick();
+                if (next_due_tick >= 0 && (this_ptr->armed_tick < 0 || next_due_tick < this_ptr->armed_tick)) {
+                    this_ptr->arm(next_due_tick, snap_tick());
+                }
+                ::ReleaseSRWLockExclusive(&this_ptr->lock);
+            }
+        }
+    };
+}
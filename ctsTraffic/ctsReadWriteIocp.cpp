@@ -19,6 +19,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ctl headers
 #include <ctThreadIocp.hpp>
 #include <ctSockaddr.hpp>
+#include <ctSocketExtensions.hpp>
 // local headers
 #include "ctsConfig.h"
 #include "ctsSocket.h"
@@ -30,6 +31,15 @@ namespace ctsTraffic {
     /// forward delcaration
     void ctsReadWriteIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
 
+    ///
+    /// The context kept with each pooled IO request for the completion callback
+    ///
+    struct ctsReadWriteIocpRequest
+    {
+        std::weak_ptr<ctsSocket> weak_socket;
+        ctsIOTask io_task;
+    };
+
     ///
     /// IO Threadpool completion callback 
     ///
@@ -61,7 +71,9 @@ namespace ctsTraffic {
             }
         }
 
-        const wchar_t* Function = (IOTaskAction::Send == _io_task.ioAction) ? L"WriteFile" : L"ReadFile";
+        const wchar_t* Function =
+            (ctsIOTask::BufferType::TransmitFile == _io_task.buffer_type) ? L"TransmitFile" :
+            (IOTaskAction::Send == _io_task.ioAction) ? L"WriteFile" : L"ReadFile";
         if (gle != 0) PrintDebugInfo(L"\t\tIO Failed: %ws (%d) [ctsReadWriteIocp]\n", Function, gle);
         // see if complete_io requests more IO
         DWORD readwrite_status = NO_ERROR;
@@ -97,6 +109,11 @@ namespace ctsTraffic {
         }
     }
 
+    static void ctsReadWriteIocpPooledCompletionCallback(_In_ OVERLAPPED* _overlapped, ctsReadWriteIocpRequest& _request) noexcept
+    {
+        ctsReadWriteIocpIoCompletionCallback(_overlapped, _request.weak_socket, _request.io_task);
+    }
+
     ///
     /// The registered function with ctsConfig
     ///
@@ -151,9 +168,9 @@ namespace ctsTraffic {
                     try {
                         // these are the only calls which can throw in this function
                         io_thread_pool = shared_socket->thread_pool();
-                        pov = io_thread_pool->new_request(
-                            [_weak_socket, next_io](OVERLAPPED* _ov) noexcept
-                        { ctsReadWriteIocpIoCompletionCallback(_ov, _weak_socket, next_io); });
+                        pov = io_thread_pool->new_pooled_request(
+                            ctsReadWriteIocpPooledCompletionCallback,
+                            ctsReadWriteIocpRequest{ _weak_socket, next_io });
                     }
                     catch (const std::exception& e) {
                         ctsConfig::PrintException(e);
@@ -170,7 +187,14 @@ namespace ctsTraffic {
                     // No-Throw operations from here until end of try {} block
                     /////////////////////////////////////////////////////////////
                     char* io_buffer = next_io.buffer + next_io.buffer_offset;
-                    if (IOTaskAction::Send == next_io.ioAction) {
+                    if (ctsIOTask::BufferType::TransmitFile == next_io.buffer_type) {
+                        // TransmitFile reads from the offset specified in the OVERLAPPED
+                        pov->Offset = next_io.buffer_offset;
+                        pov->OffsetHigh = 0;
+                        if (!ctl::ctTransmitFile(socket, ctsConfig::Settings->TransmitFileHandle, next_io.buffer_length, 0, pov, nullptr, 0)) {
+                            io_error = ::WSAGetLastError();
+                        }
+                    } else if (IOTaskAction::Send == next_io.ioAction) {
                         if (!::WriteFile(reinterpret_cast<HANDLE>(socket), io_buffer, next_io.buffer_length, nullptr, pov)) {
                             io_error = ::GetLastError();
                         }
@@ -192,7 +216,9 @@ namespace ctsTraffic {
                         // decrement the IO count since it was not pended
                         io_count = shared_socket->decrement_io();
                         // call back to the socket that it failed to see if wants more IO
-                        const wchar_t* Function = (IOTaskAction::Send == next_io.ioAction) ? L"WriteFile" : L"ReadFile";
+                        const wchar_t* Function =
+                            (ctsIOTask::BufferType::TransmitFile == next_io.buffer_type) ? L"TransmitFile" :
+                            (IOTaskAction::Send == next_io.ioAction) ? L"WriteFile" : L"ReadFile";
                         PrintDebugInfo(L"\t\tIO Failed: %ws (%d) [ctsReadWriteIocp]\n", Function, io_error);
 
                         const ctsIOStatus protocol_status = shared_pattern->complete_io(next_io, 0, io_error);
@@ -28,6 +28,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsSocket.h"
 #include "ctsIOTask.hpp"
 #include "ctsSocketGuard.hpp"
+#include "ctsCompletionQueueShards.hpp"
+#include "ctsSubmissionBatcher.hpp"
 
 namespace ctsTraffic {
 
@@ -39,185 +41,319 @@ namespace ctsTraffic {
     static const LONG RioMaxDataBuffers = 1; // this is the only value accepted as of Win8
     static const LONG RioDefaultCQSize = 1000;
     static const ULONG_PTR ExitCompletionKey = 0xffffffff;
+    static const LONG RioPollResultArrayLength = 128;
+    static const ULONG RioPollSpinCount = 1000;
+    static const size_t RioMaxBatchedRequests = 16;
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// RioCompletionQueue
+    ///
+    /// The RIO backend for ctsCompletionQueueShards
+    /// - owns one RIO_CQ, and unless the CQ is polled, the IOCP and OVERLAPPED used for its RIONotify
+    /// - every shard has its own IOCP so each worker thread only wakes for completions on its own CQ
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class RioCompletionQueue {
+    private:
+        RIO_NOTIFICATION_COMPLETION notify_settings{};
+        OVERLAPPED notify_overlapped{};
+        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+        RIO_CQ rio_cq = RIO_INVALID_CQ;
+        unsigned long queue_size = 0;
+        bool polled = false;
+
+    public:
+        static const unsigned long MaxSize = RIO_MAX_CQ_SIZE;
+
+        // can throw ctl::ctException
+        RioCompletionQueue(unsigned long _queue_size, bool _polled) : polled(_polled)
+        {
+            // with RIO, we don't associate the IOCP handle with the socket like 'typical' sockets
+            // - instead we directly pass the IOCP handle through RIOCreateCompletionQueue
+            // - a polled CQ is created without any notification settings
+            if (!this->polled) {
+                this->notify_settings.Type = RIO_NOTIFICATION_COMPLETION_TYPE::RIO_IOCP_COMPLETION;
+                this->notify_settings.Iocp.CompletionKey = nullptr;
+                this->notify_settings.Iocp.Overlapped = &this->notify_overlapped;
+                // only the one worker thread for this shard waits on this IOCP
+                this->notify_settings.Iocp.IocpHandle = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+                if (!this->notify_settings.Iocp.IocpHandle) {
+                    throw ctl::ctException(::GetLastError(), L"CreateIoCompletionPort", L"ctsRioIocp", false);
+                }
+            }
+            ctlScopeGuard(closeIocpOnError, {
+                if (this->notify_settings.Iocp.IocpHandle != nullptr) {
+                    ::CloseHandle(this->notify_settings.Iocp.IocpHandle);
+                }
+            });
+
+            this->rio_cq = ctl::ctRIOCreateCompletionQueue(_queue_size, this->polled ? nullptr : &this->notify_settings);
+            // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+            if (RIO_INVALID_CQ == this->rio_cq) {
+                throw ctl::ctException(::WSAGetLastError(), L"ctRIOCreateCompletionQueue", L"ctsRioIocp", false);
+            }
+            ctlScopeGuard(closeCqOnError, { ctl::ctRIOCloseCompletionQueue(this->rio_cq); });
+
+            // post a Notify to catch the first set of IO
+            // - polled CQs are never notified
+            if (!this->polled) {
+                const auto notify = ctl::ctRIONotify(this->rio_cq);
+                if (notify != NO_ERROR) {
+                    throw ctl::ctException(notify, L"ctRIONotify", L"ctsRioIocp", false);
+                }
+            }
+
+            this->queue_size = _queue_size;
+            // no failures
+            closeCqOnError.dismiss();
+            closeIocpOnError.dismiss();
+        }
+
+        ~RioCompletionQueue() noexcept
+        {
+            // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
+            if (this->rio_cq != RIO_INVALID_CQ) {
+                ctl::ctRIOCloseCompletionQueue(this->rio_cq);
+            }
+            if (this->notify_settings.Iocp.IocpHandle != nullptr) {
+                ::CloseHandle(this->notify_settings.Iocp.IocpHandle);
+            }
+        }
+
+        unsigned long size() const noexcept
+        {
+            return this->queue_size;
+        }
+
+        // can throw ctl::ctException
+        void resize(unsigned long _new_size)
+        {
+            PrintDebugInfo(
+                L"\t\tctsRioIocp: Resizing the CQ (%p) from %u to %u\n",
+                this->rio_cq, this->queue_size, _new_size);
+            if (!ctl::ctRIOResizeCompletionQueue(this->rio_cq, _new_size)) {
+                throw ctl::ctException(::WSAGetLastError(), L"ctRIOResizeCompletionQueue", L"ctsRioIocp", false);
+            }
+            this->queue_size = _new_size;
+        }
+
+        RIO_CQ get() const noexcept
+        {
+            return this->rio_cq;
+        }
+
+        HANDLE iocp() const noexcept
+        {
+            return this->notify_settings.Iocp.IocpHandle;
+        }
+
+        ///
+        /// Queues the exit key to the worker thread waiting on this CQ's IOCP
+        /// - polled CQs have no IOCP: their worker checks s_rio_poll_exit
+        ///
+        void post_exit() const noexcept
+        {
+            if (!this->polled && !::PostQueuedCompletionStatus(this->notify_settings.Iocp.IocpHandle, 0, ExitCompletionKey, nullptr)) {
+                // if can't indicate to exit, kill the process to see why
+                ctl::ctAlwaysFatalCondition(
+                    L"PostQueuedCompletionStatus(%p) failed [%u] to tear down the threadpool",
+                    this->notify_settings.Iocp.IocpHandle, ::GetLastError());
+            }
+        }
+
+        RioCompletionQueue(const RioCompletionQueue&) = delete;
+        RioCompletionQueue(RioCompletionQueue&&) = delete;
+        RioCompletionQueue& operator=(const RioCompletionQueue&) = delete;
+        RioCompletionQueue& operator=(RioCompletionQueue&&) = delete;
+    };
+    using RioCompletionQueueShard = ctsCompletionQueueShard<RioCompletionQueue>;
 
     ///
     /// forward-declaring CQ-functions leveraging the below variables
     ///
-    static void  s_make_room_in_cq(ULONG _new_slots);
-    static void  s_release_room_in_cq(ULONG _slots) noexcept;
-    static ULONG s_deque_from_cq(_Out_writes_(RioResultArrayLength) RIORESULT* _rio_results) noexcept;
+    static ULONG s_deque_from_cq(RioCompletionQueueShard& _shard, _Out_writes_(RioResultArrayLength) RIORESULT* _rio_results) noexcept;
+    static ULONG s_poll_from_cq(RioCompletionQueueShard& _shard, _Out_writes_(RioPollResultArrayLength) RIORESULT* _rio_results) noexcept;
     static void  s_delete_all_cqs() noexcept;
     ///
-    /// Forward-declaring the IOCP threadpool function
+    /// Forward-declaring the IOCP threadpool function and the polling thread function
+    /// - each is passed the RioCompletionQueueShard it services
     ///
-    static DWORD WINAPI RioIocpThreadProc(LPVOID) noexcept;
+    static DWORD WINAPI RioIocpThreadProc(LPVOID _shard) noexcept;
+    static DWORD WINAPI RioPollThreadProc(LPVOID _shard) noexcept;
 
     ///
-    /// Management of the CQ and its corresponding threadpool implemented in this unnamed namespace
+    /// Management of the CQ shards and their worker threads
+    /// - one CQ shard and one worker thread per processor, across all processor groups
     /// - initialized with InitOneExecuteOnce
+    /// - the parameter is non-null when the CQs should be polled instead of using IOCP notifications
     /// 
-    static BOOL CALLBACK s_init_once_cq(PINIT_ONCE, PVOID, PVOID *) noexcept;
+    static BOOL CALLBACK s_init_once_cq(PINIT_ONCE, PVOID _polled, PVOID *) noexcept;
     // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
     static INIT_ONCE s_sharedbuffer_initializer = INIT_ONCE_STATIC_INIT;
 
-    static ctl::ctPrioritizedCriticalSection* s_prioritized_cs = nullptr;
-    static RIO_NOTIFICATION_COMPLETION s_rio_notify_setttings;
-    // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
-    static RIO_CQ  s_rio_cq = RIO_INVALID_CQ;
-    static ULONG   s_rio_cq_size = 0;
-    static ULONG   s_rio_cq_used = 0;
+    static ctsCompletionQueueShards<RioCompletionQueue>* s_rio_cq_shards = nullptr;
     static HANDLE* s_rio_worker_threads = nullptr;
     static DWORD   s_rio_worker_thread_count = 0;
+    static bool    s_rio_cq_polled = false;
+    static volatile LONG s_rio_poll_exit = 0;
 
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Make room in the CQ for a new IO
-    ///
-    /// - check if there is room in the CQ for the new IO
-    ///   - if not, take a writer lock around the CS to halt readers and to write to cq_used
-    ///     then take the CS over the CQ, and resize the CQ by 1.5 times current size
-    ///
-    /// - can throw under low resources or failure to resize
+    /// Flattens a processor's (group, number) into an index across all active processor groups
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static void s_make_room_in_cq(ULONG _new_slots)
+    static DWORD s_processor_index(const PROCESSOR_NUMBER& _processor) noexcept
     {
-        // taking an priority lock to interrupt the general lock taken by the deque IO path
-        // - we want to interrupt the IO path so we can initiate more IO if we need to grow the CQ
-        ctl::ctAutoReleasePriorityCriticalSection priority_lock_on_static_cs(*s_prioritized_cs);
-
-        const ULONG new_cq_used = s_rio_cq_used + _new_slots;
-        ULONG new_cq_size = s_rio_cq_size; // not yet resized
-        if (s_rio_cq_size < new_cq_used) {
-            // fail hard if we are already at the max CQ size and can't grow it for more IO
-            ctl::ctFatalCondition(
-                ((RIO_MAX_CQ_SIZE == s_rio_cq_size) || (new_cq_used > RIO_MAX_CQ_SIZE)),
-                L"ctsRioIocp: attempting to grow the CQ beyond RIO_MAX_CQ_SIZE");
+        DWORD processor_index = _processor.Number;
+        for (WORD group = 0; group < _processor.Group; ++group) {
+            processor_index += ::GetActiveProcessorCount(group);
+        }
+        return processor_index;
+    }
 
-            // multiply new_cq_used by 1.25 for bettery growth patterns
-            new_cq_size = static_cast<ULONG>(new_cq_used * 1.5);
-            if (new_cq_size > RIO_MAX_CQ_SIZE) {
-                static_assert(MAXLONG / 1.5 > RIO_MAX_CQ_SIZE, "s_rio_cq_size can overflow");
-                new_cq_size = RIO_MAX_CQ_SIZE;
+    static PROCESSOR_NUMBER s_processor_from_index(DWORD _processor_index) noexcept
+    {
+        PROCESSOR_NUMBER processor{};
+        const WORD group_count = ::GetActiveProcessorGroupCount();
+        for (WORD group = 0; group < group_count; ++group) {
+            const DWORD group_processors = ::GetActiveProcessorCount(group);
+            if (_processor_index < group_processors) {
+                processor.Group = group;
+                processor.Number = static_cast<BYTE>(_processor_index);
+                break;
             }
-            PrintDebugInfo(
-                L"\t\tctsRioIocp: Resizing the CQ from %u to %u (used slots = %u increasing used slots to %u)\n",
-                s_rio_cq_size,
-                new_cq_size,
-                s_rio_cq_used,
-                new_cq_used);
+            _processor_index -= group_processors;
+        }
+        return processor;
+    }
 
-            if (!ctl::ctRIOResizeCompletionQueue(s_rio_cq, new_cq_size)) {
-                throw ctl::ctException(::WSAGetLastError(), L"ctRIOResizeCompletionQueue", L"ctsRioIocp", false);
-            }
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Returns the affinity pinning the worker thread of a processor's shard to the -CpuSet processors
+    /// - the processor itself when it's in the set
+    /// - otherwise the processors of the set in the same group, or those of the first group with any in the set
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static GROUP_AFFINITY s_cpu_set_affinity(const PROCESSOR_NUMBER& _processor) noexcept
+    {
+        const auto& cpu_set_masks = ctsConfig::Settings->CpuSetMasks;
+        const KAFFINITY processor_mask = static_cast<KAFFINITY>(1) << _processor.Number;
+
+        GROUP_AFFINITY affinity{};
+        if (cpu_set_masks[_processor.Group] & processor_mask) {
+            affinity.Group = _processor.Group;
+            affinity.Mask = processor_mask;
+        } else if (cpu_set_masks[_processor.Group] != 0) {
+            affinity.Group = _processor.Group;
+            affinity.Mask = cpu_set_masks[_processor.Group];
         } else {
-            PrintDebugInfo(
-                L"\t\tctsRioIocp: Not resizing the CQ from %u (used slots = %u increasing to %u)\n",
-                s_rio_cq_size, s_rio_cq_used, new_cq_used);
+            for (WORD group = 0; group < cpu_set_masks.size(); ++group) {
+                if (cpu_set_masks[group] != 0) {
+                    affinity.Group = group;
+                    affinity.Mask = cpu_set_masks[group];
+                    break;
+                }
+            }
         }
-        // update cq_used and cq_size on the success path
-        s_rio_cq_used = new_cq_used;
-        s_rio_cq_size = new_cq_size;
+        return affinity;
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Release slots in the CQ
+    /// Returns the CQ shard for the processor the caller is running on
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static void s_release_room_in_cq(ULONG _slots) noexcept
+    static RioCompletionQueueShard& s_shard_for_current_processor() noexcept
     {
-        ctl::ctAutoReleasePriorityCriticalSection priority_lock_on_static_cs(*s_prioritized_cs);
-
-        ctl::ctFatalCondition(
-            s_rio_cq_used < _slots,
-            L"ctsRioIocp::s_release_room_in_cq(%u): underflow - current s_rio_cq_used value (%u)",
-            _slots, s_rio_cq_used);
+        PROCESSOR_NUMBER current_processor;
+        ::GetCurrentProcessorNumberEx(&current_processor);
+        return s_rio_cq_shards->shard_for(s_processor_index(current_processor));
+    }
 
-        PrintDebugInfo(
-            L"\t\tctsRioIocp: Reducing the CQ used slots from %u to %u\n",
-            s_rio_cq_used,
-            s_rio_cq_used - _slots);
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Safely dequeus from the shard's CQ into the supplied RIORESULT vector
+    /// - will always post a Notify with proper synchronization
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static ULONG s_deque_from_cq(RioCompletionQueueShard& _shard, _Out_writes_(RioResultArrayLength) RIORESULT* _rio_results) noexcept
+    {
+        // dequeuing under the shard's lower-priority lock, to allow the priority lock to interrupt dequeing
+        // - so it can add space to the CQ
+        return _shard.dequeue([_rio_results](const RioCompletionQueue& _cq) noexcept {
+            const auto deque_result = ctl::ctRIODequeueCompletion(_cq.get(), _rio_results, RioResultArrayLength);
+            // We were notified there were completions, but we can't dequeue any IO
+            // - something has gone horribly wrong - likely our CQ is corrupt
+            // Will kill the test into the debugger to investigate
+            ctl::ctFatalCondition(
+                ((0 == deque_result) || (RIO_CORRUPT_CQ == deque_result)),
+                L"ctRIODequeueCompletion on(%p) returned [%u] : expected to have dequeued IO after being signaled",
+                _cq.get(), deque_result);
+            //
+            // Immediately after invoking Dequeue, post another Notify
+            //
+            const auto notify_result = ctl::ctRIONotify(_cq.get());
+            // if notify fails, we can't reliably know when the next IO completes
+            // - this will cause everything to come to a grinding halt
+            // Will kill the test into the debugger to investigate
+            ctl::ctFatalCondition(
+                (notify_result != 0),
+                L"RIONotify(%p) failed [%d]", _cq.get(), notify_result);
 
-        s_rio_cq_used -= _slots;
+            return deque_result;
+        });
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Safely dequeus from the CQ into the supplied RIORESULT vector
-    /// - will always post a Notify with proper synchronization
+    /// Polls the shard's CQ into the supplied RIORESULT vector
+    /// - used when the CQ was created without a notification mechanism
+    /// - returns zero if there were no completions to reap
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static ULONG s_deque_from_cq(_Out_writes_(RioResultArrayLength) RIORESULT* _rio_results) noexcept
+    static ULONG s_poll_from_cq(RioCompletionQueueShard& _shard, _Out_writes_(RioPollResultArrayLength) RIORESULT* _rio_results) noexcept
     {
-        // taking a lower-priority lock, to allow the priority lock to interrupt dequeing
+        // dequeuing under the shard's lower-priority lock, to allow the priority lock to interrupt dequeing
         // - so it can add space to the CQ
-        ctl::ctAutoReleaseDefaultCriticalSection default_lock_on_cs(*s_prioritized_cs);
-
-        const auto deque_result = ctl::ctRIODequeueCompletion(s_rio_cq, _rio_results, RioResultArrayLength);
-        // We were notified there were completions, but we can't dequeue any IO
-        // - something has gone horribly wrong - likely our CQ is corrupt
-        // Will kill the test into the debugger to investigate
-        ctl::ctFatalCondition(
-            ((0 == deque_result) || (RIO_CORRUPT_CQ == deque_result)),
-            L"ctRIODequeueCompletion on(%p) returned [%u] : expected to have dequeued IO after being signaled",
-            s_rio_cq, deque_result);
-        //
-        // Immediately after invoking Dequeue, post another Notify
-        //
-        const auto notify_result = ctl::ctRIONotify(s_rio_cq);
-        // if notify fails, we can't reliably know when the next IO completes
-        // - this will cause everything to come to a grinding halt
-        // Will kill the test into the debugger to investigate
-        ctl::ctFatalCondition(
-            (notify_result != 0),
-            L"RIONotify(%p) failed [%d]", s_rio_cq, notify_result);
-
-        return deque_result;
+        return _shard.dequeue([_rio_results](const RioCompletionQueue& _cq) noexcept {
+            const auto deque_result = ctl::ctRIODequeueCompletion(_cq.get(), _rio_results, RioPollResultArrayLength);
+            // a corrupt CQ is not recoverable other than closing every socket and making a new CQ
+            // Will kill the test into the debugger to investigate
+            ctl::ctFatalCondition(
+                (RIO_CORRUPT_CQ == deque_result),
+                L"ctRIODequeueCompletion on(%p) returned RIO_CORRUPT_CQ", _cq.get());
+
+            return deque_result;
+        });
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Shutdown all IOCP threads and close the CQ
+    /// Shutdown all worker threads and close all CQs
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     static void s_delete_all_cqs() noexcept
     {
-        unsigned threads_alive = 0;
-        // send an exit key to all threads, then wait on all threads to exit
+        // polling threads check for the exit flag each time they poll the CQ
+        ::InterlockedExchange(&s_rio_poll_exit, 1);
+        // send an exit key to each thread through the IOCP of the shard it services
         for (unsigned loop_workers = 0; loop_workers < s_rio_worker_thread_count; ++loop_workers) {
-            // queue an exit key to the worker thread
             if (s_rio_worker_threads[loop_workers] != nullptr) {
-                ++threads_alive;
-                if (!PostQueuedCompletionStatus(
-                    s_rio_notify_setttings.Iocp.IocpHandle,
-                    0,
-                    ExitCompletionKey,
-                    reinterpret_cast<OVERLAPPED*>(s_rio_notify_setttings.Iocp.Overlapped))) {
-                    // if can't indicate to exit, kill the process to see why
-                    ctl::ctAlwaysFatalCondition(
-                        L"PostQueuedCompletionStatus(%p) failed [%u] to tear down the threadpool",
-                        s_rio_notify_setttings.Iocp.IocpHandle, ::GetLastError());
-                }
+                (*s_rio_cq_shards)[loop_workers].completion_queue().post_exit();
             }
         }
         // wait for threads to exit
-        if (threads_alive > 0) {
-            if (::WaitForMultipleObjects(
-                threads_alive,
-                &s_rio_worker_threads[0],
-                TRUE,
-                INFINITE) != WAIT_OBJECT_0) {
-                // if can't wait for the worker threads, kill the process to see why
-                ctl::ctAlwaysFatalCondition(
-                    L"WaitForMultipleObjects(%p) failed [%u] to wait on the threadpool",
-                    &s_rio_worker_threads[0], ::GetLastError());
-            }
-        }
-        // now can close the thread handles
+        // - waiting on each individually: there can be more threads than MAXIMUM_WAIT_OBJECTS
         for (unsigned loop_workers = 0; loop_workers < s_rio_worker_thread_count; ++loop_workers) {
             if (s_rio_worker_threads[loop_workers] != nullptr) {
+                if (::WaitForSingleObject(s_rio_worker_threads[loop_workers], INFINITE) != WAIT_OBJECT_0) {
+                    // if can't wait for the worker threads, kill the process to see why
+                    ctl::ctAlwaysFatalCondition(
+                        L"WaitForSingleObject(%p) failed [%u] to wait on the threadpool",
+                        s_rio_worker_threads[loop_workers], ::GetLastError());
+                }
                 ::CloseHandle(s_rio_worker_threads[loop_workers]);
             }
         }
@@ -226,139 +362,99 @@ namespace ctsTraffic {
         s_rio_worker_threads = nullptr;
         s_rio_worker_thread_count = 0;
 
-        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
-        if (s_rio_cq != RIO_INVALID_CQ) {
-            ctl::ctRIOCloseCompletionQueue(s_rio_cq);
-            // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
-            s_rio_cq = RIO_INVALID_CQ;
-        }
-
-        if (s_rio_notify_setttings.Iocp.IocpHandle != nullptr) {
-            ::CloseHandle(s_rio_notify_setttings.Iocp.IocpHandle);
-            s_rio_notify_setttings.Iocp.IocpHandle = nullptr;
-        }
-
-        ::free(s_rio_notify_setttings.Iocp.Overlapped);
-        s_rio_notify_setttings.Iocp.Overlapped = nullptr;
-
-        delete s_prioritized_cs;
-        s_prioritized_cs = nullptr;
-
-        s_rio_cq_size = 0;
-        s_rio_cq_used = 0;
+        // closes every CQ and its IOCP
+        delete s_rio_cq_shards;
+        s_rio_cq_shards = nullptr;
     }
 
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Singleton initialization routine for the global CQ and its corresponding IOCP thread pool
+    /// Singleton initialization routine for the CQ shards and their worker threads
+    /// - each worker thread is given the processor of its shard as its ideal processor
+    /// - with -CpuSet, each worker thread is also pinned to the processors of the set
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static BOOL CALLBACK s_init_once_cq(PINIT_ONCE, PVOID, PVOID *) noexcept
+    static BOOL CALLBACK s_init_once_cq(PINIT_ONCE, PVOID _polled, PVOID *) noexcept
     {
+        s_rio_cq_polled = (_polled != nullptr);
+
         // delete all cq's on error
         ctlScopeGuard(deleteAllCqsOnError, { s_delete_all_cqs(); });
 
-        s_prioritized_cs = new (std::nothrow) ctl::ctPrioritizedCriticalSection;
-        if (nullptr == s_prioritized_cs) {
-            return FALSE;
-        }
-        // delete the prioritized cs on error
-        ctlScopeGuard(deletePrioritzedCsOnError, { delete s_prioritized_cs; });
-
-        ::ZeroMemory(&s_rio_notify_setttings, sizeof s_rio_notify_setttings);
-        // completion key for RioNotify IOCP is the ctsRioIocpImpl*
-        s_rio_notify_setttings.Type = RIO_NOTIFICATION_COMPLETION_TYPE::RIO_IOCP_COMPLETION;
-        s_rio_notify_setttings.Iocp.CompletionKey = nullptr;
-        s_rio_notify_setttings.Iocp.Overlapped = nullptr;
-        s_rio_notify_setttings.Iocp.IocpHandle = nullptr;
-
-        s_rio_notify_setttings.Iocp.Overlapped = ::calloc(1, sizeof OVERLAPPED);
-        if (nullptr == s_rio_notify_setttings.Iocp.Overlapped) {
-            ctsConfig::PrintException(std::bad_alloc());
-            ::SetLastError(WSAENOBUFS);
-            return FALSE;
-        }
-        // free the OVERLAPPED on error
-        ctlScopeGuard(freeOverlappedOnError, { ::free(s_rio_notify_setttings.Iocp.Overlapped); });
-
-        s_rio_notify_setttings.Iocp.IocpHandle = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
-        if (!s_rio_notify_setttings.Iocp.IocpHandle) {
-            const auto gle = ::GetLastError();
-            ctsConfig::PrintException(ctl::ctException(gle, L"CreateIoCompletionPort", L"ctsRioIocp", false));
-            ::SetLastError(gle);
-            return FALSE;
-        }
-        // close the IOCP handle on error
-        ctlScopeGuard(deleteIoCPOnError, { ::CloseHandle(s_rio_notify_setttings.Iocp.IocpHandle); });
+        const DWORD processor_count = ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
 
-        // with RIO, we don't associate the IOCP handle with the socket like 'typical' sockets
-        // - instead we directly pass the IOCP handle through RIOCreateCompletionQueue
-        DWORD new_queue_size = RioDefaultCQSize;
+        // the initial CQ size is split across the shards: each shard grows as needed for the sockets bound to it
+        DWORD total_queue_size = RioDefaultCQSize;
         if (!ctsConfig::IsListening()) {
             // for clients we'll know the CQ size since we know the concurrent connection count
-            new_queue_size = ctsConfig::Settings->ConnectionLimit * 2;
+            total_queue_size = ctsConfig::Settings->ConnectionLimit * 2;
         }
-        s_rio_cq = ctl::ctRIOCreateCompletionQueue(new_queue_size, &s_rio_notify_setttings);
-        // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
-        if (RIO_INVALID_CQ == s_rio_cq) {
-            const auto gle = ::WSAGetLastError();
-            ctsConfig::PrintException(ctl::ctException(gle, L"ctRIOCreateCompletionQueue", L"ctsRioIocp", false));
-            ::SetLastError(gle);
+        const DWORD shard_queue_size = (total_queue_size + processor_count - 1) / processor_count;
+
+        try {
+            s_rio_cq_shards = new ctsCompletionQueueShards<RioCompletionQueue>;
+            for (DWORD loop_shards = 0; loop_shards < processor_count; ++loop_shards) {
+                s_rio_cq_shards->add(std::make_unique<RioCompletionQueue>(shard_queue_size, s_rio_cq_polled));
+            }
+        }
+        catch (const std::exception& e) {
+            ctsConfig::PrintException(e);
+            ::SetLastError(ctl::ctErrorCode(e));
             return FALSE;
         }
-        // close the RIO CQ on error
-        ctlScopeGuard(closeCQOnError, { ctl::ctRIOCloseCompletionQueue(s_rio_cq); });
-
-        // now that the CQ is created, update info
-        s_rio_cq_size = new_queue_size;
-        s_rio_cq_used = 0;
 
         // reserve space for handles
-        SYSTEM_INFO system_info;
-        ::GetSystemInfo(&system_info);
-        s_rio_worker_threads = static_cast<HANDLE*>(::calloc(system_info.dwNumberOfProcessors, sizeof HANDLE));
+        s_rio_worker_threads = static_cast<HANDLE*>(::calloc(processor_count, sizeof HANDLE));
         if (nullptr == s_rio_worker_threads) {
             ctsConfig::PrintException(std::bad_alloc());
             ::SetLastError(WSAENOBUFS);
             return FALSE;
         }
-        // free the handle array on error
-        ctlScopeGuard(freeHandleArrayOnError, { ::free(s_rio_worker_threads); });
+        s_rio_worker_thread_count = processor_count;
 
-        s_rio_worker_thread_count = system_info.dwNumberOfProcessors;
-
-        // now that we are ready to go, kick off our thread-pool
+        // now that we are ready to go, kick off one worker thread per shard
         for (unsigned loop_workers = 0; loop_workers < s_rio_worker_thread_count; ++loop_workers) {
-            s_rio_worker_threads[loop_workers] = ::CreateThread(nullptr, 0, RioIocpThreadProc, nullptr, 0, nullptr);
+            s_rio_worker_threads[loop_workers] = ::CreateThread(
+                nullptr,
+                0,
+                s_rio_cq_polled ? RioPollThreadProc : RioIocpThreadProc,
+                &(*s_rio_cq_shards)[loop_workers],
+                0,
+                nullptr);
             if (!s_rio_worker_threads[loop_workers]) {
                 const auto gle = ::GetLastError();
                 ctsConfig::PrintException(ctl::ctException(gle, L"CreateThread", L"ctsRioIocp", false));
                 ::SetLastError(gle);
                 return FALSE;
             }
-        }
-        // scopedDeleteAllCqs will take care of cleaning up these threads on failure
 
-        // if everything succeeds, post a Notify to catch the first set of IO
-        const auto notify = ctl::ctRIONotify(s_rio_cq);
-        if (notify != NO_ERROR) {
-            ctsConfig::PrintException(ctl::ctException(notify, L"ctRIONotify", L"ctsRioIocp", false));
-            ::SetLastError(notify);
-            return FALSE;
+            // not fatal if the ideal processor can't be set - the scheduler can still run the thread anywhere
+            PROCESSOR_NUMBER ideal_processor = s_processor_from_index(loop_workers);
+            if (!::SetThreadIdealProcessorEx(s_rio_worker_threads[loop_workers], &ideal_processor, nullptr)) {
+                PrintDebugInfo(
+                    L"\t\tctsRioIocp: SetThreadIdealProcessorEx(%u:%u) failed [%u]\n",
+                    ideal_processor.Group, ideal_processor.Number, ::GetLastError());
+            }
+
+            // pinning was explicitly requested: fail if the worker can't be kept on the set
+            if (!ctsConfig::Settings->CpuSetMasks.empty()) {
+                const GROUP_AFFINITY worker_affinity = s_cpu_set_affinity(ideal_processor);
+                if (!::SetThreadGroupAffinity(s_rio_worker_threads[loop_workers], &worker_affinity, nullptr)) {
+                    const auto gle = ::GetLastError();
+                    ctsConfig::PrintException(ctl::ctException(gle, L"SetThreadGroupAffinity", L"ctsRioIocp", false));
+                    ::SetLastError(gle);
+                    return FALSE;
+                }
+            }
         }
+        // deleteAllCqsOnError will take care of cleaning up these threads on failure
 
-        // dismiss all scope guards - successfully initialized
-        freeHandleArrayOnError.dismiss();
-        closeCQOnError.dismiss();
-        deleteIoCPOnError.dismiss();
-        freeOverlappedOnError.dismiss();
-        deletePrioritzedCsOnError.dismiss();
+        // dismiss the scope guard - successfully initialized
         deleteAllCqsOnError.dismiss();
         return TRUE;
     }
 
-    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// RioSocketContext
     ///
@@ -366,11 +462,14 @@ namespace ctsTraffic {
     /// 
     /// This stores all relevant information with regards to the RIO SOCKET
     /// Including encapsulating the RIO_RQ associated with the socket
+    /// - the RQ is bound to the CQ shard of the processor which created the context
+    ///   and all CQ space for the RQ is reserved from that shard
     /// 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     class RioSocketContext {
     private:
         std::weak_ptr<ctsSocket> weak_socket;
+        RioCompletionQueueShard& cq_shard;
         ctl::ctSockaddr remote_sockaddr;
         RIO_RQ rio_rq = RIO_INVALID_RQ;
         RIO_BUF rio_remote_address{};
@@ -390,8 +489,8 @@ namespace ctsTraffic {
                 // guarantee room in the RQ for this next IO
                 if (new_rqueue_used > this->rqueue_reserved) {
                     // making room in the CQ for these next 2 slots in the RQ - can throw
-                    s_make_room_in_cq(RioRQGrowthFactor);
-                    ctlScopeGuard(releaseCqSlotsOnFailure, { s_release_room_in_cq(RioRQGrowthFactor); });
+                    this->cq_shard.make_room(RioRQGrowthFactor);
+                    ctlScopeGuard(releaseCqSlotsOnFailure, { this->cq_shard.release_room(RioRQGrowthFactor); });
 
                     // guarantee room in the RQ for this next IO
                     PrintDebugInfo(
@@ -428,9 +527,136 @@ namespace ctsTraffic {
             this->rqueue_used -= RioRQGrowthFactor;
         }
 
+        ///
+        /// Returns the RIO function used to submit the IO, for error messages
+        ///
+        static const wchar_t* s_rio_function(const ctsIOTask& _task) noexcept
+        {
+            if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
+                return (IOTaskAction::Send == _task.ioAction) ? L"RIOSend" : L"RIOReceive";
+            }
+            return (IOTaskAction::Send == _task.ioAction) ? L"RIOSendEx" : L"RIOReceiveEx";
+        }
+
+        ///
+        /// The RIO backend for ctsSubmissionBatcher
+        /// - sends and receives are separate queues in the RQ, each needing its own doorbell
+        /// - assumes the caller has locked the this->weak_socket -> ctsSocket
+        ///
+        class RioBatchSubmitter {
+        private:
+            RioSocketContext& socket_context;
+            ctsSocket& socket;
+            ctsIOPattern& pattern;
+
+        public:
+            static const size_t QueueCount = 2;
+            static const size_t SendQueue = 0;
+            static const size_t RecvQueue = 1;
+
+            // updated as requests fail to be submitted
+            long refcount_io;
+            bool continue_io = false;
+
+            RioBatchSubmitter(RioSocketContext& _socket_context, ctsSocket& _socket, ctsIOPattern& _pattern, long _refcount_io) noexcept :
+                socket_context(_socket_context),
+                socket(_socket),
+                pattern(_pattern),
+                refcount_io(_refcount_io)
+            {
+            }
+
+            size_t queue_of(const ctsIOTask* _task) const noexcept
+            {
+                return (IOTaskAction::Send == _task->ioAction) ? SendQueue : RecvQueue;
+            }
+
+            DWORD submit(ctsIOTask* _task, bool _defer) noexcept
+            {
+                RIO_BUF rio_buffer;
+                rio_buffer.BufferId = _task->rio_bufferid;
+                rio_buffer.Length = _task->buffer_length;
+                rio_buffer.Offset = _task->buffer_offset;
+                const DWORD flags = _defer ? RIO_MSG_DEFER : 0;
+
+                BOOL submitted = FALSE;
+                if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
+                    if (IOTaskAction::Send == _task->ioAction) {
+                        submitted = ctl::ctRIOSend(this->socket_context.rio_rq, &rio_buffer, 1, flags, _task);
+                    } else {
+                        submitted = ctl::ctRIOReceive(this->socket_context.rio_rq, &rio_buffer, 1, flags, _task);
+                    }
+                } else {
+                    if (IOTaskAction::Send == _task->ioAction) {
+                        const auto pRemote = &this->socket_context.rio_remote_address;
+                        submitted = ctl::ctRIOSendEx(this->socket_context.rio_rq, &rio_buffer, 1, nullptr, pRemote, nullptr, nullptr, flags, _task);
+                    } else {
+                        submitted = ctl::ctRIOReceiveEx(this->socket_context.rio_rq, &rio_buffer, 1, nullptr, nullptr, nullptr, nullptr, flags, _task);
+                    }
+                }
+                return submitted ? NO_ERROR : ::WSAGetLastError();
+            }
+
+            DWORD commit(size_t _queue) const noexcept
+            {
+                BOOL committed = FALSE;
+                if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
+                    committed = (SendQueue == _queue) ?
+                        ctl::ctRIOSend(this->socket_context.rio_rq, nullptr, 0, RIO_MSG_COMMIT_ONLY, nullptr) :
+                        ctl::ctRIOReceive(this->socket_context.rio_rq, nullptr, 0, RIO_MSG_COMMIT_ONLY, nullptr);
+                } else {
+                    committed = (SendQueue == _queue) ?
+                        ctl::ctRIOSendEx(this->socket_context.rio_rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr) :
+                        ctl::ctRIOReceiveEx(this->socket_context.rio_rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+                }
+                // if deferred requests can't be committed they will never complete
+                // - the connection would hang waiting for them
+                // Will kill the test into the debugger to investigate
+                ctl::ctFatalCondition(
+                    !committed,
+                    L"RioSocketContext: failed to commit deferred requests on RQ (%p) [%d]",
+                    this->socket_context.rio_rq, ::WSAGetLastError());
+                return NO_ERROR;
+            }
+
+            void failed(ctsIOTask* _task, DWORD _error) noexcept
+            {
+                ctsConfig::PrintException(ctl::ctException(_error, s_rio_function(*_task), false));
+                if (this->pattern.complete_io(*_task, 0, _error) == ctsIOStatus::ContinueIo) {
+                    this->continue_io = true;
+                }
+                this->refcount_io = this->socket.decrement_io();
+                this->socket_context.release_room_in_rq();
+                delete _task;
+            }
+        };
+        using RioSubmissionBatch = ctsSubmissionBatcher<ctsIOTask*, RioMaxBatchedRequests>;
+
+        ///
+        /// Submits all batched requests: one doorbell each for the sends and the receives in the batch
+        /// - assumes the caller has locked the this->weak_socket -> ctsSocket
+        ///
+        /// Returns true if a request failed to be submitted and the protocol then requested more IO
+        ///
+        bool submit_batch(RioSubmissionBatch& _batch, ctsSocket& _socket, ctsIOPattern& _pattern, long& _refcount_io) noexcept
+        {
+            if (_batch.empty()) {
+                return false;
+            }
+
+            RioBatchSubmitter submitter(*this, _socket, _pattern, _refcount_io);
+            const ctsSubmissionResults results = _batch.flush(submitter);
+            ctsConfig::Settings->TcpStatusDetails.io_requests_submitted.add(results.submitted);
+            ctsConfig::Settings->TcpStatusDetails.io_doorbells.add(results.doorbells);
+
+            _refcount_io = submitter.refcount_io;
+            return submitter.continue_io;
+        }
+
     public:
         explicit RioSocketContext(std::weak_ptr<ctsSocket> _weak_socket)
-        : weak_socket(std::move(_weak_socket))
+        : weak_socket(std::move(_weak_socket)),
+          cq_shard(s_shard_for_current_processor())
         {
             // first initialize the RIO structure
             rio_remote_address.BufferId = RIO_INVALID_BUFFERID;
@@ -449,8 +675,8 @@ namespace ctsTraffic {
                 throw std::exception("ctsRioIocp: invalid socket given to RioSocketContext");
             }
 
-            s_make_room_in_cq(RioRQGrowthFactor);
-            ctlScopeGuard(releaseRoomInCqOnFailure, { s_release_room_in_cq(RioRQGrowthFactor); });
+            this->cq_shard.make_room(RioRQGrowthFactor);
+            ctlScopeGuard(releaseRoomInCqOnFailure, { this->cq_shard.release_room(RioRQGrowthFactor); });
 
             // create the RQ for this socket
             // don't need a scope guard to close the RQ on error - the RQ is freed when the RIO socket is closed
@@ -458,8 +684,8 @@ namespace ctsTraffic {
                 socket,
                 RioRQGrowthFactor / 2, RioMaxDataBuffers,
                 RioRQGrowthFactor / 2, RioMaxDataBuffers,
-                s_rio_cq,
-                s_rio_cq,
+                this->cq_shard.completion_queue().get(),
+                this->cq_shard.completion_queue().get(),
                 this);
             // ReSharper disable once CppZeroConstantCanBeReplacedWithNullptr
             if (RIO_INVALID_RQ == rio_rq) {
@@ -485,7 +711,7 @@ namespace ctsTraffic {
         ~RioSocketContext() noexcept
         {
             // release all the space in the CQ for this RQ
-            s_release_room_in_cq(static_cast<ULONG>(this->rqueue_reserved));
+            this->cq_shard.release_room(static_cast<ULONG>(this->rqueue_reserved));
 
             if (this->rio_remote_address.BufferId != RIO_INVALID_BUFFERID) {
                 ctl::ctRIODeregisterBuffer(this->rio_remote_address.BufferId);
@@ -534,27 +760,7 @@ namespace ctsTraffic {
             // - if the protocol wants more IO even though this failed, 
             //   will return the error from the next IO
             //
-            const wchar_t* RIOFunction = nullptr;
-            if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
-                switch (_task.ioAction) {
-                case IOTaskAction::Recv:
-                    RIOFunction = L"RIOReceive";
-                    break;
-                case IOTaskAction::Send:
-                    RIOFunction = L"RIOSend";
-                    break;
-                }
-            } else {
-                switch (_task.ioAction) {
-                case IOTaskAction::Recv:
-                    RIOFunction = L"RIOReceiveEx";
-                    break;
-                case IOTaskAction::Send:
-                    RIOFunction = L"RIOSendEx";
-                    break;
-                }
-            }
-            _Analysis_assume_(RIOFunction != nullptr);
+            const wchar_t* RIOFunction = s_rio_function(_task);
 
             if (_status != 0) PrintDebugInfo(L"\t\tIO Failed: %ws (%d) [ctsReadWriteIocp]\n", RIOFunction, _status);
 
@@ -594,6 +800,8 @@ namespace ctsTraffic {
         }
         ///
         /// Attempts to send/recv IO on the socket
+        /// - IO is batched while the protocol offers more, then submitted with a single doorbell for the sends
+        ///   and a single doorbell for the receives
         /// Returns the counter of pended IO on the socket
         ///
         LONG execute_io() noexcept
@@ -615,6 +823,8 @@ namespace ctsTraffic {
             // can't initialize to zero - zero indicates to complete_state()
             long refcount_io = -1;
             bool continue_io = true;
+            // every path out of the loop must leave the batch empty
+            RioSubmissionBatch batch;
             // loop until complete_io() doesn't offer IO
             while (continue_io) {
                 DWORD error = NO_ERROR;
@@ -622,10 +832,14 @@ namespace ctsTraffic {
                 // push IO until None is returned
                 const ctsIOTask next_io = shared_pattern->initiate_io();
                 if (IOTaskAction::None == next_io.ioAction) {
-                    break;
+                    // the protocol can request more IO if any batched IO failed to be submitted
+                    continue_io = this->submit_batch(batch, *shared_socket, *shared_pattern, refcount_io);
+                    continue;
                 }
 
                 if (IOTaskAction::GracefulShutdown == next_io.ioAction) {
+                    // batched sends must be submitted before the shutdown
+                    (void) this->submit_batch(batch, *shared_socket, *shared_pattern, refcount_io);
                     if (0 != ::shutdown(rio_socket, SD_SEND)) {
                         error = ::WSAGetLastError();
                     }
@@ -634,6 +848,7 @@ namespace ctsTraffic {
                 }
 
                 if (IOTaskAction::HardShutdown == next_io.ioAction) {
+                    (void) this->submit_batch(batch, *shared_socket, *shared_pattern, refcount_io);
                     // pass through -1 to force an RST with the closesocket
                     error = shared_socket->close_socket(-1);
                     rio_socket = INVALID_SOCKET;
@@ -654,67 +869,27 @@ namespace ctsTraffic {
                     error = WSAENOBUFS;
                 }
 
-                bool release_rq_slots = false;
-                RIO_BUF rio_buffer;
                 if (NO_ERROR == error) {
-                    // with the IOTask, we can construct the RIO_BUF to send/recv
-                    rio_buffer.BufferId = request_context->rio_bufferid;
-                    rio_buffer.Length = request_context->buffer_length;
-                    rio_buffer.Offset = request_context->buffer_offset;
-                    // must ensure we have room in the RQ & CQ before initiating the IO
+                    // must ensure we have room in the RQ & CQ before batching the IO
                     RIOFunction = L"RIOResizeRequestQueue";
                     error = this->make_room_in_rq();
-                    // track to release slots if successfully made room
-                    release_rq_slots = (NO_ERROR == error);
                 }
 
-                if (NO_ERROR == error) {
-                    // invoke the requested IO now that we have room in our queues
-                    if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
-                        switch (request_context->ioAction) {
-                        case IOTaskAction::Recv:
-                            RIOFunction = L"RIOReceive";
-                            if (!ctl::ctRIOReceive(this->rio_rq, &rio_buffer, 1, 0, request_context.get())) {
-                                error = ::WSAGetLastError();
-                            }
-                            break;
-                        case IOTaskAction::Send:
-                            RIOFunction = L"RIOSend";
-                            if (!ctl::ctRIOSend(this->rio_rq, &rio_buffer, 1, 0, request_context.get())) {
-                                error = ::WSAGetLastError();
-                            }
-                            break;
-                        }
-                    } else {
-                        switch (request_context->ioAction) {
-                        case IOTaskAction::Recv:
-                            RIOFunction = L"RIOReceiveEx";
-                            if (!ctl::ctRIOReceiveEx(this->rio_rq, &rio_buffer, 1, nullptr, nullptr, nullptr, nullptr, 0, request_context.get())) {
-                                error = ::WSAGetLastError();
-                            }
-                            break;
-                        case IOTaskAction::Send:
-                            RIOFunction = L"RIOSendEx";
-                            const auto pRemote = &this->rio_remote_address;
-                            if (!ctl::ctRIOSendEx(this->rio_rq, &rio_buffer, 1, nullptr, pRemote, nullptr, nullptr, 0, request_context.get())) {
-                                error = ::WSAGetLastError();
-                            }
-                            break;
-                        }
-                    }
-                }
-
-                // if IO was not initiated, complete the IO back the IO pattern
+                // if IO was not batched, complete the IO back the IO pattern
                 if (error != NO_ERROR) {
                     ctsConfig::PrintException(ctl::ctException(error, RIOFunction, false));
                     continue_io = (shared_pattern->complete_io(next_io, 0, error) == ctsIOStatus::ContinueIo);
                     refcount_io = shared_socket->decrement_io();
-                    if (release_rq_slots) {
-                        this->release_room_in_rq();
+                    if (!continue_io) {
+                        // submit the IO already batched before no longer issuing IO
+                        continue_io = this->submit_batch(batch, *shared_socket, *shared_pattern, refcount_io);
                     }
                 } else {
-                    // don't let the request_context be freed: it's now the context ptr in the RIO request
-                    (void) request_context.release();
+                    // don't let the request_context be freed: it will be the context ptr in the RIO request
+                    batch.queue(request_context.release());
+                    if (batch.full()) {
+                        (void) this->submit_batch(batch, *shared_socket, *shared_pattern, refcount_io);
+                    }
                 }
             } // while (...)
 
@@ -723,17 +898,52 @@ namespace ctsTraffic {
     };
 
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Completes the dequeued IO
+    /// - iterate through each one and take next steps:
+    ///   - once we have no more IO on that socket (returned from complete_io)
+    ///   - delete the socket context
+    ///   - note: interactions with the ctsSocket* are all contained in the socket_context
+    ///           never directly interacting with the ctsSocket* here
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void s_complete_rio_results(_In_reads_(_result_count) const RIORESULT* _rio_results, ULONG _result_count) noexcept
+    {
+        for (ULONG iter_result = 0; iter_result < _result_count; ++iter_result) {
+
+            const ULONG transferred = _rio_results[iter_result].BytesTransferred;
+            const LONG status = _rio_results[iter_result].Status;
+            auto* request_context = reinterpret_cast<ctsIOTask*>(_rio_results[iter_result].RequestContext);
+            auto* socket_context = reinterpret_cast<RioSocketContext*>(_rio_results[iter_result].SocketContext);
+            //
+            // Complete the dequeued IO to track the IO
+            // - will kick off another IO if required
+            // Returns the # of IO outstanding on that socket
+            // - if zero, we're done with it
+            //
+            if (0 == socket_context->complete_io(*request_context, transferred, status)) {
+                delete socket_context;
+            }
+            // always delete the prior request_context
+            delete request_context;
+        } // for (iter_results)
+    }
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// Logic for the thread pool function
     ///
+    /// - one thread per CQ shard, waiting on that shard's IOCP
     /// - Wait for Notify to wake up the IOCP
     /// - once notified, take a reader lock over the cq (hold off the writers)
     ///   - subsequently taking the CS
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static DWORD WINAPI RioIocpThreadProc(LPVOID) noexcept
+    static DWORD WINAPI RioIocpThreadProc(LPVOID _shard) noexcept
     {
+        auto& shard = *static_cast<RioCompletionQueueShard*>(_shard);
+        const HANDLE iocp = shard.completion_queue().iocp();
         RIORESULT rio_result_array[RioResultArrayLength];
 
         for (;;) {
@@ -744,7 +954,7 @@ namespace ctsTraffic {
             // Wait for the IOCP to be queued from RIO that we have results in our CQ
             //
             if (!::GetQueuedCompletionStatus(
-                s_rio_notify_setttings.Iocp.IocpHandle,
+                iocp,
                 &transferred,
                 &Key,
                 &pov,
@@ -757,7 +967,7 @@ namespace ctsTraffic {
                 ctl::ctFatalCondition(
                     (nullptr == pov),
                     L"GetQueuedCompletionStatus(%p) failed [%u] without dequeing any IO",
-                    s_rio_notify_setttings.Iocp.IocpHandle, gle);
+                    iocp, gle);
 
                 // IO was dequeued from the IOCP, meaning the deque operation failed
                 // - if Deque failed, we don't know what is going on
@@ -768,7 +978,7 @@ namespace ctsTraffic {
                 ctl::ctFatalCondition(
                     (nullptr != pov),
                     L"GetQueuedCompletionStatus(%p) dequeued a failed IO [%u] - OVERLAPPED [%p]",
-                    s_rio_notify_setttings.Iocp.IocpHandle, gle, pov);
+                    iocp, gle, pov);
             }
 
             if (ExitCompletionKey == Key) {
@@ -779,39 +989,54 @@ namespace ctsTraffic {
             // Dequeue from the RIO socket under our locks
             // - note: Dequeue will invoke a RIONotify
             //
-            const ULONG deque_result = s_deque_from_cq(rio_result_array);
-
-            // Now that we have dequeued the IO
-            // - iterate through each one and take next steps:
-            //   - once we have no more IO on that socket (returned from complete_io)
-            //   - delete the socket context
-            //   - note: interactions with the ctsSocket* are all contained in the socket_context
-            //           never directly interacting with the ctsSocket* here
-            for (ULONG iter_result = 0; iter_result < deque_result; ++iter_result) {
-
-                transferred = rio_result_array[iter_result].BytesTransferred;
-                const LONG status = rio_result_array[iter_result].Status;
-                auto* request_context = reinterpret_cast<ctsIOTask*>(rio_result_array[iter_result].RequestContext);
-                auto* socket_context = reinterpret_cast<RioSocketContext*>(rio_result_array[iter_result].SocketContext);
-                //
-                // Complete the dequeued IO to track the IO
-                // - will kick off another IO if required
-                // Returns the # of IO outstanding on that socket
-                // - if zero, we're done with it
-                //
-                if (0 == socket_context->complete_io(*request_context, transferred, status)) {
-                    delete socket_context;
-                }
-                // always delete the prior request_context
-                delete request_context;
-            } // for (iter_results)
+            const ULONG deque_result = s_deque_from_cq(shard, rio_result_array);
+            s_complete_rio_results(rio_result_array, deque_result);
         } // for (;;)
 
         return 0;
     } // RioIocpThreadProc
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Logic for the polling thread function
+    ///
+    /// - one thread per CQ shard, continuously dequeuing from that shard's CQ without waiting on a notification
+    ///   - reaping completions across all sockets sharing the CQ with a single dequeue call
+    /// - spins for RioPollSpinCount empty polls before yielding the processor
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static DWORD WINAPI RioPollThreadProc(LPVOID _shard) noexcept
+    {
+        auto& shard = *static_cast<RioCompletionQueueShard*>(_shard);
+        RIORESULT rio_result_array[RioPollResultArrayLength];
+
+        ULONG empty_polls = 0;
+        while (0 == ::InterlockedCompareExchange(&s_rio_poll_exit, 0, 0)) {
+            const ULONG deque_result = s_poll_from_cq(shard, rio_result_array);
+            if (0 == deque_result) {
+                if (++empty_polls < RioPollSpinCount) {
+                    YieldProcessor();
+                } else {
+                    empty_polls = 0;
+                    ::SwitchToThread();
+                }
+                continue;
+            }
 
-    void ctsRioIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+            empty_polls = 0;
+            s_complete_rio_results(rio_result_array, deque_result);
+        }
+
+        return 0;
+    } // RioPollThreadProc
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Initializes the CQ shards (polled or IOCP-notified) and kicks off IO on the socket
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void s_start_rio_io(const std::weak_ptr<ctsSocket>& _weak_socket, bool _polled) noexcept
     {
         // attempt to get a reference to the socket
         auto shared_socket(_weak_socket.lock());
@@ -822,7 +1047,8 @@ namespace ctsTraffic {
         //
         // guarantee fully initialized
         //
-        if (!::InitOnceExecuteOnce(&s_sharedbuffer_initializer, s_init_once_cq, nullptr, nullptr)) {
+        PVOID polled_parameter = _polled ? &s_rio_cq_polled : nullptr;
+        if (!::InitOnceExecuteOnce(&s_sharedbuffer_initializer, s_init_once_cq, polled_parameter, nullptr)) {
             auto gle = ::GetLastError();
             if (0 == gle) {
                 gle = WSAENOBUFS;
@@ -857,4 +1083,14 @@ namespace ctsTraffic {
             delete socket_context;
         }
     }
+
+    void ctsRioIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        s_start_rio_io(_weak_socket, false);
+    }
+
+    void ctsRioPoll(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        s_start_rio_io(_weak_socket, true);
+    }
 }
@@ -13,14 +13,17 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 // cpp headers
 #include <memory>
+#include <vector>
 // os headers
 #include <Windows.h>
 #include <winsock2.h>
 // ctl headers
 #include <ctThreadIocp.hpp>
 #include <ctSockaddr.hpp>
+#include <ctSocketExtensions.hpp>
 // local headers
 #include "ctsConfig.h"
+#include "ctsCoroutine.hpp"
 #include "ctsSocket.h"
 #include "ctsIOTask.hpp"
 #include "ctsSocketGuard.hpp"
@@ -40,66 +43,110 @@ namespace ctsTraffic {
         bool io_started = false;
     };
 
+    static ctsSendRecvStatus ctsDrainIo(SOCKET _socket, const std::shared_ptr<ctsSocket>& _shared_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern) noexcept;
+
     ///
-    /// IO Threadpool completion callback 
+    /// Retrieves the result of an IO request which completed through the IOCP
+    /// - the caller must hold the socket lock
     ///
-    static void ctsIoCompletionCallback(
-        _In_ OVERLAPPED* _overlapped,
-        const std::weak_ptr<ctsSocket>& _weak_socket,
-        const ctsIOTask& _io_task) noexcept
+    static int ctsGetIoResult(SOCKET _socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern, _In_ OVERLAPPED* _overlapped, DWORD& _transferred) noexcept
     {
-        auto shared_socket(_weak_socket.lock());
-        if (!shared_socket) {
-            return;
+        // if we no longer have a valid socket or the pattern was destroyed, return early
+        if (!_shared_pattern || INVALID_SOCKET == _socket) {
+            return WSAECONNABORTED;
         }
-
-        // hold a reference on the iopattern
-        auto shared_pattern = shared_socket->io_pattern();
-
-        // try to get the success/error code and bytes transferred (under the socket lock)
-        int gle = NO_ERROR;
-        DWORD transferred = 0;
-        // scoping the socket lock
-        {
-            const auto socketlock(ctsGuardSocket(shared_socket));
-            const SOCKET socket = socketlock.get();
-            // if we no longer have a valid socket or the pattern was destroyed, return early
-            if (!shared_pattern || INVALID_SOCKET == socket) {
-                gle = WSAECONNABORTED;
-            } else {
-                DWORD flags;
-                if (!::WSAGetOverlappedResult(socket, _overlapped, &transferred, FALSE, &flags)) {
-                    gle = ::WSAGetLastError();
-                }
-            }
+        DWORD flags;
+        if (!::WSAGetOverlappedResult(_socket, _overlapped, &_transferred, FALSE, &flags)) {
+            return ::WSAGetLastError();
         }
+        return NO_ERROR;
+    }
 
+    ///
+    /// Passes the result of an IO request which completed through the IOCP to the protocol
+    /// - returns true if the protocol requested more IO
+    /// - otherwise _gle is updated with the error to complete the socket with
+    ///
+    static bool ctsCompleteIoResult(const std::shared_ptr<ctsIOPattern>& _shared_pattern, const ctsIOTask& _io_task, DWORD _transferred, int& _gle) noexcept
+    {
         // write to PrintError if the IO failed
-        const wchar_t* function = (IOTaskAction::Send == _io_task.ioAction) ? L"WSASend" : L"WSARecv";
-        if (gle != 0) PrintDebugInfo(L"\t\tIO Failed: %ws (%d) [ctsSendRecvIocp]\n", function, gle);
+        const wchar_t* function =
+            (ctsIOTask::BufferType::TransmitFile == _io_task.buffer_type) ? L"TransmitFile" :
+            (IOTaskAction::Send == _io_task.ioAction) ? L"WSASend" : L"WSARecv";
+        if (_gle != 0) PrintDebugInfo(L"\t\tIO Failed: %ws (%d) [ctsSendRecvIocp]\n", function, _gle);
         // see if complete_io requests more IO
-        const ctsIOStatus protocol_status = shared_pattern->complete_io(_io_task, transferred, gle);
+        const ctsIOStatus protocol_status = _shared_pattern->complete_io(_io_task, _transferred, _gle);
         switch (protocol_status) {
         case ctsIOStatus::ContinueIo:
-            // more IO is requested from the protocol : invoke the new IO call while holding a refcount to the prior IO
-            ctsSendRecvIocp(_weak_socket);
-            break;
+            // more IO is requested from the protocol
+            return true;
 
         case ctsIOStatus::CompletedIo:
             // no more IO is requested from the protocol : indicate success
-            gle = NO_ERROR;
+            _gle = NO_ERROR;
             break;
 
         case ctsIOStatus::FailedIo:
             // write out the error to the error log since the protocol sees this as a hard error
-            ctsConfig::PrintErrorIfFailed(function, gle);
+            ctsConfig::PrintErrorIfFailed(function, _gle);
             // protocol sees this as a failure : capture the error the protocol recorded
-            gle = shared_pattern->get_last_error();
+            _gle = _shared_pattern->get_last_error();
             break;
 
         default:
             ctl::ctAlwaysFatalCondition(L"ctsSendRecvIocp : unknown ctsSocket::IOStatus (%u)", static_cast<unsigned>(protocol_status));
         }
+        return false;
+    }
+
+    ///
+    /// The context kept with each pooled IO request for the completion callback
+    ///
+    struct ctsSendRecvIocpRequest
+    {
+        std::weak_ptr<ctsSocket> weak_socket;
+        ctsIOTask io_task;
+    };
+
+    ///
+    /// IO Threadpool completion callback 
+    ///
+    static void ctsIoCompletionCallback(
+        _In_ OVERLAPPED* _overlapped,
+        const std::weak_ptr<ctsSocket>& _weak_socket,
+        const ctsIOTask& _io_task) noexcept
+    {
+        auto shared_socket(_weak_socket.lock());
+        if (!shared_socket) {
+            return;
+        }
+
+        // hold a reference on the iopattern
+        auto shared_pattern = shared_socket->io_pattern();
+
+        // try to get the success/error code and bytes transferred (under the socket lock)
+        int gle = NO_ERROR;
+        DWORD transferred = 0;
+        if (ctsConfig::Settings->RunToCompletionBudget > 0) {
+            // running to completion: take the socket lock once for both this completion and the IO which follows it
+            // - the new IO is drained directly on this thread, while holding the refcount to the prior IO
+            const auto socketlock(ctsGuardSocket(shared_socket));
+            gle = ctsGetIoResult(socketlock.get(), shared_pattern, _overlapped, transferred);
+            if (ctsCompleteIoResult(shared_pattern, _io_task, transferred, gle)) {
+                gle = static_cast<int>(ctsDrainIo(socketlock.get(), shared_socket, shared_pattern).io_errorcode);
+            }
+
+        } else {
+            // scoping the socket lock
+            {
+                const auto socketlock(ctsGuardSocket(shared_socket));
+                gle = ctsGetIoResult(socketlock.get(), shared_pattern, _overlapped, transferred);
+            }
+            if (ctsCompleteIoResult(shared_pattern, _io_task, transferred, gle)) {
+                // more IO is requested from the protocol : invoke the new IO call while holding a refcount to the prior IO
+                ctsSendRecvIocp(_weak_socket);
+            }
+        }
 
         // always decrement *after* attempting new IO : the prior IO is now formally "done"
         if (shared_socket->decrement_io() == 0) {
@@ -108,14 +155,33 @@ namespace ctsTraffic {
         }
     }
 
+    static void ctsIoPooledCompletionCallback(_In_ OVERLAPPED* _overlapped, ctsSendRecvIocpRequest& _request) noexcept
+    {
+        ctsIoCompletionCallback(_overlapped, _request.weak_socket, _request.io_task);
+    }
+
+    ///
+    /// Returns the OVERLAPPED* for IO started by ctsSendRecvIocp
+    ///
+    static OVERLAPPED* ctsNewIocpRequest(const ctl::ctThreadIocp& _thread_pool, const std::shared_ptr<ctsSocket>& _shared_socket, const ctsIOTask& _io_task)
+    {
+        return _thread_pool.new_pooled_request(
+            ctsIoPooledCompletionCallback,
+            ctsSendRecvIocpRequest{ std::weak_ptr<ctsSocket>(_shared_socket), _io_task });
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// Attempts the IO specified in the ctsIOTask on the ctsSocket
     ///
+    /// _new_request returns the OVERLAPPED* for the IO, which determines how its completion is delivered:
+    ///     OVERLAPPED* _new_request(const ctl::ctThreadIocp&, const ctsIOTask&)
+    ///
     /// ** ctsSocket::increment_io must have been called before this function was invoked
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static ctsSendRecvStatus ctsProcessIOTask(SOCKET _socket, const std::shared_ptr<ctsSocket>& _shared_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern, const ctsIOTask& next_io) noexcept
+    template <typename NewRequest>
+    static ctsSendRecvStatus ctsProcessIOTask(SOCKET _socket, const std::shared_ptr<ctsSocket>& _shared_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern, const ctsIOTask& next_io, const NewRequest& _new_request) noexcept
     {
         ctsSendRecvStatus return_status;
 
@@ -145,27 +211,32 @@ namespace ctsTraffic {
         } else {
             try {
                 // attempt to allocate an IO thread-pool object
+                // - pooled requests are reused across IO, so the common path doesn't allocate
                 const std::shared_ptr<ctl::ctThreadIocp>& io_thread_pool(_shared_socket->thread_pool());
-                OVERLAPPED* pov = io_thread_pool->new_request(
-                    [weak_reference = std::weak_ptr<ctsSocket>(_shared_socket), next_io](OVERLAPPED* _ov) noexcept
-                    {
-                        ctsIoCompletionCallback(_ov, weak_reference, next_io);
-                    });
+                OVERLAPPED* pov = _new_request(*io_thread_pool, next_io);
 
-                WSABUF wsabuf;
-                wsabuf.buf = next_io.buffer + next_io.buffer_offset;
-                wsabuf.len = next_io.buffer_length;
+                // a scatter-gather task sends or receives across all its buffers with the one call
+                WSABUF wsabufs[ctsIOTask::MaxBufferSegments];
+                const DWORD wsabuf_count = next_io.fill_wsabufs(wsabufs);
 
                 const wchar_t* function_name;
-                if (IOTaskAction::Send == next_io.ioAction) {
+                if (ctsIOTask::BufferType::TransmitFile == next_io.buffer_type) {
+                    function_name = L"TransmitFile";
+                    // TransmitFile reads from the offset specified in the OVERLAPPED
+                    pov->Offset = next_io.buffer_offset;
+                    pov->OffsetHigh = 0;
+                    if (!ctl::ctTransmitFile(_socket, ctsConfig::Settings->TransmitFileHandle, next_io.buffer_length, 0, pov, nullptr, 0)) {
+                        return_status.io_errorcode = ::WSAGetLastError();
+                    }
+                } else if (IOTaskAction::Send == next_io.ioAction) {
                     function_name = L"WSASend";
-                    if (::WSASend(_socket, &wsabuf, 1, nullptr, 0, pov, nullptr) != 0) {
+                    if (::WSASend(_socket, wsabufs, wsabuf_count, nullptr, 0, pov, nullptr) != 0) {
                         return_status.io_errorcode = ::WSAGetLastError();
                     }
                 } else {
                     function_name = L"WSARecv";
                     DWORD flags = (ctsConfig::Settings->Options & ctsConfig::OptionType::MSG_WAIT_ALL) ? MSG_WAITALL : 0;
-                    if (::WSARecv(_socket, &wsabuf, 1, nullptr, &flags, pov, nullptr) != 0) {
+                    if (::WSARecv(_socket, wsabufs, wsabuf_count, nullptr, &flags, pov, nullptr) != 0) {
                         return_status.io_errorcode = ::WSAGetLastError();
                     }
                 }
@@ -253,7 +324,11 @@ namespace ctsTraffic {
         shared_socket->increment_io();
 
         // run the ctsIOTask (next_io) that was scheduled through the TP timer
-        const ctsSendRecvStatus status = ctsProcessIOTask(socketlock.get(), shared_socket, shared_socket->io_pattern(), next_io);
+        const ctsSendRecvStatus status = ctsProcessIOTask(
+            socketlock.get(), shared_socket, shared_socket->io_pattern(), next_io,
+            [&shared_socket](const ctl::ctThreadIocp& _thread_pool, const ctsIOTask& _io_task) {
+                return ctsNewIocpRequest(_thread_pool, shared_socket, _io_task);
+            });
         // if no IO was started, decrement the IO counter
         if (!status.io_started) {
             if (0 == shared_socket->decrement_io()) {
@@ -273,46 +348,41 @@ namespace ctsTraffic {
         }
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// The function registered with ctsConfig
+    /// Loops until failure or initiate_io returns None
     ///
-    void ctsSendRecvIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    /// IO is always done in the ctsProcessIOTask function,
+    /// - either synchronously or scheduled through a timer object
+    ///
+    /// With -RunToCompletion, IO which completed inline is counted against the socket's budget
+    /// - once the budget is used, the next IO is scheduled through the timer object to run from the threadpool
+    ///   and this loop returns, so other connections get their turn on this thread
+    ///
+    /// ** the caller must hold the socket lock and an IO refcount on the ctsSocket
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static ctsSendRecvStatus ctsDrainIo(SOCKET _socket, const std::shared_ptr<ctsSocket>& _shared_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern) noexcept
     {
-        // attempt to get a reference to the socket
-        auto shared_socket(_weak_socket.lock());
-        if (!shared_socket) {
-            return;
-        }
-        // take a lock on the socket before working with it
-        const auto socketlock(ctsGuardSocket(shared_socket));
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
-        //
-        // loop until failure or initiate_io returns None
-        //
-        // IO is always done in the ctsProcessIOTask function,
-        // - either synchronously or scheduled through a timer object
-        //
-        // The IO refcount must be incremented here to hold an IO count on the socket
-        // - so that we won't inadvertently call complete_state() while IO is still being scheduled
-        //
-        shared_socket->increment_io();
+        const unsigned long inline_budget = ctsConfig::Settings->RunToCompletionBudget;
+        unsigned long inline_completions = 0;
 
         ctsSendRecvStatus status;
         while (!status.io_done) {
-            const ctsIOTask next_io = shared_pattern->initiate_io();
+            const ctsIOTask next_io = _shared_pattern->initiate_io();
             if (IOTaskAction::None == next_io.ioAction) {
                 // nothing failed, just no more IO right now
                 break;
             }
 
             // increment IO for each individual request
-            shared_socket->increment_io();
+            _shared_socket->increment_io();
 
-            if (next_io.time_offset_milliseconds > 0) {
+            const bool yield_io = (inline_budget > 0) && (inline_completions >= inline_budget);
+            if (next_io.time_offset_milliseconds > 0 || next_io.time_offset_microseconds > 0 || yield_io) {
                 // set_timer can throw
                 try {
-                    shared_socket->set_timer(next_io, ctsProcessIOTaskCallback);
+                    _shared_socket->set_timer(next_io, ctsProcessIOTaskCallback);
                     status.io_started = true; // IO started in the context of keeping the count incremented
                 }
                 catch (const std::exception& e) {
@@ -322,23 +392,285 @@ namespace ctsTraffic {
                 }
 
             } else {
-                status = ctsProcessIOTask(socketlock.get(), shared_socket, shared_pattern, next_io);
+                status = ctsProcessIOTask(
+                    _socket, _shared_socket, _shared_pattern, next_io,
+                    [&_shared_socket](const ctl::ctThreadIocp& _thread_pool, const ctsIOTask& _io_task) {
+                        return ctsNewIocpRequest(_thread_pool, _shared_socket, _io_task);
+                    });
+                if (!status.io_started) {
+                    ++inline_completions;
+                }
             }
 
             // if no IO was started, decrement the IO counter
             if (!status.io_started) {
                 // since IO is not pended, remove the refcount
-                if (0 == shared_socket->decrement_io()) {
-                    // this should never be zero as we are holding a reference outside the loop
+                if (0 == _shared_socket->decrement_io()) {
+                    // this should never be zero as the caller is holding a reference
                     ctl::ctAlwaysFatalCondition(
-                        L"The ctsSocket (%p) refcount fell to zero while this function was holding a reference", shared_socket.get());
+                        L"The ctsSocket (%p) refcount fell to zero while this function was holding a reference", _shared_socket.get());
                 }
+            } else if (yield_io) {
+                // the IO scheduled through the threadpool continues this loop
+                break;
             }
         }
+        return status;
+    }
+
+    ///
+    /// The function registered with ctsConfig
+    ///
+    void ctsSendRecvIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        // attempt to get a reference to the socket
+        auto shared_socket(_weak_socket.lock());
+        if (!shared_socket) {
+            return;
+        }
+        // take a lock on the socket before working with it
+        const auto socketlock(ctsGuardSocket(shared_socket));
+        // hold a reference on the iopattern
+        auto shared_pattern(shared_socket->io_pattern());
+        //
+        // The IO refcount must be incremented here to hold an IO count on the socket
+        // - so that we won't inadvertently call complete_state() while IO is still being scheduled
+        //
+        shared_socket->increment_io();
+
+        const ctsSendRecvStatus status = ctsDrainIo(socketlock.get(), shared_socket, shared_pattern);
         // decrement IO at the end to release the refcount held before the loop
         if (0 == shared_socket->decrement_io()) {
             shared_socket->complete_state(status.io_errorcode);
         }
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// -IO:coroutine
+    ///
+    /// The same WSASend/WSARecv IO as ctsSendRecvIocp, driven by a single coroutine per connection
+    /// rather than by callbacks which each re-lock the ctsSocket, re-take the pattern and re-enter ctsSendRecvIocp
+    /// - the coroutine holds the socket and pattern references and one IO refcount for the whole IO stage
+    /// - completions are posted to the coroutine's channel: when it's waiting, it's resumed on the completing thread
+    ///   where it takes the socket lock once to retrieve the result and start the IO which follows it
+    /// - its frame comes from the per-thread ctsCoroutineFramePool
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct ctsCoroutineIoEvent
+    {
+        ctsIOTask io_task;
+        // set when the result must still be retrieved from the OVERLAPPED, which is valid until the coroutine next suspends
+        OVERLAPPED* overlapped = nullptr;
+        DWORD transferred = 0;
+        int error = NO_ERROR;
+        // the task was scheduled on the socket's timer and is now to be started
+        bool scheduled = false;
+        // the task was scheduled on the socket's timer, but the timer was torn down before it ran
+        bool cancelled = false;
+    };
+
+    struct ctsCoroutineIoState
+    {
+        std::shared_ptr<ctsSocket> shared_socket;
+        std::shared_ptr<ctsIOPattern> shared_pattern;
+        ctsCoroutineChannel<ctsCoroutineIoEvent> channel;
+    };
+
+    ///
+    /// The context kept with each pooled IO request started by the coroutine
+    /// - the state lives in the coroutine frame, which can't complete while this request is outstanding
+    ///
+    struct ctsCoroutineIoRequest
+    {
+        ctsCoroutineIoState* state;
+        ctsIOTask io_task;
+    };
+
+    ///
+    /// Posts the event for a task scheduled on the socket's timer exactly once
+    /// - when the timer runs the task, it's posted to be started
+    /// - when ctsSocket::shutdown tears down the timer first, the timer's copy of the callback is destroyed without running:
+    ///   the last reference then posts the task as cancelled, so the coroutine is never left waiting on it
+    ///
+    class ctsCoroutineScheduledIo
+    {
+    public:
+        ctsCoroutineScheduledIo(_In_ ctsCoroutineChannel<ctsCoroutineIoEvent>* _channel, const ctsIOTask& _io_task) noexcept :
+            channel(_channel),
+            io_task(_io_task)
+        {
+        }
+
+        ~ctsCoroutineScheduledIo() noexcept
+        {
+            if (!this->posted) {
+                ctsCoroutineIoEvent cancelled_io{ this->io_task };
+                cancelled_io.error = WSA_OPERATION_ABORTED;
+                cancelled_io.cancelled = true;
+                this->channel->post(std::move(cancelled_io));
+            }
+        }
+
+        void post_scheduled() noexcept
+        {
+            this->posted = true;
+            ctsCoroutineIoEvent scheduled_io{ this->io_task };
+            scheduled_io.scheduled = true;
+            this->channel->post(std::move(scheduled_io));
+        }
+
+        // for when scheduling failed: the caller completes the task itself
+        void dismiss() noexcept
+        {
+            this->posted = true;
+        }
+
+        // non-copyable
+        ctsCoroutineScheduledIo(const ctsCoroutineScheduledIo&) = delete;
+        ctsCoroutineScheduledIo& operator=(const ctsCoroutineScheduledIo&) = delete;
+        ctsCoroutineScheduledIo(ctsCoroutineScheduledIo&&) = delete;
+        ctsCoroutineScheduledIo& operator=(ctsCoroutineScheduledIo&&) = delete;
+
+    private:
+        ctsCoroutineChannel<ctsCoroutineIoEvent>* channel;
+        ctsIOTask io_task;
+        bool posted = false;
+    };
+
+    static void ctsCoroutineIoCompletionCallback(_In_ OVERLAPPED* _overlapped, ctsCoroutineIoRequest& _request) noexcept
+    {
+        // the coroutine retrieves the result itself if it's waiting to be resumed on this thread
+        if (_request.state->channel.post_if_waiting(ctsCoroutineIoEvent{ _request.io_task, _overlapped })) {
+            return;
+        }
+
+        // otherwise retrieve it now: the OVERLAPPED is reused as soon as this callback returns
+        ctsCoroutineIoEvent completed_io{ _request.io_task };
+        {
+            const auto socketlock(ctsGuardSocket(_request.state->shared_socket));
+            completed_io.error = ctsGetIoResult(socketlock.get(), _request.state->shared_pattern, _overlapped, completed_io.transferred);
+        }
+        _request.state->channel.post(std::move(completed_io));
+    }
+
+    static ctsCoroutineTask ctsSendRecvCoroutineIo(std::shared_ptr<ctsSocket> _shared_socket) noexcept
+    {
+        ctsCoroutineIoState state;
+        state.shared_socket = std::move(_shared_socket);
+        state.shared_pattern = state.shared_socket->io_pattern();
+
+        std::vector<ctsCoroutineIoEvent> events;
+        // IO pended on the socket and tasks scheduled on its timer: each will post an event to the channel
+        unsigned long outstanding_io = 0;
+        int gle = NO_ERROR;
+
+        const auto new_request = [&state](const ctl::ctThreadIocp& _thread_pool, const ctsIOTask& _io_task) {
+            return _thread_pool.new_pooled_request(ctsCoroutineIoCompletionCallback, ctsCoroutineIoRequest{ &state, _io_task });
+        };
+        // starts the task now or schedules it on the socket's timer, counting it as outstanding if it will post an event
+        const auto start_io = [&](SOCKET _socket, const ctsIOTask& _io_task, bool _scheduled) noexcept {
+            ctsSendRecvStatus status;
+            try {
+                // make room for the event ahead of time: completion callbacks can then never fail to post it
+                state.channel.reserve(events, outstanding_io + 1);
+                if (!_scheduled && (_io_task.time_offset_milliseconds > 0 || _io_task.time_offset_microseconds > 0)) {
+                    // the event is posted whether the timer runs the task or is torn down first
+                    auto scheduled_io = std::make_shared<ctsCoroutineScheduledIo>(&state.channel, _io_task);
+                    try {
+                        state.shared_socket->set_timer(_io_task, [scheduled_io](const std::weak_ptr<ctsSocket>&, const ctsIOTask&) noexcept {
+                            scheduled_io->post_scheduled();
+                        });
+                    }
+                    catch (...) {
+                        // completed as failed below: it must not also be posted as cancelled
+                        scheduled_io->dismiss();
+                        throw;
+                    }
+                    status.io_started = true;
+                } else {
+                    status = ctsProcessIOTask(_socket, state.shared_socket, state.shared_pattern, _io_task, new_request);
+                }
+            }
+            catch (const std::exception& e) {
+                ctsConfig::PrintException(e);
+                status.io_errorcode = ctl::ctErrorCode(e);
+                status.io_done = (state.shared_pattern->complete_io(_io_task, 0, status.io_errorcode) != ctsIOStatus::ContinueIo);
+                status.io_started = false;
+            }
+            if (status.io_started) {
+                ++outstanding_io;
+            }
+            return status;
+        };
+
+        // the one IO refcount held for the life of the coroutine
+        state.shared_socket->increment_io();
+
+        bool request_io = true;
+        // once the socket's timer is torn down the socket is shutting down: no more IO is started
+        bool timer_cancelled = false;
+        for (;;) {
+            {
+                const auto socketlock(ctsGuardSocket(state.shared_socket));
+                // indexing and copying each event: starting IO can reserve more room in the vector
+                for (size_t index = 0; index < events.size(); ++index) {
+                    ctsCoroutineIoEvent event(events[index]);
+                    --outstanding_io;
+                    if (event.scheduled) {
+                        const ctsSendRecvStatus status = start_io(socketlock.get(), event.io_task, true);
+                        gle = static_cast<int>(status.io_errorcode);
+                        request_io |= !status.io_done;
+                    } else if (event.cancelled) {
+                        timer_cancelled = true;
+                        gle = event.error;
+                        ctsCompleteIoResult(state.shared_pattern, event.io_task, 0, gle);
+                    } else {
+                        if (event.overlapped) {
+                            event.error = ctsGetIoResult(socketlock.get(), state.shared_pattern, event.overlapped, event.transferred);
+                        }
+                        gle = event.error;
+                        request_io |= ctsCompleteIoResult(state.shared_pattern, event.io_task, event.transferred, gle);
+                    }
+                }
+
+                while (request_io && !timer_cancelled) {
+                    const ctsIOTask next_io = state.shared_pattern->initiate_io();
+                    if (IOTaskAction::None == next_io.ioAction) {
+                        // nothing failed, just no more IO right now
+                        break;
+                    }
+                    const ctsSendRecvStatus status = start_io(socketlock.get(), next_io, false);
+                    gle = static_cast<int>(status.io_errorcode);
+                    request_io = !status.io_done;
+                }
+                request_io = false;
+            }
+
+            if (0 == outstanding_io) {
+                break;
+            }
+            co_await state.channel.next(events);
+        }
+
+        if (0 == state.shared_socket->decrement_io()) {
+            state.shared_socket->complete_state(gle);
+        }
+    }
+
+    ///
+    /// The function registered with ctsConfig for -IO:coroutine
+    ///
+    void ctsSendRecvCoroutine(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        auto shared_socket(_weak_socket.lock());
+        if (!shared_socket) {
+            return;
+        }
+
+        if (!ctsSendRecvCoroutineIo(shared_socket).started()) {
+            shared_socket->complete_state(ERROR_NOT_ENOUGH_MEMORY);
+        }
+    }
+
 } // namespace
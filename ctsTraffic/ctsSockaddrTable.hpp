@@ -0,0 +1,156 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <unordered_map>
+// os headers
+#include <Windows.h>
+#include <WinSock2.h>
+#include <ws2ipdef.h>
+// ctl headers
+#include <ctSockaddr.hpp>
+#include <ctScopeGuard.hpp>
+
+namespace ctsTraffic {
+    ///
+    /// Hashes the address, port, and (for IPv6) the flow info and scope of a ctSockaddr
+    /// - consistent with ctSockaddr::operator==, which compares the entire SOCKADDR_STORAGE
+    ///
+    struct ctsSockaddrHash {
+        size_t operator()(const ctl::ctSockaddr& _addr) const noexcept
+        {
+            size_t length;
+            switch (_addr.family()) {
+                case AF_INET:
+                    length = sizeof(SOCKADDR_IN);
+                    break;
+                case AF_INET6:
+                    length = sizeof(SOCKADDR_IN6);
+                    break;
+                default:
+                    length = sizeof(SOCKADDR_STORAGE);
+                    break;
+            }
+
+            // FNV-1a
+#ifdef _WIN64
+            size_t hash = 14695981039346656037ULL;
+            const size_t prime = 1099511628211ULL;
+#else
+            size_t hash = 2166136261UL;
+            const size_t prime = 16777619UL;
+#endif
+            const auto* bytes = reinterpret_cast<const unsigned char*>(_addr.sockaddr_storage());
+            for (size_t offset = 0; offset < length; ++offset) {
+                hash ^= bytes[offset];
+                hash *= prime;
+            }
+            return hash;
+        }
+    };
+
+    ///
+    /// A concurrent map of remote addresses to the objects tracking them
+    /// - the table is split into StripeCount stripes, each an unordered_map under its own SRWLOCK
+    /// - lookups take only the shared lock of one stripe, so readers never block each other
+    ///   and writers only block readers of the same stripe
+    ///
+    template <typename T>
+    class ctsSockaddrTable {
+    public:
+        static const size_t StripeBits = 6;
+        static const size_t StripeCount = 1 << StripeBits;
+
+        ctsSockaddrTable() = default;
+
+        ///
+        /// Returns the object tracking the address, or null if the address isn't in the table
+        ///
+        std::shared_ptr<T> find(const ctl::ctSockaddr& _addr) const noexcept
+        {
+            const Stripe& stripe = this->stripes[stripe_index(_addr)];
+            ::AcquireSRWLockShared(&stripe.lock);
+            const auto found = stripe.entries.find(_addr);
+            std::shared_ptr<T> found_object = (found != stripe.entries.end()) ? found->second : nullptr;
+            ::ReleaseSRWLockShared(&stripe.lock);
+            return found_object;
+        }
+
+        ///
+        /// Adds the object for the address
+        /// - returns false, leaving the table unchanged, if the address is already in the table
+        ///
+        /// - can throw std::bad_alloc
+        ///
+        bool insert(const ctl::ctSockaddr& _addr, std::shared_ptr<T> _object)
+        {
+            Stripe& stripe = this->stripes[stripe_index(_addr)];
+            ::AcquireSRWLockExclusive(&stripe.lock);
+            ctlScopeGuard(releaseLock, { ::ReleaseSRWLockExclusive(&stripe.lock); });
+            return stripe.entries.emplace(_addr, std::move(_object)).second;
+        }
+
+        ///
+        /// Removes the address from the table
+        /// - returns the object which was tracking it (null if none was) so the caller
+        ///   can release the last reference after the stripe's lock is released
+        ///
+        std::shared_ptr<T> erase(const ctl::ctSockaddr& _addr) noexcept
+        {
+            Stripe& stripe = this->stripes[stripe_index(_addr)];
+            std::shared_ptr<T> erased_object;
+            ::AcquireSRWLockExclusive(&stripe.lock);
+            const auto found = stripe.entries.find(_addr);
+            if (found != stripe.entries.end()) {
+                erased_object = std::move(found->second);
+                stripe.entries.erase(found);
+            }
+            ::ReleaseSRWLockExclusive(&stripe.lock);
+            return erased_object;
+        }
+
+        size_t size() const noexcept
+        {
+            size_t total = 0;
+            for (const auto& stripe : this->stripes) {
+                ::AcquireSRWLockShared(&stripe.lock);
+                total += stripe.entries.size();
+                ::ReleaseSRWLockShared(&stripe.lock);
+            }
+            return total;
+        }
+
+        // non-copyable
+        ctsSockaddrTable(const ctsSockaddrTable&) = delete;
+        ctsSockaddrTable& operator=(const ctsSockaddrTable&) = delete;
+        ctsSockaddrTable(ctsSockaddrTable&&) = delete;
+        ctsSockaddrTable& operator=(ctsSockaddrTable&&) = delete;
+
+    private:
+        struct Stripe {
+            mutable SRWLOCK lock = SRWLOCK_INIT;
+            std::unordered_map<ctl::ctSockaddr, std::shared_ptr<T>, ctsSockaddrHash> entries;
+        };
+        Stripe stripes[StripeCount];
+
+        // the stripe is chosen from the high bits of the hash:
+        // unordered_map chooses its bucket from the low bits
+        static size_t stripe_index(const ctl::ctSockaddr& _addr) noexcept
+        {
+            return ctsSockaddrHash()(_addr) >> (sizeof(size_t) * 8 - StripeBits);
+        }
+    };
+}
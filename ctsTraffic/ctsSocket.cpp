@@ -20,6 +20,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 // project headers
 #include "ctsConfig.h"
+#include "ctsPacer.hpp"
 #include "ctsSocketState.h"
 #include "ctsWinsockLayer.h"
 
@@ -30,12 +31,19 @@ namespace ctsTraffic {
     using namespace std;
 
     // default values are assigned in the class declaration
-    ctsSocket::ctsSocket(weak_ptr<ctsSocketState> _parent) : parent(move(_parent))
+    ctsSocket::ctsSocket(weak_ptr<ctsSocketState> _parent) :
+        parent(move(_parent)),
+        tp_environment(ctsConfig::Settings->PTPEnvironment)
     {
         /// using a common spin count from base OS usage & crt usage
         if (!::InitializeCriticalSectionEx(&this->socket_cs, 4000, 0)) {
             throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsSocket", false);
         }
+
+        // the node's threadpool threads only run on the node's processors
+        if (ctsConfig::Settings->NumaBind && ctsConfig::Settings->PTPNodeEnvironments.size() > 1) {
+            this->tp_environment = ctsConfig::Settings->PTPNodeEnvironments[ctsConfig::CurrentNumaNode()];
+        }
     }
 
     _No_competing_thread_
@@ -102,7 +110,7 @@ namespace ctsTraffic {
 
         // must verify a valid socket first to avoid racing destrying the iocp shared_ptr as we try to create it here
         if ((this->socket != INVALID_SOCKET) && (!this->tp_iocp)) {
-            this->tp_iocp = make_shared<ctThreadIocp>(this->socket, ctsConfig::Settings->PTPEnvironment); // can throw
+            this->tp_iocp = make_shared<ctThreadIocp>(this->socket, this->tp_environment); // can throw
         }
 
         return this->tp_iocp;
@@ -301,9 +309,18 @@ namespace ctsTraffic {
     ///
     void ctsSocket::set_timer(const ctsIOTask& _task, function<void(weak_ptr<ctsSocket>, const ctsIOTask&)> _func)
     {
+        if (_task.time_offset_microseconds > 0) {
+            // the pacer can't cancel what it schedules when this socket is shutdown: only hold a weak reference
+            ctsPacer::instance().schedule(
+                [_func = std::move(_func), weak_reference = weak_ptr<ctsSocket>(this->shared_from_this()), _task] () { _func(weak_reference, _task); },
+                _task.time_offset_microseconds,
+                this->tp_environment);
+            return;
+        }
+
         const ctAutoReleaseCriticalSection auto_lock(&this->socket_cs);
         if (!this->tp_timer) {
-            this->tp_timer = make_shared<ctl::ctThreadpoolTimer>(ctsConfig::Settings->PTPEnvironment);
+            this->tp_timer = make_shared<ctl::ctThreadpoolTimer>(this->tp_environment);
         }
         
         // register a weak pointer after creating a shared_ptr from the 'this' ptry
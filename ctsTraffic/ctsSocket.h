@@ -121,7 +121,7 @@ namespace ctsTraffic {
 
         //
         // Function to register a task for completion at the future point in time referenced
-        // - by ctsIOTask::time_offset_milliseconds
+        // - by ctsIOTask::time_offset_milliseconds, or by ctsIOTask::time_offset_microseconds for paced sends
         //
         // set_timer stores a weak_ptr to 'this' ctsSocket object
         // - so that the object lifetime is not maintained just from a scheduled work item
@@ -164,6 +164,9 @@ namespace ctsTraffic {
         /// only guarded when returning to the caller
         std::shared_ptr<ctl::ctThreadIocp>      tp_iocp;
         std::shared_ptr<ctl::ctThreadpoolTimer> tp_timer;
+        // the threadpool IO and timer callbacks run on
+        // - with -NumaBind, the threadpool of the NUMA node this socket was created on
+        PTP_CALLBACK_ENVIRON tp_environment = nullptr;
 
         ctl::ctSockaddr local_sockaddr;
         ctl::ctSockaddr target_sockaddr;
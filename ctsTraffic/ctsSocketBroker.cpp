@@ -19,6 +19,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <algorithm>
 #include <memory>
 #include <iterator>
+#include <vector>
 
 // os headers
 #include <Windows.h>
@@ -28,6 +29,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctLocks.hpp>
 #include <ctThreadPoolTimer.hpp>
 #include <ctScopeGuard.hpp>
+#include <ctTimer.hpp>
 
 // project headers
 #include "ctsConfig.h"
@@ -40,37 +42,105 @@ namespace ctsTraffic {
     using namespace ctl;
     using namespace std;
 
-    // timer to wake up and clean up the socket pool
-    // - delete any closed sockets
-    // - create new sockets
+    // timer to wake up and refill the socket pool
+    // - closed sockets are deleted and replaced as they close:
+    //   the timer only retries creating sockets which previously failed to be created
     unsigned long ctsSocketBroker::s_TimerCallbackTimeoutMs = 333; // millseconds
 
+    //
+    // Splits _total evenly across _count shards, the remainder going to the first shards
+    //
+    static unsigned long ctsShardShare(unsigned long _total, size_t _count, size_t _index) noexcept
+    {
+        const unsigned long share = static_cast<unsigned long>(_total / _count);
+        return (_index < _total % _count) ? share + 1 : share;
+    }
+
+    //
+    // The current QPC value: connect latency is measured in microseconds, finer than ctTimer::snap_qpc_as_msec
+    //
+    static long long ctsSnapQpc() noexcept
+    {
+        LARGE_INTEGER qpc;
+        ::QueryPerformanceCounter(&qpc);
+        return qpc.QuadPart;
+    }
+
+    ctsSocketBroker::Shard::Shard(_In_ ctsSocketBroker* _broker, size_t _shard_index, PTP_CALLBACK_ENVIRON _tp_environment) :
+        broker(_broker),
+        shard_index(_shard_index),
+        tp_environment(_tp_environment)
+    {
+        ::InitializeSListHead(&closed_states);
+
+        if (!::InitializeCriticalSectionEx(&cs, 4000, 0)) {
+            throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsSocketBroker", false);
+        }
+        ctlScopeGuard(deleteCsOnExit, { ::DeleteCriticalSection(&this->cs); });
+
+        refill_work = ::CreateThreadpoolWork(RefillCallback, this, tp_environment);
+        if (nullptr == refill_work) {
+            throw ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsSocketBroker", false);
+        }
+
+        // no failures, dismiss the scope guards
+        deleteCsOnExit.dismiss();
+    }
+
+    ctsSocketBroker::Shard::~Shard() noexcept
+    {
+        // stop the refill work from creating/tearing down the socket pool
+        ::WaitForThreadpoolWorkCallbacks(refill_work, TRUE);
+        ::CloseThreadpoolWork(refill_work);
+
+        // now delete all children, guaranteeing they stop processing
+        // - must do this explicitly before deleting the CS
+        //   in case they were calling back while we called detach
+        socket_pool.clear();
+
+        // now can delete the CS
+        ::DeleteCriticalSection(&cs);
+    }
+
     ctsSocketBroker::ctsSocketBroker() :
         wakeup_timer(std::make_unique<ctThreadpoolTimer>())
     {
+        ULONGLONG total_connections = 0ULL;
+        unsigned long pending_limit = 0UL;
         if (ctsConfig::Settings->AcceptFunction) {
             // server 'accept' settings
-            total_connections_remaining = ctsConfig::Settings->ServerExitLimit;
+            total_connections = ctsConfig::Settings->ServerExitLimit;
             pending_limit = ctsConfig::Settings->AcceptLimit;
 
         } else {
             // client 'connect' settings
             if (ctsConfig::Settings->Iterations == MAXULONGLONG) {
-                total_connections_remaining = MAXULONGLONG;
+                total_connections = MAXULONGLONG;
             } else {
-                total_connections_remaining = ctsConfig::Settings->Iterations * static_cast<ULONGLONG>(ctsConfig::Settings->ConnectionLimit);
+                total_connections = ctsConfig::Settings->Iterations * static_cast<ULONGLONG>(ctsConfig::Settings->ConnectionLimit);
             }
             pending_limit = ctsConfig::Settings->ConnectionLimit;
         }
-        // make sure pending_limit cannot be larger than total_connections_remaining
-        if (pending_limit > total_connections_remaining) {
-            pending_limit = static_cast<unsigned long>(total_connections_remaining);
+        // make sure pending_limit cannot be larger than total_connections
+        if (pending_limit > total_connections) {
+            pending_limit = static_cast<unsigned long>(total_connections);
+        }
+        if (total_connections > static_cast<ULONGLONG>(MAXLONGLONG)) {
+            unlimited_connections = true;
+        } else {
+            connections_remaining = static_cast<LONGLONG>(total_connections);
         }
 
-        if (!::InitializeCriticalSectionEx(&cs, 4000, 0)) {
-            throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsSocketBroker", false);
+        // every shard must be able to pend at least one connection
+        size_t shard_count = (ctsConfig::Settings->BrokerShards > 0) ? ctsConfig::Settings->BrokerShards : 1;
+        if (pending_limit > 0 && shard_count > pending_limit) {
+            shard_count = pending_limit;
+        }
+        if (!ctsConfig::Settings->AcceptFunction &&
+            ctsConfig::Settings->ConnectionThrottleLimit > 0 &&
+            shard_count > ctsConfig::Settings->ConnectionThrottleLimit) {
+            shard_count = ctsConfig::Settings->ConnectionThrottleLimit;
         }
-        ctlScopeGuard(deleteCsOnExit, { ::DeleteCriticalSection(&this->cs); });
 
         // create our manual-reset notification event
         done_event.reset(::CreateEvent(nullptr, TRUE, FALSE, nullptr));
@@ -78,47 +148,74 @@ namespace ctsTraffic {
             throw ctException(::GetLastError(), L"CreateEvent", L"ctsSocketBroker", false);
         }
 
-        // no failures, dismiss the scope guards
-        deleteCsOnExit.dismiss();
+        // only clients pace the connections they create
+        if (!ctsConfig::Settings->AcceptFunction && ctsConfig::Settings->ConnectionRateHigh > 0) {
+            pacing_timer = ::CreateThreadpoolTimer(PacingCallback, this, ctsConfig::Settings->PTPEnvironment);
+            if (nullptr == pacing_timer) {
+                throw ctException(::GetLastError(), L"CreateThreadpoolTimer", L"ctsSocketBroker", false);
+            }
+        }
+        ctlScopeGuard(closePacingTimerOnError, { if (pacing_timer) { ::CloseThreadpoolTimer(pacing_timer); } });
+
+        // shards run on the process threadpool unless -NumaBind is set
+        // - with -NumaBind, spread the shards evenly across the NUMA nodes, each using its node's threadpool
+        //   whose threads only run on the node's processors, so a shard's lists and counters stay in that node's caches
+        //   and the sockets a shard creates also complete their IO on the shard's node
+        const auto& node_environments = ctsConfig::Settings->PTPNodeEnvironments;
+        shards.reserve(shard_count);
+        for (size_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+            PTP_CALLBACK_ENVIRON tp_environment = ctsConfig::Settings->PTPEnvironment;
+            if (ctsConfig::Settings->NumaBind && !node_environments.empty()) {
+                tp_environment = node_environments[shard_index * node_environments.size() / shard_count];
+            }
+
+            shards.push_back(make_unique<Shard>(this, shard_index, tp_environment));
+            Shard& shard = **shards.rbegin();
+            shard.pending_limit = ctsShardShare(pending_limit, shard_count, shard_index);
+            shard.connection_limit = ctsShardShare(ctsConfig::Settings->ConnectionLimit, shard_count, shard_index);
+            shard.throttle_limit = ctsShardShare(ctsConfig::Settings->ConnectionThrottleLimit, shard_count, shard_index);
+        }
+        running_shards = static_cast<LONG>(shard_count);
+
+        closePacingTimerOnError.dismiss();
     }
 
     ctsSocketBroker::~ctsSocketBroker() noexcept
     {
-        // first, turn off the timer to stop creating/tearing down the socket pool
+        // first, turn off the timers to stop scheduling refills
         wakeup_timer.reset();
+        if (pacing_timer) {
+            ::SetThreadpoolTimer(pacing_timer, nullptr, 0, 0);
+            ::WaitForThreadpoolTimerCallbacks(pacing_timer, TRUE);
+            ::CloseThreadpoolTimer(pacing_timer);
+        }
 
-        // now delete all children, guaranteeing they stop processing
-        // - must do this explicitly before deleting the CS
-        //   in case they were calling back while we called detach
-        socket_pool.clear();
-
-        // now can delete the CS
-        ::DeleteCriticalSection(&cs);
+        // now delete all shards, each stopping its refill work before deleting its sockets
+        shards.clear();
     }
 
     void ctsSocketBroker::start()
     {
         PrintDebugInfo(
-            L"\t\tStarting broker: total connections remaining (%llu), pending limit (%u)\n",
-            total_connections_remaining, pending_limit);
-
-        // must always guard access to the vector
-        const ctAutoReleaseCriticalSection csLock(&cs);
-
-        // only loop to pending_limit
-        while (total_connections_remaining > 0 && pending_sockets < pending_limit) {
-            // for outgoing connections, limit to ConnectionThrottleLimit 
-            // - to prevent killing the box with DPCs with too many concurrent connect attempts
-            // checking first since TimerCallback might have already established connections
-            if (!ctsConfig::Settings->AcceptFunction &&
-                this->pending_sockets >= ctsConfig::Settings->ConnectionThrottleLimit) {
-                break;
-            }
+            L"\t\tStarting broker: total connections remaining (%lld%ws), shards (%Iu)\n",
+            unlimited_connections ? -1LL : connections_remaining,
+            unlimited_connections ? L" - unlimited" : L"",
+            shards.size());
+
+        if (pacing_timer) {
+            rate_start_ms = ctTimer::snap_qpc_as_msec();
+            rate_limiter = make_unique<ctsConnectionRateLimiter>(
+                ctsConnectionRateSchedule(
+                    ctsConfig::Settings->ConnectionRateLow,
+                    ctsConfig::Settings->ConnectionRateHigh,
+                    ctsConfig::Settings->ConnectionRateRampSeconds * 1000LL),
+                rate_start_ms);
+        }
 
-            socket_pool.push_back(make_shared<ctsSocketState>(shared_from_this()));
-            (*this->socket_pool.rbegin())->start();
-            ++this->pending_sockets;
-            --this->total_connections_remaining;
+        for (auto& shard : shards) {
+            // must always guard access to the vector
+            const ctAutoReleaseCriticalSection csLock(&shard->cs);
+            this->create_sockets(*shard);
         }
 
         // intiate the threadpool timer
@@ -132,39 +229,62 @@ namespace ctsTraffic {
     // - and will be pumping IO
     // Update pending and active counts under guard
     //
-    void ctsSocketBroker::initiating_io() noexcept
+    void ctsSocketBroker::initiating_io(ctsSocketState& _socket_state) noexcept
     {
-        const ctAutoReleaseCriticalSection lock_broker(&this->cs);
+        Shard& shard = *this->shards[_socket_state.shard_index];
+        {
+            const ctAutoReleaseCriticalSection lock_shard(&shard.cs);
+
+            ctFatalCondition(
+                (shard.pending_sockets == 0),
+                L"ctsSocketBroker::initiating_io - About to decrement pending_sockets, but pending_sockets == 0 (active_sockets == %u)",
+                shard.active_sockets);
 
-        ctFatalCondition(
-            (this->pending_sockets == 0),
-            L"ctsSocketBroker::initiating_io - About to decrement pending_sockets, but pending_sockets == 0 (active_sockets == %u)",
-            this->active_sockets);
+            --shard.pending_sockets;
+            ++shard.active_sockets;
+        }
 
-        --this->pending_sockets;
-        ++this->active_sockets;
+        if (this->rate_limiter) {
+            const long long latency_usec = (ctsSnapQpc() - _socket_state.connect_start_qpc) * 1000000LL / ctTimer::snap_qpf();
+            ctsConfig::Settings->ConnectionRateDetails.connected(ctTimer::snap_qpc_as_msec() - this->rate_start_ms, latency_usec);
+        }
+
+        // a pending slot just opened: a new connection can be created
+        schedule_refill(shard);
     }
     //
     // SocketState is indicating the socket is now 'closed'
     // Update pending or active counts (depending on prior state) under guard
+    // Then queue the closed ctsSocketState to be deleted and replaced
     //
-    void ctsSocketBroker::closing(bool _was_active) noexcept
+    void ctsSocketBroker::closing(ctsSocketState& _socket_state, bool _was_active) noexcept
     {
-        const ctAutoReleaseCriticalSection lock_broker(&this->cs);
+        Shard& shard = *this->shards[_socket_state.shard_index];
+        {
+            const ctAutoReleaseCriticalSection lock_shard(&shard.cs);
+
+            if (_was_active) {
+                ctFatalCondition(
+                    (shard.active_sockets == 0),
+                    L"ctsSocketBroker::closing - About to decrement active_sockets, but active_sockets == 0 (pending_sockets == %u)",
+                    shard.pending_sockets);
+                --shard.active_sockets;
+            } else {
+                ctFatalCondition(
+                    (shard.pending_sockets == 0),
+                    L"ctsSocketBroker::closing - About to decrement pending_sockets, but pending_sockets == 0 (active_sockets == %u)",
+                    shard.active_sockets);
+                --shard.pending_sockets;
+            }
+        }
 
-        if (_was_active) {
-            ctFatalCondition(
-                (this->active_sockets == 0),
-                L"ctsSocketBroker::closing - About to decrement active_sockets, but active_sockets == 0 (pending_sockets == %u)",
-                this->pending_sockets);
-            --this->active_sockets;
-        } else {
-            ctFatalCondition(
-                (this->pending_sockets == 0),
-                L"ctsSocketBroker::closing - About to decrement pending_sockets, but pending_sockets == 0 (active_sockets == %u)",
-                this->active_sockets);
-            --this->pending_sockets;
+        if (this->rate_limiter && !_was_active) {
+            ctsConfig::Settings->ConnectionRateDetails.connect_failed(ctTimer::snap_qpc_as_msec() - this->rate_start_ms);
         }
+
+        // the closed socket can't be deleted inline: this is invoked from its own threadpool callback
+        ::InterlockedPushEntrySList(&shard.closed_states, &_socket_state.closed_entry);
+        schedule_refill(shard);
     }
 
     bool ctsSocketBroker::wait(DWORD _milliseconds) const noexcept
@@ -192,76 +312,210 @@ namespace ctsTraffic {
         return fReturn;
     }
 
+    bool ctsSocketBroker::claim_connection() noexcept
+    {
+        if (this->unlimited_connections) {
+            return true;
+        }
+
+        LONGLONG remaining = ::InterlockedCompareExchange64(&this->connections_remaining, 0LL, 0LL);
+        while (remaining > 0) {
+            const LONGLONG prior = ::InterlockedCompareExchange64(&this->connections_remaining, remaining - 1, remaining);
+            if (prior == remaining) {
+                return true;
+            }
+            remaining = prior;
+        }
+        return false;
+    }
+
+    void ctsSocketBroker::release_connection() noexcept
+    {
+        if (!this->unlimited_connections) {
+            ::InterlockedIncrement64(&this->connections_remaining);
+        }
+    }
+
+    bool ctsSocketBroker::connections_exhausted() const noexcept
+    {
+        if (this->unlimited_connections) {
+            return false;
+        }
+        return 0LL == ::InterlockedCompareExchange64(const_cast<volatile LONGLONG*>(&this->connections_remaining), 0LL, 0LL);
+    }
+
+    void ctsSocketBroker::schedule_refill(Shard& _shard) noexcept
+    {
+        if (0 == ::InterlockedExchange(&_shard.refill_queued, 1)) {
+            ::SubmitThreadpoolWork(_shard.refill_work);
+        }
+    }
+
+    void ctsSocketBroker::schedule_pacing() noexcept
+    {
+        if (0 == ::InterlockedExchange(&this->pacing_scheduled, 1)) {
+            FILETIME due_time(ctTimer::convert_msec_relative_filetime(
+                this->rate_limiter->delay_until_next(ctTimer::snap_qpc_as_msec())));
+            ::SetThreadpoolTimer(this->pacing_timer, &due_time, 0, 0);
+        }
+    }
+
     //
-    // Timer callback to scavenge any closed sockets
-    // Then refresh sockets that should be created anew
+    // Must be called holding the shard's cs
+    //
+    void ctsSocketBroker::create_sockets(Shard& _shard)
+    {
+        // only loop to the shard's pending_limit
+        while (_shard.pending_sockets < _shard.pending_limit) {
+            // not throttling the server accepting sockets based off total # of connections (pending + active)
+            // - only throttling total connections for outgoing connections
+            if (!ctsConfig::Settings->AcceptFunction) {
+                if ((_shard.pending_sockets + _shard.active_sockets) >= _shard.connection_limit) {
+                    break;
+                }
+                // for outgoing connections, limit to this shard's share of ConnectionThrottleLimit
+                // - to prevent killing the box with DPCs with too many concurrent connect attempts
+                if (_shard.pending_sockets >= _shard.throttle_limit) {
+                    break;
+                }
+            }
+
+            // with -ConnectionRate, wait for the rate limiter to allow the next connection
+            if (this->rate_limiter && !this->rate_limiter->try_claim(ctTimer::snap_qpc_as_msec())) {
+                this->schedule_pacing();
+                break;
+            }
+            ctlScopeGuard(releaseRateOnExit, { if (this->rate_limiter) { this->rate_limiter->release(); } });
+
+            if (!this->claim_connection()) {
+                break;
+            }
+            ctlScopeGuard(releaseConnectionOnExit, { this->release_connection(); });
+
+            _shard.socket_pool.push_back(make_shared<ctsSocketState>(shared_from_this(), _shard.tp_environment));
+            auto& new_state = *_shard.socket_pool.rbegin();
+            new_state->shard_index = _shard.shard_index;
+            new_state->pool_index = _shard.socket_pool.size() - 1;
+            new_state->connect_start_qpc = ctsSnapQpc();
+            new_state->start();
+
+            releaseRateOnExit.dismiss();
+            releaseConnectionOnExit.dismiss();
+            ++_shard.pending_sockets;
+        }
+    }
+
+    VOID NTAPI ctsSocketBroker::RefillCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept
+    {
+        auto* shard = static_cast<Shard*>(_context);
+        // reset before refilling: a socket closing from here on must schedule another pass
+        ::InterlockedExchange(&shard->refill_queued, 0);
+        shard->broker->refill(*shard);
+    }
+
+    //
+    // Timer callback to retry refilling the pools
+    // - closed sockets schedule the refill as they close, so the timer only needs to catch
+    //   sockets which failed to be created on a prior pass
     //
     void ctsSocketBroker::TimerCallback(_In_ ctsSocketBroker* _broker) noexcept
     {
-        // removed_objects will delete the closed objects outside of the broker lock
+        for (auto& shard : _broker->shards) {
+            schedule_refill(*shard);
+        }
+    }
+
+    VOID NTAPI ctsSocketBroker::PacingCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept
+    {
+        auto* broker = static_cast<ctsSocketBroker*>(_context);
+        // reset before refilling: a shard blocked by the rate limiter from here on must set the timer again
+        ::InterlockedExchange(&broker->pacing_scheduled, 0);
+        for (auto& shard : broker->shards) {
+            schedule_refill(*shard);
+        }
+    }
+
+    //
+    // Deletes the shard's sockets which have closed since the last pass
+    // Then refresh sockets that should be created anew
+    //
+    void ctsSocketBroker::refill(Shard& _shard) noexcept
+    {
+        // removed_objects will delete the closed objects outside of the shard lock
         vector<shared_ptr<ctsSocketState>> removed_objects;
         {
-            if (!::TryEnterCriticalSection(&_broker->cs)) {
-                return;
-            }
-
-            // refresh our pool of sockets if more sockets should be added
-            try {
-                //
-                // Everything must occur under the broker lock
-                // - touching the socket_pool
-                // - touching the socket / connection counters
-                //
-                for (auto& socket_pool_entry : _broker->socket_pool) {
-                    if (ctsSocketState::InternalState::Closed == socket_pool_entry->current_state()) {
-                        removed_objects.push_back(socket_pool_entry);
-                        socket_pool_entry.reset();
+            const ctAutoReleaseCriticalSection lock_shard(&_shard.cs);
+
+            // take only the sockets which have closed: each is removed from socket_pool in O(1)
+            PSLIST_ENTRY closed_entry = ::InterlockedFlushSList(&_shard.closed_states);
+            while (closed_entry != nullptr) {
+                PSLIST_ENTRY next_entry = closed_entry->Next;
+                ctsSocketState* closed_state = CONTAINING_RECORD(closed_entry, ctsSocketState, closed_entry);
+                const size_t closed_index = closed_state->pool_index;
+                ctFatalCondition(
+                    (closed_index >= _shard.socket_pool.size() || _shard.socket_pool[closed_index].get() != closed_state),
+                    L"ctsSocketBroker::refill - closed ctsSocketState (%p) is not in the socket pool of shard %Iu at index %Iu",
+                    closed_state, _shard.shard_index, closed_index);
+
+                try {
+                    removed_objects.push_back(move(_shard.socket_pool[closed_index]));
+                }
+                catch (const exception&) {
+                    // put back the sockets not yet removed to be deleted on the next pass
+                    while (closed_entry != nullptr) {
+                        next_entry = closed_entry->Next;
+                        ::InterlockedPushEntrySList(&_shard.closed_states, closed_entry);
+                        closed_entry = next_entry;
                     }
+                    break;
                 }
 
-                _broker->socket_pool.erase(
-                    remove(
-                        begin(_broker->socket_pool),
-                        end(_broker->socket_pool),
-                        nullptr),
-                    end(_broker->socket_pool));
-
-                if (0 == _broker->total_connections_remaining &&
-                    0 == _broker->pending_sockets &&
-                    0 == _broker->active_sockets) {
-                    // it's time to exit if no more work is to be done
-                    ::SetEvent(_broker->done_event.get());
-
-                } else {
-                    // don't spin up more if the user asked to shutdown
-                    if (WAIT_OBJECT_0 != ::WaitForSingleObject(_broker->done_event.get(), 0)) {
-                        // catch up to the expected # of pended connections
-                        while (_broker->pending_sockets < _broker->pending_limit && _broker->total_connections_remaining > 0) {
-                            // not throttling the server accepting sockets based off total # of connections (pending + active)
-                            // - only throttling total connections for outgoing connections
-                            if (!ctsConfig::Settings->AcceptFunction) {
-                                if ((_broker->pending_sockets + _broker->active_sockets) >= ctsConfig::Settings->ConnectionLimit) {
-                                    break;
-                                }
-                                // throttle pending connection attempts as specified
-                                if (_broker->pending_sockets >= ctsConfig::Settings->ConnectionThrottleLimit) {
-                                    break;
-                                }
-                            }
-
-                            _broker->socket_pool.push_back(make_shared<ctsSocketState>(_broker->shared_from_this()));
-                            (*_broker->socket_pool.rbegin())->start();
-                            ++_broker->pending_sockets;
-                            --_broker->total_connections_remaining;
-                        }
-                    }
+                // swap the last socket into the closed socket's slot
+                if (closed_index != _shard.socket_pool.size() - 1) {
+                    _shard.socket_pool[closed_index] = move(_shard.socket_pool.back());
+                    _shard.socket_pool[closed_index]->pool_index = closed_index;
                 }
+                _shard.socket_pool.pop_back();
+
+                closed_entry = next_entry;
+            }
+        }
+
+        // delete the closed sockets before creating new sockets
+        // - must not hold the shard lock: ~ctsSocketState waits for its threadpool callbacks to complete
+        removed_objects.clear();
+
+        // refresh our pool of sockets if more sockets should be added
+        const ctAutoReleaseCriticalSection lock_shard(&_shard.cs);
+        if (_shard.done) {
+            return;
+        }
+
+        //
+        // Everything must occur under the shard lock
+        // - touching the socket_pool
+        // - touching the socket / connection counters
+        //
+        // don't spin up more if the user asked to shutdown
+        if (WAIT_OBJECT_0 != ::WaitForSingleObject(this->done_event.get(), 0)) {
+            try {
+                // catch up to the expected # of pended connections
+                this->create_sockets(_shard);
             }
             catch (const exception&) {
                 // if failed to create a socket will eventually reschedule
             }
+        }
 
-            ::LeaveCriticalSection(&_broker->cs);
+        if (0 == _shard.pending_sockets &&
+            0 == _shard.active_sockets &&
+            this->connections_exhausted()) {
+            // this shard will never create another socket
+            // - it's time to exit once no shard has more work to be done
+            _shard.done = true;
+            if (0 == ::InterlockedDecrement(&this->running_shards)) {
+                ::SetEvent(this->done_event.get());
+            }
         }
     }
 
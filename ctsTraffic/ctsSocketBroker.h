@@ -23,6 +23,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctHandle.hpp>
 // project headers
 #include "ctsSocketState.h"
+#include "ctsConnectionRate.hpp"
 
 namespace ctsTraffic {
 
@@ -32,9 +33,9 @@ namespace ctsTraffic {
 
     class ctsSocketBroker : public std::enable_shared_from_this<ctsSocketBroker> {
     public:
-        // timer to wake up and clean up the socket pool
-        // - delete any closed sockets
-        // - create new sockets
+        // timer to wake up and refill the socket pool
+        // - closed sockets are deleted and replaced as they close:
+        //   the timer only retries creating sockets which previously failed to be created
         static unsigned long s_TimerCallbackTimeoutMs;
 
         // only the c'tor can throw
@@ -44,8 +45,10 @@ namespace ctsTraffic {
         void start();
 
         // methods that the child ctsSocketState objects will invoke when they change state
-        void initiating_io() noexcept;
-        void closing(bool _was_active) noexcept;
+        // - each is routed to the shard which created the ctsSocketState
+        // - closing() is given the ctsSocketState once it's Closed, to be deleted and replaced
+        void initiating_io(ctsSocketState& _socket_state) noexcept;
+        void closing(ctsSocketState& _socket_state, bool _was_active) noexcept;
 
         // method to wait on when all connections are completed
         bool wait(DWORD _milliseconds) const noexcept;
@@ -57,28 +60,118 @@ namespace ctsTraffic {
         ctsSocketBroker& operator=(ctsSocketBroker&&) = delete;
 
     private:
-        // CS to guard access to the vector socket_pool
-        CRITICAL_SECTION cs{};
+        //
+        // The broker splits its sockets across shards
+        // - each shard has its own lock, socket pool, counters and refill work
+        //   so connections created and closed on different shards never contend
+        // - each shard's limits are its share of the global pending, connection and throttle limits
+        // - only the total number of connections to create is shared, through the broker's budget
+        //
+        struct Shard {
+            Shard(_In_ ctsSocketBroker* _broker, size_t _shard_index, PTP_CALLBACK_ENVIRON _tp_environment);
+            ~Shard() noexcept;
+
+            // closed sockets pushed by closing() without taking the lock, waiting to be deleted and replaced
+            SLIST_HEADER closed_states{};
+            // CS to guard access to the vector socket_pool and the counters
+            CRITICAL_SECTION cs{};
+            // vector of currently active sockets
+            // must be shared_ptr since ctsSocketState derives from enable_shared_from_this
+            // - and thus there must be at least one refcount on that object to call shared_from_this()
+            // each ctsSocketState tracks its index in the vector, so closed sockets are removed in O(1)
+            std::vector<std::shared_ptr<ctsSocketState>> socket_pool{};
+            ctsSocketBroker* broker = nullptr;
+            size_t shard_index = 0;
+            // the threadpool running the refill work and the socket state machines
+            // - with -NumaBind, the threadpool of this shard's NUMA node, whose threads are pinned to the node's processors
+            PTP_CALLBACK_ENVIRON tp_environment = nullptr;
+            // threadpool work to delete closed sockets and create their replacements
+            PTP_WORK refill_work = nullptr;
+            // set while refill_work is submitted and has not yet started running
+            // - so closing many sockets at once submits the work only once
+            volatile LONG refill_queued = 0L;
+            // track what's pended and what's active
+            unsigned long pending_limit = 0UL;
+            unsigned long connection_limit = 0UL;
+            unsigned long throttle_limit = 0UL;
+            unsigned long pending_sockets = 0UL;
+            unsigned long active_sockets = 0UL;
+            // set once this shard has no sockets and the budget is spent
+            bool done = false;
+
+            // not copyable
+            Shard(const Shard&) = delete;
+            Shard& operator=(const Shard&) = delete;
+            Shard(Shard&&) = delete;
+            Shard& operator=(Shard&&) = delete;
+        };
+
         // notification event when we're done
         ctl::ctScopedHandle done_event{};
-        // vector of currently active sockets
-        // must be shared_ptr since ctsSocketState derives from enable_shared_from_this
-        // - and thus there must be at least one refcount on that object to call shared_from_this()
-        std::vector<std::shared_ptr<ctsSocketState>> socket_pool{};
-        // timer to initiate the savenge routine TimerCallback()
+        std::vector<std::unique_ptr<Shard>> shards{};
+        // timer to retry refilling the pools through TimerCallback()
         std::unique_ptr<ctl::ctThreadpoolTimer> wakeup_timer{};
-        // keep a burn-down count as connections are made to know when to be 'done'
-        ULONGLONG total_connections_remaining = 0ULL;
-        // track what's pended and what's active
-        unsigned long pending_limit = 0UL;
-        unsigned long pending_sockets = 0UL;
-        unsigned long active_sockets = 0UL;
+        // keep a burn-down count as connections are made across all shards to know when to be 'done'
+        // - not counted when unlimited_connections (connections are created until the user exits)
+        volatile LONGLONG connections_remaining = 0LL;
+        bool unlimited_connections = false;
+        // the number of shards not yet done: the broker is done once every shard is done
+        volatile LONG running_shards = 0L;
+        // paces new client connections with -ConnectionRate across all shards
+        // - null when new connections are not paced
+        std::unique_ptr<ctsConnectionRateLimiter> rate_limiter{};
+        long long rate_start_ms = 0LL;
+        // timer to resume creating connections once the rate_limiter allows another
+        PTP_TIMER pacing_timer = nullptr;
+        // set while pacing_timer is waiting to fire
+        // - so every shard blocked by the rate_limiter sets the timer only once
+        volatile LONG pacing_scheduled = 0L;
+
+        //
+        // Takes one connection from the budget shared by all shards
+        // - returns false if the budget is spent
+        //
+        bool claim_connection() noexcept;
+        void release_connection() noexcept;
+        bool connections_exhausted() const noexcept;
+
+        //
+        // Submits the shard's refill_work unless it's already waiting to run
+        //
+        static void schedule_refill(Shard& _shard) noexcept;
+
+        //
+        // Sets pacing_timer for when the rate_limiter allows another connection, unless it's already set
+        //
+        void schedule_pacing() noexcept;
 
         //
-        // Callback for the threadpool timer to scavenge closed sockets and recreate new ones
+        // Creates new ctsSocketStates in the shard up to its limits, starting each
+        // - must be called holding the shard's cs
+        // - can throw on failure to create a new ctsSocketState
+        //
+        void create_sockets(Shard& _shard);
+
+        //
+        // Deletes the shard's sockets queued by closing(), then creates new sockets up to its limits
+        //
+        void refill(Shard& _shard) noexcept;
+
+        //
+        // Callback for the threadpool work to delete closed sockets and create new ones
         // - this allows destroying ctsSockets outside of an inline path from ctsSocket
         //
+        static VOID NTAPI RefillCallback(PTP_CALLBACK_INSTANCE /*_instance*/, PVOID _context, PTP_WORK /*_work*/) noexcept;
+
+        //
+        // Callback for the threadpool timer to retry creating new sockets
+        //
         static void TimerCallback(_In_ ctsSocketBroker* _broker) noexcept;
+
+        //
+        // Callback for pacing_timer to resume creating connections on every shard
+        //
+        static VOID NTAPI PacingCallback(PTP_CALLBACK_INSTANCE /*_instance*/, PVOID _context, PTP_TIMER /*_timer*/) noexcept;
     };
 
 } // namespace
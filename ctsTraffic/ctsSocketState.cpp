@@ -37,14 +37,19 @@ namespace ctsTraffic {
     using namespace ctl;
     using namespace std;
 
-    ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker) 
+    ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker)
+    : ctsSocketState(move(_broker), ctsConfig::Settings->PTPEnvironment)
+    {
+    }
+
+    ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker, PTP_CALLBACK_ENVIRON _tp_environment)
     : broker(move(_broker))
     {
         if (!::InitializeCriticalSectionEx(&state_guard, 4000, 0)) {
             throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsSocketState", false);
         }
 
-        thread_pool_worker = ::CreateThreadpoolWork(ThreadPoolWorker, this, ctsConfig::Settings->PTPEnvironment);
+        thread_pool_worker = ::CreateThreadpoolWork(ThreadPoolWorker, this, _tp_environment);
         if (nullptr == thread_pool_worker) {
             const auto gle = ::GetLastError();
             ::DeleteCriticalSection(&state_guard);
@@ -154,7 +159,7 @@ namespace ctsTraffic {
             // always notify the broker
             auto parent = broker.lock();
             if (parent) {
-                parent->initiating_io();
+                parent->initiating_io(*this);
             }
         }
         //
@@ -263,15 +268,16 @@ namespace ctsTraffic {
                     ctsConfig::Settings->ClosingFunction(context->socket);
                 }
 
-                // update the state last, since ctsBroker looks for this state value
-                // - to know when to delete the ctsSocketState instance
+                // update the state last, then hand this instance back to the broker
+                // - the broker deletes it from its own threadpool work (waiting for this callback to return)
+                //   and creates its replacement
                 ::EnterCriticalSection(&context->state_guard);
                 context->state = InternalState::Closed;
                 ::LeaveCriticalSection(&context->state_guard);
 
                 auto parent = context->broker.lock();
                 if (parent) {
-                    parent->closing(context->initiated_io);
+                    parent->closing(*context, context->initiated_io);
                 }
                 
                 PrintDebugInfo(L"\t\tctsSocketState Closed\n");
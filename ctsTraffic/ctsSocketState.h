@@ -53,8 +53,10 @@ namespace ctsTraffic {
 
         //
         // c'tor requiring a parent ctsSocketBroker
+        // - state transitions run on the given threadpool environment (ctsConfig::Settings->PTPEnvironment if not given)
         //
         explicit ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker);
+        ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker, PTP_CALLBACK_ENVIRON _tp_environment);
 
         ~ctsSocketState() noexcept;
 
@@ -96,6 +98,19 @@ namespace ctsTraffic {
         int                            last_error = 0UL;
         bool                           initiated_io = false;
 
+        //
+        // maintained by the parent ctsSocketBroker
+        // - closed_entry links this object into its broker shard's lock-free list of closed sockets
+        // - shard_index is the broker shard which created this object
+        // - pool_index is this object's position in that shard's socket pool
+        // - connect_start_qpc is when the broker started this object, to measure connect latency with -ConnectionRate
+        //
+        friend class ctsSocketBroker;
+        SLIST_ENTRY                    closed_entry{};
+        size_t                         shard_index = 0;
+        size_t                         pool_index = 0;
+        long long                      connect_start_qpc = 0LL;
+
         //
         // static threadpool callback function
         //
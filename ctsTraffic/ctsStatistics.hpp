@@ -185,6 +185,10 @@ namespace ctsTraffic
         ctStatsTracking successful_completion_count;
         ctStatsTracking connection_error_count;
         ctStatsTracking protocol_error_count;
+        // IO completions tracked against the NUMA node of their connection (only on machines with more than one node)
+        // and how many of those completed on a processor of a different node
+        ctStatsTracking numa_tracked_completion_count;
+        ctStatsTracking cross_node_completion_count;
 
         explicit ctsConnectionStatistics(long long _start_time = 0LL) noexcept :
             start_time(_start_time),
@@ -192,7 +196,9 @@ namespace ctsTraffic
             active_connection_count(0LL),
             successful_completion_count(0LL),
             connection_error_count(0LL),
-            protocol_error_count(0LL)
+            protocol_error_count(0LL),
+            numa_tracked_completion_count(0LL),
+            cross_node_completion_count(0LL)
         {
         }
         ctsConnectionStatistics(const ctsConnectionStatistics&) = default;
@@ -220,6 +226,8 @@ namespace ctsTraffic
             return_stats.successful_completion_count.set(this->successful_completion_count.get());
             return_stats.connection_error_count.set(this->connection_error_count.get());
             return_stats.protocol_error_count.set(this->protocol_error_count.get());
+            return_stats.numa_tracked_completion_count.set(this->numa_tracked_completion_count.get());
+            return_stats.cross_node_completion_count.set(this->cross_node_completion_count.get());
 
             return return_stats;
         }
@@ -234,6 +242,9 @@ namespace ctsTraffic
         ctStatsTracking dropped_frames;
         ctStatsTracking duplicate_frames;
         ctStatsTracking error_frames;
+        // datagrams sent by the server and the number of calls made to submit them
+        ctStatsTracking datagrams_sent;
+        ctStatsTracking datagram_send_calls;
         // unique connection identifier
         char connection_identifier[ctsStatistics::ConnectionIdLength]{};
 
@@ -244,7 +255,9 @@ namespace ctsTraffic
             successful_frames(0LL),
             dropped_frames(0LL),
             duplicate_frames(0LL),
-            error_frames(0LL)
+            error_frames(0LL),
+            datagrams_sent(0LL),
+            datagram_send_calls(0LL)
         {
             connection_identifier[0] = '\0';
         }
@@ -258,7 +271,9 @@ namespace ctsTraffic
             successful_frames(_in.successful_frames),
             dropped_frames(_in.dropped_frames),
             duplicate_frames(_in.duplicate_frames),
-            error_frames(_in.error_frames)
+            error_frames(_in.error_frames),
+            datagrams_sent(_in.datagrams_sent),
+            datagram_send_calls(_in.datagram_send_calls)
         {
             // not needing to guard this string: it's created exactly once
             ::memcpy_s(connection_identifier, ctsStatistics::ConnectionIdLength, _in.connection_identifier, ctsStatistics::ConnectionIdLength);
@@ -291,6 +306,8 @@ namespace ctsTraffic
                 return_stats.dropped_frames.set(this->dropped_frames.snap_value_difference());
                 return_stats.duplicate_frames.set(this->duplicate_frames.snap_value_difference());
                 return_stats.error_frames.set(this->duplicate_frames.snap_value_difference());
+                return_stats.datagrams_sent.set(this->datagrams_sent.snap_value_difference());
+                return_stats.datagram_send_calls.set(this->datagram_send_calls.snap_value_difference());
 
             } else {
                 return_stats.bits_received.set(this->bits_received.read_value_difference());
@@ -298,6 +315,8 @@ namespace ctsTraffic
                 return_stats.dropped_frames.set(this->dropped_frames.read_value_difference());
                 return_stats.duplicate_frames.set(this->duplicate_frames.read_value_difference());
                 return_stats.error_frames.set(this->duplicate_frames.read_value_difference());
+                return_stats.datagrams_sent.set(this->datagrams_sent.read_value_difference());
+                return_stats.datagram_send_calls.set(this->datagram_send_calls.read_value_difference());
             }
 
             return return_stats;
@@ -310,6 +329,11 @@ namespace ctsTraffic
         ctStatsTracking end_time;
         ctStatsTracking bytes_sent;
         ctStatsTracking bytes_recv;
+        // IO requests submitted with RIO and the number of doorbells (non-deferred submissions and commits) it took
+        ctStatsTracking io_requests_submitted;
+        ctStatsTracking io_doorbells;
+        // with -RateLimit, the most bytes the connection sent ahead of its rate limit
+        ctStatsTracking send_burst_bytes;
         // unique connection identifier
         char connection_identifier[ctsStatistics::ConnectionIdLength]{};
 
@@ -317,7 +341,10 @@ namespace ctsTraffic
             start_time(_current_time),
             end_time(0LL),
             bytes_sent(0LL),
-            bytes_recv(0LL)
+            bytes_recv(0LL),
+            io_requests_submitted(0LL),
+            io_doorbells(0LL),
+            send_burst_bytes(0LL)
         {
             static const char * NULL_GUID_STRING = "00000000-0000-0000-0000-000000000000";
             ::strcpy_s(
@@ -331,7 +358,10 @@ namespace ctsTraffic
             start_time(_in.start_time),
             end_time(_in.end_time),
             bytes_sent(_in.bytes_sent),
-            bytes_recv(_in.bytes_recv)
+            bytes_recv(_in.bytes_recv),
+            io_requests_submitted(_in.io_requests_submitted),
+            io_doorbells(_in.io_doorbells),
+            send_burst_bytes(_in.send_burst_bytes)
         {
             // not needing to guard this string: it's created exactly once
             ::memcpy_s(connection_identifier, ctsStatistics::ConnectionIdLength, _in.connection_identifier, ctsStatistics::ConnectionIdLength);
@@ -362,10 +392,14 @@ namespace ctsTraffic
             if (_clear_settings) {
                 return_stats.bytes_sent.set(this->bytes_sent.snap_value_difference());
                 return_stats.bytes_recv.set(this->bytes_recv.snap_value_difference());
+                return_stats.io_requests_submitted.set(this->io_requests_submitted.snap_value_difference());
+                return_stats.io_doorbells.set(this->io_doorbells.snap_value_difference());
 
             } else {
                 return_stats.bytes_sent.set(this->bytes_sent.read_value_difference());
                 return_stats.bytes_recv.set(this->bytes_recv.read_value_difference());
+                return_stats.io_requests_submitted.set(this->io_requests_submitted.read_value_difference());
+                return_stats.io_doorbells.set(this->io_doorbells.read_value_difference());
             }
 
             return return_stats;
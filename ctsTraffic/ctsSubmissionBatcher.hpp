@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <array>
+#include <utility>
+// os headers
+#include <Windows.h>
+
+namespace ctsTraffic {
+    ///
+    /// The results of flushing a ctsSubmissionBatcher
+    /// - submitted : the requests accepted by the submitter
+    /// - doorbells : the calls that made requests visible to the kernel (non-deferred submissions and commits)
+    ///
+    struct ctsSubmissionResults {
+        unsigned long submitted = 0;
+        unsigned long doorbells = 0;
+    };
+
+    ///
+    /// Batches IO requests so that several requests can be handed to the kernel with a single doorbell per queue
+    /// - requests are queued as they are initiated, then submitted in order with flush()
+    /// - every request except the last one for its queue is submitted deferred:
+    ///   the final, non-deferred submission to each queue rings the doorbell for every request deferred before it
+    /// - if that final submission fails, the queue is explicitly committed so the deferred requests are not stranded
+    ///
+    /// Batches are bounded by MaxBatchSize: the caller must flush() once full() returns true
+    ///
+    /// The Submitter passed to flush() implements the backend, and must expose:
+    ///   static const size_t QueueCount;                       // the number of independent submission queues (e.g. send and receive)
+    ///   size_t queue_of(const Request&) const noexcept;       // the queue [0, QueueCount) the request is submitted to
+    ///   DWORD submit(Request&, bool _defer) noexcept;         // submits the request, deferring the doorbell if _defer is true
+    ///   DWORD commit(size_t _queue) noexcept;                 // rings the doorbell for requests already deferred on the queue
+    ///   void failed(Request&, DWORD _error) noexcept;         // invoked for each request which failed to be submitted
+    ///
+    template <typename Request, size_t MaxBatchSize>
+    class ctsSubmissionBatcher {
+    private:
+        std::array<Request, MaxBatchSize> requests{};
+        size_t queued = 0;
+
+    public:
+        ctsSubmissionBatcher() = default;
+
+        bool empty() const noexcept
+        {
+            return 0 == this->queued;
+        }
+
+        bool full() const noexcept
+        {
+            return MaxBatchSize == this->queued;
+        }
+
+        size_t size() const noexcept
+        {
+            return this->queued;
+        }
+
+        ///
+        /// Queues a request to be submitted with the next flush()
+        /// - the caller must have checked full() is false
+        ///
+        void queue(Request _request) noexcept
+        {
+            this->requests[this->queued] = std::move(_request);
+            ++this->queued;
+        }
+
+        ///
+        /// Submits every queued request, in the order queued, leaving the batch empty
+        ///
+        template <typename Submitter>
+        ctsSubmissionResults flush(Submitter& _submitter) noexcept
+        {
+            static const size_t NoRequest = MaxBatchSize;
+            ctsSubmissionResults results;
+
+            // find the last request for each queue: it's submitted without deferring to ring the doorbell
+            std::array<size_t, Submitter::QueueCount> last_request;
+            last_request.fill(NoRequest);
+            for (size_t request = 0; request < this->queued; ++request) {
+                last_request[_submitter.queue_of(this->requests[request])] = request;
+            }
+
+            std::array<bool, Submitter::QueueCount> deferred{};
+            for (size_t request = 0; request < this->queued; ++request) {
+                const size_t queue = _submitter.queue_of(this->requests[request]);
+                const bool defer = (request != last_request[queue]);
+
+                const DWORD error = _submitter.submit(this->requests[request], defer);
+                if (NO_ERROR == error) {
+                    ++results.submitted;
+                    if (defer) {
+                        deferred[queue] = true;
+                    } else {
+                        ++results.doorbells;
+                        deferred[queue] = false;
+                    }
+                } else {
+                    _submitter.failed(this->requests[request], error);
+                    // the doorbell will not be rung by a later request for this queue
+                    if (!defer && deferred[queue]) {
+                        if (NO_ERROR == _submitter.commit(queue)) {
+                            ++results.doorbells;
+                        }
+                        deferred[queue] = false;
+                    }
+                }
+            }
+
+            this->queued = 0;
+            return results;
+        }
+
+        // non-copyable
+        ctsSubmissionBatcher(const ctsSubmissionBatcher&) = delete;
+        ctsSubmissionBatcher& operator=(const ctsSubmissionBatcher&) = delete;
+        ctsSubmissionBatcher(ctsSubmissionBatcher&&) = delete;
+        ctsSubmissionBatcher& operator=(ctsSubmissionBatcher&&) = delete;
+    };
+}
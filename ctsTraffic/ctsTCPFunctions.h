@@ -26,9 +26,12 @@ namespace ctsTraffic {
     void ctsSimpleAccept(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
     
     void ctsAcceptEx(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+    void ctsAcceptLoop(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
     void ctsConnectEx(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
 
     void ctsReadWriteIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
     void ctsSendRecvIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+    void ctsSendRecvCoroutine(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
     void ctsRioIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+    void ctsRioPoll(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
 }
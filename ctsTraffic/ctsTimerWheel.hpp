@@ -0,0 +1,279 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <Windows.h>
+
+namespace ctsTraffic {
+    ///
+    /// An entry scheduled on a ctsTimerWheel
+    /// - owned by the caller, which must keep it alive while it's linked into a wheel or a list
+    ///
+    struct ctsTimerWheelEntry {
+        ctsTimerWheelEntry* next = nullptr;
+        ctsTimerWheelEntry* prev = nullptr;
+        long long due_tick = 0LL;
+    };
+
+    ///
+    /// An intrusive, circular, doubly-linked list of ctsTimerWheelEntry
+    ///
+    class ctsTimerWheelList {
+    public:
+        ctsTimerWheelList() noexcept
+        {
+            head.next = &head;
+            head.prev = &head;
+        }
+
+        bool empty() const noexcept
+        {
+            return head.next == &head;
+        }
+
+        void push_back(_Inout_ ctsTimerWheelEntry* _entry) noexcept
+        {
+            _entry->prev = head.prev;
+            _entry->next = &head;
+            head.prev->next = _entry;
+            head.prev = _entry;
+        }
+
+        ///
+        /// Returns nullptr if the list is empty
+        ///
+        ctsTimerWheelEntry* pop_front() noexcept
+        {
+            if (this->empty()) {
+                return nullptr;
+            }
+            ctsTimerWheelEntry* entry = head.next;
+            remove(entry);
+            return entry;
+        }
+
+        ///
+        /// Unlinks the entry from whichever list it's in
+        ///
+        static void remove(_Inout_ ctsTimerWheelEntry* _entry) noexcept
+        {
+            _entry->prev->next = _entry->next;
+            _entry->next->prev = _entry->prev;
+            _entry->next = nullptr;
+            _entry->prev = nullptr;
+        }
+
+        ///
+        /// Moves every entry from _list to the end of this list
+        ///
+        void splice(_Inout_ ctsTimerWheelList& _list) noexcept
+        {
+            if (_list.empty()) {
+                return;
+            }
+            _list.head.next->prev = head.prev;
+            head.prev->next = _list.head.next;
+            _list.head.prev->next = &head;
+            head.prev = _list.head.prev;
+            _list.head.next = &_list.head;
+            _list.head.prev = &_list.head;
+        }
+
+        // non-copyable: the entries point to the head
+        ctsTimerWheelList(const ctsTimerWheelList&) = delete;
+        ctsTimerWheelList& operator=(const ctsTimerWheelList&) = delete;
+        ctsTimerWheelList(ctsTimerWheelList&&) = delete;
+        ctsTimerWheelList& operator=(ctsTimerWheelList&&) = delete;
+
+    private:
+        ctsTimerWheelEntry head;
+    };
+
+    ///
+    /// A hierarchical timer wheel of ctsTimerWheelEntry
+    /// - the root level has a slot for each of the next RootSlots ticks
+    /// - each of the LevelCount - 1 coarser levels has LevelSlots slots, each spanning an entire turn of the level below
+    /// - entries in coarser levels are cascaded down a level as the wheel turns onto their slot
+    ///
+    /// Scheduling and cancelling are O(1), and advance() costs O(1) per tick plus the entries it expires
+    /// - entries due beyond MaxDelta ticks are held in the coarsest level and cascaded until they're in range
+    ///
+    /// This is not thread-safe: callers must serialize access
+    ///
+    class ctsTimerWheel {
+    public:
+        static const unsigned long RootBits = 8;
+        static const unsigned long RootSlots = 1UL << RootBits;
+        static const unsigned long LevelBits = 6;
+        static const unsigned long LevelSlots = 1UL << LevelBits;
+        static const unsigned long LevelCount = 4;
+        static const long long MaxDelta = 1LL << (RootBits + (LevelCount - 1) * LevelBits);
+
+        explicit ctsTimerWheel(long long _start_tick) noexcept : current_tick(_start_tick)
+        {
+        }
+
+        ///
+        /// Schedules the entry to expire at _due_tick
+        /// - an entry due before the current tick expires on the current tick
+        /// - the entry must not already be scheduled
+        ///
+        void schedule(_Inout_ ctsTimerWheelEntry* _entry, long long _due_tick) noexcept
+        {
+            _entry->due_tick = (_due_tick < this->current_tick) ? this->current_tick : _due_tick;
+            this->place(_entry);
+            ++this->scheduled_count;
+        }
+
+        ///
+        /// Removes a scheduled entry from the wheel
+        ///
+        void cancel(_Inout_ ctsTimerWheelEntry* _entry) noexcept
+        {
+            ctsTimerWheelList::remove(_entry);
+            --this->scheduled_count;
+        }
+
+        ///
+        /// Turns the wheel through _now_tick, moving every entry due by then to _expired
+        /// - entries are moved in the order they are due
+        ///
+        void advance(long long _now_tick, _Inout_ ctsTimerWheelList& _expired) noexcept
+        {
+            while (this->current_tick <= _now_tick) {
+                if (0 == this->scheduled_count) {
+                    // nothing to expire: jump straight to the next tick
+                    this->current_tick = _now_tick + 1;
+                    break;
+                }
+
+                const unsigned long root_index = static_cast<unsigned long>(this->current_tick & (RootSlots - 1));
+                if (0 == root_index) {
+                    // turned onto a new slot of each coarser level whose lower level has turned all the way around
+                    for (unsigned long level = 1; level < LevelCount; ++level) {
+                        const unsigned long level_index = slot_of(this->current_tick, level);
+                        this->cascade(level, level_index);
+                        if (level_index != 0) {
+                            break;
+                        }
+                    }
+                }
+
+                ctsTimerWheelList& root_slot = this->root[root_index];
+                while (!root_slot.empty()) {
+                    _expired.push_back(root_slot.pop_front());
+                    --this->scheduled_count;
+                }
+                ++this->current_tick;
+            }
+        }
+
+        ///
+        /// The next tick at which advance() needs to be called
+        /// - the tick the earliest entry is due, or the tick at which entries in a coarser level next need to be cascaded
+        /// - returns -1 if no entries are scheduled
+        ///
+        long long next_due_tick() const noexcept
+        {
+            if (0 == this->scheduled_count) {
+                return -1LL;
+            }
+
+            // root slots hold only entries due within RootSlots ticks of the current tick
+            const long long next_cascade_tick = (this->current_tick | (RootSlots - 1)) + 1;
+            for (long long tick = this->current_tick; tick < this->current_tick + static_cast<long long>(RootSlots); ++tick) {
+                if (tick == next_cascade_tick && this->coarse_entries()) {
+                    return next_cascade_tick;
+                }
+                if (!this->root[tick & (RootSlots - 1)].empty()) {
+                    return tick;
+                }
+            }
+            // only coarser levels have entries
+            return next_cascade_tick;
+        }
+
+        unsigned long size() const noexcept
+        {
+            return this->scheduled_count;
+        }
+
+        // non-copyable
+        ctsTimerWheel(const ctsTimerWheel&) = delete;
+        ctsTimerWheel& operator=(const ctsTimerWheel&) = delete;
+        ctsTimerWheel(ctsTimerWheel&&) = delete;
+        ctsTimerWheel& operator=(ctsTimerWheel&&) = delete;
+
+    private:
+        // the next tick to be expired: every tick before it has been
+        long long current_tick;
+        unsigned long scheduled_count = 0;
+
+        ctsTimerWheelList root[RootSlots];
+        ctsTimerWheelList levels[LevelCount - 1][LevelSlots];
+
+        // the number of ticks covered by one slot at the level
+        static long long span_of(unsigned long _level) noexcept
+        {
+            return 1LL << (RootBits + (_level - 1) * LevelBits);
+        }
+
+        static unsigned long slot_of(long long _tick, unsigned long _level) noexcept
+        {
+            return static_cast<unsigned long>((_tick >> (RootBits + (_level - 1) * LevelBits)) & (LevelSlots - 1));
+        }
+
+        void place(_Inout_ ctsTimerWheelEntry* _entry) noexcept
+        {
+            // an entry too far out is held at the furthest tick in range: it's placed again as it's cascaded
+            long long placed_tick = _entry->due_tick;
+            if (placed_tick - this->current_tick >= MaxDelta) {
+                placed_tick = this->current_tick + MaxDelta - 1;
+            }
+
+            const long long delta = placed_tick - this->current_tick;
+            if (delta < static_cast<long long>(RootSlots)) {
+                this->root[placed_tick & (RootSlots - 1)].push_back(_entry);
+                return;
+            }
+            unsigned long level = 1;
+            while (level < LevelCount - 1 && delta >= span_of(level + 1)) {
+                ++level;
+            }
+            this->levels[level - 1][slot_of(placed_tick, level)].push_back(_entry);
+        }
+
+        void cascade(unsigned long _level, unsigned long _index) noexcept
+        {
+            ctsTimerWheelList cascading;
+            cascading.splice(this->levels[_level - 1][_index]);
+            while (!cascading.empty()) {
+                this->place(cascading.pop_front());
+            }
+        }
+
+        bool coarse_entries() const noexcept
+        {
+            for (const auto& level : this->levels) {
+                for (const auto& slot : level) {
+                    if (!slot.empty()) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+    };
+}
@@ -0,0 +1,111 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <cmath>
+
+namespace ctsTraffic {
+    ///
+    /// A token bucket pacing sends to a rate in bytes/second, allowing bursts of up to burst_bytes
+    /// - the bucket fills at the rate, holding at most burst_bytes: it starts full
+    /// - a send starts once the bucket holds tokens for all of its bytes
+    /// - a send larger than the bucket starts once the bucket is full, leaving it in debt for the sends after it
+    ///
+    /// Times are in nanoseconds, kept relative to the start time so a double holds them well under 1 ns
+    ///
+    class ctsTokenBucket {
+    public:
+        ctsTokenBucket(long long _bytes_per_second, long long _burst_bytes, long long _start_ns) noexcept :
+            ns_per_byte(_bytes_per_second > 0 ? 1000000000.0 / static_cast<double>(_bytes_per_second) : 0.0),
+            burst_ns(static_cast<double>(_burst_bytes > 0 ? _burst_bytes : 0) * ns_per_byte),
+            start_ns(_start_ns),
+            debt_paid_ns(-burst_ns)
+        {
+        }
+
+        ///
+        /// Returns the nanoseconds from _now_ns to wait before sending _bytes, taking their tokens from the bucket
+        ///
+        long long delay_for(long long _bytes, long long _now_ns) noexcept
+        {
+            const double now = static_cast<double>(_now_ns - this->start_ns);
+            const double send_ns = static_cast<double>(_bytes) * this->ns_per_byte;
+            const double tokens_needed_ns = (send_ns < this->burst_ns) ? send_ns : this->burst_ns;
+            const double send_time = (now > this->debt_paid_ns + tokens_needed_ns) ? now : this->debt_paid_ns + tokens_needed_ns;
+
+            // the bucket holds at most burst_ns worth of tokens
+            if (this->debt_paid_ns < send_time - this->burst_ns) {
+                this->debt_paid_ns = send_time - this->burst_ns;
+            }
+            this->debt_paid_ns += send_ns;
+
+            return static_cast<long long>(std::ceil(send_time - now));
+        }
+
+    private:
+        const double ns_per_byte;
+        const double burst_ns;
+        const long long start_ns;
+        // the time at which the bucket is no longer in debt
+        double debt_paid_ns;
+    };
+
+    ///
+    /// Measures how bursty sends are against a target rate in bytes/second
+    /// - the burst is the most bytes sent ahead of the target rate at any time,
+    ///   which is the smallest bucket a token bucket at that rate could have sent them from
+    /// - a perfectly paced connection still measures one send: each send's bytes all leave at once
+    ///
+    class ctsBurstMeter {
+    public:
+        ctsBurstMeter(long long _bytes_per_second, long long _start_ns) noexcept :
+            ns_per_byte(_bytes_per_second > 0 ? 1000000000.0 / static_cast<double>(_bytes_per_second) : 0.0),
+            start_ns(_start_ns)
+        {
+        }
+
+        void record(long long _bytes, long long _now_ns) noexcept
+        {
+            const double now = static_cast<double>(_now_ns - this->start_ns);
+            // the bytes sent ahead of the rate drain at the rate
+            this->backlog_ns -= now - this->last_ns;
+            if (this->backlog_ns < 0.0) {
+                this->backlog_ns = 0.0;
+            }
+            this->backlog_ns += static_cast<double>(_bytes) * this->ns_per_byte;
+            this->last_ns = now;
+
+            if (this->backlog_ns > this->max_backlog_ns) {
+                this->max_backlog_ns = this->backlog_ns;
+            }
+        }
+
+        long long max_burst_bytes() const noexcept
+        {
+            if (0.0 == this->ns_per_byte) {
+                return 0LL;
+            }
+            return static_cast<long long>(std::llround(this->max_backlog_ns / this->ns_per_byte));
+        }
+
+    private:
+        const double ns_per_byte;
+        const long long start_ns;
+        double last_ns = 0.0;
+        // the bytes sent ahead of the rate, in the nanoseconds the rate takes to send them
+        double backlog_ns = 0.0;
+        double max_backlog_ns = 0.0;
+    };
+}
@@ -24,6 +24,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctThreadPoolTimer.hpp>
 // local headers
 #include "ctsConfig.h"
+#include "ctsIOPattern.h"
+#include "ctsLargePages.hpp"
 #include "ctsSocketBroker.h"
 
 using namespace ctsTraffic;
@@ -152,9 +154,32 @@ __cdecl wmain(int argc, _In_reads_z_(argc) const wchar_t** argv)
             L"  Total Bytes Sent : %lld\n",
             ctsConfig::Settings->TcpStatusDetails.bytes_recv.get(),
             ctsConfig::Settings->TcpStatusDetails.bytes_sent.get());
+        // only RIO batches IO requests: report how many doorbells it took to submit them
+        const auto io_requests_submitted = ctsConfig::Settings->TcpStatusDetails.io_requests_submitted.get();
+        if (io_requests_submitted > 0) {
+            const auto io_doorbells = ctsConfig::Settings->TcpStatusDetails.io_doorbells.get();
+            ctsConfig::PrintSummary(
+                L"  Total IO Requests Submitted : %lld\n"
+                L"  Total IO Doorbells : %lld\n"
+                L"  Doorbells Per IO : %.2f\n",
+                io_requests_submitted,
+                io_doorbells,
+                static_cast<double>(io_doorbells) / static_cast<double>(io_requests_submitted));
+        }
     } else {
-        // currently don't track UDP server stats
-        if (!ctsConfig::IsListening()) {
+        if (ctsConfig::IsListening()) {
+            // the server only tracks how many datagrams were sent and how many send calls it took
+            const auto datagrams_sent = ctsConfig::Settings->UdpStatusDetails.datagrams_sent.get();
+            const auto datagram_send_calls = ctsConfig::Settings->UdpStatusDetails.datagram_send_calls.get();
+            ctsConfig::PrintSummary(
+                L"\n"
+                L"  Total Datagrams Sent : %lld\n"
+                L"  Total Datagram Send Calls : %lld\n"
+                L"  Datagrams Per Send Call : %.2f\n",
+                datagrams_sent,
+                datagram_send_calls,
+                datagram_send_calls > 0 ? static_cast<double>(datagrams_sent) / static_cast<double>(datagram_send_calls) : 0.0);
+        } else {
             ctsConfig::PrintSummary(
                 L"\n"
                 L"  Total Bytes Recv : %lld\n"
@@ -169,9 +194,85 @@ __cdecl wmain(int argc, _In_reads_z_(argc) const wchar_t** argv)
                 ctsConfig::Settings->UdpStatusDetails.error_frames.get());
         }
     }
+    // completions are only tracked against the NUMA node of their connection on machines with more than one node
+    const auto numa_tracked_completions = ctsConfig::Settings->ConnectionStatusDetails.numa_tracked_completion_count.get();
+    if (numa_tracked_completions > 0) {
+        const auto cross_node_completions = ctsConfig::Settings->ConnectionStatusDetails.cross_node_completion_count.get();
+        ctsConfig::PrintSummary(
+            L"  Cross-Node IO Completions : %lld of %lld (%.2f%%)\n",
+            cross_node_completions,
+            numa_tracked_completions,
+            static_cast<double>(cross_node_completions) * 100.0 / static_cast<double>(numa_tracked_completions));
+    }
+    // recv buffers are borrowed from slabs shared across connections: report how full each grew and how often buffers were reused
+    for (const auto& slab_statistics : ctsIOPattern::RecvBufferSlabStatistics()) {
+        ctsConfig::PrintSummary(
+            L"  Recv Buffer Slab [%lu bytes] : Borrowed [%llu] Reused [%.2f%%] Peak In Use [%lu] of [%lu] Committed Fallbacks [%llu]\n",
+            slab_statistics.buffer_length,
+            slab_statistics.allocations,
+            slab_statistics.allocations > 0 ? static_cast<double>(slab_statistics.reused_allocations) * 100.0 / static_cast<double>(slab_statistics.allocations) : 0.0,
+            slab_statistics.peak_outstanding_buffers,
+            slab_statistics.peak_committed_buffers,
+            slab_statistics.failed_allocations);
+    }
+    // with -LargePages, report the TLB reach gained at the peak of what large pages mapped
+    // - each large page takes a single TLB entry, where the same memory on standard pages takes one per page
+    if (ctsConfig::Settings->LargePageSize > 0) {
+        const auto& large_page_statistics = ctsLargePages::Statistics();
+        ::SYSTEM_INFO system_info;
+        ::GetSystemInfo(&system_info);
+        const long long peak_large_page_bytes = large_page_statistics.peak_large_page_bytes;
+        ctsConfig::PrintSummary(
+            L"  Large Pages : Peak [%lld bytes] mapped by [%lld] TLB entries instead of [%lld] Fallbacks to standard pages [%lld] (%lld bytes)\n",
+            peak_large_page_bytes,
+            peak_large_page_bytes / static_cast<long long>(ctsConfig::Settings->LargePageSize),
+            peak_large_page_bytes / static_cast<long long>(system_info.dwPageSize),
+            static_cast<long long>(large_page_statistics.fallback_count),
+            static_cast<long long>(large_page_statistics.fallback_bytes));
+    }
     ctsConfig::PrintSummary(
         L"  Total Time : %lld ms.\n",
         static_cast<long long>(total_time_run));
+    if (total_time_run > 0) {
+        ctsConfig::PrintSummary(
+            L"  Connections Per Second : %.2f\n",
+            static_cast<double>(ctsConfig::Settings->ConnectionStatusDetails.successful_completion_count.get()) * 1000.0 / static_cast<double>(total_time_run));
+    }
+
+    // with -ConnectionRate, report how well connection setup kept up with the schedule
+    if (ctsConfig::Settings->ConnectionRateHigh > 0) {
+        const auto& rate_details = ctsConfig::Settings->ConnectionRateDetails;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Connection Rate Statistics\n"
+            L"  Total Connected : %lld\n"
+            L"  Total Connect Errors : %lld\n",
+            static_cast<long long>(rate_details.connected_count),
+            static_cast<long long>(rate_details.connect_error_count));
+        if (rate_details.last_connected_ms > 0) {
+            ctsConfig::PrintSummary(
+                L"  Achieved Connections Per Second : %.2f\n",
+                static_cast<double>(rate_details.connected_count) * 1000.0 / static_cast<double>(rate_details.last_connected_ms));
+        }
+        if (rate_details.connect_latency_usec.count() > 0) {
+            ctsConfig::PrintSummary(
+                L"  Connect Latency (usec) : p50 [%lld] p90 [%lld] p99 [%lld] p99.9 [%lld]\n",
+                rate_details.connect_latency_usec.percentile(50.0),
+                rate_details.connect_latency_usec.percentile(90.0),
+                rate_details.connect_latency_usec.percentile(99.0),
+                rate_details.connect_latency_usec.percentile(99.9));
+        }
+        if (rate_details.first_connect_error_ms >= 0) {
+            const ctsConnectionRateSchedule rate_schedule(
+                ctsConfig::Settings->ConnectionRateLow,
+                ctsConfig::Settings->ConnectionRateHigh,
+                ctsConfig::Settings->ConnectionRateRampSeconds * 1000LL);
+            ctsConfig::PrintSummary(
+                L"  Connect Errors Began At : %.2f connections per second (%lld ms.)\n",
+                rate_schedule.rate_at(rate_details.first_connect_error_ms),
+                static_cast<long long>(rate_details.first_connect_error_ms));
+        }
+    }
 
     long long error_count =
         ctsConfig::Settings->ConnectionStatusDetails.connection_error_count.get() +
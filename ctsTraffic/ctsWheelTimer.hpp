@@ -0,0 +1,330 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <vector>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctTimer.hpp>
+// project headers
+#include "ctsConfig.h"
+#include "ctsTimerWheel.hpp"
+
+namespace ctsTraffic {
+    class ctsProcessorTimerWheel;
+
+    typedef void (*ctsWheelTimerCallback)(_In_opt_ PVOID _context) noexcept;
+
+    ///
+    /// A one-shot timer run from the shared timer wheel of the processor on which it was created
+    /// - a drop-in for a PTP_TIMER: set() re-arms it, cancel() stops it and waits for a running callback
+    /// - every timer due on a processor's wheel in the same tick is expired by the same threadpool timer callback,
+    ///   so thousands of timers cost one threadpool timer per processor rather than one each
+    ///
+    class ctsWheelTimer : private ctsTimerWheelEntry {
+    public:
+        // can throw ctl::ctException or std::bad_alloc
+        ctsWheelTimer(ctsWheelTimerCallback _callback, _In_opt_ PVOID _context);
+        ~ctsWheelTimer() noexcept
+        {
+            this->cancel();
+        }
+
+        ///
+        /// Runs the callback _delay_milliseconds from now, replacing the time it was last set to run
+        ///
+        void set(long long _delay_milliseconds) noexcept;
+
+        ///
+        /// Stops the callback from running, waiting for it to return if it's already running
+        /// - can be called from the callback itself, in which case it does not wait
+        ///
+        void cancel() noexcept;
+
+        // non-copyable
+        ctsWheelTimer(const ctsWheelTimer&) = delete;
+        ctsWheelTimer& operator=(const ctsWheelTimer&) = delete;
+        ctsWheelTimer(ctsWheelTimer&&) = delete;
+        ctsWheelTimer& operator=(ctsWheelTimer&&) = delete;
+
+    private:
+        friend class ctsProcessorTimerWheel;
+
+        enum class State {
+            Idle,
+            Scheduled,
+            Expired,
+            // expired while its callback was still running: it's expired again once that callback returns
+            Deferred
+        };
+
+        ctsProcessorTimerWheel& wheel;
+        const ctsWheelTimerCallback callback;
+        const PVOID context;
+        // guarded by the wheel's lock
+        State state = State::Idle;
+        bool running = false;
+    };
+
+    ///
+    /// The timer wheel shared by every ctsWheelTimer created on one processor
+    /// - the wheel turns in ticks of 1 ms, driven by a single threadpool timer set for the next tick with work due
+    /// - each threadpool timer callback expires every timer due, then submits a threadpool work callback for each
+    ///   so a slow callback doesn't hold up the other timers due in the same tick
+    ///
+    class ctsProcessorTimerWheel {
+    public:
+        ///
+        /// The wheel for the processor the calling thread is running on
+        /// - the wheels are created on first use and live for the life of the process:
+        ///   their threadpool callbacks can still be running as the process exits
+        ///
+        /// - can throw ctl::ctException or std::bad_alloc
+        ///
+        static ctsProcessorTimerWheel& for_current_processor()
+        {
+            static const std::vector<ctsProcessorTimerWheel*>& wheels = *create_wheels();
+
+            PROCESSOR_NUMBER processor;
+            ::GetCurrentProcessorNumberEx(&processor);
+            size_t wheel_index = processor.Number;
+            for (WORD group = 0; group < processor.Group; ++group) {
+                wheel_index += ::GetActiveProcessorCount(group);
+            }
+            return *wheels[wheel_index % wheels.size()];
+        }
+
+        // can throw ctl::ctException
+        explicit ctsProcessorTimerWheel(PTP_CALLBACK_ENVIRON _tp_environment) :
+            wheel(ctl::ctTimer::snap_qpc_as_msec())
+        {
+            this->tp_work = ::CreateThreadpoolWork(WorkCallback, this, _tp_environment);
+            if (nullptr == this->tp_work) {
+                throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsProcessorTimerWheel", false);
+            }
+            this->tp_timer = ::CreateThreadpoolTimer(TimerCallback, this, _tp_environment);
+            if (nullptr == this->tp_timer) {
+                const auto gle = ::GetLastError();
+                ::CloseThreadpoolWork(this->tp_work);
+                throw ctl::ctException(gle, L"CreateThreadpoolTimer", L"ctsProcessorTimerWheel", false);
+            }
+        }
+
+        ~ctsProcessorTimerWheel() noexcept
+        {
+            ::SetThreadpoolTimer(this->tp_timer, nullptr, 0, 0);
+            ::WaitForThreadpoolTimerCallbacks(this->tp_timer, TRUE);
+            ::CloseThreadpoolTimer(this->tp_timer);
+            ::WaitForThreadpoolWorkCallbacks(this->tp_work, TRUE);
+            ::CloseThreadpoolWork(this->tp_work);
+        }
+
+        void set(_Inout_ ctsWheelTimer* _timer, long long _delay_milliseconds) noexcept
+        {
+            const long long now_tick = ctl::ctTimer::snap_qpc_as_msec();
+            const long long due_tick = now_tick + ((_delay_milliseconds > 0) ? _delay_milliseconds : 0);
+
+            ::AcquireSRWLockExclusive(&this->lock);
+            this->unlink(_timer);
+            this->wheel.schedule(_timer, due_tick);
+            _timer->state = ctsWheelTimer::State::Scheduled;
+            if (this->armed_tick < 0 || due_tick < this->armed_tick) {
+                this->arm(due_tick, now_tick);
+            }
+            ::ReleaseSRWLockExclusive(&this->lock);
+        }
+
+        void cancel(_Inout_ ctsWheelTimer* _timer) noexcept
+        {
+            ::AcquireSRWLockExclusive(&this->lock);
+            this->unlink(_timer);
+            _timer->state = ctsWheelTimer::State::Idle;
+            if (_timer->running) {
+                if (running_timer() == _timer) {
+                    // cancelled from its own callback: the timer may be deleted once its callback returns
+                    _timer->running = false;
+                    running_timer() = nullptr;
+                } else {
+                    while (_timer->running) {
+                        ::SleepConditionVariableSRW(&this->callback_returned, &this->lock, INFINITE, 0);
+                    }
+                }
+            }
+            ::ReleaseSRWLockExclusive(&this->lock);
+        }
+
+        // non-copyable
+        ctsProcessorTimerWheel(const ctsProcessorTimerWheel&) = delete;
+        ctsProcessorTimerWheel& operator=(const ctsProcessorTimerWheel&) = delete;
+        ctsProcessorTimerWheel(ctsProcessorTimerWheel&&) = delete;
+        ctsProcessorTimerWheel& operator=(ctsProcessorTimerWheel&&) = delete;
+
+    private:
+        SRWLOCK lock = SRWLOCK_INIT;
+        // signaled each time a callback returns, for cancel() to wait on a running callback
+        CONDITION_VARIABLE callback_returned = CONDITION_VARIABLE_INIT;
+        PTP_TIMER tp_timer = nullptr;
+        // submitted once for each timer expired: each callback runs the next expired timer
+        PTP_WORK tp_work = nullptr;
+
+        _Guarded_by_(lock) ctsTimerWheel wheel;
+        // timers expired from the wheel, waiting to be run by a work callback
+        _Guarded_by_(lock) ctsTimerWheelList expired;
+        // the tick tp_timer is set to fire: -1 when not set
+        _Guarded_by_(lock) long long armed_tick = -1LL;
+
+        // the timer whose callback is running on this thread: cleared if it's cancelled from that callback
+        static ctsWheelTimer*& running_timer() noexcept
+        {
+            static thread_local ctsWheelTimer* timer = nullptr;
+            return timer;
+        }
+
+        static std::vector<ctsProcessorTimerWheel*>* create_wheels()
+        {
+            const DWORD processor_count = ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+            std::vector<std::unique_ptr<ctsProcessorTimerWheel>> created_wheels;
+            created_wheels.reserve(processor_count);
+            for (DWORD processor = 0; processor < processor_count; ++processor) {
+                created_wheels.push_back(std::make_unique<ctsProcessorTimerWheel>(ctsConfig::Settings->PTPEnvironment));
+            }
+
+            // deliberately never deleted
+            auto wheels = std::make_unique<std::vector<ctsProcessorTimerWheel*>>();
+            wheels->reserve(processor_count);
+            for (auto& wheel : created_wheels) {
+                wheels->push_back(wheel.release());
+            }
+            return wheels.release();
+        }
+
+        _Requires_lock_held_(lock)
+        void unlink(_Inout_ ctsWheelTimer* _timer) noexcept
+        {
+            switch (_timer->state) {
+                case ctsWheelTimer::State::Scheduled:
+                    this->wheel.cancel(_timer);
+                    break;
+                case ctsWheelTimer::State::Expired:
+                    ctsTimerWheelList::remove(_timer);
+                    break;
+                default:
+                    // Idle or Deferred: not linked into the wheel
+                    break;
+            }
+        }
+
+        _Requires_lock_held_(lock)
+        void arm(long long _due_tick, long long _now_tick) noexcept
+        {
+            const long long delay = (_due_tick > _now_tick) ? _due_tick - _now_tick : 0LL;
+            FILETIME due_time(ctl::ctTimer::convert_msec_relative_filetime(delay));
+            ::SetThreadpoolTimer(this->tp_timer, &due_time, 0, 0);
+            this->armed_tick = _due_tick;
+        }
+
+        static VOID CALLBACK TimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER) noexcept
+        {
+            auto* this_ptr = static_cast<ctsProcessorTimerWheel*>(_context);
+
+            ::AcquireSRWLockExclusive(&this_ptr->lock);
+            this_ptr->armed_tick = -1LL;
+
+            ctsTimerWheelList due;
+            this_ptr->wheel.advance(ctl::ctTimer::snap_qpc_as_msec(), due);
+            unsigned long due_count = 0;
+            while (auto* due_entry = due.pop_front()) {
+                static_cast<ctsWheelTimer*>(due_entry)->state = ctsWheelTimer::State::Expired;
+                this_ptr->expired.push_back(due_entry);
+                ++due_count;
+            }
+
+            const long long next_due_tick = this_ptr->wheel.next_due_tick();
+            if (next_due_tick >= 0) {
+                this_ptr->arm(next_due_tick, ctl::ctTimer::snap_qpc_as_msec());
+            }
+
+            // a callback for each: a work callback which finds its timer was cancelled just returns
+            for (unsigned long submitted = 0; submitted < due_count; ++submitted) {
+                ::SubmitThreadpoolWork(this_ptr->tp_work);
+            }
+            ::ReleaseSRWLockExclusive(&this_ptr->lock);
+        }
+
+        static VOID CALLBACK WorkCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_WORK) noexcept
+        {
+            auto* this_ptr = static_cast<ctsProcessorTimerWheel*>(_context);
+
+            ::AcquireSRWLockExclusive(&this_ptr->lock);
+            ctsWheelTimer* timer = nullptr;
+            while (auto* expired_entry = this_ptr->expired.pop_front()) {
+                auto* expired_timer = static_cast<ctsWheelTimer*>(expired_entry);
+                if (expired_timer->running) {
+                    // set again and expired before its last callback returned: it's run once that callback returns
+                    expired_timer->state = ctsWheelTimer::State::Deferred;
+                    continue;
+                }
+                timer = expired_timer;
+                break;
+            }
+            if (nullptr == timer) {
+                ::ReleaseSRWLockExclusive(&this_ptr->lock);
+                return;
+            }
+
+            timer->state = ctsWheelTimer::State::Idle;
+            timer->running = true;
+            running_timer() = timer;
+
+            // never hold the lock while calling out: the callback can set or cancel timers on this wheel
+            ::ReleaseSRWLockExclusive(&this_ptr->lock);
+            timer->callback(timer->context);
+            ::AcquireSRWLockExclusive(&this_ptr->lock);
+
+            // running_timer is cleared if the callback cancelled its own timer: it can no longer be touched
+            if (running_timer() == timer) {
+                timer->running = false;
+                if (ctsWheelTimer::State::Deferred == timer->state) {
+                    timer->state = ctsWheelTimer::State::Expired;
+                    this_ptr->expired.push_back(timer);
+                    ::SubmitThreadpoolWork(this_ptr->tp_work);
+                }
+            }
+            running_timer() = nullptr;
+            ::WakeAllConditionVariable(&this_ptr->callback_returned);
+            ::ReleaseSRWLockExclusive(&this_ptr->lock);
+        }
+    };
+
+    inline ctsWheelTimer::ctsWheelTimer(ctsWheelTimerCallback _callback, _In_opt_ PVOID _context) :
+        wheel(ctsProcessorTimerWheel::for_current_processor()),
+        callback(_callback),
+        context(_context)
+    {
+    }
+
+    inline void ctsWheelTimer::set(long long _delay_milliseconds) noexcept
+    {
+        this->wheel.set(this, _delay_milliseconds);
+    }
+
+    inline void ctsWheelTimer::cancel() noexcept
+    {
+        this->wheel.cancel(this);
+    }
+}
@@ -22,6 +22,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ctl headers
 #include <ctSockaddr.hpp>
 #include <ctThreadIocp.hpp>
+#include <ctSocketExtensions.hpp>
 
 // project headers
 #include "ctsWinsockLayer.h"
@@ -93,6 +94,58 @@ namespace ctsTraffic {
         return return_result;
     }
 
+    ///
+    /// WSARecvMsg
+    ///
+    wsIOResult ctsWSARecvMsg(
+        const std::shared_ptr<ctsSocket>& _shared_socket,
+        _Inout_ WSAMSG* _message,
+        std::function<void(OVERLAPPED*)>&& _callback) noexcept
+    {
+        const auto socket_lock(ctsGuardSocket(_shared_socket));
+        const SOCKET socket = socket_lock.get();
+        if (INVALID_SOCKET == socket) {
+            return wsIOResult(WSAECONNABORTED);
+        }
+
+        wsIOResult return_result;
+        try {
+            const auto& io_thread_pool = _shared_socket->thread_pool();
+            OVERLAPPED* pov = io_thread_pool->new_request(std::move(_callback));
+
+            _message->dwFlags = 0;
+            if (ctl::ctWSARecvMsg(socket, _message, nullptr, pov, nullptr) != 0) {
+                return_result.error_code = ::WSAGetLastError();
+                // IO pended == successfully initiating the IO
+                if (return_result.error_code != WSA_IO_PENDING) {
+                    // must cancel the IOCP TP if the IO call fails
+                    io_thread_pool->cancel_request(pov);
+                }
+                // will return WSA_IO_PENDING transparently to the caller
+
+            } else {
+                if (ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP) {
+                    return_result.error_code = ERROR_SUCCESS;
+                    // OVERLAPPED.InternalHigh == the number of bytes transferred for the I/O request.
+                    // - this member is set when the request is completed inline
+                    return_result.bytes_transferred = static_cast<unsigned long>(pov->InternalHigh);
+                    // completed inline, so the TP won't be notified
+                    io_thread_pool->cancel_request(pov);
+                } else {
+                    // WSARecvMsg returned success, but inline completions is not enabled
+                    // so the IOCP callback will be invoked - thus will return WSA_IO_PENDING
+                    return_result.error_code = WSA_IO_PENDING;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            ctsConfig::PrintException(e);
+            return wsIOResult(WSAENOBUFS);
+        }
+
+        return return_result;
+    }
+
     ///
     /// WSASendTo
     ///
@@ -52,6 +52,15 @@ namespace ctsTraffic {
         const ctsIOTask& _task,
         std::function<void(OVERLAPPED*)>&& _callback) noexcept;
 
+    //
+    // WSARecvMsg
+    // - _message and the buffers it references must stay valid until the IO completes
+    //
+    wsIOResult ctsWSARecvMsg(
+        const std::shared_ptr<ctsSocket>& _shared_socket,
+        _Inout_ WSAMSG* _message,
+        std::function<void(OVERLAPPED*)>&& _callback) noexcept;
+
     //
     // WSASendTo
     //